@@ -0,0 +1,30 @@
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace GLEngine {
+	/**
+	 * @brief Heap allocations made through operator new since the start of the program.
+	 *
+	 * Linking the counter replaces the global operator new and delete with versions counting the
+	 * calls, the difference of two counts gives what a piece of code allocated. Direct malloc()
+	 * calls (C libraries, the driver) are not seen.
+	 */
+	struct AllocationCount {
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+
+		AllocationCount operator-(const AllocationCount& other) const {
+			AllocationCount difference;
+			difference.count = count - other.count;
+			difference.bytes = bytes - other.bytes;
+			return difference;
+		}
+	};
+
+	// All threads together
+	AllocationCount getAllocationCount();
+}
+#endif
@@ -0,0 +1,79 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Linear allocator: allocations are carved one after the other out of large blocks and
+	 * are all released together by reset().
+	 *
+	 * Meant for temporaries whose lives end at the same time, like the parsing of a file or the
+	 * data of a frame. reset() merges the blocks into one as large as all of them, so an arena
+	 * reset every frame stops calling the heap once it has seen its largest frame. Only the last
+	 * allocation gives its space back when freed: a growing vector leaves its previous storage
+	 * behind, so it is better reserved. Not thread safe.
+	 */
+	class Arena {
+	public:
+		explicit Arena(size_t blockSize = 64 << 10);
+		~Arena();
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+		// Only the last allocation is given back, the others wait for reset()
+		void deallocate(void* pointer, size_t bytes);
+		template<class T>
+		T* allocateArray(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+		void reset();
+
+		size_t getUsed() const { return used; }           // Bytes handed out since the last reset()
+		size_t getPeak() const { return peak; }           // Largest getUsed() so far
+		size_t getCapacity() const;                        // Bytes of the blocks
+		size_t getBlockCount() const { return blocks.size(); }
+
+	private:
+		struct Block {
+			uint8_t* data;
+			size_t size;
+		};
+
+		std::vector<Block> blocks;
+		size_t blockSize;
+		size_t offset;        // In the last block
+		size_t used, peak;
+	};
+
+	/**
+	 * @brief Standard allocator over an Arena, for the containers of the temporaries.
+	 */
+	template<class T>
+	class ArenaAllocator {
+	public:
+		typedef T value_type;
+
+		ArenaAllocator(Arena& arena) noexcept : arena(&arena) {}
+		template<class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+		T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+		void deallocate(T* pointer, size_t count) noexcept { arena->deallocate(pointer, count * sizeof(T)); }
+
+		template<class U>
+		bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+		template<class U>
+		bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+		Arena* arena;
+	};
+
+	// Emptied before its arena is reset, never kept past it
+	template<class T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
+#endif
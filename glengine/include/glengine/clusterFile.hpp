@@ -0,0 +1,141 @@
+#ifndef CLUSTER_FILE_HPP
+#define CLUSTER_FILE_HPP
+
+#include <glengine/culling.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Piece of a clustered mesh at one level of detail, as stored in a cluster file.
+	 *
+	 * The clusters form a tree: the root is the whole mesh at its coarsest, the children of a
+	 * cluster cover the same surface with more triangles, the leaves are the original triangles.
+	 * Children are consecutive records. The vertices (positions then normals, 3 floats each) and
+	 * the 16-bit indices of a cluster are stored together at its offset.
+	 */
+	struct ClusterRecord {
+		float boundsMin[3];
+		float boundsMax[3];
+		float error;                // Largest distance to the original surface (cell size), 0 for the leaves
+		uint32_t level;             // 0 for the leaves
+		int32_t parent;             // -1 for the root
+		uint32_t firstChild;
+		uint32_t childCount;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		uint32_t padding;
+		uint64_t offset;
+
+		AABB getBounds() const;
+		size_t getDataBytes() const { return (size_t)vertexCount * 6 * sizeof(float) + (size_t)triangleCount * 3 * sizeof(uint16_t); }
+	};
+
+	// Geometry of one cluster, indices relative to its own vertices
+	struct ClusterGeometry {
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<uint16_t> indices;
+
+		size_t getVertexCount() const { return positions.size() / 3; }
+		size_t getTriangleCount() const { return indices.size() / 3; }
+	};
+
+	struct ClusterBuildSettings {
+		int maxTriangles = 1024;    // Per cluster, leaves and coarser levels alike
+		int groupSize = 4;          // Children merged into each coarser cluster
+	};
+
+	struct ClusterBuildStats {
+		size_t leafTriangles = 0;
+		size_t clusters = 0, leaves = 0;
+		size_t triangles = 0;       // Of every level
+		uint32_t levels = 0;
+		size_t bytes = 0;
+		double buildMs = 0.0;
+	};
+
+	/**
+	 * @brief Writes a cluster file from its leaves, building the coarser levels meanwhile.
+	 *
+	 * The leaves are given in spatial order (along a Morton curve for instance): every groupSize
+	 * consecutive clusters of a level are merged then simplified into one cluster of the next
+	 * level, as soon as they are all there. Only the pending clusters of each level are kept in
+	 * memory, the geometry goes to the file at once. Simplification snaps the vertices to a grid
+	 * whose cell is a power of two, aligned on the origin, so two neighbors simplified with the
+	 * same cell share their border vertices.
+	 */
+	class ClusterWriter {
+	public:
+		ClusterWriter(const std::string& path, const ClusterBuildSettings& settings = ClusterBuildSettings());
+
+		bool isOpen() const { return file.is_open() && !failed; }
+		void addLeaf(ClusterGeometry geometry);
+		// Merges what is pending up to a single root, writes the records. False on a write error.
+		bool finish();
+		const ClusterBuildStats& getStats() const { return stats; }
+
+	private:
+		struct Pending {
+			uint32_t id;
+			ClusterGeometry geometry;
+		};
+
+		uint32_t write(const ClusterGeometry& geometry, float error, uint32_t level);
+		void push(uint32_t level, Pending pending);
+		void merge(uint32_t level);
+
+		std::string path;
+		ClusterBuildSettings settings;
+		std::ofstream file;
+		bool failed;
+		uint64_t dataEnd;
+		std::vector<ClusterRecord> records;           // In creation order, renumbered by finish()
+		std::vector<std::vector<uint32_t>> children;
+		std::vector<std::vector<Pending>> pending;    // Per level
+		ClusterBuildStats stats;
+	};
+
+	// Morton code of a point of a box, 21 bits per axis: close codes are close points
+	uint64_t mortonCode(const glm::vec3& point, const AABB& bounds);
+
+	// Merges clusters then snaps their vertices to a grid, doubling the cell until at most
+	// maxTriangles are left; returns the cell size (the error of the result)
+	float simplifyClusters(const std::vector<const ClusterGeometry*>& clusters, int maxTriangles, float minimumCell,
+	                       ClusterGeometry& result);
+
+	// Builds a cluster file from a mesh held in memory: triangles sorted along a Morton curve
+	// then cut into leaves
+	bool buildClusterFile(const std::string& path, const float* positions, const float* normals, size_t vertexCount,
+	                      const unsigned int* indices, size_t indexCount, const ClusterBuildSettings& settings,
+	                      ClusterBuildStats* stats = nullptr);
+
+	/**
+	 * @brief Cluster file opened for reading: the header and every record, the geometry stays on disk.
+	 */
+	class ClusterFile {
+	public:
+		bool open(const std::string& path);
+		const std::string& getPath() const { return path; }
+		const std::vector<ClusterRecord>& getRecords() const { return records; }
+		const AABB& getBounds() const { return bounds; }
+		size_t getLeafTriangles() const { return leafTriangles; }
+		uint32_t getLevelCount() const { return records.empty() ? 0 : records[0].level + 1; }
+
+		// Reads a cluster with its own stream, so several threads can read at once
+		static bool readCluster(const std::string& path, const ClusterRecord& record, ClusterGeometry& geometry);
+
+	private:
+		// Checks the tree and the geometry ranges of the records read by open()
+		bool validRecords(uint64_t dataEnd) const;
+
+		std::string path;
+		std::vector<ClusterRecord> records;           // The root first
+		AABB bounds;
+		size_t leafTriangles = 0;
+	};
+}
+#endif
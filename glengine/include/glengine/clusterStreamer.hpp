@@ -0,0 +1,117 @@
+#ifndef CLUSTER_STREAMER_HPP
+#define CLUSTER_STREAMER_HPP
+
+#include <glad/glad.h>
+#include <glengine/clusterFile.hpp>
+#include <glengine/culling.hpp>
+#include <glengine/geometryBuffer.hpp>
+#include <glengine/threadPool.hpp>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	struct ClusterStreamerSettings {
+		size_t poolBytes = (size_t)64 << 20;
+		float errorThreshold = 1.0f;        // Pixels
+		int maxReadsInFlight = 16;
+		size_t uploadBytesPerFrame = (size_t)8 << 20;
+	};
+
+	/**
+	 * @brief Draws a cluster file larger than GPU memory, paging its clusters in a fixed pool.
+	 *
+	 * update() walks the cluster tree from the root: a cluster outside the frustum is skipped, one
+	 * whose error covers less than errorThreshold pixels is drawn, otherwise its children are drawn
+	 * instead once they are all resident. Until then the cluster itself stays on screen and its
+	 * missing children are read from the file by the thread pool, the coarsest first. The pool is
+	 * one position, one normal and one 16-bit index buffer of fixed size, suballocated with free
+	 * lists; when it is full the least recently drawn clusters are evicted, never the ones of the
+	 * current frame nor their ancestors. Arrived clusters are uploaded within a byte budget per
+	 * frame, so orbiting does not stall on a burst of reads.
+	 */
+	class ClusterStreamer {
+	public:
+		typedef ClusterStreamerSettings Settings;
+
+		struct Stats {
+			size_t clusters = 0, resident = 0, reading = 0;
+			size_t poolBytes = 0, poolUsed = 0;
+			size_t drawnClusters = 0, drawnTriangles = 0;
+			size_t waiting = 0;                 // Clusters drawn while their children stream
+			uint64_t reads = 0, evictions = 0, readFailures = 0;
+			uint64_t readBytes = 0, uploadedBytes = 0;
+			std::vector<size_t> drawnPerLevel;
+			double updateMs = 0.0;
+		};
+
+		ClusterStreamer(ThreadPool& pool, const Settings& settings = Settings());
+		~ClusterStreamer();
+
+		ClusterStreamer(const ClusterStreamer&) = delete;
+		ClusterStreamer& operator=(const ClusterStreamer&) = delete;
+
+		// Opens a cluster file (the pool is emptied), false when it can't be read
+		bool open(const std::string& path);
+		bool isOpen() const { return !file.getRecords().empty(); }
+		const ClusterFile& getFile() const { return file; }
+
+		// Selects the clusters to draw from this view, requests the missing ones and uploads the
+		// arrived ones. pixelsPerUnit is the size in pixels of one world unit at a distance of one.
+		void update(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+		            float pixelsPerUnit);
+
+		// Positions at location 0 and normals at location 1, like GeometryBuffer: the caller binds
+		// it, declares its instanced attributes, then draws
+		GLuint getVertexArray() const { return vao; }
+		// Draws the selected clusters in one call, returns the number of draw calls
+		int draw() const;
+
+		Settings& getSettings() { return settings; }
+		const Stats& getStats() const { return stats; }
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		enum class State { ON_DISK, READING, RESIDENT };
+		struct Cluster {
+			State state = State::ON_DISK;
+			uint64_t lastUse = 0;
+			size_t baseVertex = 0, firstIndex = 0;
+		};
+		struct Read {
+			uint32_t cluster;
+			std::future<std::shared_ptr<ClusterGeometry>> geometry;
+		};
+
+		void select(uint32_t id, const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPosition,
+		            float pixelsPerUnit, float modelScale);
+		float projectedError(uint32_t id, const glm::mat4& model, const glm::vec3& cameraPosition, float pixelsPerUnit,
+		                     float modelScale) const;
+		bool upload(uint32_t id, const ClusterGeometry& geometry);
+		bool evictOne();
+		void evict(uint32_t id);
+
+		ThreadPool& pool;
+		Settings settings;
+		ClusterFile file;
+		std::vector<Cluster> clusters;
+		std::vector<uint32_t> residentClusters;
+		std::deque<Read> reads;
+		std::vector<std::pair<float, uint32_t>> wanted;   // Projected error, cluster
+		uint64_t frame;
+
+		GLuint vao, positionBuffer, normalBuffer, indexBuffer;
+		FreeListAllocator vertexAllocator, indexAllocator;
+		std::vector<GLsizei> drawCounts;
+		std::vector<const void*> drawOffsets;
+		std::vector<GLint> drawBaseVertices;
+		Stats stats;
+	};
+}
+#endif
@@ -0,0 +1,100 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <glm/glm.hpp>
+#include <glengine/memoryUsage.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	class ThreadPool;
+
+	/**
+	 * @brief Axis aligned bounding box.
+	 */
+	struct AABB {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+
+		glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+		glm::vec3 getExtent() const { return (max - min) * 0.5f; }
+		// Box containing this box once transformed
+		AABB transformed(const glm::mat4& matrix) const;
+		// Box grown by margin on every side
+		AABB expanded(float margin) const;
+		void merge(const AABB& other);
+
+		// Bounds of packed xyz positions
+		static AABB fromPositions(const float* positions, size_t vertexCount);
+	};
+
+	/**
+	 * @brief The six planes of a view frustum, normals pointing inside.
+	 */
+	struct Frustum {
+		glm::vec4 planes[6];
+
+		// Planes of a view-projection matrix (Gribb & Hartmann)
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+		// False when the box is entirely outside one plane (conservative near the corners)
+		bool intersects(const AABB& box) const;
+	};
+
+	struct CullingStats {
+		size_t tested = 0;    // Boxes tested against the frustum (nodes and objects)
+		size_t visible = 0;   // Objects intersecting the frustum
+		size_t culled = 0;    // Objects rejected
+	};
+
+	/**
+	 * @brief 8-wide bounding volume hierarchy over object bounds, used for frustum culling.
+	 *
+	 * Every node stores the boxes of its (up to) 8 children as structure of arrays, so one
+	 * node is tested against a plane with a single SIMD operation (AVX) or two (SSE). A child
+	 * is either another node or an object. Nodes entirely inside the frustum accept their
+	 * subtree without further tests.
+	 */
+	class Bvh {
+	public:
+		static const int WIDTH = 8;
+
+		void build(const std::vector<AABB>& boxes);
+		void clear();
+		size_t getObjectCount() const { return objectCount; }
+		size_t getNodeCount() const { return nodes.size(); }
+		MemoryUsage getMemoryUsage() const {
+			MemoryUsage usage;
+			usage.host = heapBytes(nodes) + heapBytes(tasks) + heapBytes(level) + heapBytes(nextLevel)
+			           + heapBytes(taskVisible) + heapBytes(taskStats);
+			return usage;
+		}
+
+		// Fills visible with the indices of the objects intersecting the frustum, in no particular order.
+		// With a thread pool the subtrees are culled in parallel. One cull at a time, they share the scratch lists.
+		void cull(const Frustum& frustum, std::vector<uint32_t>& visible, CullingStats& stats,
+		          ThreadPool* pool = nullptr) const;
+
+	private:
+		struct alignas(32) Node {
+			float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+			float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+			// >= 0: child node, < 0: object ~child, unused slots have an empty box
+			int32_t child[WIDTH];
+			int32_t childCount;
+		};
+
+		int32_t buildNode(const std::vector<AABB>& boxes, std::vector<uint32_t>& objects, size_t begin, size_t end);
+		void cullNode(int32_t node, const Frustum& frustum, std::vector<uint32_t>& visible, CullingStats& stats) const;
+		void acceptNode(int32_t node, std::vector<uint32_t>& visible) const;
+
+		std::vector<Node> nodes;
+		size_t objectCount = 0;
+
+		// Parallel cull scratch, kept for its storage from a frame to the next
+		mutable std::vector<int32_t> tasks, level, nextLevel;
+		mutable std::vector<std::vector<uint32_t>> taskVisible;
+		mutable std::vector<CullingStats> taskStats;
+	};
+}
+#endif
@@ -0,0 +1,69 @@
+#ifndef DRAW_COMMAND_BUFFER_HPP
+#define DRAW_COMMAND_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <glengine/geometryBuffer.hpp>
+#include <glengine/memoryUsage.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Layout of glMultiDrawElementsIndirect commands.
+	 */
+	struct DrawElementsCommand {
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t baseInstance;
+	};
+
+	/**
+	 * @brief Draw commands of a frame over a GeometryBuffer, submitted with one multi-draw per range.
+	 *
+	 * Commands are filled on the CPU then uploaded once per frame to an indirect buffer. Without
+	 * glMultiDrawElementsIndirect (before OpenGL 4.3) every command becomes its own draw; as
+	 * OpenGL 3.3 has no baseInstance, the caller then moves its instanced attributes to the
+	 * command's first instance through the setBaseInstance callback. Consecutive single instance
+	 * commands of the same instance and mesh (ranges of its meshlets) are then merged into one
+	 * glMultiDrawElementsBaseVertex.
+	 */
+	class DrawCommandBuffer {
+	public:
+		DrawCommandBuffer();
+		~DrawCommandBuffer();
+
+		DrawCommandBuffer(const DrawCommandBuffer&) = delete;
+		DrawCommandBuffer& operator=(const DrawCommandBuffer&) = delete;
+
+		void clear() { commands.clear(); }
+		// Returns the index of the command
+		size_t add(const MeshRange& mesh, uint32_t instanceCount, uint32_t baseInstance);
+		size_t size() const { return commands.size(); }
+		const std::vector<DrawElementsCommand>& getCommands() const { return commands; }
+		void upload();
+
+		// Draws the commands [first, first + count) of the bound VAO, returns the number of draw calls issued
+		int draw(size_t first, size_t count, const std::function<void(uint32_t)>& setBaseInstance = nullptr) const;
+		int draw(const std::function<void(uint32_t)>& setBaseInstance = nullptr) const {
+			return draw(0, commands.size(), setBaseInstance);
+		}
+
+		bool usesMultiDraw() const { return multiDraw; }
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		std::vector<DrawElementsCommand> commands;
+		GLuint buffer;
+		size_t bufferCapacity;
+		bool multiDraw;
+		// Arrays of the merged draws without indirect commands
+		mutable std::vector<GLsizei> groupCounts;
+		mutable std::vector<void*> groupOffsets;
+		mutable std::vector<GLint> groupBaseVertices;
+	};
+}
+#endif
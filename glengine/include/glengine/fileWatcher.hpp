@@ -0,0 +1,39 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Reports the files written in a directory (not recursive).
+	 *
+	 * Uses inotify on Linux, without any thread: poll() only reads the pending events. Elsewhere
+	 * the modification times are compared, at most every pollInterval seconds.
+	 */
+	class FileWatcher {
+	public:
+		explicit FileWatcher(const std::string& directory, double pollInterval = 0.5);
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// Names (without the directory) of the files changed since the last call, each once
+		std::vector<std::string> poll();
+		// inotify is available (otherwise modification times are polled)
+		bool isNative() const { return descriptor >= 0; }
+		const std::string& getDirectory() const { return directory; }
+
+	private:
+		std::map<std::string, long long> scanModificationTimes() const;
+
+		std::string directory;
+		int descriptor;
+		double pollInterval;
+		double lastScan;
+		std::map<std::string, long long> modificationTimes;
+	};
+}
+#endif
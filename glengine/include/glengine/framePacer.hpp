@@ -0,0 +1,70 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <glad/glad.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Paces the render loop: frame rate cap, frames-in-flight limit and frame-time statistics.
+	 *
+	 * The cap sleeps until shortly before the deadline and spins for the remainder, which is far
+	 * more precise than a plain sleep. The frames-in-flight limit puts a fence after every frame
+	 * and waits on the one submitted maxFramesInFlight frames ago, so the CPU never runs further
+	 * ahead of the GPU than that (lower input latency on heavy meshes).
+	 */
+	class FramePacer {
+	public:
+		FramePacer(float frameCap = 0.0f, int maxFramesInFlight = 2);
+		~FramePacer();
+
+		FramePacer(const FramePacer&) = delete;
+		FramePacer& operator=(const FramePacer&) = delete;
+
+		// Frames per second, 0 for no cap
+		void setFrameCap(float fps);
+		float getFrameCap() const;
+		// Clamped between 1 and MAX_FRAMES_IN_FLIGHT
+		void setMaxFramesInFlight(int frames);
+		int getMaxFramesInFlight() const;
+
+		// Waits for the frame limiter and the GPU before a new frame is built
+		void beginFrame();
+		// Called right after the buffers are swapped
+		void endFrame();
+		// The loop was idle (render on demand): the next interval is not a frame time
+		void markIdle();
+		// Deletes the pending fences, must be called while the context is current
+		void release();
+
+		float getAverageMs() const { return averageMs; }
+		// Standard deviation of the frame time
+		float getJitterMs() const { return jitterMs; }
+		float getMaxMs() const { return maxMs; }
+
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		void waitUntil(Clock::time_point deadline);
+		void recordFrameTime(float ms);
+
+		float frameCap;
+		int maxFramesInFlight;
+		Clock::time_point nextDeadline;
+		std::deque<GLsync> fences;
+
+		Clock::time_point lastFrameStart;
+		bool hasLastFrame;
+		std::vector<float> frameTimes;
+		size_t frameTimeIndex;
+
+		float averageMs;
+		float jitterMs;
+		float maxMs;
+	};
+}
+#endif
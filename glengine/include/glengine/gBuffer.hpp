@@ -0,0 +1,48 @@
+#ifndef G_BUFFER_HPP
+#define G_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <cstddef>
+
+namespace GLEngine {
+	/**
+	 * @brief Compact geometry buffer of a deferred renderer.
+	 *
+	 * Three attachments, 12 bytes per pixel: the normal packed in two 16-bit channels
+	 * (octahedral encoding, done by the shaders), a 32-bit object id (0 where nothing was drawn)
+	 * and the depth/stencil. Positions are rebuilt from the depth, and everything else
+	 * (albedo, outline) is looked up with the object id.
+	 */
+	class GBuffer {
+	public:
+		GBuffer();
+		~GBuffer();
+
+		GBuffer(const GBuffer&) = delete;
+		GBuffer& operator=(const GBuffer&) = delete;
+
+		// Reallocates the attachments when the size changed
+		void resize(int width, int height);
+		// Binds the framebuffer and clears it (object ids to 0, depth to 1, stencil to 0)
+		void bindForGeometry();
+		// Copies the depth and stencil into another framebuffer, for the passes drawn after the shading
+		void blitDepth(GLuint framebuffer) const;
+
+		GLuint getFramebuffer() const { return framebuffer; }
+		GLuint getNormalTexture() const { return normalTexture; }
+		GLuint getObjectTexture() const { return objectTexture; }
+		GLuint getDepthTexture() const { return depthTexture; }
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+		size_t getMemorySize() const;
+		void release();
+
+	private:
+		GLuint framebuffer;
+		GLuint normalTexture;    // GL_RG16
+		GLuint objectTexture;    // GL_R32UI
+		GLuint depthTexture;     // GL_DEPTH24_STENCIL8
+		int width, height;
+	};
+}
+#endif
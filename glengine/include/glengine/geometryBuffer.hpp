@@ -0,0 +1,144 @@
+#ifndef GEOMETRY_BUFFER_HPP
+#define GEOMETRY_BUFFER_HPP
+
+#include <glad/glad.h>
+#include <glengine/memoryUsage.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Suballocates ranges of a linear space (in elements), best fit with coalescing on free.
+	 */
+	class FreeListAllocator {
+	public:
+		static const size_t INVALID = SIZE_MAX;
+
+		explicit FreeListAllocator(size_t capacity = 0);
+
+		// Offset of a free range of size elements, INVALID when no block is large enough
+		size_t allocate(size_t size);
+		void free(size_t offset, size_t size);
+		// Adds the space between the current capacity and newCapacity at the end
+		void grow(size_t newCapacity);
+
+		size_t getCapacity() const { return capacity; }
+		size_t getUsed() const { return used; }
+		size_t getFreeBlockCount() const { return freeBlocks.size(); }
+		size_t getLargestFreeBlock() const;
+		// 0 when all the free space is one block, close to 1 when it is scattered in small ones
+		float getFragmentation() const;
+		// Nodes of the free block map
+		size_t getHeapBytes() const;
+
+	private:
+		// Offset -> size of every free block, adjacent blocks are always merged
+		std::map<size_t, size_t> freeBlocks;
+		size_t capacity;
+		size_t used;
+	};
+
+	/**
+	 * @brief Location of a mesh in a GeometryBuffer, in vertices and indices.
+	 */
+	struct MeshRange {
+		uint32_t baseVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+	};
+
+	struct GeometryStats {
+		size_t meshCount = 0;
+		size_t vertexCapacity = 0, vertexUsed = 0;
+		size_t indexCapacity = 0, indexUsed = 0;
+		size_t vertexFreeBlocks = 0, indexFreeBlocks = 0;
+		float vertexFragmentation = 0.0f, indexFragmentation = 0.0f;
+		size_t bytes = 0;   // GPU memory of the three buffers
+		bool persistentlyMapped = false;
+		size_t pendingFrees = 0;   // Removed meshes the GPU may still be reading
+	};
+
+	/**
+	 * @brief Where the data of a mesh being added is written, see GeometryBuffer::beginMesh().
+	 */
+	struct MeshWriter {
+		uint32_t id = 0;
+		float* positions = nullptr;    // xyz per vertex
+		float* normals = nullptr;
+		unsigned int* indices = nullptr;
+	};
+
+	/**
+	 * @brief Positions, normals and indices of every mesh in three shared buffers, behind one VAO.
+	 *
+	 * Meshes are suballocated with a free list so they can be added and removed at any time.
+	 * Indices are stored relative to the mesh (drawn with its baseVertex), so a mesh can move
+	 * without rewriting them. When a buffer is full it is reallocated twice as large and the
+	 * content copied on the GPU; the VAO is updated, the buffer names change.
+	 *
+	 * With immutable storage (4.4) the buffers stay mapped, coherently, for their whole life: a mesh
+	 * is written straight into GPU visible memory instead of being copied by the driver from the
+	 * caller's arrays. The space of a removed mesh is only reused once a fence shows the GPU is
+	 * done with the commands issued before its removal.
+	 */
+	class GeometryBuffer {
+	public:
+		// Without persistentMapping, or without immutable storage, meshes go through glBufferSubData
+		GeometryBuffer(size_t vertexCapacity = 1 << 18, size_t indexCapacity = 1 << 20, bool persistentMapping = true);
+		~GeometryBuffer();
+
+		GeometryBuffer(const GeometryBuffer&) = delete;
+		GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+
+		// Copies a mesh (xyz positions and normals), returns its id
+		uint32_t addMesh(const float* positions, const float* normals, size_t vertexCount,
+		                 const unsigned int* indices, size_t indexCount);
+		// Adds a mesh whose data the caller writes where the writer points, then hands over with
+		// commitMesh() before anything else is added. The memory is only to be written, never read
+		// (it is uncached when mapped); it is a staging copy when the buffers aren't mapped.
+		MeshWriter beginMesh(size_t vertexCount, size_t indexCount);
+		void commitMesh(const MeshWriter& writer);
+		void removeMesh(uint32_t id);
+		const MeshRange& getMesh(uint32_t id) const { return meshes[id]; }
+
+		// Positions at location 0, normals at location 1 and the index buffer. Instanced
+		// attributes can be added to it by the caller.
+		GLuint getVertexArray() const { return vao; }
+		bool isPersistentlyMapped() const { return mapped; }
+		GeometryStats getStats() const;
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		struct PendingFree {
+			MeshRange range;
+			GLsync fence;
+		};
+
+		uint32_t allocateMesh(size_t vertexCount, size_t indexCount);
+		void reclaim(bool wait);
+		void growVertices(size_t minimum);
+		void growIndices(size_t minimum);
+		GLuint createBuffer(size_t bytes, void** mapping) const;
+		GLuint resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes, void** mapping) const;
+		void bindBuffers();
+
+		GLuint vao, positionBuffer, normalBuffer, indexBuffer;
+		bool mapped;
+		void* positionMapping = nullptr;
+		void* normalMapping = nullptr;
+		void* indexMapping = nullptr;
+		// Written by the caller between beginMesh() and commitMesh() when not mapped
+		std::vector<float> stagingPositions, stagingNormals;
+		std::vector<unsigned int> stagingIndices;
+		FreeListAllocator vertexAllocator, indexAllocator;
+		std::vector<PendingFree> pendingFrees;
+		std::vector<MeshRange> meshes;
+		std::vector<bool> meshUsed;
+		std::vector<uint32_t> freeIds;
+	};
+}
+#endif
@@ -0,0 +1,78 @@
+#ifndef GLEXT_HPP
+#define GLEXT_HPP
+
+#include <glad/glad.h>
+
+// Tokens newer than the 3.3 core profile glad was generated for
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+namespace GLEngine {
+	/**
+	 * @brief Entry points beyond OpenGL 3.3, loaded at runtime when the context offers them.
+	 *
+	 * The context is created as 3.3 core, but drivers usually return a higher version. Every
+	 * feature has a has*() check; its function pointers are null when it returns false.
+	 */
+	namespace ext {
+		typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void* indirect,
+		                                                      GLsizei drawCount, GLsizei stride);
+
+		typedef void (APIENTRYP PFNGETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei* length,
+		                                             GLenum* binaryFormat, void* binary);
+		typedef void (APIENTRYP PFNPROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+		typedef void (APIENTRYP PFNPROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+		typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADS)(GLuint count);
+		typedef void (APIENTRYP PFNBUFFERSTORAGE)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+		extern PFNMULTIDRAWELEMENTSINDIRECT multiDrawElementsIndirect;
+		extern PFNGETPROGRAMBINARY getProgramBinary;
+		extern PFNPROGRAMBINARY programBinary;
+		extern PFNPROGRAMPARAMETERI programParameteri;
+		extern PFNMAXSHADERCOMPILERTHREADS maxShaderCompilerThreads;
+		extern PFNBUFFERSTORAGE bufferStorage;
+
+		// To be called once the context is current and glad is loaded
+		void load(GLADloadproc loader);
+
+		bool isVersionAtLeast(int major, int minor);
+		bool hasExtension(const char* name);
+
+		// glMultiDrawElementsIndirect, with baseInstance applied to the instanced attributes (4.3)
+		bool hasMultiDrawIndirect();
+		// glGetProgramBinary / glProgramBinary with at least one binary format (4.1)
+		bool hasProgramBinary();
+		// Compilation and linking on driver threads, polled with GL_COMPLETION_STATUS_KHR
+		bool hasParallelShaderCompile();
+		// BC1 and BC3 textures (EXT_texture_compression_s3tc)
+		bool hasTextureCompressionS3tc();
+		// BC7 textures (4.2)
+		bool hasTextureCompressionBptc();
+		// Immutable buffer storage, which can stay mapped while the GPU reads it (4.4)
+		bool hasBufferStorage();
+	}
+}
+#endif
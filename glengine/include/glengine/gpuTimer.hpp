@@ -0,0 +1,43 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include <glad/glad.h>
+
+namespace GLEngine {
+	/**
+	 * @brief Measures GPU time spent between begin() and end() with timestamp queries.
+	 *
+	 * Timestamps (rather than GL_TIME_ELAPSED) let timers be nested, e.g. one per pass inside
+	 * one for the whole frame. Queries are kept in a small ring so reading a result never stalls
+	 * the pipeline: the value returned by getLastMs() is the most recent query that has completed.
+	 */
+	class GpuTimer {
+	public:
+		GpuTimer();
+		~GpuTimer();
+
+		GpuTimer(const GpuTimer&) = delete;
+		GpuTimer& operator=(const GpuTimer&) = delete;
+
+		void begin();
+		void end();
+		// Collects finished queries, returns true if a new result is available
+		bool poll();
+		float getLastMs() const;
+		// Sum of the results collected by poll() since the last call
+		float takeCompletedMs();
+
+	private:
+		static const int QUERY_COUNT = 4;
+
+		// Start and end timestamps
+		GLuint queries[QUERY_COUNT][2];
+		bool pending[QUERY_COUNT];
+		int current;
+		int oldest;
+		bool running;
+		float lastMs;
+		float completedMs;
+	};
+}
+#endif
@@ -0,0 +1,96 @@
+#ifndef HIZ_CULLER_HPP
+#define HIZ_CULLER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glengine/culling.hpp>
+#include <glengine/memoryUsage.hpp>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Occlusion culling against a hierarchical depth (Hi-Z) pyramid of the previous frames.
+	 *
+	 * After the scene is drawn, captureDepth() copies the depth buffer and reduces it on the GPU
+	 * (max of each 2x2 block) down to a small level, which is read back asynchronously through
+	 * pixel pack buffers. Once a readback arrives, prepare() reprojects it into the current view
+	 * and builds the rest of the pyramid on the CPU. isOccluded() then compares the nearest depth
+	 * of a box with the farthest depth of the texels covering it.
+	 *
+	 * The reprojection is conservative: texels nothing lands on are treated as empty (far plane)
+	 * and that emptiness is grown by one texel, so geometry disoccluded by the camera motion is
+	 * drawn rather than popping in a frame late.
+	 */
+	class HiZCuller {
+	public:
+		// downsampleProgram: full screen max reduction (fullscreen.vert / hiz.frag)
+		HiZCuller(GLuint downsampleProgram, int readbackMaxWidth = 160);
+		~HiZCuller();
+
+		HiZCuller(const HiZCuller&) = delete;
+		HiZCuller& operator=(const HiZCuller&) = delete;
+
+		// After the downsample program was rebuilt
+		void setProgram(GLuint downsampleProgram) { program = downsampleProgram; }
+
+		// Builds the pyramid from the depth of the default framebuffer and starts its readback.
+		// viewProjection is the matrix the depth was rendered with.
+		void captureDepth(int width, int height, const glm::mat4& viewProjection);
+		// Collects a finished readback, returns true if new depth data arrived
+		bool pollReadback();
+		// Reprojects the last depth readback into the current view, to be called before isOccluded()
+		void prepare(const glm::mat4& viewProjection);
+		// Drops the captured depth and the readbacks in flight, when the scene itself changed
+		void invalidate();
+		// No depth available yet: nothing can be culled
+		bool isReady() const { return ready; }
+		// True if the box is entirely hidden behind the previous depth
+		bool isOccluded(const AABB& box) const;
+
+		// Resolution of the CPU pyramid level 0
+		int getWidth() const { return cpuWidth; }
+		int getHeight() const { return cpuHeight; }
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		static const int READBACK_COUNT = 3;
+
+		struct Readback {
+			GLuint pbo = 0;
+			GLsync fence = 0;
+			int width = 0;
+			int height = 0;
+			glm::mat4 viewProjection;
+		};
+
+		void resize(int width, int height);
+		void reproject(const glm::mat4& viewProjection);
+		void buildCpuPyramid();
+
+		GLuint program;
+		int readbackMaxWidth;
+
+		// GPU side: copy of the depth buffer and max pyramid (R32F)
+		GLuint depthFbo, depthTexture;
+		GLuint pyramidFbo, pyramidTexture;
+		int depthWidth, depthHeight;
+		std::vector<glm::ivec2> levelSizes;
+		GLuint emptyVao;
+
+		Readback readbacks[READBACK_COUNT];
+		int nextReadback;
+
+		// CPU side: last readback and the pyramid reprojected in the current view
+		std::vector<float> capturedDepth;
+		glm::mat4 capturedViewProjection;
+		int cpuWidth, cpuHeight;
+		std::vector<std::vector<float>> cpuPyramid;  // cpuSizes.size() levels in use, the others keep their storage
+		std::vector<glm::ivec2> cpuSizes;
+		std::vector<float> splat;                    // Reprojection scratch
+		glm::mat4 currentViewProjection;
+		bool hasCapture;
+		bool ready;
+	};
+}
+#endif
@@ -0,0 +1,34 @@
+#ifndef KTX2_HPP
+#define KTX2_HPP
+
+#include <glad/glad.h>
+#include <glengine/textureCompression.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief 2D texture or texture array in a KTX2 container (Khronos), without supercompression.
+	 *
+	 * Only the formats the engine writes are known: 8-bit UNORM images with 1 to 4 channels and
+	 * the block formats of textureCompression.hpp.
+	 */
+	struct Ktx2Texture {
+		BlockFormat format = BlockFormat::NONE;
+		int channels = 4;                        // Of an uncompressed texture
+		int width = 0, height = 0;
+		int layerCount = 0;                      // 0 for a 2D texture, else the layers of an array
+		std::vector<std::vector<uint8_t>> levels; // Level 0 first, each holding all its layers
+	};
+
+	bool writeKtx2(const std::string& path, const Ktx2Texture& texture);
+	// False when the file is missing, invalid, supercompressed or in another format
+	bool readKtx2(const std::string& path, Ktx2Texture& texture);
+
+	// Uploads a texture (GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY) with its mip levels, repeating and
+	// filtered with mipmaps. A block format the driver lacks is decoded and uploaded uncompressed;
+	// decoded then tells it happened.
+	GLuint createKtx2Texture(const Ktx2Texture& texture, bool* decoded = nullptr);
+}
+#endif
@@ -0,0 +1,85 @@
+#ifndef LIGHT_CLUSTERS_HPP
+#define LIGHT_CLUSTERS_HPP
+
+#include <glad/glad.h>
+#include <glengine/memoryUsage.hpp>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	class ThreadPool;
+
+	struct PointLight {
+		glm::vec3 position = glm::vec3(0.0f);    // World space
+		float radius = 1.0f;                     // No light past this distance
+		glm::vec3 color = glm::vec3(1.0f);
+		float intensity = 1.0f;
+	};
+
+	/**
+	 * @brief Point lights binned into the clusters of the view frustum (clustered shading).
+	 *
+	 * The frustum is split into screen tiles and depth slices, the slices spaced exponentially
+	 * so clusters stay roughly cubic. update() tests the sphere of every light against the view
+	 * space bounds of the clusters of the slices it reaches, one slice per task, then uploads
+	 * three texture buffers: the lights (two RGBA32F texels each), the offset and count of the
+	 * lights of each cluster (RG32UI) and the light indices (R32UI). A fragment only reads the
+	 * list of its own cluster (lights.glsl).
+	 */
+	class LightClusters {
+	public:
+		LightClusters(int tilesX = 16, int tilesY = 9, int depthSlices = 24);
+		~LightClusters();
+
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+
+		// Bins the lights for this view and uploads the lists, with the projection the scene is drawn with
+		void update(const std::vector<PointLight>& lights, const glm::mat4& view, float fovY, int width, int height,
+		            float nearPlane, float farPlane, ThreadPool* pool = nullptr);
+		// Binds the buffers to the texture units firstUnit to firstUnit + 2 and sets the uniforms of lights.glsl
+		void bind(GLuint program, int firstUnit) const;
+
+		int getLightCount() const { return lightCount; }
+		int getClusterCount() const { return tilesX * tilesY * depthSlices; }
+		// Light indices stored over all the clusters
+		size_t getReferenceCount() const { return indices.size(); }
+		int getMaxClusterLights() const { return maxClusterLights; }
+		double getBinningMs() const { return binningMs; }
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		void buildClusterBounds(float fovY, float aspect, float nearPlane, float farPlane);
+		void upload();
+
+		int tilesX, tilesY, depthSlices;
+
+		// View space bounds of the clusters, rebuilt when the projection changes
+		std::vector<glm::vec3> clusterMin, clusterMax;
+		std::vector<float> sliceDepths;              // depthSlices + 1 distances from the camera
+		glm::vec4 boundsProjection;                  // fovY, aspect, near, far of the bounds
+		float depthScale, depthBias;                 // slice = log(depth) * scale + bias
+		int width, height;
+
+		// Binning, one list per slice then concatenated
+		std::vector<glm::vec4> viewLights;           // Center in view space, radius
+		std::vector<std::vector<uint32_t>> sliceIndices;
+		std::vector<std::vector<uint32_t>> sliceCounts;
+		std::vector<std::vector<uint32_t>> sliceCandidates;  // Lights overlapping the depth range, kept for their storage
+
+		// Uploaded data
+		std::vector<glm::vec4> lightTexels;
+		std::vector<uint32_t> clusterRanges;         // Offset, count
+		std::vector<uint32_t> indices;
+		int lightCount;
+		int maxClusterLights;
+		double binningMs;
+
+		GLuint buffers[3];                           // Lights, cluster ranges, indices
+		GLuint textures[3];
+	};
+}
+#endif
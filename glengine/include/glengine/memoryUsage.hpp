@@ -0,0 +1,38 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Memory held by an object: its heap allocations and its buffers and textures.
+	 *
+	 * Vectors count their capacity, the GPU side the storage that was allocated, used or not.
+	 * Allocator overhead and driver copies are not included.
+	 */
+	struct MemoryUsage {
+		size_t host = 0;
+		size_t gpu = 0;
+
+		MemoryUsage& operator+=(const MemoryUsage& other) {
+			host += other.host;
+			gpu += other.gpu;
+			return *this;
+		}
+	};
+
+	template<typename T>
+	size_t heapBytes(const std::vector<T>& vector) {
+		return vector.capacity() * sizeof(T);
+	}
+
+	template<typename T>
+	size_t heapBytes(const std::vector<std::vector<T>>& vectors) {
+		size_t bytes = vectors.capacity() * sizeof(std::vector<T>);
+		for (const std::vector<T>& vector : vectors)
+			bytes += heapBytes(vector);
+		return bytes;
+	}
+}
+#endif
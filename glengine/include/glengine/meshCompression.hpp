@@ -0,0 +1,47 @@
+#ifndef MESH_COMPRESSION_HPP
+#define MESH_COMPRESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	class ThreadPool;
+
+	struct MeshCompressionSettings {
+		int positionBits = 16;           // Per coordinate, over the bounding box (1 to 16)
+		int normalBits = 12;             // Per octahedral coordinate (2 to 16)
+		uint32_t blockVertices = 8192;   // Vertices and triangles of the blocks, decoded independently
+		uint32_t blockTriangles = 8192;
+	};
+
+	/**
+	 * @brief Compressed mesh: positions, normals and triangles.
+	 *
+	 * Positions are quantized over the bounding box, normals octahedral encoded then quantized. The
+	 * vertices are renumbered in order of first use by the triangles, so every index is either the
+	 * next new vertex or close to the previous index; vertices and indices are delta coded, split
+	 * into byte streams and every stream goes through an order-0 rANS coder. Vertices and
+	 * triangles are cut into blocks holding their own streams, encoded and decoded in parallel by
+	 * the thread pool. The triangles keep their order, the vertices don't.
+	 */
+	std::vector<uint8_t> compressMesh(const float* positions, const float* normals, size_t vertexCount,
+	                                  const unsigned int* indices, size_t indexCount,
+	                                  const MeshCompressionSettings& settings = MeshCompressionSettings(),
+	                                  ThreadPool* pool = nullptr);
+
+	// False when the data is not a compressed mesh or is damaged
+	bool decompressMesh(const uint8_t* data, size_t size, std::vector<float>& positions, std::vector<float>& normals,
+	                    std::vector<unsigned int>& indices, ThreadPool* pool = nullptr);
+	// Vertex and index counts of a compressed mesh, false when the data is not one
+	bool getCompressedMeshSize(const uint8_t* data, size_t size, size_t& vertexCount, size_t& indexCount);
+	// Decodes into arrays of those sizes (3 floats per vertex). They are only written, each value
+	// once, so they can be mapped GPU memory. Their content is undefined when it returns false.
+	bool decompressMesh(const uint8_t* data, size_t size, float* positions, float* normals, unsigned int* indices,
+	                    ThreadPool* pool = nullptr);
+
+	// Octahedral encoding of a unit vector in [-1, 1]^2, and back (normalized)
+	void encodeOctahedral(const float* normal, float& u, float& v);
+	void decodeOctahedral(float u, float v, float* normal);
+}
+#endif
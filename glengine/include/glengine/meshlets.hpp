@@ -0,0 +1,69 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <glengine/arena.hpp>
+#include <glengine/culling.hpp>
+#include <glengine/memoryUsage.hpp>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Small connected piece of a mesh, a consecutive range of its triangles.
+	 *
+	 * The bounding sphere and the normal cone let a whole meshlet be rejected when it is outside
+	 * the frustum or when all its triangles face away from the camera (or all towards it).
+	 */
+	struct Meshlet {
+		uint32_t firstIndex;        // In the indices of the mesh
+		uint32_t triangleCount;
+		uint32_t vertexCount;
+		float coneCutoff;           // Sine of the cone half angle, 1 when the cone can't reject anything
+		glm::vec3 center;
+		float radius;
+		glm::vec3 coneAxis;         // Average direction of the face normals
+		float padding;
+	};
+
+	struct MeshletSettings {
+		int maxVertices = 64;
+		int maxTriangles = 124;
+	};
+
+	// Partitions a mesh into meshlets, reordering its indices so every meshlet is a range of them.
+	// Triangles are grown from a seed through shared vertices, those adding the fewest new vertices first,
+	// then the closest ones facing the same way. The temporaries come from scratch (left for the caller to
+	// reset), or from an arena of their own.
+	std::vector<Meshlet> buildMeshlets(const float* positions, size_t vertexCount, unsigned int* indices, size_t indexCount,
+	                                   const MeshletSettings& settings = MeshletSettings(), Arena* scratch = nullptr);
+
+	/**
+	 * @brief Meshlet bounds as structure of arrays, padded to a multiple of 4, for the SIMD culling.
+	 */
+	class MeshletBounds {
+	public:
+		void build(const std::vector<Meshlet>& meshlets);
+		size_t size() const { return meshletCount; }
+		MemoryUsage getMemoryUsage() const;
+
+		// Visibility bits of a meshlet
+		enum : uint8_t { FRONT = 1, BACK = 2 };
+
+		// Culls the meshlets [first, first + count) of an instance (model: rotation, translation and
+		// uniform scale) against a frustum, in object space. visibility[i - first] gets FRONT unless
+		// meshlet i is outside the frustum or faces away from the camera, BACK unless it is outside or
+		// faces the camera. margin (world units) grows the spheres, for geometry extruded along its
+		// normals. Without coneCulling only the frustum rejects. Returns the number of meshlets
+		// rejected by the frustum.
+		size_t cull(const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPosition, float margin,
+		            bool coneCulling, size_t first, size_t count, uint8_t* visibility) const;
+
+	private:
+		size_t meshletCount = 0;
+		std::vector<float> centerX, centerY, centerZ, radius;
+		std::vector<float> axisX, axisY, axisZ, cutoff;
+	};
+}
+#endif
@@ -0,0 +1,36 @@
+#ifndef MIPMAP_GENERATOR_HPP
+#define MIPMAP_GENERATOR_HPP
+
+#include <glengine/threadPool.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	// Downsampling filters of the mip levels
+	enum class MipFilter {
+		BOX,        // 2x2 average, what glGenerateMipmap usually does
+		KAISER,     // Kaiser windowed sinc (width 3, alpha 4), sharp without much ringing
+		LANCZOS,    // Lanczos 3, the sharpest, rings a little on hard edges
+		DARKEST     // Darkest texel of the footprint: dark strokes on light paper stay whole
+	};
+
+	const char* mipFilterName(MipFilter filter);
+	// Lower case name ("box", "kaiser", "lanczos" or "darkest"), false when unknown
+	bool parseMipFilter(const std::string& name, MipFilter& filter);
+
+	// Levels down to 1x1, the full image included
+	int mipLevelCount(int width, int height);
+
+	/**
+	 * @brief Mip levels of an 8-bit image (1 to 4 channels, rows tightly packed), computed on the CPU.
+	 *
+	 * Returns the levels 1 to 1x1, each half the size of the previous one (rounded down). The
+	 * filters are separable: every output row first sums its source rows, 4 floats at a time with
+	 * SSE, then the columns of that row (a whole texel at once for RGBA). Rows are spread over the
+	 * pool. Edges wrap around, like repeating textures, or are clamped.
+	 */
+	std::vector<std::vector<uint8_t>> generateMipmaps(const uint8_t* pixels, int width, int height, int channels,
+	                                                  MipFilter filter, ThreadPool* pool = nullptr, bool wrap = true);
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef MODEL_LIBRARY_HPP
+#define MODEL_LIBRARY_HPP
+
+#include <glengine/culling.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief What the library knows of a model file without loading it.
+	 */
+	struct ModelInfo {
+		std::string path;               // Relative to the library directory, '/' separated
+		uint64_t fileSize = 0;
+		int64_t modifiedTime = 0;       // Last write time, in ticks of the file clock
+		uint64_t vertexCount = 0;
+		uint64_t normalCount = 0;       // vn lines
+		uint64_t texCoordCount = 0;     // vt lines
+		uint64_t faceCount = 0;
+		uint64_t triangleCount = 0;     // Polygons cut into fans
+		AABB bounds;                    // Of the vertex positions
+		bool readable = false;          // false when the file couldn't be read
+
+		bool hasNormals() const { return normalCount > 0; }
+		bool hasTexCoords() const { return texCoordCount > 0; }
+	};
+
+	/**
+	 * @brief OBJ files of a directory tree with their metadata, kept in an index file between runs.
+	 *
+	 * The tree is listed in parallel, one level of directories after the other (hidden ones and
+	 * links to directories are skipped). The files that are new or changed since the index was
+	 * written (other size or modification time) are scanned by the thread pool, largest first: a
+	 * scan reads the file in blocks, only parses the vertex positions (for the bounds) and counts
+	 * the other lines. The index is rewritten when anything changed, so a second run only lists
+	 * the directories.
+	 */
+	class ModelLibrary {
+	public:
+		struct Stats {
+			size_t directories = 0;
+			size_t files = 0;
+			size_t scanned = 0;             // Files parsed, the others came from the index
+			size_t removed = 0;             // Index entries whose file is gone
+			uint64_t scannedBytes = 0;
+			double listMs = 0.0, scanMs = 0.0, totalMs = 0.0;
+			bool indexLoaded = false;
+			bool indexWritten = false;
+		};
+
+		// Lists the models under directory, reusing the entries of indexFile (none when empty) whose file
+		// is unchanged. False when the directory can't be read.
+		bool scan(const std::string& directory, const std::string& indexFile, ThreadPool* pool);
+
+		// Sorted by path
+		const std::vector<ModelInfo>& getModels() const { return models; }
+		const Stats& getStats() const { return stats; }
+
+		// Metadata of an OBJ file, the counts and bounds of info are filled in
+		static bool scanObjFile(const std::string& file, ModelInfo& info);
+
+	private:
+		static bool readIndex(const std::string& indexFile, const std::string& directory, std::vector<ModelInfo>& entries);
+		bool writeIndex(const std::string& indexFile, const std::string& directory) const;
+
+		std::vector<ModelInfo> models;
+		Stats stats;
+	};
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef OBJ_CLUSTER_BUILDER_HPP
+#define OBJ_CLUSTER_BUILDER_HPP
+
+#include <glengine/clusterFile.hpp>
+#include <glengine/threadPool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GLEngine {
+	struct ObjClusterSettings {
+		ClusterBuildSettings clusters;
+		size_t memoryBytes = (size_t)512 << 20;   // Working memory, the rest goes through temporary files
+		std::string tempDirectory;                // Next to the output file when empty
+	};
+
+	struct ObjClusterStats {
+		size_t vertices = 0, triangles = 0;
+		size_t droppedTriangles = 0;              // Referencing a vertex the file doesn't have
+		uint64_t objBytes = 0, tempBytes = 0;     // Read from the OBJ file, written to the temporary files
+		int vertexChunks = 0;                     // Passes over the triangles to find their vertices
+		int sortRuns = 0, mergePasses = 0;
+		double parseMs = 0.0, joinMs = 0.0, sortMs = 0.0, buildMs = 0.0, totalMs = 0.0;
+		ClusterBuildStats clusters;
+
+		double getTrianglesPerSecond() const { return totalMs > 0.0 ? triangles * 1000.0 / totalMs : 0.0; }
+	};
+
+	/**
+	 * @brief Builds a cluster file from an OBJ file of any size, in bounded memory.
+	 *
+	 * The OBJ file is parsed in blocks by the thread pool into binary vertex and triangle files.
+	 * The triangles then get their positions and normals in as many passes as there are chunks of
+	 * vertices fitting in memory, and their Morton code. They are sorted by it in runs fitting in
+	 * memory, the runs merged into the leaves given to a ClusterWriter. Only the positions (v) and
+	 * the faces (f, polygons as fans) are read; the normal of a vertex is the sum of the normals of
+	 * its faces, weighted by their area.
+	 */
+	bool buildClusterFileFromObj(const std::string& objPath, const std::string& path, ThreadPool& pool,
+	                             const ObjClusterSettings& settings, ObjClusterStats* stats, std::string& error);
+}
+#endif
@@ -0,0 +1,68 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	struct ShaderStage {
+		GLenum type;
+		std::string source;
+		std::string name;   // Shown in the error messages, usually the file
+	};
+
+	struct ProgramCacheStats {
+		int loaded = 0;      // Programs created from a cached binary
+		int compiled = 0;    // Programs compiled from source
+		int rejected = 0;    // Cached binaries refused by the driver (then compiled)
+		int stored = 0;      // Binaries written to the cache
+		double loadMs = 0.0;
+		double compileMs = 0.0;
+	};
+
+	/**
+	 * @brief Creates shader programs, keeping their driver binaries in a directory for the next launches.
+	 *
+	 * A program is identified by a hash of its sources, its defines and the driver (vendor, renderer,
+	 * version): updating the driver or editing a shader compiles it again. A binary the driver
+	 * refuses is deleted and the program compiled from source, so the cache can never break a
+	 * launch. Without a directory, or without program binary support (OpenGL 4.1), programs are
+	 * always compiled.
+	 */
+	class ProgramCache {
+	public:
+		explicit ProgramCache(const std::string& directory = "");
+
+		// Linked program, or 0 with the error in getLastError()
+		GLuint getProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines = {});
+		const std::string& getLastError() const { return lastError; }
+
+		bool isEnabled() const { return enabled; }
+		const std::string& getDirectory() const { return directory; }
+		const ProgramCacheStats& getStats() const { return stats; }
+		void resetStats() { stats = ProgramCacheStats(); }
+		// Deletes every cached binary
+		void clear();
+
+		// Source with a #define line per define right after its #version line (line numbers kept)
+		static std::string injectDefines(const std::string& source, const std::vector<std::string>& defines);
+		// Compiles and links without the cache, 0 on failure with the log in error
+		static GLuint compileProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines,
+		                             std::string& error, bool retrievable = false);
+
+	private:
+		uint64_t computeKey(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines) const;
+		std::string getPath(uint64_t key) const;
+		GLuint loadBinary(uint64_t key);
+		void storeBinary(uint64_t key, GLuint program);
+
+		std::string directory;
+		std::string driver;
+		bool enabled;
+		std::string lastError;
+		ProgramCacheStats stats;
+	};
+}
+#endif
@@ -0,0 +1,76 @@
+#ifndef RESOURCE_MANAGER_HPP
+#define RESOURCE_MANAGER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief GPU memory of the buffers and textures of the application, kept under a budget.
+	 *
+	 * Every resource is registered with its size and the callbacks freeing it and loading it
+	 * again. A resource is marked with use() each frame it is needed, which loads it first when it
+	 * was evicted. endFrame() then evicts the least recently used resources until the total fits
+	 * in the budget; the ones used during the frame and the busy ones are never evicted, so the
+	 * budget may be exceeded when the frame alone needs more.
+	 */
+	class ResourceManager {
+	public:
+		enum class Kind { BUFFER, TEXTURE };
+
+		struct Callbacks {
+			std::function<size_t()> load;       // Makes the resource resident again, returns its size
+			std::function<void()> unload;       // Frees its GPU memory
+			std::function<bool()> busy;         // Optional: can't be evicted meanwhile (upload in flight)
+		};
+
+		struct Stats {
+			size_t budget = 0;
+			size_t used = 0;                    // Resident bytes
+			size_t peak = 0;
+			size_t bufferBytes = 0, textureBytes = 0;
+			size_t resident = 0, count = 0;     // Resources
+			uint64_t evictions = 0, reloads = 0;  // Reloads include the first loads of the deferred resources
+		};
+
+		explicit ResourceManager(size_t budget = (size_t)256 << 20);
+
+		// Adds a resource, returns its id. A resource added as not resident (bytes being a guess) is
+		// loaded by its first use().
+		uint32_t add(Kind kind, size_t bytes, Callbacks callbacks, bool resident = true);
+		// Forgets a resource, the caller frees it if it is resident
+		void remove(uint32_t id);
+		// The resource is needed this frame; returns true when it had to be loaded again
+		bool use(uint32_t id);
+		// Size known later (a texture streamed in), or changed
+		void resize(uint32_t id, size_t bytes);
+		bool isResident(uint32_t id) const { return resources[id].resident; }
+		size_t getBytes(uint32_t id) const { return resources[id].bytes; }
+
+		// Evicts the resources not used during the frame, oldest first, until the budget is met
+		void endFrame();
+		void setBudget(size_t bytes) { stats.budget = bytes; }
+		const Stats& getStats() const { return stats; }
+
+	private:
+		struct Resource {
+			Kind kind = Kind::BUFFER;
+			size_t bytes = 0;
+			uint64_t lastUse = 0;               // Frame of the last use()
+			bool resident = false;
+			Callbacks callbacks;
+		};
+
+		void account(const Resource& resource, bool add);
+		void evict(Resource& resource);
+
+		std::vector<Resource> resources;
+		std::vector<bool> resourceUsed;
+		std::vector<uint32_t> freeIds;
+		uint64_t frame;
+		Stats stats;
+	};
+}
+#endif
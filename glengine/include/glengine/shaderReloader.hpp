@@ -0,0 +1,109 @@
+#ifndef SHADER_RELOADER_HPP
+#define SHADER_RELOADER_HPP
+
+#include <glad/glad.h>
+#include <glengine/fileWatcher.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GLEngine {
+	struct ShaderFile {
+		GLenum type;
+		std::string name;   // File in the watched directory
+	};
+
+	/**
+	 * @brief Recompiles the programs whose shader files (or included files) change, without stalling the render loop.
+	 *
+	 * Compilation runs on the driver threads with KHR_parallel_shader_compile, otherwise on a
+	 * worker thread owning a context that shares objects with the main one (given by the caller),
+	 * otherwise on the main thread. A new program replaces the old one between two frames, and
+	 * only if it links: on error the old one is kept and the log is available until the next
+	 * successful build.
+	 */
+	class ShaderReloader {
+	public:
+		enum class Mode { PARALLEL_COMPILE, WORKER_CONTEXT, MAIN_THREAD };
+
+		struct Error {
+			std::string program;
+			std::string log;
+		};
+
+		// makeWorkerContextCurrent is called once on the worker thread, it may be empty
+		ShaderReloader(const std::string& directory, std::function<void()> makeWorkerContextCurrent = nullptr);
+		~ShaderReloader();
+
+		ShaderReloader(const ShaderReloader&) = delete;
+		ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+		// *program (created by the caller) is replaced by every new version that links, and the old one deleted
+		void watch(GLuint* program, const std::vector<ShaderFile>& files, const std::vector<std::string>& defines = {});
+		// Stops replacing *program, to be called before the caller deletes it
+		void unwatch(GLuint* program);
+		// Once per frame on the main thread: reads the file changes, starts and finishes the compilations
+		void update();
+		// Rebuilds every program
+		void reloadAll();
+
+		const std::vector<Error>& getErrors() const { return errors; }
+		int getPendingCount() const;
+		int getReloadCount() const { return reloadCount; }
+		Mode getMode() const { return mode; }
+		static const char* getModeName(Mode mode);
+		bool isWatchingNatively() const { return watcher.isNative(); }
+
+	private:
+		struct Entry {
+			GLuint* program;
+			std::vector<ShaderFile> files;
+			std::vector<std::string> defines;
+			std::vector<std::string> dependencies;   // Files and their includes, names in the directory
+			std::string name;
+			bool dirty = false;     // Changed again since the build in progress started
+			bool building = false;
+			// Parallel compile: objects being built by the driver
+			GLuint pendingProgram = 0;
+			std::vector<GLuint> pendingShaders;
+		};
+
+		struct Job {
+			Entry* entry;
+			std::vector<std::string> sources;
+		};
+
+		struct Result {
+			Entry* entry;
+			GLuint program;
+			std::string log;
+		};
+
+		void startBuild(Entry& entry);
+		void finishBuild(Entry& entry, GLuint program, const std::string& log);
+		void pollParallelBuild(Entry& entry);
+		void workerLoop(std::function<void()> makeContextCurrent);
+		std::vector<std::string> readSources(Entry& entry) const;
+
+		std::string directory;
+		FileWatcher watcher;
+		Mode mode;
+		std::vector<std::unique_ptr<Entry>> entries;
+		std::vector<Error> errors;
+		int reloadCount;
+
+		// Worker context: jobs in, results out
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Job> jobs;
+		std::deque<Result> results;
+		bool stopping;
+	};
+}
+#endif
@@ -0,0 +1,18 @@
+#ifndef SHADER_SOURCE_HPP
+#define SHADER_SOURCE_HPP
+
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Reads a shader file and expands its #include "file" directives, recursively.
+	 *
+	 * Included paths are relative to the including file, and a file is only included once. #line
+	 * directives keep the line numbers of the error messages; their source string number is the
+	 * index of the file in dependencies (0 is the shader itself). Errors (missing file) are
+	 * returned as an #error directive so they show up as a compilation error.
+	 */
+	std::string loadShaderSource(const std::string& path, std::vector<std::string>* dependencies = nullptr);
+}
+#endif
@@ -0,0 +1,77 @@
+#ifndef SHADOW_MAP_HPP
+#define SHADOW_MAP_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glengine/culling.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace GLEngine {
+	/**
+	 * @brief Shadow map of a point light, rendered again only when what it shows changed.
+	 *
+	 * With one cascade, the map is a perspective view from the light fitted to the scene bounds:
+	 * it only depends on the light and the scene, so moving the camera never renders it. With
+	 * more cascades (large scenes), the light is treated as directional and each cascade covers
+	 * a depth range of the camera with an orthographic view. Those views follow the camera but are
+	 * snapped to their texels, so they only change, and are rendered, when the camera moved by
+	 * at least a texel. The cascades are the layers of one depth texture array, sampled with
+	 * hardware comparison (sampler2DArrayShadow, shadows.glsl).
+	 */
+	class ShadowMap {
+	public:
+		static constexpr int MAX_CASCADES = 4;
+
+		explicit ShadowMap(int cascadeCount = 1, int resolution = 2048);
+		~ShadowMap();
+
+		ShadowMap(const ShadowMap&) = delete;
+		ShadowMap& operator=(const ShadowMap&) = delete;
+
+		// Reallocates the maps when the number of cascades or the resolution changed
+		void configure(int cascadeCount, int resolution);
+		// Computes the views of the frame and returns the mask of the cascades to render (zero when
+		// all the stored ones are still valid). sceneVersion changes whenever a caster moved.
+		unsigned int prepare(const glm::vec3& lightPos, const AABB& sceneBounds, uint64_t sceneVersion,
+		                     const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float farPlane);
+		// Binds and clears the layer of a cascade, which is then considered up to date
+		void beginCascade(int cascade);
+		// Everything is rendered again at the next prepare()
+		void invalidate();
+		// Binds the maps to a texture unit and sets the uniforms of shadows.glsl (disabled: the
+		// sampler is still set, so it never shares a unit with a sampler of another type)
+		void bind(GLuint program, int unit, bool enabled) const;
+
+		int getCascadeCount() const { return cascadeCount; }
+		int getResolution() const { return resolution; }
+		const glm::mat4& getViewProjection(int cascade) const { return cascades[cascade].viewProjection; }
+		// Cascades rendered since the creation, to see the cache at work
+		uint64_t getRenderCount() const { return renderCount; }
+		size_t getMemorySize() const;
+		void release();
+
+	private:
+		struct Cascade {
+			glm::mat4 viewProjection = glm::mat4(1.0f);
+			float splitDepth = 0.0f;                 // View depth where the cascade ends
+			float texelSize = 0.0f;                  // World size of a texel, for the normal offset
+			// Content of the layer
+			glm::mat4 renderedViewProjection = glm::mat4(0.0f);
+			uint64_t renderedVersion = 0;
+			bool rendered = false;
+		};
+
+		void allocate();
+		void fitSingle(const glm::vec3& lightPos, const AABB& sceneBounds);
+		void fitCascades(const glm::vec3& lightPos, const AABB& sceneBounds, const glm::mat4& cameraView,
+		                 float fovY, float aspect, float nearPlane, float farPlane);
+
+		int cascadeCount, resolution;
+		Cascade cascades[MAX_CASCADES];
+		uint64_t sceneVersion;
+		uint64_t renderCount;
+		GLuint texture, framebuffer;
+	};
+}
+#endif
@@ -0,0 +1,52 @@
+#ifndef TEXTURE_COMPRESSION_HPP
+#define TEXTURE_COMPRESSION_HPP
+
+#include <glad/glad.h>
+#include <glengine/threadPool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GLEngine {
+	// Block compressed formats, 4x4 texels per block
+	enum class BlockFormat {
+		NONE,       // Uncompressed
+		BC1,        // RGB, 8 bytes (S3TC DXT1)
+		BC3,        // RGBA, 16 bytes: BC1 color and BC4 alpha (S3TC DXT5)
+		BC4,        // One channel, 8 bytes (RGTC1)
+		BC5,        // Two channels, 16 bytes (RGTC2)
+		BC7         // RGBA, 16 bytes (BPTC), mode 6 only
+	};
+
+	const char* blockFormatName(BlockFormat format);
+	// 8 or 16, 0 for NONE
+	int blockBytes(BlockFormat format);
+	size_t compressedSize(BlockFormat format, int width, int height);
+	// Channels of the decoded texels (BC1: 3, BC4: 1, BC5: 2, BC3 and BC7: 4)
+	int blockFormatChannels(BlockFormat format);
+	// BC4 for 1 channel, BC5 for 2, BC1 for 3, BC3 for 4 (or BC7 for 3 and 4)
+	BlockFormat defaultBlockFormat(int channels, bool bc7 = false);
+
+	/**
+	 * @brief Encodes an 8-bit image (1 to 4 channels, rows tightly packed) into 4x4 blocks.
+	 *
+	 * Each block takes the principal axis of its colors as the endpoint line, picks the nearest
+	 * palette entry for every texel (4 texels at a time with SSE) and refits the endpoints to those
+	 * indices once by least squares. Rows of blocks are spread over the pool. BC1 and BC3 take
+	 * gray images as gray RGB, BC4 and BC5 read the first channels as they are. The blocks on the
+	 * right and bottom edges repeat the last texels.
+	 */
+	std::vector<uint8_t> compressImage(const uint8_t* pixels, int width, int height, int channels, BlockFormat format,
+	                                   ThreadPool* pool = nullptr);
+	// Decodes blocks to blockFormatChannels(format) channels (BC7: only mode 6, the one compressImage writes)
+	std::vector<uint8_t> decompressImage(const uint8_t* blocks, int width, int height, BlockFormat format);
+	// Peak signal to noise ratio over the channels both images have, in dB (infinite when equal)
+	double computePsnr(const uint8_t* reference, int referenceChannels, const uint8_t* image, int imageChannels,
+	                   size_t pixelCount);
+
+	// GL internal format of a block format (the S3TC and BPTC tokens are defined when glad lacks them)
+	GLenum compressedInternalFormat(BlockFormat format);
+	// RGTC is core, S3TC and BPTC depend on the driver (the context must be current)
+	bool isBlockFormatSupported(BlockFormat format);
+}
+#endif
@@ -0,0 +1,120 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include <glad/glad.h>
+#include <glengine/memoryUsage.hpp>
+#include <glengine/threadPool.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	struct DecodedImage {
+		int width = 0;
+		int height = 0;
+		int channels = 0;                       // 1 to 4, 8 bits each, rows tightly packed
+		std::vector<unsigned char> pixels;
+		// Levels 1 to 1x1 when the decoder made them (see generateMipmaps), else glGenerateMipmap does
+		std::vector<std::vector<unsigned char>> mipLevels;
+	};
+
+	// Formats of an 8-bit image with 1 to 4 channels (R8, RG8, RGB8 or RGBA8)
+	GLint textureInternalFormat(int channels);
+	GLenum textureFormat(int channels);
+	// Single channel images are shown in gray rather than red
+	void setTextureSwizzle(GLenum target, int channels);
+
+	/**
+	 * @brief Loads textures without ever blocking the render thread.
+	 *
+	 * request() returns a texture at once, showing a small placeholder. The image is decoded by
+	 * the thread pool, then update() (once per frame) copies it into a ring of pixel unpack buffers
+	 * and starts the transfers from there. A ring slot is only reused once its fence signaled, and
+	 * at most one ring's worth of rows is copied per frame: large images are spread over several
+	 * frames. Mip levels made by the decoder are streamed too, smallest first, each one becoming
+	 * the base level once its rows are sent; otherwise glGenerateMipmap runs the frame after the
+	 * last rows were uploaded.
+	 */
+	class TextureStreamer {
+	public:
+		typedef std::function<bool(const std::string& path, DecodedImage& image)> Decoder;
+
+		struct Stats {
+			size_t requested = 0;
+			size_t completed = 0;
+			size_t failed = 0;                  // Could not be decoded, the placeholder stays
+			size_t uploadedBytes = 0;
+			double lastUpdateMs = 0.0;          // Render thread time of the last update()
+			double maxUpdateMs = 0.0;
+		};
+		// A texture done loading and its GPU memory (with its mipmaps)
+		struct Completed {
+			GLuint texture;
+			size_t bytes;
+			bool failed;
+		};
+
+		TextureStreamer(ThreadPool& pool, Decoder decoder, size_t slotBytes = 4 << 20, int slotCount = 3);
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		// The texture belongs to the caller, but must not be deleted before isReady()
+		GLuint request(const std::string& path);
+		// Collects the decoded images and uploads what the free ring slots can take
+		void update();
+
+		bool isReady(GLuint texture) const { return pending.count(texture) == 0; }
+		// Textures done since the last call
+		std::vector<Completed> takeCompleted();
+		size_t getPendingCount() const { return pending.size(); }
+		const Stats& getStats() const { return stats; }
+		// The textures belong to the caller: the staging ring on the GPU, the decoded images on the CPU
+		MemoryUsage getMemoryUsage() const;
+		void release();
+
+	private:
+		struct Job {
+			GLuint texture = 0;
+			std::future<std::shared_ptr<DecodedImage>> decoding;
+			std::shared_ptr<DecodedImage> image;
+			int level = 0;                      // Mip level being uploaded, -1 once done
+			int nextRow = 0;                    // Its first row not uploaded yet
+		};
+		struct Slot {
+			GLuint buffer = 0;
+			GLsync fence = 0;
+		};
+		// Rows of a job copied in a slot, sent to the texture once the slot is unmapped
+		struct Band {
+			Job* job;
+			int level, firstRow, rowCount;
+			size_t offset;
+		};
+
+		bool isFree(Slot& slot);
+		void fillSlot(Slot& slot);
+		// Every row is sent: mip levels to generate, or done
+		void finish(const Job& job);
+
+		ThreadPool& pool;
+		Decoder decoder;
+		size_t slotBytes;
+		std::vector<Slot> slots;
+
+		std::deque<Job> decoding;
+		std::deque<Job> uploading;
+		std::vector<Completed> mipQueue;        // Uploaded without mip levels, generated at the next update()
+		std::vector<Completed> completed;
+		std::set<GLuint> pending;
+		Stats stats;
+	};
+}
+#endif
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace GLEngine {
+	/**
+	 * @brief Fixed set of worker threads running submitted tasks.
+	 *
+	 * parallelFor() splits a loop over the workers and the calling thread, submit() runs a
+	 * single task in the background and returns a future.
+	 */
+	class ThreadPool {
+	public:
+		// 0 uses one worker per hardware thread, minus the calling thread
+		explicit ThreadPool(unsigned int workerCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Workers plus the calling thread
+		unsigned int getConcurrency() const;
+
+		// Calls task(i) for every i in [0, count), returns once they are all done
+		void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+		template<class F>
+		auto submit(F&& function) -> std::future<decltype(function())> {
+			typedef decltype(function()) Result;
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+			std::future<Result> result = task->get_future();
+			enqueue([task]() { (*task)(); });
+			return result;
+		}
+
+	private:
+		void enqueue(std::function<void()> task);
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping;
+	};
+}
+#endif
@@ -0,0 +1,45 @@
+#ifndef TONAL_ART_MAP_HPP
+#define TONAL_ART_MAP_HPP
+
+#include <glengine/threadPool.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLEngine {
+	struct TonalArtMapSettings {
+		int toneCount = 6;
+		int levelCount = 8;          // Mip levels, clamped to the size
+		int size = 256;              // Side of the level 0 (a power of two)
+		float strokeWidth = 1.0f;    // Pixels, the same in every level
+		float strokeLength = 0.3f;   // Fraction of the texture side
+		float lightestInk = 0.08f;   // Ink coverage of the first tone
+		float darkestInk = 0.8f;     // Ink coverage of the last tone
+		uint32_t seed = 1;
+
+		// Identifies the generated maps, to name their cache
+		std::string getKey() const;
+	};
+
+	struct TonalArtMap {
+		int toneCount = 0;
+		int levelCount = 0;
+		std::vector<int> sizes;                      // Side of each level
+		// Each level holds its toneCount images stacked vertically, 255 being the blank paper
+		std::vector<std::vector<uint8_t>> levels;
+		std::vector<int> strokeCounts;               // Strokes in the darkest tone of each level
+		double generationMs = 0.0;
+	};
+
+	/**
+	 * @brief Procedural hatching tonal art map (Praun et al., "Real-Time Hatching").
+	 *
+	 * Strokes are drawn until each tone reaches its ink coverage, darker tones keeping the strokes
+	 * of the lighter ones and adding crossed directions. Across resolutions, a level contains every
+	 * stroke of the coarser levels, so hatching does not shimmer when the mip level changes.
+	 * The levels are drawn in parallel, each one on its own; the few whose stroke counts must be
+	 * raised to match a coarser level are then drawn again. Textures are tileable.
+	 */
+	TonalArtMap generateTonalArtMap(const TonalArtMapSettings& settings, ThreadPool* pool = nullptr);
+}
+#endif
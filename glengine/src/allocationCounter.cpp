@@ -0,0 +1,94 @@
+#include <glengine/allocationCounter.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace GLEngine {
+	namespace {
+		std::atomic<uint64_t> allocationCount{0};
+		std::atomic<uint64_t> allocationBytes{0};
+
+		void* countedAllocate(size_t size, size_t alignment, bool nothrow) {
+			allocationCount.fetch_add(1, std::memory_order_relaxed);
+			allocationBytes.fetch_add(size, std::memory_order_relaxed);
+			if (size == 0)
+				size = 1;
+			void* pointer = nullptr;
+			while (true) {
+				if (alignment <= alignof(std::max_align_t))
+					pointer = std::malloc(size);
+				else {
+#ifdef _WIN32
+					pointer = _aligned_malloc(size, alignment);
+#else
+					if (posix_memalign(&pointer, alignment, size) != 0)
+						pointer = nullptr;
+#endif
+				}
+				if (pointer)
+					return pointer;
+				std::new_handler handler = std::get_new_handler();
+				if (!handler) {
+					if (nothrow)
+						return nullptr;
+					throw std::bad_alloc();
+				}
+				handler();
+			}
+		}
+
+		void countedFree(void* pointer, size_t alignment) {
+#ifdef _WIN32
+			if (alignment > alignof(std::max_align_t)) {
+				_aligned_free(pointer);
+				return;
+			}
+#else
+			(void)alignment;
+#endif
+			std::free(pointer);
+		}
+	}
+
+	AllocationCount getAllocationCount() {
+		AllocationCount current;
+		current.count = allocationCount.load(std::memory_order_relaxed);
+		current.bytes = allocationBytes.load(std::memory_order_relaxed);
+		return current;
+	}
+}
+
+// Replacements of the global allocation functions, the sized and aligned ones included
+using GLEngine::countedAllocate;
+using GLEngine::countedFree;
+const size_t defaultAlignment = alignof(std::max_align_t);
+
+void* operator new(size_t size) { return countedAllocate(size, defaultAlignment, false); }
+void* operator new[](size_t size) { return countedAllocate(size, defaultAlignment, false); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, defaultAlignment, true); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, defaultAlignment, true); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, (size_t)alignment, false); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, (size_t)alignment, false); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return countedAllocate(size, (size_t)alignment, true);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return countedAllocate(size, (size_t)alignment, true);
+}
+
+void operator delete(void* pointer) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete(void* pointer, size_t) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete[](void* pointer, size_t) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer, defaultAlignment); }
+void operator delete(void* pointer, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	countedFree(pointer, (size_t)alignment);
+}
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	countedFree(pointer, (size_t)alignment);
+}
@@ -0,0 +1,68 @@
+#include <glengine/arena.hpp>
+#include <algorithm>
+#include <new>
+
+namespace GLEngine {
+	Arena::Arena(size_t blockSize)
+	: blockSize(std::max(blockSize, (size_t)256)), offset(0), used(0), peak(0) {}
+
+	Arena::~Arena() {
+		for (const Block& block : blocks)
+			::operator delete(block.data);
+	}
+
+	void* Arena::allocate(size_t bytes, size_t alignment) {
+		if (!blocks.empty()) {
+			Block& block = blocks.back();
+			// The address is aligned, not the offset: alignments beyond the block's own are honoured
+			uintptr_t base = (uintptr_t)block.data;
+			size_t start = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+			if (start + bytes <= block.size) {
+				used += start - offset + bytes;
+				peak = std::max(peak, used);
+				offset = start + bytes;
+				return block.data + start;
+			}
+		}
+		// A new block, at least as large as the request (blocks are aligned for any fundamental type)
+		Block block;
+		block.size = std::max(blockSize, bytes + alignment);
+		block.data = (uint8_t*)::operator new(block.size);
+		blocks.push_back(block);
+		size_t start = (alignment - (uintptr_t)block.data % alignment) % alignment;
+		offset = start + bytes;
+		used += offset;
+		peak = std::max(peak, used);
+		return block.data + start;
+	}
+
+	void Arena::deallocate(void* pointer, size_t bytes) {
+		if (blocks.empty() || (uint8_t*)pointer + bytes != blocks.back().data + offset)
+			return;
+		offset -= bytes;
+		used -= bytes;
+	}
+
+	void Arena::reset() {
+		used = 0;
+		offset = 0;
+		if (blocks.size() <= 1)
+			return;
+		// One block holding what all of them did, for the next time
+		size_t size = getCapacity();
+		for (const Block& block : blocks)
+			::operator delete(block.data);
+		blocks.clear();
+		Block block;
+		block.size = size;
+		block.data = (uint8_t*)::operator new(size);
+		blocks.push_back(block);
+	}
+
+	size_t Arena::getCapacity() const {
+		size_t capacity = 0;
+		for (const Block& block : blocks)
+			capacity += block.size;
+		return capacity;
+	}
+}
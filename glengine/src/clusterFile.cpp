@@ -0,0 +1,388 @@
+#include <glengine/clusterFile.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace GLEngine {
+	namespace {
+		struct FileHeader {
+			char magic[8];
+			uint32_t clusterCount;
+			uint32_t maxTriangles;
+			uint64_t recordOffset;
+			uint64_t leafTriangles;
+			float boundsMin[3];
+			float boundsMax[3];
+		};
+		const char fileMagic[8] = { 'G', 'L', 'C', 'L', 'U', 'S', '1', '\0' };
+
+		AABB geometryBounds(const ClusterGeometry& geometry) {
+			return AABB::fromPositions(geometry.positions.data(), geometry.getVertexCount());
+		}
+
+		// Spreads the 21 low bits of x over every third bit
+		uint64_t spreadBits(uint64_t x) {
+			x &= 0x1fffff;
+			x = (x | x << 32) & 0x1f00000000ffffULL;
+			x = (x | x << 16) & 0x1f0000ff0000ffULL;
+			x = (x | x << 8) & 0x100f00f00f00f00fULL;
+			x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+			x = (x | x << 2) & 0x1249249249249249ULL;
+			return x;
+		}
+	}
+
+	uint64_t mortonCode(const glm::vec3& point, const AABB& bounds) {
+		glm::vec3 scale = 2097151.0f / glm::max(bounds.max - bounds.min, glm::vec3(1e-20f));
+		glm::uvec3 cell = glm::uvec3(glm::clamp((point - bounds.min) * scale, glm::vec3(0.0f), glm::vec3(2097151.0f)));
+		return spreadBits(cell.x) | spreadBits(cell.y) << 1 | spreadBits(cell.z) << 2;
+	}
+
+	AABB ClusterRecord::getBounds() const {
+		AABB bounds;
+		bounds.min = glm::vec3(boundsMin[0], boundsMin[1], boundsMin[2]);
+		bounds.max = glm::vec3(boundsMax[0], boundsMax[1], boundsMax[2]);
+		return bounds;
+	}
+
+	float simplifyClusters(const std::vector<const ClusterGeometry*>& clusters, int maxTriangles, float minimumCell,
+	                       ClusterGeometry& result) {
+		size_t triangles = 0, vertices = 0;
+		AABB bounds;
+		bool first = true;
+		for (const ClusterGeometry* cluster : clusters) {
+			triangles += cluster->getTriangleCount();
+			vertices += cluster->getVertexCount();
+			if (cluster->getVertexCount() == 0)
+				continue;
+			AABB clusterBounds = geometryBounds(*cluster);
+			if (first)
+				bounds = clusterBounds;
+			else
+				bounds.merge(clusterBounds);
+			first = false;
+		}
+
+		// Few enough triangles: the clusters are only put together
+		result = ClusterGeometry();
+		if (triangles <= (size_t)maxTriangles && vertices <= 0xffff) {
+			for (const ClusterGeometry* cluster : clusters) {
+				uint16_t base = (uint16_t)result.getVertexCount();
+				result.positions.insert(result.positions.end(), cluster->positions.begin(), cluster->positions.end());
+				result.normals.insert(result.normals.end(), cluster->normals.begin(), cluster->normals.end());
+				for (uint16_t index : cluster->indices)
+					result.indices.push_back((uint16_t)(base + index));
+			}
+			return minimumCell;
+		}
+
+		glm::vec3 size = bounds.max - bounds.min;
+		float extent = std::max(size.x, std::max(size.y, size.z));
+		float cell = std::max(minimumCell, extent / std::sqrt((float)maxTriangles) * 0.5f);
+		cell = std::exp2(std::ceil(std::log2(std::max(cell, 1e-20f))));
+		std::unordered_map<uint64_t, uint16_t> cellVertices;
+		std::vector<glm::vec3> normalSums;
+		while (true) {
+			result = ClusterGeometry();
+			cellVertices.clear();
+			normalSums.clear();
+			glm::vec3 origin = glm::floor(bounds.min / cell);
+			bool tooManyVertices = false;
+			for (const ClusterGeometry* cluster : clusters) {
+				for (size_t t = 0; t + 2 < cluster->indices.size() && !tooManyVertices; t += 3) {
+					uint16_t corners[3];
+					uint64_t keys[3];
+					for (int c = 0; c < 3; c++) {
+						const float* p = &cluster->positions[(size_t)cluster->indices[t + c] * 3];
+						glm::vec3 cellIndex = glm::floor(glm::vec3(p[0], p[1], p[2]) / cell);
+						glm::uvec3 local = glm::uvec3(glm::max(cellIndex - origin, glm::vec3(0.0f)));
+						keys[c] = (uint64_t)local.x | (uint64_t)local.y << 21 | (uint64_t)local.z << 42;
+						auto found = cellVertices.find(keys[c]);
+						if (found == cellVertices.end()) {
+							if (result.getVertexCount() == 0xffff) {
+								tooManyVertices = true;
+								break;
+							}
+							// The center of the cell, the same for every cluster snapped with this cell
+							glm::vec3 position = (cellIndex + 0.5f) * cell;
+							found = cellVertices.emplace(keys[c], (uint16_t)result.getVertexCount()).first;
+							result.positions.insert(result.positions.end(), { position.x, position.y, position.z });
+							normalSums.push_back(glm::vec3(0.0f));
+						}
+						corners[c] = found->second;
+						const float* n = &cluster->normals[(size_t)cluster->indices[t + c] * 3];
+						normalSums[corners[c]] += glm::vec3(n[0], n[1], n[2]);
+					}
+					// Triangles collapsed in a cell or on an edge disappear
+					if (!tooManyVertices && keys[0] != keys[1] && keys[1] != keys[2] && keys[0] != keys[2])
+						result.indices.insert(result.indices.end(), { corners[0], corners[1], corners[2] });
+				}
+			}
+			if (!tooManyVertices && result.getTriangleCount() <= (size_t)maxTriangles)
+				break;
+			cell *= 2.0f;
+		}
+		for (const glm::vec3& sum : normalSums) {
+			glm::vec3 normal = glm::length(sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+			result.normals.insert(result.normals.end(), { normal.x, normal.y, normal.z });
+		}
+		return cell;
+	}
+
+	ClusterWriter::ClusterWriter(const std::string& path, const ClusterBuildSettings& settings)
+	: path(path), settings(settings), file(path, std::ios::binary | std::ios::trunc), failed(false), dataEnd(sizeof(FileHeader)) {
+		this->settings.maxTriangles = std::clamp(settings.maxTriangles, 64, 0xffff / 3);
+		this->settings.groupSize = std::max(settings.groupSize, 2);
+		FileHeader header = {};
+		file.write((const char*)&header, sizeof(header));
+	}
+
+	uint32_t ClusterWriter::write(const ClusterGeometry& geometry, float error, uint32_t level) {
+		ClusterRecord record = {};
+		AABB bounds = geometryBounds(geometry);
+		for (int i = 0; i < 3; i++) {
+			record.boundsMin[i] = bounds.min[i];
+			record.boundsMax[i] = bounds.max[i];
+		}
+		record.error = error;
+		record.level = level;
+		record.parent = -1;
+		record.vertexCount = (uint32_t)geometry.getVertexCount();
+		record.triangleCount = (uint32_t)geometry.getTriangleCount();
+		record.offset = dataEnd;
+		file.write((const char*)geometry.positions.data(), geometry.positions.size() * sizeof(float));
+		file.write((const char*)geometry.normals.data(), geometry.normals.size() * sizeof(float));
+		file.write((const char*)geometry.indices.data(), geometry.indices.size() * sizeof(uint16_t));
+		if (!file)
+			failed = true;
+		dataEnd += record.getDataBytes();
+
+		records.push_back(record);
+		children.emplace_back();
+		stats.clusters++;
+		stats.triangles += record.triangleCount;
+		stats.levels = std::max(stats.levels, level + 1);
+		return (uint32_t)records.size() - 1;
+	}
+
+	void ClusterWriter::addLeaf(ClusterGeometry geometry) {
+		uint32_t id = write(geometry, 0.0f, 0);
+		stats.leaves++;
+		stats.leafTriangles += geometry.getTriangleCount();
+		push(0, { id, std::move(geometry) });
+	}
+
+	void ClusterWriter::push(uint32_t level, Pending cluster) {
+		if (pending.size() <= level)
+			pending.resize(level + 1);
+		pending[level].push_back(std::move(cluster));
+		if ((int)pending[level].size() == settings.groupSize)
+			merge(level);
+	}
+
+	void ClusterWriter::merge(uint32_t level) {
+		std::vector<Pending> group = std::move(pending[level]);
+		pending[level].clear();
+		std::vector<const ClusterGeometry*> geometries;
+		float minimumCell = 0.0f;
+		for (const Pending& cluster : group) {
+			geometries.push_back(&cluster.geometry);
+			minimumCell = std::max(minimumCell, records[cluster.id].error);
+		}
+		ClusterGeometry merged;
+		float error = simplifyClusters(geometries, settings.maxTriangles, minimumCell, merged);
+		uint32_t parent = write(merged, error, level + 1);
+
+		// The parent covers its children even where snapping moved the surface inside them
+		if (merged.getVertexCount() == 0) {
+			std::memcpy(records[parent].boundsMin, records[group[0].id].boundsMin, sizeof(records[parent].boundsMin));
+			std::memcpy(records[parent].boundsMax, records[group[0].id].boundsMax, sizeof(records[parent].boundsMax));
+		}
+		for (const Pending& cluster : group) {
+			ClusterRecord& child = records[cluster.id];
+			child.parent = (int32_t)parent;
+			children[parent].push_back(cluster.id);
+			for (int i = 0; i < 3; i++) {
+				records[parent].boundsMin[i] = std::min(records[parent].boundsMin[i], child.boundsMin[i]);
+				records[parent].boundsMax[i] = std::max(records[parent].boundsMax[i], child.boundsMax[i]);
+			}
+		}
+		push(level + 1, { parent, std::move(merged) });
+	}
+
+	bool ClusterWriter::finish() {
+		auto start = std::chrono::steady_clock::now();
+		// What is left of every level goes up, a lone cluster without merging
+		for (uint32_t level = 0; level < pending.size(); level++) {
+			bool above = false;
+			for (uint32_t upper = level + 1; upper < pending.size(); upper++)
+				above = above || !pending[upper].empty();
+			if (pending[level].empty() || (!above && pending[level].size() == 1))
+				continue;
+			if (pending[level].size() == 1) {
+				Pending lone = std::move(pending[level][0]);
+				pending[level].clear();
+				push(level + 1, std::move(lone));
+			}
+			else
+				merge(level);
+		}
+		if (records.empty() || !isOpen())
+			return false;
+		// The last level always holds the root: a merge or a lone cluster went up to it
+		uint32_t root = pending.back()[0].id;
+		pending.clear();
+
+		// Breadth first order: the root first, the children of every cluster consecutive
+		std::vector<uint32_t> order(1, root), newIds(records.size());
+		for (size_t i = 0; i < order.size(); i++)
+			for (uint32_t child : children[order[i]])
+				order.push_back(child);
+		for (size_t i = 0; i < order.size(); i++)
+			newIds[order[i]] = (uint32_t)i;
+		std::vector<ClusterRecord> sorted;
+		sorted.reserve(order.size());
+		for (uint32_t id : order) {
+			ClusterRecord record = records[id];
+			record.parent = record.parent < 0 ? -1 : (int32_t)newIds[record.parent];
+			record.childCount = (uint32_t)children[id].size();
+			record.firstChild = record.childCount ? newIds[children[id][0]] : 0;
+			sorted.push_back(record);
+		}
+
+		FileHeader header = {};
+		std::memcpy(header.magic, fileMagic, sizeof(header.magic));
+		header.clusterCount = (uint32_t)sorted.size();
+		header.maxTriangles = (uint32_t)settings.maxTriangles;
+		header.recordOffset = dataEnd;
+		header.leafTriangles = stats.leafTriangles;
+		std::memcpy(header.boundsMin, sorted[0].boundsMin, sizeof(header.boundsMin));
+		std::memcpy(header.boundsMax, sorted[0].boundsMax, sizeof(header.boundsMax));
+		file.write((const char*)sorted.data(), sorted.size() * sizeof(ClusterRecord));
+		file.seekp(0);
+		file.write((const char*)&header, sizeof(header));
+		file.close();
+		stats.bytes = dataEnd + sorted.size() * sizeof(ClusterRecord);
+		stats.buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return !file.fail() && !failed;
+	}
+
+	bool buildClusterFile(const std::string& path, const float* positions, const float* normals, size_t vertexCount,
+	                      const unsigned int* indices, size_t indexCount, const ClusterBuildSettings& settings,
+	                      ClusterBuildStats* stats) {
+		auto start = std::chrono::steady_clock::now();
+		ClusterWriter writer(path, settings);
+		if (!writer.isOpen() || vertexCount == 0 || indexCount < 3)
+			return false;
+
+		// Triangles ordered by the Morton code of their centroid
+		AABB bounds = AABB::fromPositions(positions, vertexCount);
+		size_t triangleCount = indexCount / 3;
+		std::vector<std::pair<uint64_t, uint32_t>> order(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++) {
+			glm::vec3 centroid(0.0f);
+			for (int c = 0; c < 3; c++)
+				centroid += glm::vec3(positions[indices[3 * t + c] * 3], positions[indices[3 * t + c] * 3 + 1],
+				                      positions[indices[3 * t + c] * 3 + 2]);
+			order[t] = { mortonCode(centroid / 3.0f, bounds), (uint32_t)t };
+		}
+		std::sort(order.begin(), order.end());
+
+		// Consecutive runs of triangles become the leaves, with their own vertices
+		int maxTriangles = std::clamp(settings.maxTriangles, 64, 0xffff / 3);
+		std::vector<uint32_t> localIndex(vertexCount), stamp(vertexCount, UINT32_MAX);
+		for (size_t first = 0, leaf = 0; first < triangleCount; first += maxTriangles, leaf++) {
+			ClusterGeometry geometry;
+			size_t last = std::min(first + maxTriangles, triangleCount);
+			for (size_t i = first; i < last; i++) {
+				for (int c = 0; c < 3; c++) {
+					unsigned int vertex = indices[3 * order[i].second + c];
+					if (stamp[vertex] != leaf) {
+						stamp[vertex] = (uint32_t)leaf;
+						localIndex[vertex] = (uint32_t)geometry.getVertexCount();
+						geometry.positions.insert(geometry.positions.end(), positions + 3 * vertex, positions + 3 * vertex + 3);
+						geometry.normals.insert(geometry.normals.end(), normals + 3 * vertex, normals + 3 * vertex + 3);
+					}
+					geometry.indices.push_back((uint16_t)localIndex[vertex]);
+				}
+			}
+			writer.addLeaf(std::move(geometry));
+		}
+		bool written = writer.finish();
+		if (stats) {
+			*stats = writer.getStats();
+			stats->buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		return written;
+	}
+
+	bool ClusterFile::open(const std::string& filePath) {
+		path = filePath;
+		records.clear();
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in)
+			return false;
+		uint64_t fileSize = (uint64_t)in.tellg();
+		in.seekg(0);
+		// The records come last, after the geometry: the counts have to fit in the file before the
+		// records are allocated
+		FileHeader header;
+		if (fileSize < sizeof(header) || !in.read((char*)&header, sizeof(header))
+		    || std::memcmp(header.magic, fileMagic, sizeof(header.magic)) != 0 || header.clusterCount == 0
+		    || header.recordOffset < sizeof(header) || header.recordOffset > fileSize
+		    || header.clusterCount > (fileSize - header.recordOffset) / sizeof(ClusterRecord))
+			return false;
+		records.resize(header.clusterCount);
+		in.seekg((std::streamoff)header.recordOffset);
+		if (!in.read((char*)records.data(), records.size() * sizeof(ClusterRecord)) || !validRecords(header.recordOffset)) {
+			records.clear();
+			return false;
+		}
+		bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+		leafTriangles = header.leafTriangles;
+		return true;
+	}
+
+	bool ClusterFile::validRecords(uint64_t dataEnd) const {
+		// The root is the highest level, children come after their parent (so the tree has no
+		// cycle) one level below it, the geometry lies before the records and is indexable in 16 bits
+		uint64_t count = records.size();
+		for (uint64_t i = 0; i < count; i++) {
+			const ClusterRecord& record = records[i];
+			if (record.level > records[0].level || (i == 0) != (record.parent < 0)
+			    || (record.parent >= 0 && (uint64_t)record.parent >= i)
+			    || record.vertexCount > 0x10000 || record.offset < sizeof(FileHeader)
+			    || record.offset > dataEnd || record.getDataBytes() > dataEnd - record.offset)
+				return false;
+			if (record.childCount == 0)
+				continue;
+			if (record.firstChild <= i || record.level == 0 || (uint64_t)record.firstChild + record.childCount > count)
+				return false;
+			for (uint32_t child = record.firstChild; child < record.firstChild + record.childCount; child++)
+				if (records[child].level >= record.level)
+					return false;
+		}
+		return true;
+	}
+
+	bool ClusterFile::readCluster(const std::string& path, const ClusterRecord& record, ClusterGeometry& geometry) {
+		std::ifstream in(path, std::ios::binary);
+		in.seekg((std::streamoff)record.offset);
+		geometry.positions.resize((size_t)record.vertexCount * 3);
+		geometry.normals.resize((size_t)record.vertexCount * 3);
+		geometry.indices.resize((size_t)record.triangleCount * 3);
+		in.read((char*)geometry.positions.data(), geometry.positions.size() * sizeof(float));
+		in.read((char*)geometry.normals.data(), geometry.normals.size() * sizeof(float));
+		in.read((char*)geometry.indices.data(), geometry.indices.size() * sizeof(uint16_t));
+		if (!in)
+			return false;
+		// An index past the vertices would read outside them on the GPU
+		for (uint16_t index : geometry.indices)
+			if (index >= record.vertexCount)
+				return false;
+		return true;
+	}
+}
@@ -0,0 +1,296 @@
+#include <glengine/clusterStreamer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace GLEngine {
+	namespace {
+		const size_t vertexBytes = 6 * sizeof(float);
+	}
+
+	ClusterStreamer::ClusterStreamer(ThreadPool& pool, const Settings& settings)
+	: pool(pool), settings(settings), frame(0) {
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &positionBuffer);
+		glGenBuffers(1, &normalBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	ClusterStreamer::~ClusterStreamer() {
+		release();
+	}
+
+	void ClusterStreamer::release() {
+		// The reads in flight only hold copies, they finish on their own
+		reads.clear();
+		if (vao) {
+			glDeleteVertexArrays(1, &vao);
+			glDeleteBuffers(1, &positionBuffer);
+			glDeleteBuffers(1, &normalBuffer);
+			glDeleteBuffers(1, &indexBuffer);
+			vao = positionBuffer = normalBuffer = indexBuffer = 0;
+		}
+	}
+
+	bool ClusterStreamer::open(const std::string& path) {
+		reads.clear();
+		residentClusters.clear();
+		drawCounts.clear();
+		drawOffsets.clear();
+		drawBaseVertices.clear();
+		stats = Stats();
+		if (!file.open(path)) {
+			clusters.clear();
+			return false;
+		}
+		const std::vector<ClusterRecord>& records = file.getRecords();
+		clusters.assign(records.size(), Cluster());
+
+		// The pool is shared between vertices and indices like the file is, and holds at least the
+		// largest clusters of a path from the root to a leaf
+		size_t fileVertexBytes = 0, fileIndexBytes = 0, largest = 0;
+		for (const ClusterRecord& record : records) {
+			fileVertexBytes += record.vertexCount * vertexBytes;
+			fileIndexBytes += record.triangleCount * 3 * sizeof(uint16_t);
+			largest = std::max(largest, record.getDataBytes());
+		}
+		size_t poolBytes = std::max(settings.poolBytes, largest * 4 * file.getLevelCount());
+		double vertexShare = (double)fileVertexBytes / std::max(fileVertexBytes + fileIndexBytes, (size_t)1);
+		size_t vertexCapacity = (size_t)(poolBytes * vertexShare) / vertexBytes;
+		size_t indexCapacity = (size_t)(poolBytes * (1.0 - vertexShare)) / sizeof(uint16_t);
+		vertexAllocator = FreeListAllocator(vertexCapacity);
+		indexAllocator = FreeListAllocator(indexCapacity);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, normalBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(uint16_t), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		stats.clusters = records.size();
+		stats.poolBytes = vertexCapacity * vertexBytes + indexCapacity * sizeof(uint16_t);
+		return true;
+	}
+
+	float ClusterStreamer::projectedError(uint32_t id, const glm::mat4& model, const glm::vec3& cameraPosition,
+	                                      float pixelsPerUnit, float modelScale) const {
+		const ClusterRecord& record = file.getRecords()[id];
+		AABB box = record.getBounds().transformed(model);
+		float distance = glm::distance(cameraPosition, glm::clamp(cameraPosition, box.min, box.max));
+		return record.error * modelScale * pixelsPerUnit / std::max(distance, 1e-4f);
+	}
+
+	void ClusterStreamer::select(uint32_t id, const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPosition,
+	                             float pixelsPerUnit, float modelScale) {
+		const ClusterRecord& record = file.getRecords()[id];
+		if (!frustum.intersects(record.getBounds().transformed(model)))
+			return;
+		Cluster& cluster = clusters[id];
+		if (cluster.state != State::RESIDENT) {
+			// Only the root gets here without being resident
+			if (cluster.state == State::ON_DISK)
+				wanted.push_back({ std::numeric_limits<float>::max(), id });
+			return;
+		}
+		cluster.lastUse = frame;
+
+		float error = projectedError(id, model, cameraPosition, pixelsPerUnit, modelScale);
+		if (record.childCount > 0 && error > settings.errorThreshold) {
+			// The resident children are kept while their siblings arrive
+			bool childrenResident = true;
+			for (uint32_t child = record.firstChild; child < record.firstChild + record.childCount; child++) {
+				if (clusters[child].state == State::RESIDENT) {
+					clusters[child].lastUse = frame;
+					continue;
+				}
+				if (!frustum.intersects(file.getRecords()[child].getBounds().transformed(model)))
+					continue;
+				childrenResident = false;
+				if (clusters[child].state == State::ON_DISK)
+					wanted.push_back({ error, child });
+			}
+			if (childrenResident) {
+				for (uint32_t child = record.firstChild; child < record.firstChild + record.childCount; child++)
+					select(child, model, frustum, cameraPosition, pixelsPerUnit, modelScale);
+				return;
+			}
+			stats.waiting++;
+		}
+
+		if (record.triangleCount == 0)
+			return;
+		drawCounts.push_back((GLsizei)record.triangleCount * 3);
+		drawOffsets.push_back((const void*)(cluster.firstIndex * sizeof(uint16_t)));
+		drawBaseVertices.push_back((GLint)cluster.baseVertex);
+		stats.drawnClusters++;
+		stats.drawnTriangles += record.triangleCount;
+		stats.drawnPerLevel[record.level]++;
+	}
+
+	void ClusterStreamer::update(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+	                             float pixelsPerUnit) {
+		if (!isOpen())
+			return;
+		auto start = std::chrono::steady_clock::now();
+		frame++;
+
+		// Clusters to draw from what is resident, the missing ones they wait for
+		drawCounts.clear();
+		drawOffsets.clear();
+		drawBaseVertices.clear();
+		wanted.clear();
+		stats.drawnClusters = stats.drawnTriangles = stats.waiting = 0;
+		stats.drawnPerLevel.assign(file.getLevelCount(), 0);
+		float modelScale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		select(0, model, Frustum::fromMatrix(viewProjection), cameraPosition, pixelsPerUnit, modelScale);
+
+		// The most visible errors are read first, as long as the pool can take them without evicting
+		// what this frame uses: otherwise they would be read again and again for nothing
+		std::sort(wanted.begin(), wanted.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+			return a.first > b.first;
+		});
+		size_t freeVertices = vertexAllocator.getCapacity() - vertexAllocator.getUsed();
+		size_t freeIndices = indexAllocator.getCapacity() - indexAllocator.getUsed();
+		for (uint32_t id : residentClusters) {
+			if (clusters[id].lastUse < frame) {
+				freeVertices += file.getRecords()[id].vertexCount;
+				freeIndices += (size_t)file.getRecords()[id].triangleCount * 3;
+			}
+		}
+		for (const Read& read : reads) {
+			freeVertices -= std::min(freeVertices, (size_t)file.getRecords()[read.cluster].vertexCount);
+			freeIndices -= std::min(freeIndices, (size_t)file.getRecords()[read.cluster].triangleCount * 3);
+		}
+		std::string path = file.getPath();
+		for (const std::pair<float, uint32_t>& request : wanted) {
+			if ((int)reads.size() >= settings.maxReadsInFlight)
+				break;
+			uint32_t id = request.second;
+			ClusterRecord record = file.getRecords()[id];
+			if (record.vertexCount > freeVertices || (size_t)record.triangleCount * 3 > freeIndices)
+				continue;
+			freeVertices -= record.vertexCount;
+			freeIndices -= (size_t)record.triangleCount * 3;
+			clusters[id].state = State::READING;
+			reads.push_back({ id, pool.submit([path, record]() {
+				std::shared_ptr<ClusterGeometry> geometry = std::make_shared<ClusterGeometry>();
+				if (!ClusterFile::readCluster(path, record, *geometry))
+					return std::shared_ptr<ClusterGeometry>();
+				return geometry;
+			}) });
+			stats.reads++;
+		}
+
+		// Arrived clusters, shown from the next frame, within the upload budget
+		size_t uploaded = 0;
+		for (auto it = reads.begin(); it != reads.end() && uploaded < settings.uploadBytesPerFrame;) {
+			if (it->geometry.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+			uint32_t id = it->cluster;
+			std::shared_ptr<ClusterGeometry> geometry = it->geometry.get();
+			it = reads.erase(it);
+			if (!geometry) {
+				stats.readFailures++;
+				clusters[id].state = State::ON_DISK;
+				continue;
+			}
+			stats.readBytes += file.getRecords()[id].getDataBytes();
+			if (upload(id, *geometry))
+				uploaded += file.getRecords()[id].getDataBytes();
+			else
+				clusters[id].state = State::ON_DISK;
+		}
+		stats.uploadedBytes += uploaded;
+
+		stats.resident = residentClusters.size();
+		stats.reading = reads.size();
+		stats.poolUsed = vertexAllocator.getUsed() * vertexBytes + indexAllocator.getUsed() * sizeof(uint16_t);
+		stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool ClusterStreamer::upload(uint32_t id, const ClusterGeometry& geometry) {
+		Cluster& cluster = clusters[id];
+		size_t vertexCount = geometry.getVertexCount(), indexCount = geometry.indices.size();
+		if (vertexCount > 0) {
+			// Room is made by evicting the least recently drawn clusters
+			while ((cluster.baseVertex = vertexAllocator.allocate(vertexCount)) == FreeListAllocator::INVALID)
+				if (!evictOne())
+					return false;
+			while ((cluster.firstIndex = indexAllocator.allocate(indexCount)) == FreeListAllocator::INVALID) {
+				if (!evictOne()) {
+					vertexAllocator.free(cluster.baseVertex, vertexCount);
+					return false;
+				}
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, positionBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, cluster.baseVertex * 3 * sizeof(float), vertexCount * 3 * sizeof(float),
+			                geometry.positions.data());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, normalBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, cluster.baseVertex * 3 * sizeof(float), vertexCount * 3 * sizeof(float),
+			                geometry.normals.data());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, cluster.firstIndex * sizeof(uint16_t), indexCount * sizeof(uint16_t),
+			                geometry.indices.data());
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		// Not evicted before its first frame on screen
+		cluster.state = State::RESIDENT;
+		cluster.lastUse = frame;
+		residentClusters.push_back(id);
+		return true;
+	}
+
+	bool ClusterStreamer::evictOne() {
+		size_t oldest = residentClusters.size();
+		for (size_t i = 0; i < residentClusters.size(); i++) {
+			uint64_t lastUse = clusters[residentClusters[i]].lastUse;
+			if (lastUse < frame && (oldest == residentClusters.size() || lastUse < clusters[residentClusters[oldest]].lastUse))
+				oldest = i;
+		}
+		if (oldest == residentClusters.size())
+			return false;
+		evict(residentClusters[oldest]);
+		return true;
+	}
+
+	void ClusterStreamer::evict(uint32_t id) {
+		const ClusterRecord& record = file.getRecords()[id];
+		Cluster& cluster = clusters[id];
+		if (record.vertexCount > 0) {
+			vertexAllocator.free(cluster.baseVertex, record.vertexCount);
+			indexAllocator.free(cluster.firstIndex, (size_t)record.triangleCount * 3);
+		}
+		cluster.state = State::ON_DISK;
+		residentClusters.erase(std::find(residentClusters.begin(), residentClusters.end(), id));
+		stats.evictions++;
+	}
+
+	int ClusterStreamer::draw() const {
+		if (drawCounts.empty())
+			return 0;
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_SHORT, drawOffsets.data(),
+		                              (GLsizei)drawCounts.size(), drawBaseVertices.data());
+		return 1;
+	}
+
+	MemoryUsage ClusterStreamer::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.gpu = stats.poolBytes;
+		usage.host = heapBytes(file.getRecords()) + heapBytes(clusters) + heapBytes(residentClusters) + heapBytes(wanted)
+		           + vertexAllocator.getHeapBytes() + indexAllocator.getHeapBytes() + heapBytes(drawCounts)
+		           + heapBytes(drawOffsets) + heapBytes(drawBaseVertices) + heapBytes(stats.drawnPerLevel);
+		return usage;
+	}
+}
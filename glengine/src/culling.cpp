@@ -0,0 +1,305 @@
+#include <glengine/culling.hpp>
+#include <glengine/threadPool.hpp>
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+namespace GLEngine {
+	AABB AABB::transformed(const glm::mat4& matrix) const {
+		// Arvo: the extent of the transformed box is |M| * extent
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+		glm::vec3 extent = getExtent();
+		glm::vec3 newExtent(0.0f);
+		for (int column = 0; column < 3; column++)
+			newExtent += glm::abs(glm::vec3(matrix[column])) * extent[column];
+
+		AABB result;
+		result.min = center - newExtent;
+		result.max = center + newExtent;
+		return result;
+	}
+
+	AABB AABB::expanded(float margin) const {
+		AABB result;
+		result.min = min - glm::vec3(margin);
+		result.max = max + glm::vec3(margin);
+		return result;
+	}
+
+	void AABB::merge(const AABB& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	AABB AABB::fromPositions(const float* positions, size_t vertexCount) {
+		AABB result;
+		if (vertexCount == 0)
+			return result;
+		result.min = result.max = glm::vec3(positions[0], positions[1], positions[2]);
+		for (size_t i = 1; i < vertexCount; i++) {
+			glm::vec3 p(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+			result.min = glm::min(result.min, p);
+			result.max = glm::max(result.max, p);
+		}
+		return result;
+	}
+
+	Frustum Frustum::fromMatrix(const glm::mat4& m) {
+		Frustum frustum;
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		frustum.planes[0] = row3 + row0;   // Left
+		frustum.planes[1] = row3 - row0;   // Right
+		frustum.planes[2] = row3 + row1;   // Bottom
+		frustum.planes[3] = row3 - row1;   // Top
+		frustum.planes[4] = row3 + row2;   // Near
+		frustum.planes[5] = row3 - row2;   // Far
+
+		for (glm::vec4& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	bool Frustum::intersects(const AABB& box) const {
+		for (const glm::vec4& plane : planes) {
+			// Corner of the box furthest along the plane normal
+			glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y,
+			                 plane.z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	namespace {
+		// Tests the 8 boxes of a node against the frustum.
+		// outside: bit set if the box is entirely outside, intersecting: bit set if it crosses a plane.
+		template<class Node>
+		void testNode(const Node& node, const Frustum& frustum, int& outside, int& intersecting) {
+			outside = 0;
+			intersecting = 0;
+			for (const glm::vec4& plane : frustum.planes) {
+				// Corner furthest along the normal (p) and the opposite one (n)
+				const float* px = plane.x > 0.0f ? node.maxX : node.minX;
+				const float* py = plane.y > 0.0f ? node.maxY : node.minY;
+				const float* pz = plane.z > 0.0f ? node.maxZ : node.minZ;
+				const float* nx = plane.x > 0.0f ? node.minX : node.maxX;
+				const float* ny = plane.y > 0.0f ? node.minY : node.maxY;
+				const float* nz = plane.z > 0.0f ? node.minZ : node.maxZ;
+
+#if defined(__AVX__)
+				__m256 a = _mm256_set1_ps(plane.x), b = _mm256_set1_ps(plane.y);
+				__m256 c = _mm256_set1_ps(plane.z), d = _mm256_set1_ps(plane.w);
+				__m256 zero = _mm256_setzero_ps();
+				__m256 dp = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_load_ps(px)), _mm256_mul_ps(b, _mm256_load_ps(py))),
+				                          _mm256_add_ps(_mm256_mul_ps(c, _mm256_load_ps(pz)), d));
+				__m256 dn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_load_ps(nx)), _mm256_mul_ps(b, _mm256_load_ps(ny))),
+				                          _mm256_add_ps(_mm256_mul_ps(c, _mm256_load_ps(nz)), d));
+				outside |= _mm256_movemask_ps(_mm256_cmp_ps(dp, zero, _CMP_LT_OQ));
+				intersecting |= _mm256_movemask_ps(_mm256_cmp_ps(dn, zero, _CMP_LT_OQ));
+#elif defined(__SSE__)
+				__m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y);
+				__m128 c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+				__m128 zero = _mm_setzero_ps();
+				for (int half = 0; half < 2; half++) {
+					int o = half * 4;
+					__m128 dp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(px + o)), _mm_mul_ps(b, _mm_load_ps(py + o))),
+					                       _mm_add_ps(_mm_mul_ps(c, _mm_load_ps(pz + o)), d));
+					__m128 dn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_load_ps(nx + o)), _mm_mul_ps(b, _mm_load_ps(ny + o))),
+					                       _mm_add_ps(_mm_mul_ps(c, _mm_load_ps(nz + o)), d));
+					outside |= _mm_movemask_ps(_mm_cmplt_ps(dp, zero)) << o;
+					intersecting |= _mm_movemask_ps(_mm_cmplt_ps(dn, zero)) << o;
+				}
+#else
+				for (int i = 0; i < Bvh::WIDTH; i++) {
+					if (plane.x * px[i] + plane.y * py[i] + plane.z * pz[i] + plane.w < 0.0f)
+						outside |= 1 << i;
+					if (plane.x * nx[i] + plane.y * ny[i] + plane.z * nz[i] + plane.w < 0.0f)
+						intersecting |= 1 << i;
+				}
+#endif
+			}
+			intersecting &= ~outside;
+		}
+	}
+
+	void Bvh::clear() {
+		nodes.clear();
+		objectCount = 0;
+	}
+
+	void Bvh::build(const std::vector<AABB>& boxes) {
+		clear();
+		objectCount = boxes.size();
+		if (boxes.empty())
+			return;
+
+		std::vector<uint32_t> objects(boxes.size());
+		for (size_t i = 0; i < objects.size(); i++)
+			objects[i] = (uint32_t)i;
+		nodes.reserve(boxes.size() / (WIDTH - 1) + 1);
+		buildNode(boxes, objects, 0, objects.size());
+	}
+
+	int32_t Bvh::buildNode(const std::vector<AABB>& boxes, std::vector<uint32_t>& objects, size_t begin, size_t end) {
+		int32_t index = (int32_t)nodes.size();
+		nodes.emplace_back();
+
+		// Splitting the range in up to 8 groups with three rounds of median splits on the longest axis
+		std::vector<std::pair<size_t, size_t>> groups;
+		groups.push_back({ begin, end });
+		if (end - begin > (size_t)WIDTH) {
+			for (int round = 0; round < 3; round++) {
+				std::vector<std::pair<size_t, size_t>> next;
+				for (auto group : groups) {
+					if (group.second - group.first < 2) {
+						next.push_back(group);
+						continue;
+					}
+					AABB centers;
+					centers.min = centers.max = boxes[objects[group.first]].getCenter();
+					for (size_t i = group.first; i < group.second; i++) {
+						glm::vec3 c = boxes[objects[i]].getCenter();
+						centers.min = glm::min(centers.min, c);
+						centers.max = glm::max(centers.max, c);
+					}
+					glm::vec3 size = centers.max - centers.min;
+					int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+					size_t middle = (group.first + group.second) / 2;
+					std::nth_element(objects.begin() + group.first, objects.begin() + middle, objects.begin() + group.second,
+						[&](uint32_t a, uint32_t b) { return boxes[a].getCenter()[axis] < boxes[b].getCenter()[axis]; });
+					next.push_back({ group.first, middle });
+					next.push_back({ middle, group.second });
+				}
+				groups.swap(next);
+			}
+		}
+		else {
+			// Few enough objects: one per child
+			groups.clear();
+			for (size_t i = begin; i < end; i++)
+				groups.push_back({ i, i + 1 });
+		}
+
+		Node node;
+		const float inf = std::numeric_limits<float>::max();
+		for (int i = 0; i < WIDTH; i++) {
+			node.minX[i] = node.minY[i] = node.minZ[i] = inf;
+			node.maxX[i] = node.maxY[i] = node.maxZ[i] = -inf;
+			node.child[i] = -1;
+		}
+		node.childCount = (int32_t)groups.size();
+
+		for (size_t g = 0; g < groups.size(); g++) {
+			AABB bounds = boxes[objects[groups[g].first]];
+			for (size_t i = groups[g].first + 1; i < groups[g].second; i++)
+				bounds.merge(boxes[objects[i]]);
+
+			node.minX[g] = bounds.min.x; node.minY[g] = bounds.min.y; node.minZ[g] = bounds.min.z;
+			node.maxX[g] = bounds.max.x; node.maxY[g] = bounds.max.y; node.maxZ[g] = bounds.max.z;
+			if (groups[g].second - groups[g].first == 1)
+				node.child[g] = ~(int32_t)objects[groups[g].first];
+			else
+				node.child[g] = buildNode(boxes, objects, groups[g].first, groups[g].second);
+		}
+
+		nodes[index] = node;
+		return index;
+	}
+
+	void Bvh::acceptNode(int32_t node, std::vector<uint32_t>& visible) const {
+		const Node& n = nodes[node];
+		for (int i = 0; i < n.childCount; i++) {
+			if (n.child[i] < 0)
+				visible.push_back((uint32_t)~n.child[i]);
+			else
+				acceptNode(n.child[i], visible);
+		}
+	}
+
+	void Bvh::cullNode(int32_t root, const Frustum& frustum, std::vector<uint32_t>& visible, CullingStats& stats) const {
+		int32_t stack[128];
+		int top = 0;
+		stack[top++] = root;
+
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			int outside, intersecting;
+			testNode(node, frustum, outside, intersecting);
+			stats.tested += node.childCount;
+
+			for (int i = 0; i < node.childCount; i++) {
+				if (outside & (1 << i))
+					continue;
+				if (node.child[i] < 0)
+					visible.push_back((uint32_t)~node.child[i]);
+				else if (intersecting & (1 << i))
+					stack[top++] = node.child[i];
+				else
+					acceptNode(node.child[i], visible);
+			}
+		}
+	}
+
+	void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible, CullingStats& stats, ThreadPool* pool) const {
+		visible.clear();
+		stats = CullingStats();
+		if (nodes.empty())
+			return;
+
+		// Small hierarchies are not worth the synchronization
+		const size_t parallelThreshold = 2048;
+		if (!pool || objectCount < parallelThreshold) {
+			cullNode(0, frustum, visible, stats);
+		}
+		else {
+			// Testing the first two levels here, the subtrees that cross the frustum are culled in parallel
+			level.assign(1, 0);
+			for (int depth = 0; depth < 2 && !level.empty(); depth++) {
+				nextLevel.clear();
+				for (int32_t index : level) {
+					const Node& node = nodes[index];
+					int outside, intersecting;
+					testNode(node, frustum, outside, intersecting);
+					stats.tested += node.childCount;
+					for (int i = 0; i < node.childCount; i++) {
+						if (outside & (1 << i))
+							continue;
+						if (node.child[i] < 0)
+							visible.push_back((uint32_t)~node.child[i]);
+						else if (intersecting & (1 << i))
+							nextLevel.push_back(node.child[i]);
+						else
+							acceptNode(node.child[i], visible);
+					}
+				}
+				level.swap(nextLevel);
+			}
+			tasks.swap(level);
+
+			// cullNode() appends, the lists only grow to the largest frame
+			if (taskVisible.size() < tasks.size())
+				taskVisible.resize(tasks.size());
+			for (size_t t = 0; t < tasks.size(); t++)
+				taskVisible[t].clear();
+			taskStats.assign(tasks.size(), CullingStats());
+			pool->parallelFor(tasks.size(), [&](size_t t) {
+				cullNode(tasks[t], frustum, taskVisible[t], taskStats[t]);
+			});
+			for (size_t t = 0; t < tasks.size(); t++) {
+				visible.insert(visible.end(), taskVisible[t].begin(), taskVisible[t].end());
+				stats.tested += taskStats[t].tested;
+			}
+		}
+
+		stats.visible = visible.size();
+		stats.culled = objectCount - visible.size();
+	}
+}
@@ -0,0 +1,100 @@
+#include <glengine/drawCommandBuffer.hpp>
+#include <glengine/glext.hpp>
+
+namespace GLEngine {
+	DrawCommandBuffer::DrawCommandBuffer()
+	: buffer(0), bufferCapacity(0), multiDraw(ext::hasMultiDrawIndirect()) {
+		if (multiDraw)
+			glGenBuffers(1, &buffer);
+	}
+
+	DrawCommandBuffer::~DrawCommandBuffer() {
+		release();
+	}
+
+	void DrawCommandBuffer::release() {
+		if (buffer)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		bufferCapacity = 0;
+	}
+
+	size_t DrawCommandBuffer::add(const MeshRange& mesh, uint32_t instanceCount, uint32_t baseInstance) {
+		DrawElementsCommand command;
+		command.count = mesh.indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = mesh.firstIndex;
+		command.baseVertex = (int32_t)mesh.baseVertex;
+		command.baseInstance = baseInstance;
+		commands.push_back(command);
+		return commands.size() - 1;
+	}
+
+	void DrawCommandBuffer::upload() {
+		if (!multiDraw || commands.empty())
+			return;
+		size_t bytes = commands.size() * sizeof(DrawElementsCommand);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+		if (bytes > bufferCapacity)
+			bufferCapacity = bytes * 2;
+		// Orphaning: the commands of the frames in flight stay valid
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, bufferCapacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, commands.data());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	int DrawCommandBuffer::draw(size_t first, size_t count, const std::function<void(uint32_t)>& setBaseInstance) const {
+		if (count == 0)
+			return 0;
+		if (multiDraw) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+			ext::multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawElementsCommand)),
+			                               (GLsizei)count, sizeof(DrawElementsCommand));
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			return 1;
+		}
+
+		int drawCalls = 0;
+		for (size_t i = first; i < first + count; i++) {
+			const DrawElementsCommand& command = commands[i];
+			if (command.instanceCount == 0)
+				continue;
+			if (setBaseInstance)
+				setBaseInstance(command.baseInstance);
+			// Single instance commands of one instance and mesh (meshlet ranges) go in a single multi-draw
+			size_t last = i;
+			if (command.instanceCount == 1) {
+				while (last + 1 < first + count && commands[last + 1].instanceCount == 1
+				       && commands[last + 1].baseInstance == command.baseInstance
+				       && commands[last + 1].baseVertex == command.baseVertex)
+					last++;
+			}
+			if (last > i) {
+				groupCounts.clear();
+				groupOffsets.clear();
+				groupBaseVertices.clear();
+				for (size_t k = i; k <= last; k++) {
+					groupCounts.push_back((GLsizei)commands[k].count);
+					groupOffsets.push_back((void*)(commands[k].firstIndex * sizeof(unsigned int)));
+					groupBaseVertices.push_back(commands[k].baseVertex);
+				}
+				glMultiDrawElementsBaseVertex(GL_TRIANGLES, groupCounts.data(), GL_UNSIGNED_INT, groupOffsets.data(),
+				                              (GLsizei)groupCounts.size(), groupBaseVertices.data());
+				i = last;
+			}
+			else
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+				                                  (void*)(command.firstIndex * sizeof(unsigned int)),
+				                                  command.instanceCount, command.baseVertex);
+			drawCalls++;
+		}
+		return drawCalls;
+	}
+
+	MemoryUsage DrawCommandBuffer::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.host = heapBytes(commands) + heapBytes(groupCounts) + heapBytes(groupOffsets) + heapBytes(groupBaseVertices);
+		usage.gpu = bufferCapacity;
+		return usage;
+	}
+}
@@ -0,0 +1,84 @@
+#include <glengine/fileWatcher.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace GLEngine {
+	namespace {
+		double now() {
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+	}
+
+	FileWatcher::FileWatcher(const std::string& directory, double pollInterval)
+	: directory(directory), descriptor(-1), pollInterval(pollInterval), lastScan(now()) {
+#ifdef __linux__
+		descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		// Editors either rewrite the file or replace it with a renamed temporary one
+		if (descriptor >= 0 && inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+			close(descriptor);
+			descriptor = -1;
+		}
+#endif
+		if (descriptor < 0)
+			modificationTimes = scanModificationTimes();
+	}
+
+	FileWatcher::~FileWatcher() {
+#ifdef __linux__
+		if (descriptor >= 0)
+			close(descriptor);
+#endif
+	}
+
+	std::vector<std::string> FileWatcher::poll() {
+		std::vector<std::string> changed;
+#ifdef __linux__
+		if (descriptor >= 0) {
+			alignas(inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+				for (char* event = buffer; event < buffer + length; ) {
+					const inotify_event* info = (const inotify_event*)event;
+					if (info->len > 0 && !(info->mask & IN_ISDIR))
+						changed.push_back(info->name);
+					event += sizeof(inotify_event) + info->len;
+				}
+			}
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+			return changed;
+		}
+#endif
+		double time = now();
+		if (time - lastScan < pollInterval)
+			return changed;
+		lastScan = time;
+		std::map<std::string, long long> current = scanModificationTimes();
+		for (const auto& file : current) {
+			auto previous = modificationTimes.find(file.first);
+			if (previous == modificationTimes.end() || previous->second != file.second)
+				changed.push_back(file.first);
+		}
+		modificationTimes = std::move(current);
+		return changed;
+	}
+
+	std::map<std::string, long long> FileWatcher::scanModificationTimes() const {
+		std::map<std::string, long long> times;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (!entry.is_regular_file(error))
+				continue;
+			auto time = std::filesystem::last_write_time(entry.path(), error);
+			if (!error)
+				times[entry.path().filename().string()] = (long long)time.time_since_epoch().count();
+		}
+		return times;
+	}
+}
@@ -0,0 +1,117 @@
+#include <glengine/framePacer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace GLEngine {
+	namespace {
+		// Number of frames used for the statistics
+		const size_t FRAME_TIME_WINDOW = 120;
+		// The limiter stops sleeping this long before the deadline and spins instead,
+		// the scheduler granularity being around 1 ms on most systems
+		const std::chrono::microseconds SPIN_MARGIN(2000);
+	}
+
+	FramePacer::FramePacer(float frameCap, int maxFramesInFlight)
+	: frameCap(0.0f), maxFramesInFlight(2), nextDeadline(Clock::now()),
+	  hasLastFrame(false), frameTimeIndex(0), averageMs(0.0f), jitterMs(0.0f), maxMs(0.0f) {
+		setFrameCap(frameCap);
+		setMaxFramesInFlight(maxFramesInFlight);
+		frameTimes.reserve(FRAME_TIME_WINDOW);
+	}
+
+	FramePacer::~FramePacer() {
+		release();
+	}
+
+	void FramePacer::setFrameCap(float fps) {
+		frameCap = std::max(fps, 0.0f);
+		nextDeadline = Clock::now();
+	}
+
+	float FramePacer::getFrameCap() const {
+		return frameCap;
+	}
+
+	void FramePacer::setMaxFramesInFlight(int frames) {
+		maxFramesInFlight = std::clamp(frames, 1, MAX_FRAMES_IN_FLIGHT);
+	}
+
+	int FramePacer::getMaxFramesInFlight() const {
+		return maxFramesInFlight;
+	}
+
+	void FramePacer::beginFrame() {
+		// Frame limiter
+		if (frameCap > 0.0f) {
+			auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameCap));
+			nextDeadline += period;
+			Clock::time_point now = Clock::now();
+			// Too late (slow frame or idle period): restart from now instead of bursting
+			if (nextDeadline < now - period)
+				nextDeadline = now;
+			else
+				waitUntil(nextDeadline);
+		}
+
+		// Frames in flight: wait for the GPU to finish the frame submitted maxFramesInFlight frames ago
+		while ((int)fences.size() >= maxFramesInFlight) {
+			GLsync fence = fences.front();
+			fences.pop_front();
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(fence);
+		}
+
+		Clock::time_point frameStart = Clock::now();
+		if (hasLastFrame)
+			recordFrameTime(std::chrono::duration<float, std::milli>(frameStart - lastFrameStart).count());
+		lastFrameStart = frameStart;
+		hasLastFrame = true;
+	}
+
+	void FramePacer::endFrame() {
+		fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	}
+
+	void FramePacer::markIdle() {
+		hasLastFrame = false;
+	}
+
+	void FramePacer::release() {
+		for (GLsync fence : fences)
+			glDeleteSync(fence);
+		fences.clear();
+	}
+
+	void FramePacer::waitUntil(Clock::time_point deadline) {
+		Clock::time_point now = Clock::now();
+		if (deadline - now > SPIN_MARGIN)
+			std::this_thread::sleep_for(deadline - now - SPIN_MARGIN);
+		while (Clock::now() < deadline)
+			std::this_thread::yield();
+	}
+
+	void FramePacer::recordFrameTime(float ms) {
+		if (frameTimes.size() < FRAME_TIME_WINDOW)
+			frameTimes.push_back(ms);
+		else
+			frameTimes[frameTimeIndex] = ms;
+		frameTimeIndex = (frameTimeIndex + 1) % FRAME_TIME_WINDOW;
+
+		double sum = 0.0;
+		float maximum = 0.0f;
+		for (float t : frameTimes) {
+			sum += t;
+			maximum = std::max(maximum, t);
+		}
+		double mean = sum / frameTimes.size();
+		double variance = 0.0;
+		for (float t : frameTimes)
+			variance += (t - mean) * (t - mean);
+		variance /= frameTimes.size();
+
+		averageMs = (float)mean;
+		jitterMs = (float)std::sqrt(variance);
+		maxMs = maximum;
+	}
+}
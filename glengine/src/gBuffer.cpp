@@ -0,0 +1,82 @@
+#include <glengine/gBuffer.hpp>
+
+namespace GLEngine {
+	namespace {
+		GLuint createTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+			GLuint texture;
+			glGenTextures(1, &texture);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+			// Read with texelFetch only
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			return texture;
+		}
+	}
+
+	GBuffer::GBuffer()
+	: framebuffer(0), normalTexture(0), objectTexture(0), depthTexture(0), width(0), height(0) {
+	}
+
+	GBuffer::~GBuffer() {
+		release();
+	}
+
+	void GBuffer::release() {
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteTextures(1, &normalTexture);
+		glDeleteTextures(1, &objectTexture);
+		glDeleteTextures(1, &depthTexture);
+		framebuffer = normalTexture = objectTexture = depthTexture = 0;
+		width = height = 0;
+	}
+
+	void GBuffer::resize(int newWidth, int newHeight) {
+		if (newWidth == width && newHeight == height)
+			return;
+		release();
+		if (newWidth <= 0 || newHeight <= 0)
+			return;
+		width = newWidth;
+		height = newHeight;
+
+		normalTexture = createTexture(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+		objectTexture = createTexture(GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, width, height);
+		// Same format as the default framebuffer so it can be blitted there
+		depthTexture = createTexture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, objectTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void GBuffer::bindForGeometry() {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+		const GLfloat noNormal[4] = { 0.5f, 0.5f, 0.0f, 0.0f };
+		const GLuint noObject[4] = { 0, 0, 0, 0 };
+		glClearBufferfv(GL_COLOR, 0, noNormal);
+		glClearBufferuiv(GL_COLOR, 1, noObject);
+		glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+	}
+
+	void GBuffer::blitDepth(GLuint target) const {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, target);
+	}
+
+	size_t GBuffer::getMemorySize() const {
+		// RG16 + R32UI + D24S8
+		return (size_t)width * height * (4 + 4 + 4);
+	}
+}
@@ -0,0 +1,350 @@
+#include <glengine/geometryBuffer.hpp>
+#include <glengine/glext.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace GLEngine {
+	FreeListAllocator::FreeListAllocator(size_t capacity)
+	: capacity(0), used(0) {
+		grow(capacity);
+	}
+
+	size_t FreeListAllocator::allocate(size_t size) {
+		if (size == 0)
+			return INVALID;
+		// Best fit keeps the large blocks for the large meshes
+		auto best = freeBlocks.end();
+		for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+			if (it->second >= size && (best == freeBlocks.end() || it->second < best->second)) {
+				best = it;
+				if (best->second == size)
+					break;
+			}
+		if (best == freeBlocks.end())
+			return INVALID;
+
+		size_t offset = best->first;
+		size_t remaining = best->second - size;
+		freeBlocks.erase(best);
+		if (remaining > 0)
+			freeBlocks[offset + size] = remaining;
+		used += size;
+		return offset;
+	}
+
+	void FreeListAllocator::free(size_t offset, size_t size) {
+		if (size == 0)
+			return;
+		used -= size;
+		auto next = freeBlocks.lower_bound(offset);
+		// Merging with the block just before and the one just after
+		if (next != freeBlocks.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset) {
+				offset = previous->first;
+				size += previous->second;
+				freeBlocks.erase(previous);
+			}
+		}
+		if (next != freeBlocks.end() && offset + size == next->first) {
+			size += next->second;
+			freeBlocks.erase(next);
+		}
+		freeBlocks[offset] = size;
+	}
+
+	void FreeListAllocator::grow(size_t newCapacity) {
+		if (newCapacity <= capacity)
+			return;
+		size_t added = newCapacity - capacity;
+		size_t offset = capacity;
+		capacity = newCapacity;
+		// Counted as used for a moment so free() can merge it with a free block at the end
+		used += added;
+		free(offset, added);
+	}
+
+	size_t FreeListAllocator::getLargestFreeBlock() const {
+		size_t largest = 0;
+		for (const auto& block : freeBlocks)
+			largest = std::max(largest, block.second);
+		return largest;
+	}
+
+	size_t FreeListAllocator::getHeapBytes() const {
+		// A red-black tree node: three links and the color next to the pair
+		return freeBlocks.size() * (sizeof(std::pair<const size_t, size_t>) + 4 * sizeof(void*));
+	}
+
+	float FreeListAllocator::getFragmentation() const {
+		size_t freeSize = capacity - used;
+		if (freeSize == 0)
+			return 0.0f;
+		return 1.0f - (float)getLargestFreeBlock() / (float)freeSize;
+	}
+
+	GeometryBuffer::GeometryBuffer(size_t vertexCapacity, size_t indexCapacity, bool persistentMapping)
+	: mapped(persistentMapping && ext::hasBufferStorage()), vertexAllocator(vertexCapacity), indexAllocator(indexCapacity) {
+		glGenVertexArrays(1, &vao);
+		positionBuffer = createBuffer(vertexCapacity * 3 * sizeof(float), &positionMapping);
+		normalBuffer = createBuffer(vertexCapacity * 3 * sizeof(float), &normalMapping);
+		indexBuffer = createBuffer(indexCapacity * sizeof(unsigned int), &indexMapping);
+		if (mapped && (!positionMapping || !normalMapping || !indexMapping)) {
+			// Storage the driver can't map: back to mutable buffers
+			GLuint buffers[3] = { positionBuffer, normalBuffer, indexBuffer };
+			glDeleteBuffers(3, buffers);
+			mapped = false;
+			positionBuffer = createBuffer(vertexCapacity * 3 * sizeof(float), &positionMapping);
+			normalBuffer = createBuffer(vertexCapacity * 3 * sizeof(float), &normalMapping);
+			indexBuffer = createBuffer(indexCapacity * sizeof(unsigned int), &indexMapping);
+		}
+		glBindVertexArray(vao);
+		bindBuffers();
+		glBindVertexArray(0);
+	}
+
+	GeometryBuffer::~GeometryBuffer() {
+		release();
+	}
+
+	void GeometryBuffer::release() {
+		for (const PendingFree& pending : pendingFrees)
+			glDeleteSync(pending.fence);
+		pendingFrees.clear();
+		if (vao)
+			glDeleteVertexArrays(1, &vao);
+		// Deleting a buffer unmaps it
+		GLuint buffers[3] = { positionBuffer, normalBuffer, indexBuffer };
+		glDeleteBuffers(3, buffers);
+		vao = positionBuffer = normalBuffer = indexBuffer = 0;
+		positionMapping = normalMapping = indexMapping = nullptr;
+	}
+
+	GLuint GeometryBuffer::createBuffer(size_t bytes, void** mapping) const {
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		*mapping = nullptr;
+		if (mapped) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			ext::bufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags);
+			*mapping = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+		}
+		else
+			glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+		return buffer;
+	}
+
+	void GeometryBuffer::bindBuffers() {
+		glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	}
+
+	uint32_t GeometryBuffer::addMesh(const float* positions, const float* normals, size_t vertexCount,
+	                                 const unsigned int* indices, size_t indexCount) {
+		if (mapped) {
+			MeshWriter writer = beginMesh(vertexCount, indexCount);
+			memcpy(writer.positions, positions, vertexCount * 3 * sizeof(float));
+			memcpy(writer.normals, normals, vertexCount * 3 * sizeof(float));
+			memcpy(writer.indices, indices, indexCount * sizeof(unsigned int));
+			commitMesh(writer);
+			return writer.id;
+		}
+
+		uint32_t id = allocateMesh(vertexCount, indexCount);
+		const MeshRange& range = meshes[id];
+		glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * 3 * sizeof(float), vertexCount * 3 * sizeof(float), positions);
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * 3 * sizeof(float), vertexCount * 3 * sizeof(float), normals);
+		// The element buffer binding belongs to the VAO
+		glBindVertexArray(vao);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+		glBindVertexArray(0);
+		return id;
+	}
+
+	MeshWriter GeometryBuffer::beginMesh(size_t vertexCount, size_t indexCount) {
+		MeshWriter writer;
+		writer.id = allocateMesh(vertexCount, indexCount);
+		const MeshRange& range = meshes[writer.id];
+		if (mapped) {
+			writer.positions = (float*)positionMapping + range.baseVertex * 3;
+			writer.normals = (float*)normalMapping + range.baseVertex * 3;
+			writer.indices = (unsigned int*)indexMapping + range.firstIndex;
+		}
+		else {
+			stagingPositions.resize(vertexCount * 3);
+			stagingNormals.resize(vertexCount * 3);
+			stagingIndices.resize(indexCount);
+			writer.positions = stagingPositions.data();
+			writer.normals = stagingNormals.data();
+			writer.indices = stagingIndices.data();
+		}
+		return writer;
+	}
+
+	void GeometryBuffer::commitMesh(const MeshWriter& writer) {
+		// Coherent mapping: the writes are visible to the commands issued from now on
+		if (mapped)
+			return;
+		const MeshRange& range = meshes[writer.id];
+		glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * 3 * sizeof(float), range.vertexCount * 3 * sizeof(float),
+		                stagingPositions.data());
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * 3 * sizeof(float), range.vertexCount * 3 * sizeof(float),
+		                stagingNormals.data());
+		glBindVertexArray(vao);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.firstIndex * sizeof(unsigned int), range.indexCount * sizeof(unsigned int),
+		                stagingIndices.data());
+		glBindVertexArray(0);
+		// Not kept: the driver has its copy
+		std::vector<float>().swap(stagingPositions);
+		std::vector<float>().swap(stagingNormals);
+		std::vector<unsigned int>().swap(stagingIndices);
+	}
+
+	uint32_t GeometryBuffer::allocateMesh(size_t vertexCount, size_t indexCount) {
+		reclaim(false);
+		size_t baseVertex = vertexAllocator.allocate(vertexCount);
+		size_t firstIndex = indexAllocator.allocate(indexCount);
+		// Waiting for the GPU to release the removed meshes rather than growing
+		if ((baseVertex == FreeListAllocator::INVALID || firstIndex == FreeListAllocator::INVALID) && !pendingFrees.empty()) {
+			if (baseVertex != FreeListAllocator::INVALID)
+				vertexAllocator.free(baseVertex, vertexCount);
+			if (firstIndex != FreeListAllocator::INVALID)
+				indexAllocator.free(firstIndex, indexCount);
+			reclaim(true);
+			baseVertex = vertexAllocator.allocate(vertexCount);
+			firstIndex = indexAllocator.allocate(indexCount);
+		}
+		if (baseVertex == FreeListAllocator::INVALID) {
+			growVertices(vertexCount);
+			baseVertex = vertexAllocator.allocate(vertexCount);
+		}
+		if (firstIndex == FreeListAllocator::INVALID) {
+			growIndices(indexCount);
+			firstIndex = indexAllocator.allocate(indexCount);
+		}
+
+		MeshRange range;
+		range.baseVertex = (uint32_t)baseVertex;
+		range.vertexCount = (uint32_t)vertexCount;
+		range.firstIndex = (uint32_t)firstIndex;
+		range.indexCount = (uint32_t)indexCount;
+
+		uint32_t id;
+		if (!freeIds.empty()) {
+			id = freeIds.back();
+			freeIds.pop_back();
+			meshes[id] = range;
+			meshUsed[id] = true;
+		}
+		else {
+			id = (uint32_t)meshes.size();
+			meshes.push_back(range);
+			meshUsed.push_back(true);
+		}
+		return id;
+	}
+
+	void GeometryBuffer::removeMesh(uint32_t id) {
+		if (id >= meshes.size() || !meshUsed[id])
+			return;
+		// Frames in flight may still draw it: with glBufferSubData the driver orders the writes of
+		// the next mesh after them, through a mapping the fence has to
+		if (mapped)
+			pendingFrees.push_back({ meshes[id], glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+		else {
+			vertexAllocator.free(meshes[id].baseVertex, meshes[id].vertexCount);
+			indexAllocator.free(meshes[id].firstIndex, meshes[id].indexCount);
+		}
+		meshes[id] = MeshRange();
+		meshUsed[id] = false;
+		freeIds.push_back(id);
+	}
+
+	void GeometryBuffer::reclaim(bool wait) {
+		size_t kept = 0;
+		for (size_t i = 0; i < pendingFrees.size(); i++) {
+			PendingFree& pending = pendingFrees[i];
+			GLenum status = glClientWaitSync(pending.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+				pendingFrees[kept++] = pending;
+				continue;
+			}
+			glDeleteSync(pending.fence);
+			vertexAllocator.free(pending.range.baseVertex, pending.range.vertexCount);
+			indexAllocator.free(pending.range.firstIndex, pending.range.indexCount);
+		}
+		pendingFrees.resize(kept);
+	}
+
+	GLuint GeometryBuffer::resizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes, void** mapping) const {
+		GLuint resized = createBuffer(newBytes, mapping);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+		glDeleteBuffers(1, &buffer);
+		if (mapped) {
+			// The copy has to land before a mesh is written through the new mapping
+			GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(fence);
+		}
+		return resized;
+	}
+
+	void GeometryBuffer::growVertices(size_t minimum) {
+		size_t oldCapacity = vertexAllocator.getCapacity();
+		size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + minimum);
+		positionBuffer = resizeBuffer(positionBuffer, oldCapacity * 3 * sizeof(float), newCapacity * 3 * sizeof(float),
+		                              &positionMapping);
+		normalBuffer = resizeBuffer(normalBuffer, oldCapacity * 3 * sizeof(float), newCapacity * 3 * sizeof(float), &normalMapping);
+		vertexAllocator.grow(newCapacity);
+		glBindVertexArray(vao);
+		bindBuffers();
+		glBindVertexArray(0);
+	}
+
+	void GeometryBuffer::growIndices(size_t minimum) {
+		size_t oldCapacity = indexAllocator.getCapacity();
+		size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + minimum);
+		indexBuffer = resizeBuffer(indexBuffer, oldCapacity * sizeof(unsigned int), newCapacity * sizeof(unsigned int), &indexMapping);
+		indexAllocator.grow(newCapacity);
+		glBindVertexArray(vao);
+		bindBuffers();
+		glBindVertexArray(0);
+	}
+
+	GeometryStats GeometryBuffer::getStats() const {
+		GeometryStats stats;
+		stats.meshCount = meshes.size() - freeIds.size();
+		stats.vertexCapacity = vertexAllocator.getCapacity();
+		stats.vertexUsed = vertexAllocator.getUsed();
+		stats.indexCapacity = indexAllocator.getCapacity();
+		stats.indexUsed = indexAllocator.getUsed();
+		stats.vertexFreeBlocks = vertexAllocator.getFreeBlockCount();
+		stats.indexFreeBlocks = indexAllocator.getFreeBlockCount();
+		stats.vertexFragmentation = vertexAllocator.getFragmentation();
+		stats.indexFragmentation = indexAllocator.getFragmentation();
+		stats.bytes = stats.vertexCapacity * 6 * sizeof(float) + stats.indexCapacity * sizeof(unsigned int);
+		stats.persistentlyMapped = mapped;
+		stats.pendingFrees = pendingFrees.size();
+		return stats;
+	}
+
+	MemoryUsage GeometryBuffer::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.gpu = getStats().bytes;
+		usage.host = vertexAllocator.getHeapBytes() + indexAllocator.getHeapBytes() + heapBytes(meshes)
+		           + meshUsed.capacity() / 8 + heapBytes(freeIds) + heapBytes(pendingFrees)
+		           + heapBytes(stagingPositions) + heapBytes(stagingNormals) + heapBytes(stagingIndices);
+		return usage;
+	}
+}
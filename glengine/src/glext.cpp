@@ -0,0 +1,84 @@
+#include <glengine/glext.hpp>
+#include <cstring>
+
+namespace GLEngine {
+	namespace ext {
+		PFNMULTIDRAWELEMENTSINDIRECT multiDrawElementsIndirect = nullptr;
+		PFNGETPROGRAMBINARY getProgramBinary = nullptr;
+		PFNPROGRAMBINARY programBinary = nullptr;
+		PFNPROGRAMPARAMETERI programParameteri = nullptr;
+		PFNMAXSHADERCOMPILERTHREADS maxShaderCompilerThreads = nullptr;
+		PFNBUFFERSTORAGE bufferStorage = nullptr;
+
+		namespace {
+			bool textureCompressionS3tc = false;
+			bool textureCompressionBptc = false;
+		}
+
+		void load(GLADloadproc loader) {
+			if (isVersionAtLeast(4, 3) || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance")))
+				multiDrawElementsIndirect = (PFNMULTIDRAWELEMENTSINDIRECT)loader("glMultiDrawElementsIndirect");
+
+			if (isVersionAtLeast(4, 1) || hasExtension("GL_ARB_get_program_binary")) {
+				// Some drivers expose the functions without any binary format
+				GLint formats = 0;
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+				if (formats > 0) {
+					getProgramBinary = (PFNGETPROGRAMBINARY)loader("glGetProgramBinary");
+					programBinary = (PFNPROGRAMBINARY)loader("glProgramBinary");
+					programParameteri = (PFNPROGRAMPARAMETERI)loader("glProgramParameteri");
+				}
+			}
+
+			if (hasExtension("GL_KHR_parallel_shader_compile"))
+				maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS)loader("glMaxShaderCompilerThreadsKHR");
+			else if (hasExtension("GL_ARB_parallel_shader_compile"))
+				maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADS)loader("glMaxShaderCompilerThreadsARB");
+
+			if (isVersionAtLeast(4, 4) || hasExtension("GL_ARB_buffer_storage"))
+				bufferStorage = (PFNBUFFERSTORAGE)loader("glBufferStorage");
+
+			textureCompressionS3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+			textureCompressionBptc = isVersionAtLeast(4, 2) || hasExtension("GL_ARB_texture_compression_bptc");
+		}
+
+		bool isVersionAtLeast(int major, int minor) {
+			return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+		}
+
+		bool hasExtension(const char* name) {
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++) {
+				const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+				if (extension && strcmp(extension, name) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		bool hasMultiDrawIndirect() {
+			return multiDrawElementsIndirect != nullptr;
+		}
+
+		bool hasProgramBinary() {
+			return getProgramBinary && programBinary && programParameteri;
+		}
+
+		bool hasParallelShaderCompile() {
+			return maxShaderCompilerThreads != nullptr;
+		}
+
+		bool hasTextureCompressionS3tc() {
+			return textureCompressionS3tc;
+		}
+
+		bool hasTextureCompressionBptc() {
+			return textureCompressionBptc;
+		}
+
+		bool hasBufferStorage() {
+			return bufferStorage != nullptr;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#include <glengine/gpuTimer.hpp>
+
+namespace GLEngine {
+	GpuTimer::GpuTimer()
+	: current(0), oldest(0), running(false), lastMs(0.0f), completedMs(0.0f) {
+		glGenQueries(2 * QUERY_COUNT, &queries[0][0]);
+		for (int i = 0; i < QUERY_COUNT; i++)
+			pending[i] = false;
+	}
+
+	GpuTimer::~GpuTimer() {
+		glDeleteQueries(2 * QUERY_COUNT, &queries[0][0]);
+	}
+
+	void GpuTimer::begin() {
+		// Every query is still in flight: drop this measurement rather than waiting
+		if (pending[current])
+			return;
+		glQueryCounter(queries[current][0], GL_TIMESTAMP);
+		running = true;
+	}
+
+	void GpuTimer::end() {
+		if (!running)
+			return;
+		glQueryCounter(queries[current][1], GL_TIMESTAMP);
+		pending[current] = true;
+		current = (current + 1) % QUERY_COUNT;
+		running = false;
+	}
+
+	bool GpuTimer::poll() {
+		bool updated = false;
+		while (pending[oldest]) {
+			GLint available = 0;
+			// The end timestamp being available implies the start one is
+			glGetQueryObjectiv(queries[oldest][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(queries[oldest][0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[oldest][1], GL_QUERY_RESULT, &end);
+			lastMs = (float)((end - start) / 1.0e6);
+			completedMs += lastMs;
+			pending[oldest] = false;
+			oldest = (oldest + 1) % QUERY_COUNT;
+			updated = true;
+		}
+		return updated;
+	}
+
+	float GpuTimer::getLastMs() const {
+		return lastMs;
+	}
+
+	float GpuTimer::takeCompletedMs() {
+		float ms = completedMs;
+		completedMs = 0.0f;
+		return ms;
+	}
+}
@@ -0,0 +1,369 @@
+#include <glengine/hiZCuller.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace GLEngine {
+	HiZCuller::HiZCuller(GLuint downsampleProgram, int readbackMaxWidth)
+	: program(downsampleProgram), readbackMaxWidth(readbackMaxWidth),
+	  depthFbo(0), depthTexture(0), pyramidFbo(0), pyramidTexture(0), depthWidth(0), depthHeight(0),
+	  nextReadback(0), cpuWidth(0), cpuHeight(0), hasCapture(false), ready(false) {
+		glGenVertexArrays(1, &emptyVao);
+		for (Readback& readback : readbacks)
+			glGenBuffers(1, &readback.pbo);
+	}
+
+	HiZCuller::~HiZCuller() {
+		release();
+	}
+
+	void HiZCuller::release() {
+		for (Readback& readback : readbacks) {
+			if (readback.fence)
+				glDeleteSync(readback.fence);
+			if (readback.pbo)
+				glDeleteBuffers(1, &readback.pbo);
+			readback.fence = 0;
+			readback.pbo = 0;
+		}
+		if (emptyVao)
+			glDeleteVertexArrays(1, &emptyVao);
+		emptyVao = 0;
+		glDeleteFramebuffers(1, &depthFbo);
+		glDeleteFramebuffers(1, &pyramidFbo);
+		glDeleteTextures(1, &depthTexture);
+		glDeleteTextures(1, &pyramidTexture);
+		depthFbo = pyramidFbo = depthTexture = pyramidTexture = 0;
+		depthWidth = depthHeight = 0;
+	}
+
+	void HiZCuller::invalidate() {
+		for (Readback& readback : readbacks) {
+			if (readback.fence)
+				glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+		hasCapture = false;
+		ready = false;
+	}
+
+	void HiZCuller::resize(int width, int height) {
+		glDeleteFramebuffers(1, &depthFbo);
+		glDeleteFramebuffers(1, &pyramidFbo);
+		glDeleteTextures(1, &depthTexture);
+		glDeleteTextures(1, &pyramidTexture);
+		depthWidth = width;
+		depthHeight = height;
+
+		// Copy of the depth buffer, same format as the default framebuffer so it can be blitted
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		glGenFramebuffers(1, &depthFbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, depthFbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+		// Max pyramid, from half the resolution down to the level that is read back
+		levelSizes.clear();
+		glm::ivec2 size(std::max(width / 2, 1), std::max(height / 2, 1));
+		levelSizes.push_back(size);
+		while (size.x > readbackMaxWidth && (size.x > 1 || size.y > 1)) {
+			size = glm::ivec2(std::max(size.x / 2, 1), std::max(size.y / 2, 1));
+			levelSizes.push_back(size);
+		}
+
+		glGenTextures(1, &pyramidTexture);
+		glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+		for (size_t level = 0; level < levelSizes.size(); level++)
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_R32F, levelSizes[level].x, levelSizes[level].y, 0, GL_RED, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glGenFramebuffers(1, &pyramidFbo);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void HiZCuller::captureDepth(int width, int height, const glm::mat4& viewProjection) {
+		if (width <= 0 || height <= 0)
+			return;
+		// Every readback is still in flight: skip this frame
+		Readback& readback = readbacks[nextReadback];
+		if (readback.fence)
+			return;
+		if (width != depthWidth || height != depthHeight)
+			resize(width, height);
+
+		// Saving the state changed below
+		GLint viewport[4], previousProgram, polygonMode[2];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+		glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLboolean stencilTest = glIsEnabled(GL_STENCIL_TEST);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFbo);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_STENCIL_TEST);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glUseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "source"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindVertexArray(emptyVao);
+		glBindFramebuffer(GL_FRAMEBUFFER, pyramidFbo);
+
+		for (size_t level = 0; level < levelSizes.size(); level++) {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, (GLint)level);
+			glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+			if (level == 0)
+				glBindTexture(GL_TEXTURE_2D, depthTexture);
+			else {
+				// Only the previous level can be sampled, the written one is attached
+				glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level - 1);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)level - 1);
+			}
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		// Asynchronous readback of the last level
+		glm::ivec2 size = levelSizes.back();
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * sizeof(float), nullptr, GL_STREAM_READ);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readback.width = size.x;
+		readback.height = size.y;
+		readback.viewProjection = viewProjection;
+		nextReadback = (nextReadback + 1) % READBACK_COUNT;
+
+		// Restoring the state
+		glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelSizes.size() - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glUseProgram(previousProgram);
+		glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+		if (stencilTest)
+			glEnable(GL_STENCIL_TEST);
+	}
+
+	bool HiZCuller::pollReadback() {
+		bool received = false;
+		// Oldest readback first, so the newest one wins
+		for (int i = 0; i < READBACK_COUNT; i++) {
+			Readback& readback = readbacks[(nextReadback + i) % READBACK_COUNT];
+			if (!readback.fence)
+				continue;
+			GLenum status = glClientWaitSync(readback.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+			size_t bytes = readback.width * readback.height * sizeof(float);
+			void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+			if (data) {
+				capturedDepth.resize(readback.width * readback.height);
+				memcpy(capturedDepth.data(), data, bytes);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				cpuWidth = readback.width;
+				cpuHeight = readback.height;
+				capturedViewProjection = readback.viewProjection;
+				hasCapture = true;
+				received = true;
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+		if (received)
+			ready = false;
+		return received;
+	}
+
+	void HiZCuller::prepare(const glm::mat4& viewProjection) {
+		if (!hasCapture) {
+			ready = false;
+			return;
+		}
+		if (ready && viewProjection == currentViewProjection)
+			return;
+
+		currentViewProjection = viewProjection;
+		reproject(viewProjection);
+		buildCpuPyramid();
+		ready = true;
+	}
+
+	void HiZCuller::reproject(const glm::mat4& viewProjection) {
+		// The levels keep their storage from a view to the next, buildCpuPyramid() overwrites them
+		if (cpuPyramid.empty())
+			cpuPyramid.emplace_back();
+		std::vector<float>& level0 = cpuPyramid[0];
+
+		// Same view: the readback is used as is
+		if (viewProjection == capturedViewProjection) {
+			level0 = capturedDepth;
+			return;
+		}
+
+		// Moving every texel (as a quad at its farthest depth) into the current view. Every texel the moved
+		// quad overlaps keeps the farthest depth landing on it: a surface coming closer still covers the
+		// texels it spreads over, and along silhouettes the background wins. -1 marks the texels nothing
+		// landed on.
+		splat.assign(cpuWidth * cpuHeight, -1.0f);
+		glm::mat4 toCurrent = viewProjection * glm::inverse(capturedViewProjection);
+		glm::vec2 scale(0.5f * cpuWidth, 0.5f * cpuHeight);
+		for (int y = 0; y < cpuHeight; y++) {
+			for (int x = 0; x < cpuWidth; x++) {
+				float depth = capturedDepth[y * cpuWidth + x];
+				// Corners in texel coordinates of the current view, in the order (0,0) (1,0) (0,1) (1,1)
+				glm::vec2 corners[4];
+				float farthest = 0.0f;
+				bool behind = false;
+				for (int corner = 0; corner < 4 && !behind; corner++) {
+					glm::vec4 ndc((float)(x + (corner & 1)) / cpuWidth * 2.0f - 1.0f,
+					              (float)(y + (corner >> 1)) / cpuHeight * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+					glm::vec4 clip = toCurrent * ndc;
+					behind = clip.w <= 1e-6f;
+					corners[corner] = (glm::vec2(clip) / clip.w + 1.0f) * scale;
+					farthest = std::max(farthest, clip.z / clip.w * 0.5f + 0.5f);
+				}
+				if (behind)
+					continue;
+				// The background stays at the far plane whatever the motion
+				float reprojected = depth >= 1.0f ? 1.0f : glm::clamp(farthest, 0.0f, 1.0f);
+
+				// Texels overlapped by the quad (a small margin so exactly adjacent texels aren't touched)
+				const float margin = 1e-3f;
+				glm::vec2 low = glm::min(glm::min(corners[0], corners[1]), glm::min(corners[2], corners[3]));
+				glm::vec2 high = glm::max(glm::max(corners[0], corners[1]), glm::max(corners[2], corners[3]));
+				int x0 = (int)std::floor(low.x + margin), x1 = (int)std::ceil(high.x - margin) - 1;
+				int y0 = (int)std::floor(low.y + margin), y1 = (int)std::ceil(high.y - margin) - 1;
+				x0 = std::max(x0, 0);
+				y0 = std::max(y0, 0);
+				x1 = std::min(x1, cpuWidth - 1);
+				y1 = std::min(y1, cpuHeight - 1);
+				for (int py = y0; py <= y1; py++)
+					for (int px = x0; px <= x1; px++) {
+						float& cell = splat[py * cpuWidth + px];
+						cell = std::max(cell, reprojected);
+					}
+			}
+		}
+
+		// Holes and their neighbours occlude nothing
+		level0.assign(cpuWidth * cpuHeight, 1.0f);
+		for (int y = 0; y < cpuHeight; y++) {
+			for (int x = 0; x < cpuWidth; x++) {
+				bool nearHole = false;
+				for (int dy = -1; dy <= 1 && !nearHole; dy++)
+					for (int dx = -1; dx <= 1 && !nearHole; dx++) {
+						int nx = std::clamp(x + dx, 0, cpuWidth - 1);
+						int ny = std::clamp(y + dy, 0, cpuHeight - 1);
+						nearHole = splat[ny * cpuWidth + nx] < 0.0f;
+					}
+				if (!nearHole)
+					level0[y * cpuWidth + x] = splat[y * cpuWidth + x];
+			}
+		}
+	}
+
+	void HiZCuller::buildCpuPyramid() {
+		cpuSizes.assign(1, glm::ivec2(cpuWidth, cpuHeight));
+		while (cpuSizes.back().x > 1 || cpuSizes.back().y > 1) {
+			glm::ivec2 source = cpuSizes.back();
+			glm::ivec2 size(std::max(source.x / 2, 1), std::max(source.y / 2, 1));
+			if (cpuPyramid.size() <= cpuSizes.size())
+				cpuPyramid.emplace_back();
+			const std::vector<float>& src = cpuPyramid[cpuSizes.size() - 1];
+			std::vector<float>& level = cpuPyramid[cpuSizes.size()];
+			level.resize(size.x * size.y);
+
+			for (int y = 0; y < size.y; y++) {
+				// The last row/column also takes the odd texel left over
+				int y0 = 2 * y, y1 = (y == size.y - 1) ? source.y - 1 : std::min(2 * y + 1, source.y - 1);
+				for (int x = 0; x < size.x; x++) {
+					int x0 = 2 * x, x1 = (x == size.x - 1) ? source.x - 1 : std::min(2 * x + 1, source.x - 1);
+					float farthest = 0.0f;
+					for (int sy = y0; sy <= y1; sy++)
+						for (int sx = x0; sx <= x1; sx++)
+							farthest = std::max(farthest, src[sy * source.x + sx]);
+					level[y * size.x + x] = farthest;
+				}
+			}
+			cpuSizes.push_back(size);
+		}
+	}
+
+	bool HiZCuller::isOccluded(const AABB& box) const {
+		if (!ready)
+			return false;
+
+		glm::vec3 ndcMin(1.0f), ndcMax(-1.0f);
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec4 position((corner & 1) ? box.max.x : box.min.x,
+			                   (corner & 2) ? box.max.y : box.min.y,
+			                   (corner & 4) ? box.max.z : box.min.z, 1.0f);
+			glm::vec4 clip = currentViewProjection * position;
+			// Crossing the camera plane: can't be projected, considered visible
+			if (clip.w <= 1e-5f)
+				return false;
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if (ndcMin.z <= -1.0f)
+			return false;
+
+		int x0 = std::clamp((int)std::floor((ndcMin.x * 0.5f + 0.5f) * cpuWidth), 0, cpuWidth - 1);
+		int x1 = std::clamp((int)std::floor((ndcMax.x * 0.5f + 0.5f) * cpuWidth), 0, cpuWidth - 1);
+		int y0 = std::clamp((int)std::floor((ndcMin.y * 0.5f + 0.5f) * cpuHeight), 0, cpuHeight - 1);
+		int y1 = std::clamp((int)std::floor((ndcMax.y * 0.5f + 0.5f) * cpuHeight), 0, cpuHeight - 1);
+
+		// Going up the pyramid until the box covers at most 2x2 texels
+		size_t level = 0;
+		while ((x1 - x0 > 1 || y1 - y0 > 1) && level + 1 < cpuSizes.size()) {
+			level++;
+			glm::ivec2 size = cpuSizes[level];
+			x0 = std::min(x0 / 2, size.x - 1);
+			x1 = std::min(x1 / 2, size.x - 1);
+			y0 = std::min(y0 / 2, size.y - 1);
+			y1 = std::min(y1 / 2, size.y - 1);
+		}
+
+		const std::vector<float>& depth = cpuPyramid[level];
+		int width = cpuSizes[level].x;
+		float farthest = 0.0f;
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				farthest = std::max(farthest, depth[y * width + x]);
+
+		float nearest = ndcMin.z * 0.5f + 0.5f;
+		return nearest > farthest;
+	}
+
+	MemoryUsage HiZCuller::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.host = heapBytes(levelSizes) + heapBytes(capturedDepth) + heapBytes(cpuPyramid) + heapBytes(cpuSizes) + heapBytes(splat);
+		// D24S8 copy of the depth, R32F pyramid and the pixel pack buffers
+		usage.gpu = (size_t)depthWidth * depthHeight * 4;
+		for (const glm::ivec2& size : levelSizes)
+			usage.gpu += (size_t)size.x * size.y * sizeof(float);
+		for (const Readback& readback : readbacks)
+			usage.gpu += (size_t)readback.width * readback.height * sizeof(float);
+		return usage;
+	}
+}
@@ -0,0 +1,260 @@
+#include <glengine/ktx2.hpp>
+#include <glengine/textureStreamer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace GLEngine {
+	namespace {
+		const uint8_t IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		// The 64-bit offsets are only 4-byte aligned in the struct, as in the file
+#pragma pack(push, 4)
+		struct Header {
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth, pixelHeight, pixelDepth;
+			uint32_t layerCount, faceCount, levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset, dfdByteLength;
+			uint32_t kvdByteOffset, kvdByteLength;
+			uint64_t sgdByteOffset, sgdByteLength;
+		};
+#pragma pack(pop)
+		static_assert(sizeof(Header) == 68, "KTX2 header layout");
+
+		struct LevelIndex {
+			uint64_t byteOffset, byteLength, uncompressedByteLength;
+		};
+
+		// Vulkan formats of the textures the engine writes
+		uint32_t vkFormatOf(BlockFormat format, int channels) {
+			switch (format) {
+			case BlockFormat::BC1: return 131;    // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+			case BlockFormat::BC3: return 137;    // VK_FORMAT_BC3_UNORM_BLOCK
+			case BlockFormat::BC4: return 139;    // VK_FORMAT_BC4_UNORM_BLOCK
+			case BlockFormat::BC5: return 141;    // VK_FORMAT_BC5_UNORM_BLOCK
+			case BlockFormat::BC7: return 145;    // VK_FORMAT_BC7_UNORM_BLOCK
+			default: {
+				// VK_FORMAT_R8_UNORM, R8G8, R8G8B8, R8G8B8A8
+				const uint32_t formats[4] = { 9, 16, 23, 37 };
+				return formats[std::clamp(channels, 1, 4) - 1];
+			}
+			}
+		}
+
+		bool formatOf(uint32_t vkFormat, BlockFormat& format, int& channels) {
+			const BlockFormat blockFormats[5] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+			for (BlockFormat candidate : blockFormats) {
+				if (vkFormatOf(candidate, 4) == vkFormat) {
+					format = candidate;
+					channels = blockFormatChannels(candidate);
+					return true;
+				}
+			}
+			for (int candidate = 1; candidate <= 4; candidate++) {
+				if (vkFormatOf(BlockFormat::NONE, candidate) == vkFormat) {
+					format = BlockFormat::NONE;
+					channels = candidate;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Bytes of one layer of a level
+		size_t layerSize(BlockFormat format, int channels, int width, int height) {
+			if (format == BlockFormat::NONE)
+				return (size_t)width * height * channels;
+			return compressedSize(format, width, height);
+		}
+
+		// Basic data format descriptor: color model and one sample per channel (or per block half)
+		std::vector<uint32_t> dataFormatDescriptor(BlockFormat format, int channels) {
+			struct Sample {
+				uint32_t bitOffset, bitLength, channel, upper;
+			};
+			std::vector<Sample> samples;
+			uint32_t model, blockDimensions, bytesPerBlock;
+			const uint32_t COMPRESSED = 0xFFFFFFFF;
+			switch (format) {
+			case BlockFormat::BC1:
+				model = 128;                         // KHR_DF_MODEL_BC1A
+				samples = { { 0, 64, 0, COMPRESSED } };
+				break;
+			case BlockFormat::BC3:
+				model = 130;                         // KHR_DF_MODEL_BC3, alpha then color
+				samples = { { 0, 64, 15, COMPRESSED }, { 64, 64, 0, COMPRESSED } };
+				break;
+			case BlockFormat::BC4:
+				model = 131;
+				samples = { { 0, 64, 0, COMPRESSED } };
+				break;
+			case BlockFormat::BC5:
+				model = 132;                         // Red then green
+				samples = { { 0, 64, 0, COMPRESSED }, { 64, 64, 1, COMPRESSED } };
+				break;
+			case BlockFormat::BC7:
+				model = 134;
+				samples = { { 0, 128, 0, COMPRESSED } };
+				break;
+			default:
+				model = 1;                           // KHR_DF_MODEL_RGBSDA
+				for (int c = 0; c < channels; c++)
+					samples.push_back({ (uint32_t)c * 8, 8, c == 3 ? 15u : (uint32_t)c, 255 });
+				break;
+			}
+			if (format == BlockFormat::NONE) {
+				blockDimensions = 0;
+				bytesPerBlock = channels;
+			}
+			else {
+				blockDimensions = 3 | 3 << 8;        // 4x4, stored minus one
+				bytesPerBlock = blockBytes(format);
+			}
+
+			uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+			std::vector<uint32_t> words = { 4 + blockSize, 0, 2 | blockSize << 16,
+			                                model | 1 << 8 | 1 << 16,   // BT.709 primaries, linear transfer
+			                                blockDimensions, bytesPerBlock, 0 };
+			for (const Sample& sample : samples) {
+				words.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+				words.push_back(0);
+				words.push_back(0);
+				words.push_back(sample.upper);
+			}
+			return words;
+		}
+	}
+
+	bool writeKtx2(const std::string& path, const Ktx2Texture& texture) {
+		std::vector<uint32_t> dfd = dataFormatDescriptor(texture.format, texture.channels);
+		uint32_t levelCount = (uint32_t)texture.levels.size();
+
+		Header header = {};
+		header.vkFormat = vkFormatOf(texture.format, texture.channels);
+		header.typeSize = 1;
+		header.pixelWidth = texture.width;
+		header.pixelHeight = texture.height;
+		header.layerCount = texture.layerCount;
+		header.faceCount = 1;
+		header.levelCount = levelCount;
+		header.dfdByteOffset = (uint32_t)(sizeof(IDENTIFIER) + sizeof(Header) + levelCount * sizeof(LevelIndex));
+		header.dfdByteLength = (uint32_t)(dfd.size() * 4);
+
+		// Levels from the smallest to the largest, each aligned on the texel block size and on 4
+		size_t texelBlock = texture.format == BlockFormat::NONE ? texture.channels : blockBytes(texture.format);
+		size_t alignment = texelBlock % 4 == 0 ? texelBlock : texelBlock % 2 == 0 ? texelBlock * 2 : texelBlock * 4;
+		std::vector<LevelIndex> index(levelCount);
+		size_t offset = header.dfdByteOffset + header.dfdByteLength;
+		for (int level = (int)levelCount - 1; level >= 0; level--) {
+			offset = (offset + alignment - 1) / alignment * alignment;
+			index[level] = { offset, texture.levels[level].size(), texture.levels[level].size() };
+			offset += texture.levels[level].size();
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		file.write((const char*)IDENTIFIER, sizeof(IDENTIFIER));
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)index.data(), index.size() * sizeof(LevelIndex));
+		file.write((const char*)dfd.data(), dfd.size() * 4);
+		size_t position = header.dfdByteOffset + header.dfdByteLength;
+		for (int level = (int)levelCount - 1; level >= 0; level--) {
+			const char padding[16] = {};
+			file.write(padding, index[level].byteOffset - position);
+			file.write((const char*)texture.levels[level].data(), texture.levels[level].size());
+			position = index[level].byteOffset + index[level].byteLength;
+		}
+		return (bool)file;
+	}
+
+	bool readKtx2(const std::string& path, Ktx2Texture& texture) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		Header header;
+		if (data.size() < sizeof(IDENTIFIER) + sizeof(Header) || std::memcmp(data.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+			return false;
+		std::memcpy(&header, data.data() + sizeof(IDENTIFIER), sizeof(Header));
+		if (header.supercompressionScheme != 0 || header.pixelDepth != 0 || header.faceCount != 1 || header.pixelWidth == 0
+		    || header.pixelHeight == 0 || header.levelCount == 0 || header.levelCount > 32)
+			return false;
+		if (!formatOf(header.vkFormat, texture.format, texture.channels))
+			return false;
+		texture.width = (int)header.pixelWidth;
+		texture.height = (int)header.pixelHeight;
+		texture.layerCount = (int)header.layerCount;
+
+		size_t indexOffset = sizeof(IDENTIFIER) + sizeof(Header);
+		if (data.size() < indexOffset + header.levelCount * sizeof(LevelIndex))
+			return false;
+		texture.levels.assign(header.levelCount, {});
+		for (uint32_t level = 0; level < header.levelCount; level++) {
+			LevelIndex entry;
+			std::memcpy(&entry, data.data() + indexOffset + level * sizeof(LevelIndex), sizeof(LevelIndex));
+			size_t expected = layerSize(texture.format, texture.channels, std::max(texture.width >> level, 1),
+			                            std::max(texture.height >> level, 1)) * std::max(texture.layerCount, 1);
+			if (entry.byteLength != expected || entry.byteOffset > data.size() || data.size() - entry.byteOffset < entry.byteLength)
+				return false;
+			texture.levels[level].assign(data.begin() + entry.byteOffset, data.begin() + entry.byteOffset + entry.byteLength);
+		}
+		return true;
+	}
+
+	GLuint createKtx2Texture(const Ktx2Texture& texture, bool* decoded) {
+		GLenum target = texture.layerCount > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+		int layers = std::max(texture.layerCount, 1);
+		bool compressed = texture.format != BlockFormat::NONE && isBlockFormatSupported(texture.format);
+		int channels = texture.format == BlockFormat::NONE ? texture.channels : blockFormatChannels(texture.format);
+		if (decoded)
+			*decoded = texture.format != BlockFormat::NONE && !compressed;
+
+		GLuint id;
+		glGenTextures(1, &id);
+		glBindTexture(target, id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t level = 0; level < texture.levels.size(); level++) {
+			int width = std::max(texture.width >> level, 1), height = std::max(texture.height >> level, 1);
+			const std::vector<uint8_t>& data = texture.levels[level];
+			if (compressed) {
+				GLenum format = compressedInternalFormat(texture.format);
+				if (target == GL_TEXTURE_2D_ARRAY)
+					glCompressedTexImage3D(target, (GLint)level, format, width, height, layers, 0, (GLsizei)data.size(), data.data());
+				else
+					glCompressedTexImage2D(target, (GLint)level, format, width, height, 0, (GLsizei)data.size(), data.data());
+				continue;
+			}
+
+			// Uncompressed, or decoded here layer by layer
+			std::vector<uint8_t> pixels;
+			const uint8_t* source = data.data();
+			if (texture.format != BlockFormat::NONE) {
+				size_t size = compressedSize(texture.format, width, height);
+				for (int layer = 0; layer < layers; layer++) {
+					std::vector<uint8_t> layerPixels = decompressImage(data.data() + layer * size, width, height, texture.format);
+					pixels.insert(pixels.end(), layerPixels.begin(), layerPixels.end());
+				}
+				source = pixels.data();
+			}
+			if (target == GL_TEXTURE_2D_ARRAY)
+				glTexImage3D(target, (GLint)level, textureInternalFormat(channels), width, height, layers, 0, textureFormat(channels),
+				             GL_UNSIGNED_BYTE, source);
+			else
+				glTexImage2D(target, (GLint)level, textureInternalFormat(channels), width, height, 0, textureFormat(channels),
+				             GL_UNSIGNED_BYTE, source);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (texture.format == BlockFormat::NONE)
+			setTextureSwizzle(target, channels);
+
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, texture.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(target, 0);
+		return id;
+	}
+}
@@ -0,0 +1,198 @@
+#include <glengine/lightClusters.hpp>
+#include <glengine/threadPool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace GLEngine {
+	namespace {
+		bool sphereIntersectsBox(const glm::vec4& sphere, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+			glm::vec3 center(sphere);
+			glm::vec3 offset = center - glm::clamp(center, boxMin, boxMax);
+			return glm::dot(offset, offset) <= sphere.w * sphere.w;
+		}
+	}
+
+	LightClusters::LightClusters(int tilesX, int tilesY, int depthSlices)
+	: tilesX(std::max(tilesX, 1)), tilesY(std::max(tilesY, 1)), depthSlices(std::max(depthSlices, 1)),
+	  boundsProjection(0.0f), depthScale(0.0f), depthBias(0.0f), width(1), height(1),
+	  lightCount(0), maxClusterLights(0), binningMs(0.0) {
+		sliceIndices.resize(this->depthSlices);
+		sliceCounts.resize(this->depthSlices);
+		sliceCandidates.resize(this->depthSlices);
+		glGenBuffers(3, buffers);
+		glGenTextures(3, textures);
+		const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+		for (int i = 0; i < 3; i++) {
+			glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+		}
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	LightClusters::~LightClusters() {
+		release();
+	}
+
+	void LightClusters::release() {
+		glDeleteTextures(3, textures);
+		glDeleteBuffers(3, buffers);
+		for (int i = 0; i < 3; i++)
+			textures[i] = buffers[i] = 0;
+	}
+
+	void LightClusters::buildClusterBounds(float fovY, float aspect, float nearPlane, float farPlane) {
+		boundsProjection = glm::vec4(fovY, aspect, nearPlane, farPlane);
+		float logRatio = std::log(farPlane / nearPlane);
+		depthScale = depthSlices / logRatio;
+		depthBias = -depthSlices * std::log(nearPlane) / logRatio;
+
+		sliceDepths.resize(depthSlices + 1);
+		for (int slice = 0; slice <= depthSlices; slice++)
+			sliceDepths[slice] = nearPlane * std::pow(farPlane / nearPlane, (float)slice / depthSlices);
+
+		// Half size of the view at a distance of 1
+		float halfHeight = std::tan(fovY * 0.5f), halfWidth = halfHeight * aspect;
+		clusterMin.resize(getClusterCount());
+		clusterMax.resize(getClusterCount());
+		for (int slice = 0; slice < depthSlices; slice++) {
+			float depths[2] = { sliceDepths[slice], sliceDepths[slice + 1] };
+			for (int y = 0; y < tilesY; y++) {
+				for (int x = 0; x < tilesX; x++) {
+					float ndcX[2] = { 2.0f * x / tilesX - 1.0f, 2.0f * (x + 1) / tilesX - 1.0f };
+					float ndcY[2] = { 2.0f * y / tilesY - 1.0f, 2.0f * (y + 1) / tilesY - 1.0f };
+					glm::vec3 boxMin(INFINITY), boxMax(-INFINITY);
+					// The tile is a truncated pyramid, its corners at both depths bound it
+					for (float depth : depths) {
+						for (float cornerX : ndcX) {
+							for (float cornerY : ndcY) {
+								glm::vec3 corner(cornerX * halfWidth * depth, cornerY * halfHeight * depth, -depth);
+								boxMin = glm::min(boxMin, corner);
+								boxMax = glm::max(boxMax, corner);
+							}
+						}
+					}
+					int cluster = (slice * tilesY + y) * tilesX + x;
+					clusterMin[cluster] = boxMin;
+					clusterMax[cluster] = boxMax;
+				}
+			}
+		}
+	}
+
+	void LightClusters::update(const std::vector<PointLight>& lights, const glm::mat4& view, float fovY, int newWidth, int newHeight,
+	                           float nearPlane, float farPlane, ThreadPool* pool) {
+		auto start = std::chrono::steady_clock::now();
+
+		width = std::max(newWidth, 1);
+		height = std::max(newHeight, 1);
+		glm::vec4 projection(fovY, (float)width / height, nearPlane, farPlane);
+		if (projection != boundsProjection)
+			buildClusterBounds(projection.x, projection.y, projection.z, projection.w);
+
+		lightCount = (int)lights.size();
+		viewLights.resize(lights.size());
+		lightTexels.resize(2 * lights.size());
+		for (size_t i = 0; i < lights.size(); i++) {
+			viewLights[i] = glm::vec4(glm::vec3(view * glm::vec4(lights[i].position, 1.0f)), lights[i].radius);
+			lightTexels[2 * i] = glm::vec4(lights[i].position, lights[i].radius);
+			lightTexels[2 * i + 1] = glm::vec4(lights[i].color, lights[i].intensity);
+		}
+
+		// Each slice only tests the lights overlapping its depth range
+		int tileCount = tilesX * tilesY;
+		auto binSlice = [&](size_t slice) {
+			std::vector<uint32_t>& sliceList = sliceIndices[slice];
+			std::vector<uint32_t>& counts = sliceCounts[slice];
+			sliceList.clear();
+			counts.assign(tileCount, 0);
+
+			std::vector<uint32_t>& candidates = sliceCandidates[slice];
+			candidates.clear();
+			for (size_t i = 0; i < viewLights.size(); i++) {
+				float depth = -viewLights[i].z, radius = viewLights[i].w;
+				if (depth + radius >= sliceDepths[slice] && depth - radius <= sliceDepths[slice + 1])
+					candidates.push_back((uint32_t)i);
+			}
+			if (candidates.empty())
+				return;
+
+			for (int tile = 0; tile < tileCount; tile++) {
+				int cluster = (int)slice * tileCount + tile;
+				for (uint32_t light : candidates) {
+					if (sphereIntersectsBox(viewLights[light], clusterMin[cluster], clusterMax[cluster])) {
+						sliceList.push_back(light);
+						counts[tile]++;
+					}
+				}
+			}
+		};
+		if (pool)
+			pool->parallelFor(depthSlices, binSlice);
+		else
+			for (int slice = 0; slice < depthSlices; slice++)
+				binSlice(slice);
+
+		// Concatenation, the lists of a slice are stored tile after tile
+		clusterRanges.resize(2 * getClusterCount());
+		indices.clear();
+		maxClusterLights = 0;
+		for (int slice = 0; slice < depthSlices; slice++) {
+			uint32_t offset = (uint32_t)indices.size();
+			for (int tile = 0; tile < tileCount; tile++) {
+				int cluster = slice * tileCount + tile;
+				clusterRanges[2 * cluster] = offset;
+				clusterRanges[2 * cluster + 1] = sliceCounts[slice][tile];
+				offset += sliceCounts[slice][tile];
+				maxClusterLights = std::max(maxClusterLights, (int)sliceCounts[slice][tile]);
+			}
+			indices.insert(indices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+		}
+
+		upload();
+		binningMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void LightClusters::upload() {
+		// Never empty, a texture buffer needs storage
+		const glm::vec4 noLight(0.0f);
+		const uint32_t noIndex = 0;
+		auto store = [](GLuint buffer, const void* data, size_t size, const void* fallback, size_t fallbackSize) {
+			glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+			// New storage every frame, the previous one may still be read by the GPU
+			if (size > 0)
+				glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+			else
+				glBufferData(GL_TEXTURE_BUFFER, fallbackSize, fallback, GL_STREAM_DRAW);
+		};
+		store(buffers[0], lightTexels.data(), lightTexels.size() * sizeof(glm::vec4), &noLight, sizeof(noLight));
+		store(buffers[1], clusterRanges.data(), clusterRanges.size() * sizeof(uint32_t), &noIndex, sizeof(noIndex));
+		store(buffers[2], indices.data(), indices.size() * sizeof(uint32_t), &noIndex, sizeof(noIndex));
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	void LightClusters::bind(GLuint program, int firstUnit) const {
+		const char* samplers[3] = { "stageLights", "lightClusters", "lightIndices" };
+		for (int i = 0; i < 3; i++) {
+			glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+			glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+			glUniform1i(glGetUniformLocation(program, samplers[i]), firstUnit + i);
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		glUniform1i(glGetUniformLocation(program, "stageLightCount"), lightCount);
+		glUniform3i(glGetUniformLocation(program, "clusterCounts"), tilesX, tilesY, depthSlices);
+		glUniform2f(glGetUniformLocation(program, "clusterTileScale"), (float)tilesX / width, (float)tilesY / height);
+		glUniform2f(glGetUniformLocation(program, "clusterDepthParams"), depthScale, depthBias);
+	}
+
+	MemoryUsage LightClusters::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.host = heapBytes(clusterMin) + heapBytes(clusterMax) + heapBytes(sliceDepths) + heapBytes(viewLights)
+		           + heapBytes(sliceIndices) + heapBytes(sliceCounts) + heapBytes(sliceCandidates) + heapBytes(lightTexels) + heapBytes(clusterRanges)
+		           + heapBytes(indices);
+		// The texture buffers hold what was last uploaded
+		usage.gpu = lightTexels.size() * sizeof(glm::vec4) + (clusterRanges.size() + indices.size()) * sizeof(uint32_t);
+		return usage;
+	}
+}
@@ -0,0 +1,535 @@
+#include <glengine/meshCompression.hpp>
+#include <glengine/threadPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace GLEngine {
+	namespace {
+		const char meshMagic[4] = { 'G', 'L', 'M', 'Z' };
+		const uint32_t meshVersion = 1;
+
+		// Followed by the offsets of the blocks (vertex blocks then index blocks, one more for the end),
+		// relative to the end of the offsets
+		struct MeshHeader {
+			char magic[4];
+			uint32_t version;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			float boundsMin[3];
+			float boundsMax[3];
+			uint8_t positionBits;
+			uint8_t normalBits;
+			uint8_t padding[2];
+			uint32_t blockVertices;
+			uint32_t blockTriangles;
+			uint32_t vertexBlocks;
+			uint32_t indexBlocks;
+		};
+
+		// Quantized components of a vertex: position x, y, z then octahedral normal u, v
+		const int vertexComponents = 5;
+
+		// rANS with 12-bit probabilities and a 32-bit state renormalized by bytes (Duda, Giesen)
+		const int probabilityBits = 12;
+		const uint32_t probabilityScale = 1u << probabilityBits;
+		const uint32_t ransLow = 1u << 23;
+
+		enum StreamMode : uint8_t { STREAM_RAW, STREAM_RANS, STREAM_CONSTANT };
+
+		void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+			while (value >= 0x80) {
+				out.push_back((uint8_t)(value | 0x80));
+				value >>= 7;
+			}
+			out.push_back((uint8_t)value);
+		}
+
+		bool getVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (data == end)
+					return false;
+				uint8_t byte = *data++;
+				value |= (uint64_t)(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+		int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+		// Counts scaled to probabilityScale, every present symbol keeping at least 1
+		void normalizeFrequencies(const uint32_t counts[256], size_t total, uint32_t frequencies[256]) {
+			uint32_t sum = 0;
+			for (int s = 0; s < 256; s++) {
+				frequencies[s] = counts[s] ? std::max<uint32_t>(1, (uint32_t)((uint64_t)counts[s] * probabilityScale / total)) : 0;
+				sum += frequencies[s];
+			}
+			while (sum != probabilityScale) {
+				int largest = (int)(std::max_element(frequencies, frequencies + 256) - frequencies);
+				if (sum < probabilityScale) {
+					frequencies[largest] += probabilityScale - sum;
+					sum = probabilityScale;
+				}
+				else {
+					uint32_t excess = std::min(sum - probabilityScale, frequencies[largest] - 1);
+					// Symbols raised to 1 may leave the largest at 1 as well: take one from each in turn
+					if (excess == 0) {
+						for (int s = 0; s < 256 && sum > probabilityScale; s++)
+							if (frequencies[s] > 1) {
+								frequencies[s]--;
+								sum--;
+							}
+						continue;
+					}
+					frequencies[largest] -= excess;
+					sum -= excess;
+				}
+			}
+		}
+
+		// Appends a byte stream, rANS coded (two interleaved states) unless stored smaller as is
+		void encodeStream(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+			uint32_t counts[256] = {};
+			for (size_t i = 0; i < size; i++)
+				counts[data[i]]++;
+			int symbols = 0;
+			for (int s = 0; s < 256; s++)
+				symbols += counts[s] != 0;
+			if (symbols <= 1) {
+				out.push_back(STREAM_CONSTANT);
+				out.push_back(size ? data[0] : 0);
+				return;
+			}
+
+			uint32_t frequencies[256], starts[256];
+			normalizeFrequencies(counts, size, frequencies);
+			uint32_t start = 0;
+			for (int s = 0; s < 256; s++) {
+				starts[s] = start;
+				start += frequencies[s];
+			}
+
+			// Encoded backwards: the decoder reads the bytes in the order it needs them
+			std::vector<uint8_t> buffer(size * 2 + 16);
+			uint8_t* end = buffer.data() + buffer.size();
+			uint8_t* pointer = end;
+			uint32_t states[2] = { ransLow, ransLow };
+			for (size_t i = size; i-- > 0;) {
+				uint32_t& state = states[i & 1];
+				uint32_t frequency = frequencies[data[i]];
+				uint32_t maximum = ((ransLow >> probabilityBits) << 8) * frequency;
+				while (state >= maximum) {
+					*--pointer = (uint8_t)state;
+					state >>= 8;
+				}
+				state = ((state / frequency) << probabilityBits) + state % frequency + starts[data[i]];
+			}
+			for (int k = 1; k >= 0; k--) {
+				pointer -= 4;
+				for (int b = 0; b < 4; b++)
+					pointer[b] = (uint8_t)(states[k] >> (8 * b));
+			}
+			size_t payload = end - pointer;
+
+			std::vector<uint8_t> table;
+			putVarint(table, (uint64_t)symbols);
+			for (int s = 0; s < 256; s++) {
+				if (!frequencies[s])
+					continue;
+				table.push_back((uint8_t)s);
+				putVarint(table, frequencies[s]);
+			}
+			if (table.size() + payload + 8 >= size) {
+				out.push_back(STREAM_RAW);
+				out.insert(out.end(), data, data + size);
+				return;
+			}
+			out.push_back(STREAM_RANS);
+			out.insert(out.end(), table.begin(), table.end());
+			putVarint(out, payload);
+			out.insert(out.end(), pointer, end);
+		}
+
+		// Decodes a stream of size bytes written by encodeStream
+		bool decodeStream(const uint8_t*& in, const uint8_t* end, uint8_t* data, size_t size) {
+			if (in == end)
+				return false;
+			uint8_t mode = *in++;
+			if (mode == STREAM_CONSTANT) {
+				if (in == end)
+					return false;
+				memset(data, *in++, size);
+				return true;
+			}
+			if (mode == STREAM_RAW) {
+				if ((size_t)(end - in) < size)
+					return false;
+				memcpy(data, in, size);
+				in += size;
+				return true;
+			}
+			if (mode != STREAM_RANS)
+				return false;
+
+			uint64_t symbols, payload;
+			if (!getVarint(in, end, symbols) || symbols < 2 || symbols > 256)
+				return false;
+			uint32_t frequencies[256] = {}, starts[256] = {};
+			uint8_t lookup[probabilityScale];
+			uint32_t start = 0;
+			for (uint64_t i = 0; i < symbols; i++) {
+				uint64_t frequency;
+				if (in == end)
+					return false;
+				uint8_t symbol = *in++;
+				if (!getVarint(in, end, frequency) || frequency == 0 || start + frequency > probabilityScale)
+					return false;
+				frequencies[symbol] = (uint32_t)frequency;
+				starts[symbol] = start;
+				memset(lookup + start, symbol, frequency);
+				start += (uint32_t)frequency;
+			}
+			if (start != probabilityScale || !getVarint(in, end, payload) || payload < 8 || payload > (uint64_t)(end - in))
+				return false;
+
+			const uint8_t* pointer = in;
+			const uint8_t* payloadEnd = in + payload;
+			uint32_t states[2];
+			for (int k = 0; k < 2; k++) {
+				states[k] = pointer[0] | (uint32_t)pointer[1] << 8 | (uint32_t)pointer[2] << 16 | (uint32_t)pointer[3] << 24;
+				pointer += 4;
+			}
+			const uint32_t mask = probabilityScale - 1;
+			for (size_t i = 0; i < size; i++) {
+				uint32_t& state = states[i & 1];
+				uint8_t symbol = lookup[state & mask];
+				data[i] = symbol;
+				state = frequencies[symbol] * (state >> probabilityBits) + (state & mask) - starts[symbol];
+				while (state < ransLow) {
+					if (pointer == payloadEnd)
+						return false;
+					state = (state << 8) | *pointer++;
+				}
+			}
+			in = payloadEnd;
+			return true;
+		}
+
+		uint16_t quantize(float value, float minimum, float scale, uint32_t maximum) {
+			float q = std::floor((value - minimum) * scale + 0.5f);
+			return (uint16_t)std::min<float>(std::max(q, 0.0f), (float)maximum);
+		}
+
+		// Quantized vertices [first, first + count), delta coded, as the low then high bytes of every component
+		void encodeVertexBlock(const uint16_t* quantized, size_t first, size_t count, std::vector<uint8_t>& out) {
+			std::vector<uint8_t> bytes(count);
+			for (int c = 0; c < vertexComponents; c++) {
+				for (int half = 0; half < 2; half++) {
+					uint16_t previous = 0;
+					for (size_t i = 0; i < count; i++) {
+						uint16_t value = quantized[(first + i) * vertexComponents + c];
+						uint32_t delta = zigzag((int16_t)(uint16_t)(value - previous));
+						bytes[i] = (uint8_t)(delta >> (8 * half));
+						previous = value;
+					}
+					encodeStream(bytes.data(), count, out);
+				}
+			}
+		}
+
+		// The next new vertex at the start of the block, then for every index 0 when it is that vertex,
+		// else 1 + the zigzag of its distance to the previous index
+		void encodeIndexBlock(const unsigned int* indices, size_t first, size_t count, uint32_t nextVertex, std::vector<uint8_t>& out) {
+			std::vector<uint8_t> codes;
+			codes.reserve(count * 2);
+			putVarint(codes, nextVertex);
+			uint32_t previous = nextVertex ? nextVertex - 1 : 0;
+			for (size_t i = first; i < first + count; i++) {
+				uint32_t index = indices[i];
+				if (index == nextVertex) {
+					codes.push_back(0);
+					nextVertex++;
+				}
+				else
+					putVarint(codes, 1 + (uint64_t)zigzag((int32_t)(index - previous)));
+				previous = index;
+			}
+			putVarint(out, codes.size());
+			encodeStream(codes.data(), codes.size(), out);
+		}
+	}
+
+	void encodeOctahedral(const float* normal, float& u, float& v) {
+		float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+		if (length <= 0.0f) {
+			u = v = 0.0f;
+			return;
+		}
+		float x = normal[0] / length, y = normal[1] / length;
+		// The lower half folded over the diagonals
+		if (normal[2] < 0.0f) {
+			float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+		u = x;
+		v = y;
+	}
+
+	void decodeOctahedral(float u, float v, float* normal) {
+		float z = 1.0f - std::fabs(u) - std::fabs(v);
+		float x = u, y = v;
+		if (z < 0.0f) {
+			x = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		}
+		float length = std::sqrt(x * x + y * y + z * z);
+		normal[0] = x / length;
+		normal[1] = y / length;
+		normal[2] = z / length;
+	}
+
+	std::vector<uint8_t> compressMesh(const float* positions, const float* normals, size_t vertexCount,
+	                                  const unsigned int* indices, size_t indexCount,
+	                                  const MeshCompressionSettings& settings, ThreadPool* pool) {
+		MeshHeader header = {};
+		memcpy(header.magic, meshMagic, sizeof(header.magic));
+		header.version = meshVersion;
+		header.vertexCount = (uint32_t)vertexCount;
+		header.indexCount = (uint32_t)(indexCount / 3 * 3);
+		header.positionBits = (uint8_t)std::min(std::max(settings.positionBits, 1), 16);
+		header.normalBits = (uint8_t)std::min(std::max(settings.normalBits, 2), 16);
+		header.blockVertices = std::max<uint32_t>(settings.blockVertices, 1);
+		header.blockTriangles = std::max<uint32_t>(settings.blockTriangles, 1);
+		header.vertexBlocks = (uint32_t)((vertexCount + header.blockVertices - 1) / header.blockVertices);
+		header.indexBlocks = (uint32_t)((header.indexCount / 3 + header.blockTriangles - 1) / header.blockTriangles);
+
+		// Vertices in order of first use, the unused ones last
+		std::vector<uint32_t> remap(vertexCount, UINT32_MAX), order;
+		std::vector<unsigned int> remapped(header.indexCount);
+		order.reserve(vertexCount);
+		for (size_t i = 0; i < header.indexCount; i++) {
+			unsigned int index = indices[i] < vertexCount ? indices[i] : 0;
+			if (remap[index] == UINT32_MAX) {
+				remap[index] = (uint32_t)order.size();
+				order.push_back(index);
+			}
+			remapped[i] = remap[index];
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+			if (remap[v] == UINT32_MAX)
+				order.push_back((uint32_t)v);
+
+		for (int c = 0; c < 3; c++) {
+			header.boundsMin[c] = header.boundsMax[c] = vertexCount ? positions[c] : 0.0f;
+			for (size_t v = 0; v < vertexCount; v++) {
+				header.boundsMin[c] = std::min(header.boundsMin[c], positions[3 * v + c]);
+				header.boundsMax[c] = std::max(header.boundsMax[c], positions[3 * v + c]);
+			}
+		}
+		uint32_t positionMaximum = (1u << header.positionBits) - 1, normalMaximum = (1u << header.normalBits) - 1;
+		float positionScales[3];
+		for (int c = 0; c < 3; c++) {
+			float extent = header.boundsMax[c] - header.boundsMin[c];
+			positionScales[c] = extent > 0.0f ? positionMaximum / extent : 0.0f;
+		}
+		std::vector<uint16_t> quantized(vertexCount * vertexComponents);
+		for (size_t v = 0; v < vertexCount; v++) {
+			const float* position = positions + 3 * order[v];
+			uint16_t* vertex = &quantized[v * vertexComponents];
+			for (int c = 0; c < 3; c++)
+				vertex[c] = quantize(position[c], header.boundsMin[c], positionScales[c], positionMaximum);
+			float u, w;
+			encodeOctahedral(normals + 3 * order[v], u, w);
+			vertex[3] = quantize(u, -1.0f, normalMaximum * 0.5f, normalMaximum);
+			vertex[4] = quantize(w, -1.0f, normalMaximum * 0.5f, normalMaximum);
+		}
+
+		// New vertices before every index block: the highest index so far + 1, as they come in order
+		std::vector<uint32_t> blockNextVertex(header.indexBlocks, 0);
+		uint32_t nextVertex = 0;
+		for (size_t i = 0; i < header.indexCount; i++) {
+			if (i % ((size_t)header.blockTriangles * 3) == 0)
+				blockNextVertex[i / ((size_t)header.blockTriangles * 3)] = nextVertex;
+			nextVertex = std::max(nextVertex, remapped[i] + 1);
+		}
+
+		size_t blockCount = (size_t)header.vertexBlocks + header.indexBlocks;
+		std::vector<std::vector<uint8_t>> blocks(blockCount);
+		auto encodeBlock = [&](size_t block) {
+			if (block < header.vertexBlocks) {
+				size_t first = block * header.blockVertices;
+				encodeVertexBlock(quantized.data(), first, std::min<size_t>(header.blockVertices, vertexCount - first), blocks[block]);
+			}
+			else {
+				size_t indexBlock = block - header.vertexBlocks;
+				size_t first = indexBlock * header.blockTriangles * 3;
+				size_t count = std::min<size_t>((size_t)header.blockTriangles * 3, header.indexCount - first);
+				encodeIndexBlock(remapped.data(), first, count, blockNextVertex[indexBlock], blocks[block]);
+			}
+		};
+		if (pool)
+			pool->parallelFor(blockCount, encodeBlock);
+		else
+			for (size_t block = 0; block < blockCount; block++)
+				encodeBlock(block);
+
+		std::vector<uint64_t> offsets(blockCount + 1, 0);
+		for (size_t block = 0; block < blockCount; block++)
+			offsets[block + 1] = offsets[block] + blocks[block].size();
+		std::vector<uint8_t> out(sizeof(header) + offsets.size() * sizeof(uint64_t));
+		memcpy(out.data(), &header, sizeof(header));
+		memcpy(out.data() + sizeof(header), offsets.data(), offsets.size() * sizeof(uint64_t));
+		out.reserve(out.size() + offsets.back());
+		for (const std::vector<uint8_t>& block : blocks)
+			out.insert(out.end(), block.begin(), block.end());
+		return out;
+	}
+
+	namespace {
+		bool readMeshHeader(const uint8_t* data, size_t size, MeshHeader& header) {
+			if (size < sizeof(header))
+				return false;
+			memcpy(&header, data, sizeof(header));
+			return memcmp(header.magic, meshMagic, sizeof(header.magic)) == 0 && header.version == meshVersion
+			    && header.positionBits >= 1 && header.positionBits <= 16 && header.normalBits >= 2 && header.normalBits <= 16
+			    && header.blockVertices != 0 && header.blockTriangles != 0 && header.indexCount % 3 == 0
+			    && header.vertexBlocks == (header.vertexCount + (uint64_t)header.blockVertices - 1) / header.blockVertices
+			    && header.indexBlocks == (header.indexCount / 3 + (uint64_t)header.blockTriangles - 1) / header.blockTriangles;
+		}
+	}
+
+	bool getCompressedMeshSize(const uint8_t* data, size_t size, size_t& vertexCount, size_t& indexCount) {
+		MeshHeader header;
+		if (!readMeshHeader(data, size, header))
+			return false;
+		vertexCount = header.vertexCount;
+		indexCount = header.indexCount;
+		return true;
+	}
+
+	bool decompressMesh(const uint8_t* data, size_t size, std::vector<float>& positions, std::vector<float>& normals,
+	                    std::vector<unsigned int>& indices, ThreadPool* pool) {
+		size_t vertexCount, indexCount;
+		if (!getCompressedMeshSize(data, size, vertexCount, indexCount))
+			return false;
+		positions.resize(vertexCount * 3);
+		normals.resize(vertexCount * 3);
+		indices.resize(indexCount);
+		return decompressMesh(data, size, positions.data(), normals.data(), indices.data(), pool);
+	}
+
+	bool decompressMesh(const uint8_t* data, size_t size, float* positions, float* normals, unsigned int* indices,
+	                    ThreadPool* pool) {
+		MeshHeader header;
+		if (!readMeshHeader(data, size, header))
+			return false;
+		size_t blockCount = (size_t)header.vertexBlocks + header.indexBlocks;
+		size_t tableEnd = sizeof(header) + (blockCount + 1) * sizeof(uint64_t);
+		if (size < tableEnd)
+			return false;
+		std::vector<uint64_t> offsets(blockCount + 1);
+		memcpy(offsets.data(), data + sizeof(header), offsets.size() * sizeof(uint64_t));
+		for (size_t block = 0; block < blockCount; block++)
+			if (offsets[block] > offsets[block + 1])
+				return false;
+		if (offsets[0] != 0 || offsets.back() > size - tableEnd)
+			return false;
+		const uint8_t* blockData = data + tableEnd;
+
+		float positionSteps[3];
+		for (int c = 0; c < 3; c++)
+			positionSteps[c] = (header.boundsMax[c] - header.boundsMin[c]) / ((1u << header.positionBits) - 1);
+		float normalStep = 2.0f / ((1u << header.normalBits) - 1);
+
+		// The temporaries of all the blocks in one allocation: the delta bytes and values of the vertex
+		// blocks, then the codes of the index blocks (their size leads the block)
+		std::vector<size_t> scratchOffsets(blockCount + 1, 0);
+		for (size_t block = 0; block < blockCount; block++) {
+			size_t bytes = 0;
+			if (block < header.vertexBlocks) {
+				size_t count = std::min<size_t>(header.blockVertices, header.vertexCount - block * header.blockVertices);
+				bytes = count * 2 + count * vertexComponents * sizeof(uint16_t);
+			}
+			else {
+				const uint8_t* in = blockData + offsets[block];
+				uint64_t codeBytes;
+				size_t count = std::min<size_t>((size_t)header.blockTriangles * 3,
+				                                header.indexCount - (block - header.vertexBlocks) * header.blockTriangles * 3);
+				if (getVarint(in, blockData + offsets[block + 1], codeBytes) && codeBytes <= (count + 1) * 5)
+					bytes = (size_t)codeBytes;
+			}
+			scratchOffsets[block + 1] = scratchOffsets[block] + ((bytes + 7) & ~(size_t)7);
+		}
+		std::vector<uint8_t> scratch(scratchOffsets.back());
+
+		std::vector<uint8_t> valid(blockCount, 0);
+		auto decodeBlock = [&](size_t block) {
+			const uint8_t* in = blockData + offsets[block];
+			const uint8_t* end = blockData + offsets[block + 1];
+			if (block < header.vertexBlocks) {
+				size_t first = block * header.blockVertices;
+				size_t count = std::min<size_t>(header.blockVertices, header.vertexCount - first);
+				uint8_t* bytes = scratch.data() + scratchOffsets[block];
+				uint16_t* values = (uint16_t*)(bytes + count * 2);
+				for (int c = 0; c < vertexComponents; c++) {
+					if (!decodeStream(in, end, bytes, count) || !decodeStream(in, end, bytes + count, count))
+						return;
+					uint16_t previous = 0;
+					for (size_t i = 0; i < count; i++) {
+						uint32_t delta = bytes[i] | (uint32_t)bytes[count + i] << 8;
+						previous = (uint16_t)(previous + unzigzag(delta));
+						values[i * vertexComponents + c] = previous;
+					}
+				}
+				for (size_t i = 0; i < count; i++) {
+					const uint16_t* vertex = &values[i * vertexComponents];
+					float* position = &positions[(first + i) * 3];
+					for (int c = 0; c < 3; c++)
+						position[c] = header.boundsMin[c] + vertex[c] * positionSteps[c];
+					decodeOctahedral(vertex[3] * normalStep - 1.0f, vertex[4] * normalStep - 1.0f, &normals[(first + i) * 3]);
+				}
+			}
+			else {
+				size_t indexBlock = block - header.vertexBlocks;
+				size_t first = indexBlock * header.blockTriangles * 3;
+				size_t count = std::min<size_t>((size_t)header.blockTriangles * 3, header.indexCount - first);
+				uint64_t codeBytes;
+				if (!getVarint(in, end, codeBytes) || codeBytes > (count + 1) * 5)
+					return;
+				uint8_t* codes = scratch.data() + scratchOffsets[block];
+				if (!decodeStream(in, end, codes, codeBytes))
+					return;
+				const uint8_t* code = codes;
+				const uint8_t* codesEnd = code + codeBytes;
+				uint64_t nextVertex;
+				if (!getVarint(code, codesEnd, nextVertex))
+					return;
+				uint32_t next = (uint32_t)nextVertex;
+				uint32_t previous = next ? next - 1 : 0;
+				for (size_t i = 0; i < count; i++) {
+					uint64_t value;
+					if (!getVarint(code, codesEnd, value))
+						return;
+					uint32_t index = value == 0 ? next++ : previous + (uint32_t)unzigzag((uint32_t)(value - 1));
+					if (index >= header.vertexCount)
+						return;
+					indices[first + i] = index;
+					previous = index;
+				}
+			}
+			valid[block] = 1;
+		};
+		if (pool)
+			pool->parallelFor(blockCount, decodeBlock);
+		else
+			for (size_t block = 0; block < blockCount; block++)
+				decodeBlock(block);
+		return std::find(valid.begin(), valid.end(), 0) == valid.end();
+	}
+}
@@ -0,0 +1,286 @@
+#include <glengine/meshlets.hpp>
+#include <glengine/clusterFile.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+namespace GLEngine {
+	namespace {
+		const float coneWeight = 2.0f;
+#if defined(__SSE__)
+		// Set bits of a 4-bit lane mask, without a compiler builtin
+		const uint8_t maskBitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#endif
+
+		glm::vec3 vertexPosition(const float* positions, unsigned int vertex) {
+			return glm::vec3(positions[3 * vertex], positions[3 * vertex + 1], positions[3 * vertex + 2]);
+		}
+
+		// Bounding sphere and normal cone of the triangles [first, first + count)
+		void computeBounds(const float* positions, const unsigned int* indices, Meshlet& meshlet, ArenaVector<glm::vec3>& normals) {
+			const unsigned int* triangles = indices + meshlet.firstIndex;
+			AABB box;
+			box.min = box.max = vertexPosition(positions, triangles[0]);
+			glm::vec3 normalSum(0.0f);
+			normals.clear();
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+				glm::vec3 p[3];
+				for (int c = 0; c < 3; c++) {
+					p[c] = vertexPosition(positions, triangles[3 * t + c]);
+					box.min = glm::min(box.min, p[c]);
+					box.max = glm::max(box.max, p[c]);
+				}
+				glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				float length = glm::length(normal);
+				// Degenerate triangles face nowhere, they can't keep the meshlet
+				if (length > 0.0f) {
+					normals.push_back(normal / length);
+					normalSum += normals.back();
+				}
+			}
+			meshlet.center = box.getCenter();
+			float radius = 0.0f;
+			for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++)
+				radius = std::max(radius, glm::distance(meshlet.center, vertexPosition(positions, triangles[i])));
+			meshlet.radius = radius;
+
+			// Cone around the average normal; too wide (past about 84 degrees) it rejects nothing
+			meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+			meshlet.coneCutoff = 1.0f;
+			float sumLength = glm::length(normalSum);
+			if (sumLength <= 0.0f)
+				return;
+			meshlet.coneAxis = normalSum / sumLength;
+			float minimumDot = 1.0f;
+			for (const glm::vec3& normal : normals)
+				minimumDot = std::min(minimumDot, glm::dot(meshlet.coneAxis, normal));
+			if (minimumDot > 0.1f)
+				meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+		}
+	}
+
+	std::vector<Meshlet> buildMeshlets(const float* positions, size_t vertexCount, unsigned int* indices, size_t indexCount,
+	                                   const MeshletSettings& settings, Arena* scratch) {
+		std::vector<Meshlet> meshlets;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return meshlets;
+		int maxVertices = std::max(settings.maxVertices, 3);
+		int maxTriangles = std::max(settings.maxTriangles, 1);
+		// Most meshlets are full, the array rarely grows
+		meshlets.reserve(2 * triangleCount / maxTriangles + 1);
+
+		// A single block holds all the temporaries (with room for the candidates growing)
+		Arena localArena(vertexCount * 12 + triangleCount * 68 + maxTriangles * 12 + (256 << 10));
+		Arena& arena = scratch ? *scratch : localArena;
+
+		// Triangles of every vertex
+		ArenaVector<uint32_t> vertexFirst(vertexCount + 1, 0, arena), vertexTriangles(triangleCount * 3, arena);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			vertexFirst[indices[i] + 1]++;
+		std::partial_sum(vertexFirst.begin(), vertexFirst.end(), vertexFirst.begin());
+		ArenaVector<uint32_t> next(vertexFirst.begin(), vertexFirst.end() - 1, arena);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			vertexTriangles[next[indices[i]]++] = (uint32_t)(i / 3);
+
+		// Seeds along a Morton curve, so a new meshlet starts next to the previous ones
+		AABB bounds = AABB::fromPositions(positions, vertexCount);
+		ArenaVector<std::pair<uint64_t, uint32_t>> seeds(triangleCount, arena);
+		ArenaVector<glm::vec3> centroids(triangleCount, arena), faceNormals(triangleCount, arena);
+		for (size_t t = 0; t < triangleCount; t++) {
+			glm::vec3 p0 = vertexPosition(positions, indices[3 * t]);
+			glm::vec3 p1 = vertexPosition(positions, indices[3 * t + 1]);
+			glm::vec3 p2 = vertexPosition(positions, indices[3 * t + 2]);
+			centroids[t] = (p0 + p1 + p2) / 3.0f;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			faceNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+			seeds[t] = { mortonCode(centroids[t], bounds), (uint32_t)t };
+		}
+		std::sort(seeds.begin(), seeds.end());
+
+		ArenaVector<unsigned int> ordered(arena);
+		ordered.reserve(triangleCount * 3);
+		ArenaVector<uint8_t> used(triangleCount, 0, arena);
+		ArenaVector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX, arena);
+		ArenaVector<uint32_t> candidates(arena);
+		candidates.reserve(16 * maxTriangles);
+		size_t seed = 0;
+		while (true) {
+			while (seed < triangleCount && used[seeds[seed].second])
+				seed++;
+			if (seed == triangleCount)
+				break;
+			uint32_t id = (uint32_t)meshlets.size();
+			Meshlet meshlet = {};
+			meshlet.firstIndex = (uint32_t)ordered.size();
+			glm::vec3 centroidSum(0.0f), normalSum(0.0f);
+			candidates.assign(1, seeds[seed].second);
+
+			while ((int)meshlet.triangleCount < maxTriangles) {
+				// The candidate adding the fewest vertices, then the closest to the meshlet, the distance
+				// growing as the triangle turns away from its normals (so their cone stays narrow)
+				size_t best = SIZE_MAX;
+				int bestNew = 4;
+				float bestDistance = std::numeric_limits<float>::max();
+				glm::vec3 center = meshlet.triangleCount ? centroidSum / (float)meshlet.triangleCount : centroids[candidates[0]];
+				float normalLength = glm::length(normalSum);
+				glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f);
+				size_t kept = 0;
+				for (size_t i = 0; i < candidates.size(); i++) {
+					uint32_t triangle = candidates[i];
+					if (used[triangle])
+						continue;
+					candidates[kept++] = triangle;
+					int added = 0;
+					for (int c = 0; c < 3; c++)
+						added += vertexMeshlet[indices[3 * triangle + c]] != id;
+					if ((int)meshlet.vertexCount + added > maxVertices)
+						continue;
+					float distance = glm::distance(center, centroids[triangle])
+					                 * (1.0f + coneWeight * (1.0f - glm::dot(axis, faceNormals[triangle])));
+					if (added < bestNew || (added == bestNew && distance < bestDistance)) {
+						best = kept - 1;
+						bestNew = added;
+						bestDistance = distance;
+					}
+				}
+				candidates.resize(kept);
+				if (best == SIZE_MAX)
+					break;
+
+				uint32_t triangle = candidates[best];
+				used[triangle] = true;
+				meshlet.triangleCount++;
+				centroidSum += centroids[triangle];
+				normalSum += faceNormals[triangle];
+				for (int c = 0; c < 3; c++) {
+					unsigned int vertex = indices[3 * triangle + c];
+					ordered.push_back(vertex);
+					if (vertexMeshlet[vertex] == id)
+						continue;
+					vertexMeshlet[vertex] = id;
+					meshlet.vertexCount++;
+					for (uint32_t k = vertexFirst[vertex]; k < vertexFirst[vertex + 1]; k++)
+						if (!used[vertexTriangles[k]])
+							candidates.push_back(vertexTriangles[k]);
+				}
+			}
+			meshlets.push_back(meshlet);
+		}
+
+		std::copy(ordered.begin(), ordered.end(), indices);
+		ArenaVector<glm::vec3> normals(arena);
+		normals.reserve(maxTriangles);
+		for (Meshlet& meshlet : meshlets)
+			computeBounds(positions, indices, meshlet, normals);
+		return meshlets;
+	}
+
+	void MeshletBounds::build(const std::vector<Meshlet>& meshlets) {
+		meshletCount = meshlets.size();
+		size_t padded = (meshletCount + 3) & ~(size_t)3;
+		// The padding is a point that the cone never rejects
+		centerX.assign(padded, 0.0f);
+		centerY.assign(padded, 0.0f);
+		centerZ.assign(padded, 0.0f);
+		radius.assign(padded, 0.0f);
+		axisX.assign(padded, 0.0f);
+		axisY.assign(padded, 0.0f);
+		axisZ.assign(padded, 1.0f);
+		cutoff.assign(padded, 1.0f);
+		for (size_t i = 0; i < meshletCount; i++) {
+			centerX[i] = meshlets[i].center.x;
+			centerY[i] = meshlets[i].center.y;
+			centerZ[i] = meshlets[i].center.z;
+			radius[i] = meshlets[i].radius;
+			axisX[i] = meshlets[i].coneAxis.x;
+			axisY[i] = meshlets[i].coneAxis.y;
+			axisZ[i] = meshlets[i].coneAxis.z;
+			cutoff[i] = meshlets[i].coneCutoff;
+		}
+	}
+
+	size_t MeshletBounds::cull(const glm::mat4& model, const Frustum& frustum, const glm::vec3& cameraPosition, float margin,
+	                           bool coneCulling, size_t first, size_t count, uint8_t* visibility) const {
+		count = std::min(count, meshletCount - std::min(first, meshletCount));
+		visibility -= first;
+		// Planes in object space, still measuring world distances: p.(M x) = (M^T p).x
+		glm::vec4 planes[6];
+		glm::mat4 transposed = glm::transpose(model);
+		for (int k = 0; k < 6; k++)
+			planes[k] = transposed * frustum.planes[k];
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+		float objectMargin = margin / std::max(scale, 1e-20f);
+		// Without cone culling every test fails: no meshlet is both farther than its center and past its radius
+		float coneEnabled = coneCulling ? 0.0f : std::numeric_limits<float>::infinity();
+
+		size_t outsideCount = 0;
+		size_t end = first + count;
+		size_t i = first;
+#if defined(__SSE__)
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int k = 0; k < 6; k++) {
+			planeX[k] = _mm_set1_ps(planes[k].x);
+			planeY[k] = _mm_set1_ps(planes[k].y);
+			planeZ[k] = _mm_set1_ps(planes[k].z);
+			planeW[k] = _mm_set1_ps(planes[k].w);
+		}
+		__m128 scaleV = _mm_set1_ps(scale), marginV = _mm_set1_ps(margin), objectMarginV = _mm_set1_ps(objectMargin);
+		__m128 cameraX = _mm_set1_ps(camera.x), cameraY = _mm_set1_ps(camera.y), cameraZ = _mm_set1_ps(camera.z);
+		__m128 disabled = _mm_set1_ps(coneEnabled), zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_loadu_ps(&centerX[i]), y = _mm_loadu_ps(&centerY[i]), z = _mm_loadu_ps(&centerZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+			// Outside when the center is farther than the (world) radius behind one plane
+			__m128 limit = _mm_sub_ps(zero, _mm_add_ps(_mm_mul_ps(r, scaleV), marginV));
+			__m128 outside = _mm_setzero_ps();
+			for (int k = 0; k < 6; k++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[k], x), _mm_mul_ps(planeY[k], y)),
+				                             _mm_add_ps(_mm_mul_ps(planeZ[k], z), planeW[k]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, limit));
+			}
+			// Cone: dot(v, axis) >= cutoff |v| + radius, v from the camera to the center
+			__m128 vx = _mm_sub_ps(x, cameraX), vy = _mm_sub_ps(y, cameraY), vz = _mm_sub_ps(z, cameraZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+			__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&axisX[i])), _mm_mul_ps(vy, _mm_loadu_ps(&axisY[i]))),
+			                          _mm_mul_ps(vz, _mm_loadu_ps(&axisZ[i])));
+			__m128 threshold = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cutoff[i]), length), r), disabled);
+			__m128 backFacing = _mm_cmpge_ps(along, threshold);
+			__m128 frontFacing = _mm_cmpge_ps(_mm_sub_ps(zero, along), _mm_add_ps(threshold, objectMarginV));
+			int outsideMask = _mm_movemask_ps(outside);
+			int frontMask = ~(outsideMask | _mm_movemask_ps(backFacing));
+			int backMask = ~(outsideMask | _mm_movemask_ps(frontFacing));
+			for (int lane = 0; lane < 4; lane++)
+				visibility[i + lane] = (uint8_t)(((frontMask >> lane) & 1) * FRONT | ((backMask >> lane) & 1) * BACK);
+			outsideCount += maskBitCount[outsideMask];
+		}
+#endif
+		for (; i < end; i++) {
+			glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+			bool outside = false;
+			for (int k = 0; k < 6; k++)
+				outside = outside || glm::dot(glm::vec3(planes[k]), center) + planes[k].w < -(radius[i] * scale + margin);
+			glm::vec3 v = center - camera;
+			float along = glm::dot(v, glm::vec3(axisX[i], axisY[i], axisZ[i]));
+			float threshold = cutoff[i] * glm::length(v) + radius[i] + coneEnabled;
+			bool backFacing = along >= threshold, frontFacing = -along >= threshold + objectMargin;
+			visibility[i] = (uint8_t)((!outside && !backFacing ? FRONT : 0) | (!outside && !frontFacing ? BACK : 0));
+			outsideCount += outside;
+		}
+		return outsideCount;
+	}
+
+	MemoryUsage MeshletBounds::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.host = heapBytes(centerX) + heapBytes(centerY) + heapBytes(centerZ) + heapBytes(radius) + heapBytes(axisX)
+		           + heapBytes(axisY) + heapBytes(axisZ) + heapBytes(cutoff);
+		return usage;
+	}
+}
@@ -0,0 +1,233 @@
+#include <glengine/mipmapGenerator.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace GLEngine {
+	namespace {
+		const float pi = 3.14159265358979f;
+
+		float sinc(float x) {
+			if (std::abs(x) < 1e-5f)
+				return 1.0f;
+			return std::sin(pi * x) / (pi * x);
+		}
+
+		// Modified Bessel function of the first kind, order 0 (series)
+		float besselI0(float x) {
+			float sum = 1.0f, term = 1.0f;
+			for (int k = 1; k < 20; k++) {
+				term *= (x * 0.5f / k) * (x * 0.5f / k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		// Support of a filter in output texels
+		float filterRadius(MipFilter filter) {
+			return filter == MipFilter::KAISER || filter == MipFilter::LANCZOS ? 3.0f : 0.5f;
+		}
+
+		float filterWeight(MipFilter filter, float x) {
+			float radius = filterRadius(filter);
+			x = std::abs(x);
+			if (x >= radius)
+				return x == 0.5f && radius == 0.5f ? 0.5f : 0.0f;
+			switch (filter) {
+			case MipFilter::KAISER: {
+				const float alpha = 4.0f;
+				float t = x / radius;
+				return sinc(x) * besselI0(alpha * std::sqrt(1.0f - t * t)) / besselI0(alpha);
+			}
+			case MipFilter::LANCZOS:
+				return sinc(x) * sinc(x / radius);
+			default:
+				return 1.0f;
+			}
+		}
+
+		// Source texels and weights of every output texel along one axis, padded to the same count
+		struct Taps {
+			int count = 0;
+			std::vector<int> indices;
+			std::vector<float> weights;
+		};
+
+		Taps computeTaps(MipFilter filter, int sourceSize, int size, bool wrap) {
+			float scale = (float)sourceSize / size;
+			float support = filterRadius(filter) * scale;
+			std::vector<std::vector<std::pair<int, float>>> all(size);
+			Taps taps;
+			for (int i = 0; i < size; i++) {
+				float center = (i + 0.5f) * scale - 0.5f;
+				float sum = 0.0f;
+				for (int j = (int)std::floor(center - support); j <= (int)std::ceil(center + support); j++) {
+					float weight = filterWeight(filter, (j - center) / scale);
+					if (weight == 0.0f)
+						continue;
+					int index = wrap ? ((j % sourceSize) + sourceSize) % sourceSize : std::clamp(j, 0, sourceSize - 1);
+					all[i].push_back({ index, weight });
+					sum += weight;
+				}
+				for (auto& tap : all[i])
+					tap.second /= sum;
+				taps.count = std::max(taps.count, (int)all[i].size());
+			}
+			// The padding repeats the first texel with no weight, which the darkest filter ignores too
+			for (int i = 0; i < size; i++) {
+				for (int k = 0; k < taps.count; k++) {
+					bool padding = k >= (int)all[i].size();
+					taps.indices.push_back(all[i][padding ? 0 : k].first);
+					taps.weights.push_back(padding ? 0.0f : all[i][k].second);
+				}
+			}
+			return taps;
+		}
+
+		uint8_t toByte(float value) {
+			return (uint8_t)std::clamp((int)std::lround(value), 0, 255);
+		}
+
+		// Weighted sum (or minimum) of source rows into floats
+		void filterColumns(const uint8_t* const* rows, const float* weights, int tapCount, bool darkest, size_t length,
+		                   float* out) {
+			size_t i = 0;
+#if defined(__SSE2__)
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= length; i += 16) {
+				__m128 sums[4];
+				for (int k = 0; k < tapCount; k++) {
+					__m128i bytes = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+					__m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+					__m128 values[4] = { _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)),
+					                     _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)) };
+					__m128 weight = _mm_set1_ps(weights[k]);
+					for (int q = 0; q < 4; q++) {
+						if (darkest)
+							sums[q] = k == 0 ? values[q] : _mm_min_ps(sums[q], values[q]);
+						else
+							sums[q] = k == 0 ? _mm_mul_ps(values[q], weight) : _mm_add_ps(sums[q], _mm_mul_ps(values[q], weight));
+					}
+				}
+				for (int q = 0; q < 4; q++)
+					_mm_storeu_ps(out + i + q * 4, sums[q]);
+			}
+#endif
+			for (; i < length; i++) {
+				float sum = darkest ? 255.0f : 0.0f;
+				for (int k = 0; k < tapCount; k++)
+					sum = darkest ? std::min(sum, (float)rows[k][i]) : sum + rows[k][i] * weights[k];
+				out[i] = sum;
+			}
+		}
+
+		// Weighted sum (or minimum) of the texels of a filtered row into an output row
+		void filterRow(const float* row, const Taps& taps, int channels, bool darkest, int size, uint8_t* out) {
+#if defined(__SSE2__)
+			if (channels == 4) {
+				for (int x = 0; x < size; x++) {
+					const int* indices = &taps.indices[(size_t)x * taps.count];
+					const float* weights = &taps.weights[(size_t)x * taps.count];
+					__m128 sum = _mm_loadu_ps(row + indices[0] * 4);
+					if (!darkest)
+						sum = _mm_mul_ps(sum, _mm_set1_ps(weights[0]));
+					for (int k = 1; k < taps.count; k++) {
+						__m128 texel = _mm_loadu_ps(row + indices[k] * 4);
+						sum = darkest ? _mm_min_ps(sum, texel) : _mm_add_ps(sum, _mm_mul_ps(texel, _mm_set1_ps(weights[k])));
+					}
+					// Rounded, then saturated to bytes
+					__m128i words = _mm_packs_epi32(_mm_cvtps_epi32(sum), _mm_setzero_si128());
+					*(int32_t*)(out + x * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+				}
+				return;
+			}
+#endif
+			for (int x = 0; x < size; x++) {
+				const int* indices = &taps.indices[(size_t)x * taps.count];
+				const float* weights = &taps.weights[(size_t)x * taps.count];
+				for (int c = 0; c < channels; c++) {
+					float sum = darkest ? 255.0f : 0.0f;
+					for (int k = 0; k < taps.count; k++) {
+						float value = row[indices[k] * channels + c];
+						sum = darkest ? std::min(sum, value) : sum + value * weights[k];
+					}
+					out[x * channels + c] = toByte(sum);
+				}
+			}
+		}
+	}
+
+	const char* mipFilterName(MipFilter filter) {
+		switch (filter) {
+		case MipFilter::KAISER: return "Kaiser";
+		case MipFilter::LANCZOS: return "Lanczos";
+		case MipFilter::DARKEST: return "darkest";
+		default: return "box";
+		}
+	}
+
+	bool parseMipFilter(const std::string& name, MipFilter& filter) {
+		const MipFilter filters[] = { MipFilter::BOX, MipFilter::KAISER, MipFilter::LANCZOS, MipFilter::DARKEST };
+		for (MipFilter candidate : filters) {
+			std::string candidateName = mipFilterName(candidate);
+			std::transform(candidateName.begin(), candidateName.end(), candidateName.begin(),
+			               [](unsigned char c) { return (char)std::tolower(c); });
+			if (candidateName == name) {
+				filter = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int mipLevelCount(int width, int height) {
+		int levels = 1;
+		while ((width | height) >> levels)
+			levels++;
+		return levels;
+	}
+
+	std::vector<std::vector<uint8_t>> generateMipmaps(const uint8_t* pixels, int width, int height, int channels,
+	                                                  MipFilter filter, ThreadPool* pool, bool wrap) {
+		std::vector<std::vector<uint8_t>> levels;
+		bool darkest = filter == MipFilter::DARKEST;
+		const uint8_t* source = pixels;
+		while (width > 1 || height > 1) {
+			int levelWidth = std::max(width / 2, 1), levelHeight = std::max(height / 2, 1);
+			Taps columns = computeTaps(filter, width, levelWidth, wrap);
+			Taps rows = computeTaps(filter, height, levelHeight, wrap);
+			std::vector<uint8_t> level((size_t)levelWidth * levelHeight * channels);
+
+			// A few output rows per task, each with its own row of floats
+			const int rowsPerTask = 16;
+			size_t taskCount = (levelHeight + rowsPerTask - 1) / rowsPerTask;
+			auto filterRows = [&](size_t task) {
+				std::vector<float> filtered((size_t)width * channels);
+				std::vector<const uint8_t*> sourceRows(rows.count);
+				int end = std::min((int)(task + 1) * rowsPerTask, levelHeight);
+				for (int y = (int)task * rowsPerTask; y < end; y++) {
+					for (int k = 0; k < rows.count; k++)
+						sourceRows[k] = source + (size_t)rows.indices[(size_t)y * rows.count + k] * width * channels;
+					filterColumns(sourceRows.data(), &rows.weights[(size_t)y * rows.count], rows.count, darkest, filtered.size(),
+					              filtered.data());
+					filterRow(filtered.data(), columns, channels, darkest, levelWidth, &level[(size_t)y * levelWidth * channels]);
+				}
+			};
+			if (pool)
+				pool->parallelFor(taskCount, filterRows);
+			else
+				for (size_t task = 0; task < taskCount; task++)
+					filterRows(task);
+
+			levels.push_back(std::move(level));
+			source = levels.back().data();
+			width = levelWidth;
+			height = levelHeight;
+		}
+		return levels;
+	}
+}
@@ -0,0 +1,341 @@
+#include <glengine/modelLibrary.hpp>
+#include <glengine/threadPool.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace GLEngine {
+	namespace {
+		typedef std::chrono::steady_clock Clock;
+
+		double millisecondsSince(Clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		const char indexMagic[8] = { 'G', 'L', 'M', 'L', 'I', 'B', '1', '\0' };
+
+		struct IndexHeader {
+			char magic[8];
+			uint32_t directoryLength;   // Followed by the directory, then the entries
+			uint32_t entryCount;
+		};
+
+		// After the path of the entry
+		struct IndexRecord {
+			uint64_t fileSize;
+			int64_t modifiedTime;
+			uint64_t vertexCount, normalCount, texCoordCount, faceCount, triangleCount;
+			float boundsMin[3];
+			float boundsMax[3];
+			uint32_t readable;
+		};
+
+		bool isBlank(char c) {
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		bool isObjFile(const std::string& name) {
+			if (name.size() <= 4)
+				return false;
+			std::string extension = name.substr(name.size() - 4);
+			for (char& c : extension)
+				c = (char)std::tolower((unsigned char)c);
+			return extension == ".obj";
+		}
+
+		// Absolute and normalized, so the same directory matches its index however it is written
+		std::string normalizedDirectory(const std::string& directory) {
+			std::error_code error;
+			std::filesystem::path path = std::filesystem::absolute(directory, error);
+			if (error)
+				path = directory;
+			return path.lexically_normal().generic_string();
+		}
+
+		// Counts the lines of [p, end), complete lines only
+		void scanLines(const char* p, const char* end, ModelInfo& info, glm::vec3& low, glm::vec3& high) {
+			while (p < end) {
+				const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+				if (!lineEnd)
+					lineEnd = end;
+				while (p < lineEnd && isBlank(*p))
+					p++;
+				if (lineEnd - p > 2 && p[0] == 'v' && isBlank(p[1])) {
+					float v[3];
+					const char* number = p + 1;
+					int read = 0;
+					for (; read < 3; read++) {
+						char* next;
+						v[read] = std::strtof(number, &next);
+						if (next == number || next > lineEnd)
+							break;
+						number = next;
+					}
+					if (read == 3) {
+						glm::vec3 position(v[0], v[1], v[2]);
+						low = glm::min(low, position);
+						high = glm::max(high, position);
+						info.vertexCount++;
+					}
+				}
+				else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+					info.normalCount++;
+				else if (lineEnd - p > 2 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+					info.texCoordCount++;
+				else if (lineEnd - p > 2 && p[0] == 'f' && isBlank(p[1])) {
+					// Corners, whatever their v/vt/vn form
+					int corners = 0;
+					for (const char* c = p + 1; c < lineEnd; c++)
+						corners += !isBlank(*c) && isBlank(c[-1]);
+					info.faceCount++;
+					info.triangleCount += corners >= 3 ? corners - 2 : 0;
+				}
+				p = lineEnd + 1;
+			}
+		}
+	}
+
+	bool ModelLibrary::scanObjFile(const std::string& file, ModelInfo& info) {
+		info.vertexCount = info.normalCount = info.texCoordCount = info.faceCount = info.triangleCount = 0;
+		info.bounds = AABB();
+		std::ifstream in(file, std::ios::binary);
+		info.readable = (bool)in;
+		if (!in)
+			return false;
+
+		glm::vec3 low(INFINITY), high(-INFINITY);
+		// A block plus a terminator, so number parsing stops at the end of the data
+		std::vector<char> buffer(((size_t)1 << 20) + 1);
+		size_t kept = 0;
+		while (true) {
+			// A line longer than the block
+			if (kept == buffer.size() - 1)
+				buffer.resize(2 * buffer.size() - 1);
+			in.read(buffer.data() + kept, buffer.size() - 1 - kept);
+			size_t size = kept + (size_t)in.gcount();
+			bool atEnd = !in;
+			buffer[size] = '\0';
+			// The last line of the block waits for the next one, unless the file ends there
+			size_t linesEnd = size;
+			if (!atEnd) {
+				const char* lastNewline = nullptr;
+				for (size_t i = size; i > 0 && !lastNewline; i--)
+					if (buffer[i - 1] == '\n')
+						lastNewline = &buffer[i - 1];
+				if (!lastNewline) {
+					kept = size;
+					continue;
+				}
+				linesEnd = lastNewline + 1 - buffer.data();
+			}
+			scanLines(buffer.data(), buffer.data() + linesEnd, info, low, high);
+			kept = size - linesEnd;
+			memmove(buffer.data(), buffer.data() + linesEnd, kept);
+			if (atEnd)
+				break;
+		}
+		if (info.vertexCount > 0) {
+			info.bounds.min = low;
+			info.bounds.max = high;
+		}
+		return true;
+	}
+
+	bool ModelLibrary::scan(const std::string& directory, const std::string& indexFile, ThreadPool* pool) {
+		Clock::time_point start = Clock::now();
+		stats = Stats();
+		models.clear();
+		std::filesystem::path root(directory);
+		std::error_code error;
+		if (!std::filesystem::is_directory(root, error))
+			return false;
+
+		// Listing, the directories of a level in parallel
+		struct Listing {
+			std::vector<ModelInfo> files;
+			std::vector<std::string> subdirectories;
+		};
+		std::vector<std::string> level(1, std::string());
+		while (!level.empty()) {
+			std::vector<Listing> listings(level.size());
+			auto listDirectory = [&](size_t d) {
+				std::error_code listError;
+				std::filesystem::directory_iterator entry(root / level[d], listError), end;
+				for (; !listError && entry != end; entry.increment(listError)) {
+					std::string name = entry->path().filename().string();
+					if (name.empty() || name[0] == '.')
+						continue;
+					std::string relative = level[d].empty() ? name : level[d] + "/" + name;
+					std::error_code entryError;
+					if (entry->is_directory(entryError)) {
+						// A link to a directory could loop
+						if (!entry->is_symlink(entryError))
+							listings[d].subdirectories.push_back(relative);
+					}
+					else if (isObjFile(name) && entry->is_regular_file(entryError)) {
+						ModelInfo info;
+						info.path = relative;
+						info.fileSize = entry->file_size(entryError);
+						info.modifiedTime = (int64_t)entry->last_write_time(entryError).time_since_epoch().count();
+						listings[d].files.push_back(std::move(info));
+					}
+				}
+			};
+			if (pool)
+				pool->parallelFor(level.size(), listDirectory);
+			else
+				for (size_t d = 0; d < level.size(); d++)
+					listDirectory(d);
+			stats.directories += level.size();
+			level.clear();
+			for (Listing& listing : listings) {
+				std::move(listing.files.begin(), listing.files.end(), std::back_inserter(models));
+				std::move(listing.subdirectories.begin(), listing.subdirectories.end(), std::back_inserter(level));
+			}
+		}
+		std::sort(models.begin(), models.end(), [](const ModelInfo& a, const ModelInfo& b) { return a.path < b.path; });
+		stats.files = models.size();
+		stats.listMs = millisecondsSince(start);
+
+		// Unchanged files keep their entry of the index (sorted by path too)
+		std::string normalized = normalizedDirectory(directory);
+		std::vector<ModelInfo> entries;
+		stats.indexLoaded = !indexFile.empty() && readIndex(indexFile, normalized, entries);
+		std::vector<size_t> pending;
+		size_t matched = 0;
+		auto entry = entries.begin();
+		for (size_t i = 0; i < models.size(); i++) {
+			ModelInfo& model = models[i];
+			while (entry != entries.end() && entry->path < model.path)
+				++entry;
+			if (entry != entries.end() && entry->path == model.path) {
+				matched++;
+				if (entry->fileSize == model.fileSize && entry->modifiedTime == model.modifiedTime) {
+					model = *entry;
+					continue;
+				}
+			}
+			pending.push_back(i);
+		}
+		stats.removed = entries.size() - matched;
+
+		// Largest first, so a big file doesn't start last
+		Clock::time_point scanStart = Clock::now();
+		std::sort(pending.begin(), pending.end(), [&](size_t a, size_t b) { return models[a].fileSize > models[b].fileSize; });
+		auto scanFile = [&](size_t k) {
+			ModelInfo& model = models[pending[k]];
+			scanObjFile((root / model.path).string(), model);
+		};
+		if (pool)
+			pool->parallelFor(pending.size(), scanFile);
+		else
+			for (size_t k = 0; k < pending.size(); k++)
+				scanFile(k);
+		stats.scanned = pending.size();
+		for (size_t i : pending)
+			stats.scannedBytes += models[i].fileSize;
+		stats.scanMs = millisecondsSince(scanStart);
+
+		if (!indexFile.empty() && (!stats.indexLoaded || stats.scanned > 0 || stats.removed > 0))
+			stats.indexWritten = writeIndex(indexFile, normalized);
+		stats.totalMs = millisecondsSince(start);
+		return true;
+	}
+
+	bool ModelLibrary::readIndex(const std::string& indexFile, const std::string& directory, std::vector<ModelInfo>& entries) {
+		std::ifstream in(indexFile, std::ios::binary | std::ios::ate);
+		if (!in)
+			return false;
+		uint64_t fileSize = (uint64_t)in.tellg();
+		in.seekg(0);
+		IndexHeader header;
+		if (fileSize < sizeof(header) + directory.size() || !in.read((char*)&header, sizeof(header))
+		    || memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0 || header.directoryLength != directory.size())
+			return false;
+		// Written for another directory
+		std::string indexDirectory(header.directoryLength, '\0');
+		if (!in.read(&indexDirectory[0], indexDirectory.size()) || indexDirectory != directory)
+			return false;
+
+		// A damaged count can't ask for more entries than the rest of the file holds, even with empty paths
+		uint64_t minimumEntry = sizeof(uint32_t) + sizeof(IndexRecord);
+		if (header.entryCount > (fileSize - sizeof(header) - directory.size()) / minimumEntry)
+			return false;
+		entries.resize(header.entryCount);
+		for (ModelInfo& entry : entries) {
+			uint32_t pathLength;
+			IndexRecord record;
+			if (!in.read((char*)&pathLength, sizeof(pathLength)) || pathLength > 4096) {
+				entries.clear();
+				return false;
+			}
+			entry.path.resize(pathLength);
+			if (!in.read(&entry.path[0], pathLength) || !in.read((char*)&record, sizeof(record))) {
+				entries.clear();
+				return false;
+			}
+			entry.fileSize = record.fileSize;
+			entry.modifiedTime = record.modifiedTime;
+			entry.vertexCount = record.vertexCount;
+			entry.normalCount = record.normalCount;
+			entry.texCoordCount = record.texCoordCount;
+			entry.faceCount = record.faceCount;
+			entry.triangleCount = record.triangleCount;
+			entry.bounds.min = glm::vec3(record.boundsMin[0], record.boundsMin[1], record.boundsMin[2]);
+			entry.bounds.max = glm::vec3(record.boundsMax[0], record.boundsMax[1], record.boundsMax[2]);
+			entry.readable = record.readable != 0;
+		}
+		if (!std::is_sorted(entries.begin(), entries.end(), [](const ModelInfo& a, const ModelInfo& b) { return a.path < b.path; })) {
+			entries.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool ModelLibrary::writeIndex(const std::string& indexFile, const std::string& directory) const {
+		std::error_code error;
+		std::filesystem::path parent = std::filesystem::path(indexFile).parent_path();
+		if (!parent.empty())
+			std::filesystem::create_directories(parent, error);
+		// Written aside then renamed, so a reader never sees half an index
+		std::string temporary = indexFile + ".tmp";
+		{
+			std::ofstream out(temporary, std::ios::binary);
+			IndexHeader header = {};
+			memcpy(header.magic, indexMagic, sizeof(header.magic));
+			header.directoryLength = (uint32_t)directory.size();
+			header.entryCount = (uint32_t)models.size();
+			out.write((const char*)&header, sizeof(header));
+			out.write(directory.data(), directory.size());
+			for (const ModelInfo& model : models) {
+				IndexRecord record = {};
+				record.fileSize = model.fileSize;
+				record.modifiedTime = model.modifiedTime;
+				record.vertexCount = model.vertexCount;
+				record.normalCount = model.normalCount;
+				record.texCoordCount = model.texCoordCount;
+				record.faceCount = model.faceCount;
+				record.triangleCount = model.triangleCount;
+				for (int c = 0; c < 3; c++) {
+					record.boundsMin[c] = model.bounds.min[c];
+					record.boundsMax[c] = model.bounds.max[c];
+				}
+				record.readable = model.readable;
+				uint32_t pathLength = (uint32_t)model.path.size();
+				out.write((const char*)&pathLength, sizeof(pathLength));
+				out.write(model.path.data(), pathLength);
+				out.write((const char*)&record, sizeof(record));
+			}
+			if (!out)
+				return false;
+		}
+		std::filesystem::rename(temporary, indexFile, error);
+		return !error;
+	}
+}
@@ -0,0 +1,468 @@
+#include <glengine/objClusterBuilder.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace GLEngine {
+	namespace {
+		typedef std::chrono::steady_clock Clock;
+
+		double millisecondsSince(Clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		const uint32_t invalidVertex = UINT32_MAX;
+		const uint64_t invalidKey = UINT64_MAX;
+		// Relative (negative) OBJ indices are stored from this value until the vertices before their block are known
+		const int64_t relativeBase = INT64_C(1) << 62;
+
+		// Triangle with everything its leaf needs, sorted by key (the Morton code of its centroid)
+		struct SoupTriangle {
+			uint64_t key;
+			uint32_t vertices[3];
+			float positions[9];
+			float normals[9];
+		};
+
+		bool operator<(const SoupTriangle& a, const SoupTriangle& b) {
+			if (a.key != b.key)
+				return a.key < b.key;
+			return std::lexicographical_compare(a.vertices, a.vertices + 3, b.vertices, b.vertices + 3);
+		}
+
+		// Lines of a block of the OBJ file: vertices as they come, faces cut into triangles
+		struct ObjBlock {
+			std::vector<char> text;
+			std::vector<float> positions;
+			std::vector<int64_t> corners;
+		};
+
+		bool isBlank(char c) {
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		void parseBlock(ObjBlock& block) {
+			const char* p = block.text.data();
+			const char* end = p + block.text.size();
+			std::vector<int64_t> face;
+			while (p < end) {
+				const char* lineEnd = std::find(p, end, '\n');
+				while (p < lineEnd && isBlank(*p))
+					p++;
+				if (lineEnd - p > 2 && p[0] == 'v' && isBlank(p[1])) {
+					float v[3];
+					const char* number = p + 1;
+					int read = 0;
+					for (; read < 3; read++) {
+						char* next;
+						v[read] = std::strtof(number, &next);
+						if (next == number || next > lineEnd)
+							break;
+						number = next;
+					}
+					if (read == 3)
+						block.positions.insert(block.positions.end(), v, v + 3);
+				}
+				else if (lineEnd - p > 2 && p[0] == 'f' && isBlank(p[1])) {
+					face.clear();
+					p++;
+					while (true) {
+						while (p < lineEnd && isBlank(*p))
+							p++;
+						if (p >= lineEnd)
+							break;
+						char* next;
+						long long index = std::strtoll(p, &next, 10);
+						if (next == p || index == 0)
+							break;
+						face.push_back(index > 0 ? std::min((int64_t)index - 1, (int64_t)invalidVertex)
+						                         : relativeBase + (int64_t)(block.positions.size() / 3) + index);
+						// Texture coordinates and normals after the slashes are skipped
+						p = next;
+						while (p < lineEnd && !isBlank(*p))
+							p++;
+					}
+					for (size_t i = 2; i < face.size(); i++)
+						block.corners.insert(block.corners.end(), { face[0], face[i - 1], face[i] });
+				}
+				p = lineEnd + 1;
+			}
+			block.text = std::vector<char>();
+		}
+
+		// Reads and writes arrays of records, counting the written bytes
+		class RecordFile {
+		public:
+			static bool write(std::ofstream& out, const void* data, size_t bytes, uint64_t& written) {
+				out.write((const char*)data, (std::streamsize)bytes);
+				written += bytes;
+				return (bool)out;
+			}
+			template<class T>
+			static size_t read(std::ifstream& in, std::vector<T>& records, size_t count) {
+				records.resize(count);
+				in.read((char*)records.data(), (std::streamsize)(count * sizeof(T)));
+				records.resize((size_t)in.gcount() / sizeof(T));
+				return records.size();
+			}
+		};
+
+		// Sorted run read through a buffer
+		struct RunReader {
+			std::ifstream in;
+			std::vector<SoupTriangle> buffer;
+			size_t position = 0;
+			size_t bufferSize = 0;
+
+			bool refill() {
+				position = 0;
+				return RecordFile::read(in, buffer, bufferSize) > 0;
+			}
+			bool hasNext() const { return position < buffer.size(); }
+		};
+
+		// Merges sorted runs into sink, in order
+		bool mergeRuns(const std::vector<std::string>& runs, size_t bufferTriangles,
+		               const std::function<bool(const SoupTriangle&)>& sink) {
+			std::vector<RunReader> readers(runs.size());
+			typedef std::pair<const SoupTriangle*, size_t> Head;
+			auto later = [](const Head& a, const Head& b) { return *b.first < *a.first; };
+			std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+			for (size_t i = 0; i < runs.size(); i++) {
+				readers[i].in.open(runs[i], std::ios::binary);
+				readers[i].bufferSize = std::max(bufferTriangles, (size_t)1);
+				if (!readers[i].in)
+					return false;
+				if (readers[i].refill())
+					heads.push({ &readers[i].buffer[0], i });
+			}
+			while (!heads.empty()) {
+				size_t run = heads.top().second;
+				heads.pop();
+				RunReader& reader = readers[run];
+				if (!sink(reader.buffer[reader.position]))
+					return false;
+				reader.position++;
+				if (reader.hasNext() || reader.refill())
+					heads.push({ &reader.buffer[reader.position], run });
+			}
+			return true;
+		}
+	}
+
+	bool buildClusterFileFromObj(const std::string& objPath, const std::string& path, ThreadPool& pool,
+	                             const ObjClusterSettings& settings, ObjClusterStats* statsOut, std::string& error) {
+		namespace fs = std::filesystem;
+		Clock::time_point start = Clock::now();
+		ObjClusterStats stats;
+		size_t memory = std::max(settings.memoryBytes, (size_t)16 << 20);
+		unsigned int concurrency = std::max(pool.getConcurrency(), 1u);
+
+		std::ifstream obj(objPath, std::ios::binary);
+		if (!obj) {
+			error = "Can't open " + objPath;
+			return false;
+		}
+		std::error_code fileError;
+		fs::path tempDirectory = fs::path(settings.tempDirectory.empty() ? fs::path(path).parent_path() : fs::path(settings.tempDirectory))
+		                       / (fs::path(path).filename().string() + ".tmp");
+		fs::create_directories(tempDirectory, fileError);
+		if (fileError) {
+			error = "Can't create " + tempDirectory.string();
+			return false;
+		}
+		std::string verticesPath = (tempDirectory / "vertices").string();
+		std::string trianglesPath = (tempDirectory / "triangles").string();
+		std::string soupPaths[2] = { (tempDirectory / "soup0").string(), (tempDirectory / "soup1").string() };
+		auto fail = [&](const std::string& message) {
+			error = message;
+			fs::remove_all(tempDirectory, fileError);
+			return false;
+		};
+
+		// Parsing: a few blocks read in turn, parsed together, their indices resolved in order
+		AABB bounds;
+		bool firstVertex = true;
+		{
+			Clock::time_point phase = Clock::now();
+			std::ofstream vertices(verticesPath, std::ios::binary | std::ios::trunc);
+			std::ofstream triangles(trianglesPath, std::ios::binary | std::ios::trunc);
+			size_t blockBytes = std::clamp(memory / (4 * concurrency), (size_t)1 << 20, (size_t)32 << 20);
+			std::vector<ObjBlock> blocks(concurrency);
+			std::vector<char> carry;
+			std::vector<uint32_t> resolved;
+			bool done = false;
+			while (!done) {
+				size_t blockCount = 0;
+				for (; blockCount < blocks.size() && !done; blockCount++) {
+					ObjBlock& block = blocks[blockCount];
+					block.positions.clear();
+					block.corners.clear();
+					block.text.swap(carry);
+					carry.clear();
+					size_t carried = block.text.size();
+					block.text.resize(carried + blockBytes);
+					obj.read(block.text.data() + carried, (std::streamsize)blockBytes);
+					block.text.resize(carried + (size_t)obj.gcount());
+					stats.objBytes += (uint64_t)obj.gcount();
+					// Cut after the last complete line, the rest goes to the next block
+					if (obj) {
+						auto lastLine = std::find(block.text.rbegin(), block.text.rend(), '\n').base();
+						carry.assign(lastLine, block.text.end());
+						block.text.erase(lastLine, block.text.end());
+					}
+					else
+						done = true;
+					block.text.push_back('\n');
+				}
+				pool.parallelFor(blockCount, [&](size_t i) { parseBlock(blocks[i]); });
+
+				for (size_t i = 0; i < blockCount; i++) {
+					ObjBlock& block = blocks[i];
+					resolved.resize(block.corners.size());
+					for (size_t c = 0; c < block.corners.size(); c++) {
+						int64_t index = block.corners[c];
+						if (index >= relativeBase / 2)
+							index = index - relativeBase + (int64_t)stats.vertices;
+						resolved[c] = index < 0 || index >= (int64_t)invalidVertex ? invalidVertex : (uint32_t)index;
+					}
+					for (size_t v = 0; v < block.positions.size(); v += 3) {
+						glm::vec3 position(block.positions[v], block.positions[v + 1], block.positions[v + 2]);
+						if (firstVertex)
+							bounds.min = bounds.max = position;
+						bounds.min = glm::min(bounds.min, position);
+						bounds.max = glm::max(bounds.max, position);
+						firstVertex = false;
+					}
+					stats.vertices += block.positions.size() / 3;
+					stats.triangles += resolved.size() / 3;
+					RecordFile::write(vertices, block.positions.data(), block.positions.size() * sizeof(float), stats.tempBytes);
+					RecordFile::write(triangles, resolved.data(), resolved.size() * sizeof(uint32_t), stats.tempBytes);
+				}
+			}
+			if (!vertices || !triangles)
+				return fail("Can't write the temporary files in " + tempDirectory.string());
+			stats.parseMs = millisecondsSince(phase);
+		}
+		if (stats.triangles == 0 || stats.vertices == 0)
+			return fail("No triangles in " + objPath);
+
+		// Positions then normals of the corners, for one chunk of vertices at a time: every pass
+		// reads the triangles of the previous one and writes them with what this chunk adds
+		Clock::time_point phase = Clock::now();
+		size_t chunkVertices = std::max(memory / 2 / sizeof(glm::vec3), (size_t)1);
+		size_t blockTriangles = std::max(memory / 8 / sizeof(SoupTriangle), (size_t)1024);
+		size_t taskTriangles = std::max(blockTriangles / (4 * concurrency), (size_t)256);
+		stats.vertexChunks = (int)((stats.vertices + chunkVertices - 1) / chunkVertices);
+		int soup = 0;
+		std::vector<SoupTriangle> block;
+		auto forEachTask = [&](const std::function<void(SoupTriangle&)>& work) {
+			pool.parallelFor((block.size() + taskTriangles - 1) / taskTriangles, [&](size_t task) {
+				size_t end = std::min((task + 1) * taskTriangles, block.size());
+				for (size_t t = task * taskTriangles; t < end; t++)
+					work(block[t]);
+			});
+		};
+		// One pass over the triangles, transformed by work, from the index file the first time
+		auto pass = [&](bool fromIndices, const std::function<void(SoupTriangle&)>& work) {
+			std::ifstream in(fromIndices ? trianglesPath : soupPaths[soup], std::ios::binary);
+			std::ofstream out(soupPaths[1 - soup], std::ios::binary | std::ios::trunc);
+			std::vector<uint32_t> indices;
+			while (true) {
+				if (fromIndices) {
+					if (RecordFile::read(in, indices, blockTriangles * 3) == 0)
+						break;
+					block.assign(indices.size() / 3, SoupTriangle());
+					for (size_t t = 0; t < block.size(); t++)
+						std::copy(&indices[3 * t], &indices[3 * t] + 3, block[t].vertices);
+				}
+				else if (RecordFile::read(in, block, blockTriangles) == 0)
+					break;
+				forEachTask(work);
+				RecordFile::write(out, block.data(), block.size() * sizeof(SoupTriangle), stats.tempBytes);
+			}
+			soup = 1 - soup;
+			return (bool)out;
+		};
+		// Triangles only read, each block given to work
+		auto scan = [&](const std::function<void()>& work) {
+			std::ifstream in(soupPaths[soup], std::ios::binary);
+			while (RecordFile::read(in, block, blockTriangles) > 0)
+				work();
+		};
+
+		std::vector<glm::vec3> chunk;
+		for (int c = 0; c < stats.vertexChunks; c++) {
+			size_t first = c * chunkVertices, count = std::min(chunkVertices, stats.vertices - first);
+			std::ifstream vertices(verticesPath, std::ios::binary);
+			vertices.seekg((std::streamoff)(first * sizeof(glm::vec3)));
+			RecordFile::read(vertices, chunk, count);
+			bool written = pass(c == 0, [&](SoupTriangle& triangle) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t vertex = triangle.vertices[k];
+					if (vertex >= stats.vertices)
+						triangle.key = invalidKey;
+					else if (vertex >= first && vertex - first < count)
+						std::copy(&chunk[vertex - first].x, &chunk[vertex - first].x + 3, &triangle.positions[3 * k]);
+				}
+			});
+			if (!written)
+				return fail("Can't write the temporary files in " + tempDirectory.string());
+		}
+
+		// Normals: the face normals are summed into a chunk of vertices, then written to its corners
+		std::vector<glm::vec3> faceNormals;
+		for (int c = 0; c < stats.vertexChunks; c++) {
+			size_t first = c * chunkVertices, count = std::min(chunkVertices, stats.vertices - first);
+			chunk.assign(count, glm::vec3(0.0f));
+			scan([&]() {
+				faceNormals.resize(block.size());
+				pool.parallelFor((block.size() + taskTriangles - 1) / taskTriangles, [&](size_t task) {
+					size_t end = std::min((task + 1) * taskTriangles, block.size());
+					for (size_t t = task * taskTriangles; t < end; t++) {
+						const float* p = block[t].positions;
+						glm::vec3 a(p[0], p[1], p[2]), b(p[3], p[4], p[5]), d(p[6], p[7], p[8]);
+						faceNormals[t] = glm::cross(d - a, d - b);
+					}
+				});
+				for (size_t t = 0; t < block.size(); t++) {
+					if (block[t].key == invalidKey)
+						continue;
+					for (int k = 0; k < 3; k++)
+						if (block[t].vertices[k] - first < count && block[t].vertices[k] >= first)
+							chunk[block[t].vertices[k] - first] += faceNormals[t];
+				}
+			});
+			bool last = c == stats.vertexChunks - 1;
+			bool written = pass(false, [&](SoupTriangle& triangle) {
+				if (triangle.key == invalidKey)
+					return;
+				for (int k = 0; k < 3; k++) {
+					uint32_t vertex = triangle.vertices[k];
+					if (vertex < first || vertex - first >= count)
+						continue;
+					glm::vec3 sum = chunk[vertex - first];
+					glm::vec3 normal = glm::length(sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+					std::copy(&normal.x, &normal.x + 3, &triangle.normals[3 * k]);
+				}
+				// Every corner is complete after the last chunk
+				if (last) {
+					const float* p = triangle.positions;
+					glm::vec3 centroid = (glm::vec3(p[0], p[1], p[2]) + glm::vec3(p[3], p[4], p[5]) + glm::vec3(p[6], p[7], p[8])) / 3.0f;
+					triangle.key = mortonCode(centroid, bounds);
+				}
+			});
+			if (!written)
+				return fail("Can't write the temporary files in " + tempDirectory.string());
+		}
+		chunk = std::vector<glm::vec3>();
+		faceNormals = std::vector<glm::vec3>();
+		stats.joinMs = millisecondsSince(phase);
+
+		// Sorted runs: half the memory sorted in parts by the workers, the parts merged in place
+		phase = Clock::now();
+		std::vector<std::string> runs;
+		{
+			size_t runTriangles = std::max(memory / 2 / sizeof(SoupTriangle), (size_t)1024);
+			std::ifstream in(soupPaths[soup], std::ios::binary);
+			std::vector<SoupTriangle> run;
+			while (RecordFile::read(in, run, runTriangles) > 0) {
+				size_t parts = std::min((size_t)concurrency, (run.size() + 1023) / 1024);
+				std::vector<size_t> partEnds(parts + 1);
+				for (size_t i = 0; i <= parts; i++)
+					partEnds[i] = run.size() * i / parts;
+				pool.parallelFor(parts, [&](size_t i) { std::sort(run.begin() + partEnds[i], run.begin() + partEnds[i + 1]); });
+				for (size_t width = 1; width < parts; width *= 2) {
+					pool.parallelFor((parts + 2 * width - 1) / (2 * width), [&](size_t i) {
+						size_t low = 2 * width * i, middle = std::min(low + width, parts), high = std::min(low + 2 * width, parts);
+						std::inplace_merge(run.begin() + partEnds[low], run.begin() + partEnds[middle], run.begin() + partEnds[high]);
+					});
+				}
+				runs.push_back((tempDirectory / ("run" + std::to_string(runs.size()))).string());
+				std::ofstream out(runs.back(), std::ios::binary | std::ios::trunc);
+				if (!RecordFile::write(out, run.data(), run.size() * sizeof(SoupTriangle), stats.tempBytes))
+					return fail("Can't write the temporary files in " + tempDirectory.string());
+			}
+		}
+		fs::remove(soupPaths[0], fileError);
+		fs::remove(soupPaths[1], fileError);
+		stats.sortRuns = (int)runs.size();
+
+		// Too many runs for a buffer of a megabyte each: merged by groups first
+		size_t bufferBytes = (size_t)1 << 20;
+		size_t fanIn = std::max(memory / 2 / bufferBytes, (size_t)2);
+		while (runs.size() > fanIn) {
+			std::vector<std::string> merged;
+			for (size_t first = 0; first < runs.size(); first += fanIn) {
+				std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fanIn, runs.size()));
+				merged.push_back((tempDirectory / ("merge" + std::to_string(stats.mergePasses) + "-" + std::to_string(merged.size()))).string());
+				std::ofstream out(merged.back(), std::ios::binary | std::ios::trunc);
+				std::vector<SoupTriangle> pending;
+				bool written = mergeRuns(group, bufferBytes / sizeof(SoupTriangle), [&](const SoupTriangle& triangle) {
+					pending.push_back(triangle);
+					if (pending.size() * sizeof(SoupTriangle) < bufferBytes)
+						return true;
+					bool ok = RecordFile::write(out, pending.data(), pending.size() * sizeof(SoupTriangle), stats.tempBytes);
+					pending.clear();
+					return ok;
+				});
+				if (!written || !RecordFile::write(out, pending.data(), pending.size() * sizeof(SoupTriangle), stats.tempBytes))
+					return fail("Can't write the temporary files in " + tempDirectory.string());
+				for (const std::string& run : group)
+					fs::remove(run, fileError);
+			}
+			runs = merged;
+			stats.mergePasses++;
+		}
+		stats.sortMs = millisecondsSince(phase);
+
+		// Last merge: consecutive triangles become the leaves, with their own vertices
+		phase = Clock::now();
+		ClusterWriter writer(path, settings.clusters);
+		if (!writer.isOpen())
+			return fail("Can't write " + path);
+		int maxTriangles = std::clamp(settings.clusters.maxTriangles, 64, 0xffff / 3);
+		ClusterGeometry leaf;
+		std::unordered_map<uint32_t, uint16_t> leafVertices;
+		bool merged = mergeRuns(runs, std::max(memory / 2 / std::max(runs.size(), (size_t)1), bufferBytes) / sizeof(SoupTriangle),
+		                        [&](const SoupTriangle& triangle) {
+			if (triangle.key == invalidKey) {
+				stats.droppedTriangles++;
+				return true;
+			}
+			for (int k = 0; k < 3; k++) {
+				auto found = leafVertices.emplace(triangle.vertices[k], (uint16_t)leaf.getVertexCount());
+				if (found.second) {
+					leaf.positions.insert(leaf.positions.end(), &triangle.positions[3 * k], &triangle.positions[3 * k] + 3);
+					leaf.normals.insert(leaf.normals.end(), &triangle.normals[3 * k], &triangle.normals[3 * k] + 3);
+				}
+				leaf.indices.push_back(found.first->second);
+			}
+			if ((int)leaf.getTriangleCount() == maxTriangles) {
+				writer.addLeaf(std::move(leaf));
+				leaf = ClusterGeometry();
+				leafVertices.clear();
+			}
+			return writer.isOpen();
+		});
+		if (!leaf.indices.empty())
+			writer.addLeaf(std::move(leaf));
+		bool written = merged && writer.finish();
+		stats.clusters = writer.getStats();
+		stats.buildMs = millisecondsSince(phase);
+		fs::remove_all(tempDirectory, fileError);
+		stats.totalMs = millisecondsSince(start);
+		if (statsOut)
+			*statsOut = stats;
+		if (!written) {
+			error = stats.clusters.leaves == 0 ? "No valid triangles in " + objPath : "Can't write " + path;
+			return false;
+		}
+		return true;
+	}
+}
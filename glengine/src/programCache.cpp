@@ -0,0 +1,279 @@
+#include <glengine/programCache.hpp>
+#include <glengine/glext.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace GLEngine {
+	namespace {
+		const char MAGIC[4] = { 'G', 'L', 'P', 'B' };
+		const uint32_t FORMAT_VERSION = 1;
+
+		// Header of a cache file, followed by the driver string then the binary
+		struct BinaryHeader {
+			char magic[4];
+			uint32_t version;
+			uint64_t key;
+			uint32_t binaryFormat;
+			uint32_t binaryLength;
+			uint32_t driverLength;
+		};
+
+		// 64-bit FNV-1a
+		uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 0x100000001b3ULL;
+			}
+			return hash;
+		}
+
+		uint64_t hashString(uint64_t hash, const std::string& text) {
+			// The length separates consecutive strings ("ab" + "c" != "a" + "bc")
+			uint64_t length = text.size();
+			hash = hashBytes(hash, &length, sizeof(length));
+			return hashBytes(hash, text.data(), text.size());
+		}
+
+		double millisecondsSince(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		std::string getString(GLenum name) {
+			const char* value = (const char*)glGetString(name);
+			return value ? value : "";
+		}
+	}
+
+	ProgramCache::ProgramCache(const std::string& directory)
+	: directory(directory), enabled(!directory.empty() && ext::hasProgramBinary()) {
+		driver = getString(GL_VENDOR) + "|" + getString(GL_RENDERER) + "|" + getString(GL_VERSION);
+		if (enabled) {
+			std::error_code error;
+			std::filesystem::create_directories(directory, error);
+			if (error)
+				enabled = false;
+		}
+	}
+
+	uint64_t ProgramCache::computeKey(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines) const {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		hash = hashString(hash, driver);
+		for (const ShaderStage& stage : stages) {
+			hash = hashBytes(hash, &stage.type, sizeof(stage.type));
+			hash = hashString(hash, stage.source);
+		}
+		for (const std::string& define : defines)
+			hash = hashString(hash, define);
+		return hash;
+	}
+
+	std::string ProgramCache::getPath(uint64_t key) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	GLuint ProgramCache::getProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines) {
+		lastError.clear();
+		uint64_t key = 0;
+		if (enabled) {
+			auto start = std::chrono::steady_clock::now();
+			key = computeKey(stages, defines);
+			GLuint program = loadBinary(key);
+			if (program) {
+				stats.loaded++;
+				stats.loadMs += millisecondsSince(start);
+				return program;
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		GLuint program = compileProgram(stages, defines, lastError, enabled);
+		if (program) {
+			stats.compiled++;
+			if (enabled)
+				storeBinary(key, program);
+		}
+		stats.compileMs += millisecondsSince(start);
+		return program;
+	}
+
+	GLuint ProgramCache::loadBinary(uint64_t key) {
+		std::string path = getPath(key);
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return 0;
+		uint64_t fileSize = (uint64_t)file.tellg();
+		file.seekg(0);
+
+		// The lengths are checked against the file before anything is allocated, so a corrupt or
+		// truncated file is a miss like any other and is deleted
+		BinaryHeader header;
+		bool valid = fileSize >= sizeof(header) && file.read((char*)&header, sizeof(header))
+		             && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == FORMAT_VERSION
+		             && header.key == key && header.binaryLength > 0
+		             && sizeof(header) + (uint64_t)header.driverLength + header.binaryLength == fileSize;
+		std::string fileDriver;
+		std::vector<char> binary;
+		if (valid) {
+			fileDriver.resize(header.driverLength);
+			binary.resize(header.binaryLength);
+			file.read(&fileDriver[0], fileDriver.size());
+			file.read(binary.data(), binary.size());
+			// A different driver with the same hash counts as corrupt too
+			valid = file && fileDriver == driver;
+		}
+		if (!valid) {
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(path, error);
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		ext::programBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			// Refused by the driver (internal change without a version bump): compiled again
+			glDeleteProgram(program);
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(path, error);
+			stats.rejected++;
+			return 0;
+		}
+		return program;
+	}
+
+	void ProgramCache::storeBinary(uint64_t key, GLuint program) {
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		GLenum binaryFormat = 0;
+		ext::getProgramBinary(program, length, nullptr, &binaryFormat, binary.data());
+
+		BinaryHeader header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = FORMAT_VERSION;
+		header.key = key;
+		header.binaryFormat = binaryFormat;
+		header.binaryLength = (uint32_t)length;
+		header.driverLength = (uint32_t)driver.size();
+
+		// Written aside then renamed, so another instance never reads a partial file
+		std::string path = getPath(key);
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write(driver.data(), driver.size());
+			file.write(binary.data(), binary.size());
+			if (!file)
+				return;
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+		if (!error)
+			stats.stored++;
+	}
+
+	void ProgramCache::clear() {
+		if (directory.empty())
+			return;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+			if (entry.path().extension() == ".bin")
+				std::filesystem::remove(entry.path(), error);
+	}
+
+	std::string ProgramCache::injectDefines(const std::string& source, const std::vector<std::string>& defines) {
+		if (defines.empty())
+			return source;
+		std::string block;
+		for (const std::string& define : defines)
+			block += "#define " + define + "\n";
+
+		// After the #version line, which has to come first
+		std::string result = source;
+		size_t insert = 0;
+		size_t version = result.find("#version");
+		if (version != std::string::npos) {
+			size_t end = result.find('\n', version);
+			if (end == std::string::npos) {
+				result += "\n";
+				end = result.size() - 1;
+			}
+			insert = end + 1;
+		}
+		// The line following the directive keeps its number in the error messages
+		int line = 1 + (int)std::count(result.begin(), result.begin() + insert, '\n');
+		block += "#line " + std::to_string(line) + "\n";
+		result.insert(insert, block);
+		return result;
+	}
+
+	GLuint ProgramCache::compileProgram(const std::vector<ShaderStage>& stages, const std::vector<std::string>& defines,
+	                                    std::string& error, bool retrievable) {
+		std::vector<GLuint> shaders;
+		bool compiled = true;
+		for (const ShaderStage& stage : stages) {
+			std::string source = injectDefines(stage.source, defines);
+			const char* code = source.c_str();
+			GLuint shader = glCreateShader(stage.type);
+			glShaderSource(shader, 1, &code, nullptr);
+			glCompileShader(shader);
+			shaders.push_back(shader);
+
+			GLint success = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				GLint length = 0;
+				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+				std::string log(length > 0 ? length : 1, '\0');
+				glGetShaderInfoLog(shader, (GLsizei)log.size(), nullptr, &log[0]);
+				error += "Compilation of " + stage.name + " failed:\n" + log.c_str() + "\n";
+				compiled = false;
+			}
+		}
+
+		GLuint program = 0;
+		if (compiled) {
+			program = glCreateProgram();
+			for (GLuint shader : shaders)
+				glAttachShader(program, shader);
+			if (retrievable)
+				ext::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(program);
+
+			GLint success = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			if (!success) {
+				GLint length = 0;
+				glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+				std::string log(length > 0 ? length : 1, '\0');
+				glGetProgramInfoLog(program, (GLsizei)log.size(), nullptr, &log[0]);
+				error += "Linking of";
+				for (const ShaderStage& stage : stages)
+					error += " " + stage.name;
+				error += std::string(" failed:\n") + log.c_str() + "\n";
+				glDeleteProgram(program);
+				program = 0;
+			}
+			else
+				for (GLuint shader : shaders)
+					glDetachShader(program, shader);
+		}
+		// The shaders are no longer needed once linked
+		for (GLuint shader : shaders)
+			glDeleteShader(shader);
+		return program;
+	}
+}
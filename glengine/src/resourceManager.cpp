@@ -0,0 +1,109 @@
+#include <glengine/resourceManager.hpp>
+#include <algorithm>
+
+namespace GLEngine {
+	ResourceManager::ResourceManager(size_t budget)
+	: frame(1) {
+		stats.budget = budget;
+	}
+
+	void ResourceManager::account(const Resource& resource, bool add) {
+		size_t& kindBytes = resource.kind == Kind::BUFFER ? stats.bufferBytes : stats.textureBytes;
+		if (add) {
+			kindBytes += resource.bytes;
+			stats.used += resource.bytes;
+			stats.resident++;
+			stats.peak = std::max(stats.peak, stats.used);
+		}
+		else {
+			kindBytes -= resource.bytes;
+			stats.used -= resource.bytes;
+			stats.resident--;
+		}
+	}
+
+	uint32_t ResourceManager::add(Kind kind, size_t bytes, Callbacks callbacks, bool resident) {
+		uint32_t id;
+		if (!freeIds.empty()) {
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else {
+			id = (uint32_t)resources.size();
+			resources.emplace_back();
+			resourceUsed.push_back(false);
+		}
+		Resource& resource = resources[id];
+		resource.kind = kind;
+		resource.bytes = bytes;
+		resource.lastUse = frame;
+		resource.resident = resident;
+		resource.callbacks = std::move(callbacks);
+		resourceUsed[id] = true;
+		if (resident)
+			account(resource, true);
+		stats.count++;
+		return id;
+	}
+
+	void ResourceManager::remove(uint32_t id) {
+		if (id >= resources.size() || !resourceUsed[id])
+			return;
+		if (resources[id].resident)
+			account(resources[id], false);
+		resources[id] = Resource();
+		resourceUsed[id] = false;
+		freeIds.push_back(id);
+		stats.count--;
+	}
+
+	bool ResourceManager::use(uint32_t id) {
+		Resource& resource = resources[id];
+		resource.lastUse = frame;
+		if (resource.resident)
+			return false;
+		resource.bytes = resource.callbacks.load();
+		resource.resident = true;
+		account(resource, true);
+		stats.reloads++;
+		return true;
+	}
+
+	void ResourceManager::resize(uint32_t id, size_t bytes) {
+		Resource& resource = resources[id];
+		if (resource.resident) {
+			account(resource, false);
+			resource.bytes = bytes;
+			account(resource, true);
+		}
+		else
+			resource.bytes = bytes;
+	}
+
+	void ResourceManager::evict(Resource& resource) {
+		resource.callbacks.unload();
+		account(resource, false);
+		resource.resident = false;
+		stats.evictions++;
+	}
+
+	void ResourceManager::endFrame() {
+		if (stats.used > stats.budget) {
+			std::vector<uint32_t> candidates;
+			for (uint32_t id = 0; id < resources.size(); id++) {
+				const Resource& resource = resources[id];
+				if (resourceUsed[id] && resource.resident && resource.lastUse < frame
+				    && !(resource.callbacks.busy && resource.callbacks.busy()))
+					candidates.push_back(id);
+			}
+			std::sort(candidates.begin(), candidates.end(),
+			          [this](uint32_t a, uint32_t b) { return resources[a].lastUse < resources[b].lastUse; });
+			for (uint32_t id : candidates) {
+				if (stats.used <= stats.budget)
+					break;
+				evict(resources[id]);
+			}
+		}
+		frame++;
+	}
+}
@@ -0,0 +1,284 @@
+#include <glengine/shaderReloader.hpp>
+#include <glengine/glext.hpp>
+#include <glengine/programCache.hpp>
+#include <glengine/shaderSource.hpp>
+#include <algorithm>
+
+namespace GLEngine {
+	namespace {
+		std::string getShaderLog(GLuint shader) {
+			GLint length = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+			std::string log(length > 0 ? length : 1, '\0');
+			glGetShaderInfoLog(shader, (GLsizei)log.size(), nullptr, &log[0]);
+			return log.c_str();
+		}
+
+		std::string getProgramLog(GLuint program) {
+			GLint length = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+			std::string log(length > 0 ? length : 1, '\0');
+			glGetProgramInfoLog(program, (GLsizei)log.size(), nullptr, &log[0]);
+			return log.c_str();
+		}
+	}
+
+	ShaderReloader::ShaderReloader(const std::string& directory, std::function<void()> makeWorkerContextCurrent)
+	: directory(directory), watcher(directory), reloadCount(0), stopping(false) {
+		if (ext::hasParallelShaderCompile()) {
+			mode = Mode::PARALLEL_COMPILE;
+			// As many driver threads as it wants
+			ext::maxShaderCompilerThreads(0xFFFFFFFF);
+		}
+		else if (makeWorkerContextCurrent) {
+			mode = Mode::WORKER_CONTEXT;
+			worker = std::thread(&ShaderReloader::workerLoop, this, makeWorkerContextCurrent);
+		}
+		else
+			mode = Mode::MAIN_THREAD;
+	}
+
+	ShaderReloader::~ShaderReloader() {
+		if (worker.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			condition.notify_all();
+			worker.join();
+		}
+		for (const Result& result : results)
+			glDeleteProgram(result.program);
+		for (const auto& entry : entries) {
+			if (entry->pendingProgram)
+				glDeleteProgram(entry->pendingProgram);
+			for (GLuint shader : entry->pendingShaders)
+				glDeleteShader(shader);
+		}
+	}
+
+	const char* ShaderReloader::getModeName(Mode mode) {
+		switch (mode) {
+			case Mode::PARALLEL_COMPILE: return "parallel shader compile";
+			case Mode::WORKER_CONTEXT: return "worker context";
+			case Mode::MAIN_THREAD: return "main thread";
+		}
+		return "";
+	}
+
+	void ShaderReloader::watch(GLuint* program, const std::vector<ShaderFile>& files, const std::vector<std::string>& defines) {
+		std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+		entry->program = program;
+		entry->files = files;
+		entry->defines = defines;
+		for (const ShaderFile& file : files)
+			entry->name += (entry->name.empty() ? "" : " + ") + file.name;
+		for (const std::string& define : defines)
+			entry->name += " [" + define + "]";
+		readSources(*entry);
+		entries.push_back(std::move(entry));
+	}
+
+	void ShaderReloader::unwatch(GLuint* program) {
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			Entry& entry = **it;
+			if (entry.program != program)
+				continue;
+			errors.erase(std::remove_if(errors.begin(), errors.end(), [&](const Error& error) { return error.program == entry.name; }),
+			             errors.end());
+			// A build in progress still refers to the entry, it is removed once finished
+			if (entry.building)
+				entry.program = nullptr;
+			else
+				entries.erase(it);
+			return;
+		}
+	}
+
+	int ShaderReloader::getPendingCount() const {
+		int pending = 0;
+		for (const auto& entry : entries)
+			if (entry->building)
+				pending++;
+		return pending;
+	}
+
+	std::vector<std::string> ShaderReloader::readSources(Entry& entry) const {
+		std::vector<std::string> sources;
+		entry.dependencies.clear();
+		for (const ShaderFile& file : entry.files) {
+			std::vector<std::string> files;
+			sources.push_back(loadShaderSource(directory + "/" + file.name, &files));
+			for (const std::string& path : files)
+				entry.dependencies.push_back(path.substr(path.find_last_of('/') + 1));
+		}
+		return sources;
+	}
+
+	void ShaderReloader::reloadAll() {
+		for (const auto& entry : entries) {
+			if (entry->building)
+				entry->dirty = true;
+			else if (entry->program)
+				startBuild(*entry);
+		}
+	}
+
+	void ShaderReloader::update() {
+		std::vector<std::string> changed = watcher.poll();
+		if (!changed.empty()) {
+			for (const auto& entry : entries) {
+				bool affected = false;
+				for (const std::string& file : entry->dependencies)
+					affected |= std::find(changed.begin(), changed.end(), file) != changed.end();
+				if (!affected || !entry->program)
+					continue;
+				if (entry->building)
+					entry->dirty = true;
+				else
+					startBuild(*entry);
+			}
+		}
+
+		if (mode == Mode::PARALLEL_COMPILE) {
+			// Backwards: a finished build may remove its entry
+			for (size_t i = entries.size(); i-- > 0; )
+				if (entries[i]->building)
+					pollParallelBuild(*entries[i]);
+		}
+		else if (mode == Mode::WORKER_CONTEXT) {
+			std::deque<Result> finished;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.swap(results);
+			}
+			for (const Result& result : finished)
+				finishBuild(*result.entry, result.program, result.log);
+		}
+	}
+
+	void ShaderReloader::startBuild(Entry& entry) {
+		entry.building = true;
+		entry.dirty = false;
+		std::vector<std::string> sources = readSources(entry);
+
+		if (mode == Mode::PARALLEL_COMPILE) {
+			// Everything is queued, nothing is queried until GL_COMPLETION_STATUS_KHR says so
+			entry.pendingProgram = glCreateProgram();
+			for (size_t i = 0; i < entry.files.size(); i++) {
+				std::string source = ProgramCache::injectDefines(sources[i], entry.defines);
+				const char* code = source.c_str();
+				GLuint shader = glCreateShader(entry.files[i].type);
+				glShaderSource(shader, 1, &code, nullptr);
+				glCompileShader(shader);
+				glAttachShader(entry.pendingProgram, shader);
+				entry.pendingShaders.push_back(shader);
+			}
+			glLinkProgram(entry.pendingProgram);
+		}
+		else if (mode == Mode::WORKER_CONTEXT) {
+			Job job;
+			job.entry = &entry;
+			job.sources = std::move(sources);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				jobs.push_back(std::move(job));
+			}
+			condition.notify_one();
+		}
+		else {
+			std::vector<ShaderStage> stages;
+			for (size_t i = 0; i < entry.files.size(); i++)
+				stages.push_back({ entry.files[i].type, sources[i], entry.files[i].name });
+			std::string log;
+			GLuint program = ProgramCache::compileProgram(stages, entry.defines, log);
+			finishBuild(entry, program, log);
+		}
+	}
+
+	void ShaderReloader::pollParallelBuild(Entry& entry) {
+		GLint completed = GL_FALSE;
+		glGetProgramiv(entry.pendingProgram, GL_COMPLETION_STATUS_KHR, &completed);
+		if (!completed)
+			return;
+
+		GLuint program = entry.pendingProgram;
+		std::string log;
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			for (size_t i = 0; i < entry.pendingShaders.size(); i++) {
+				GLint compiled = GL_FALSE;
+				glGetShaderiv(entry.pendingShaders[i], GL_COMPILE_STATUS, &compiled);
+				if (!compiled)
+					log += "Compilation of " + entry.files[i].name + " failed:\n" + getShaderLog(entry.pendingShaders[i]) + "\n";
+			}
+			log += "Linking failed:\n" + getProgramLog(program) + "\n";
+			glDeleteProgram(program);
+			program = 0;
+		}
+		else
+			for (GLuint shader : entry.pendingShaders)
+				glDetachShader(program, shader);
+		for (GLuint shader : entry.pendingShaders)
+			glDeleteShader(shader);
+		entry.pendingShaders.clear();
+		entry.pendingProgram = 0;
+		finishBuild(entry, program, log);
+	}
+
+	void ShaderReloader::finishBuild(Entry& entry, GLuint program, const std::string& log) {
+		entry.building = false;
+		// Unwatched meanwhile
+		if (!entry.program) {
+			glDeleteProgram(program);
+			entries.erase(std::find_if(entries.begin(), entries.end(), [&](const std::unique_ptr<Entry>& e) { return e.get() == &entry; }));
+			return;
+		}
+
+		auto error = std::find_if(errors.begin(), errors.end(), [&](const Error& e) { return e.program == entry.name; });
+		if (program) {
+			// Swapped between two frames, the old program is no longer used
+			glDeleteProgram(*entry.program);
+			*entry.program = program;
+			reloadCount++;
+			if (error != errors.end())
+				errors.erase(error);
+		}
+		else if (error != errors.end())
+			error->log = log;
+		else
+			errors.push_back({ entry.name, log });
+
+		if (entry.dirty)
+			startBuild(entry);
+	}
+
+	void ShaderReloader::workerLoop(std::function<void()> makeContextCurrent) {
+		makeContextCurrent();
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			// The entry is only read: its files and defines never change
+			std::vector<ShaderStage> stages;
+			for (size_t i = 0; i < job.entry->files.size(); i++)
+				stages.push_back({ job.entry->files[i].type, job.sources[i], job.entry->files[i].name });
+			Result result;
+			result.entry = job.entry;
+			result.program = ProgramCache::compileProgram(stages, job.entry->defines, result.log);
+			// Finished before the main context uses it
+			glFinish();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			results.push_back(std::move(result));
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#include <glengine/shaderSource.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace GLEngine {
+	namespace {
+		std::string directoryOf(const std::string& path) {
+			size_t slash = path.find_last_of('/');
+			return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+		}
+
+		void expand(const std::string& path, std::vector<std::string>& files, std::ostringstream& output) {
+			std::ifstream file(path);
+			if (!file.is_open()) {
+				output << "#error cannot open " << path << "\n";
+				return;
+			}
+			int fileIndex = (int)files.size();
+			files.push_back(path);
+
+			std::string line;
+			int lineNumber = 0;
+			while (std::getline(file, line)) {
+				lineNumber++;
+				size_t start = line.find_first_not_of(" \t");
+				if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+					output << line << "\n";
+					continue;
+				}
+
+				size_t open = line.find('"', start + 8);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos) {
+					output << "#error malformed #include in " << path << "\n";
+					continue;
+				}
+				std::string included = directoryOf(path) + line.substr(open + 1, close - open - 1);
+				// Already included: skipped, as if every file had an include guard
+				if (std::find(files.begin(), files.end(), included) == files.end()) {
+					output << "#line 1 " << files.size() << "\n";
+					expand(included, files, output);
+				}
+				output << "#line " << lineNumber + 1 << " " << fileIndex << "\n";
+			}
+		}
+	}
+
+	std::string loadShaderSource(const std::string& path, std::vector<std::string>* dependencies) {
+		std::vector<std::string> files;
+		std::ostringstream output;
+		expand(path, files, output);
+		if (dependencies)
+			*dependencies = files;
+		return output.str();
+	}
+}
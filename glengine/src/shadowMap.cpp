@@ -0,0 +1,217 @@
+#include <glengine/shadowMap.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace GLEngine {
+	namespace {
+		// Share of the logarithmic split in the cascade distances, the rest being uniform
+		const float SPLIT_LAMBDA = 0.75f;
+
+		glm::vec3 upVector(const glm::vec3& direction) {
+			return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+
+		void boxCorners(const AABB& box, glm::vec3 corners[8]) {
+			for (int i = 0; i < 8; i++)
+				corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+		}
+	}
+
+	ShadowMap::ShadowMap(int cascadeCount, int resolution)
+	: cascadeCount(std::clamp(cascadeCount, 1, MAX_CASCADES)), resolution(std::max(resolution, 1)),
+	  sceneVersion(0), renderCount(0), texture(0), framebuffer(0) {
+		allocate();
+	}
+
+	ShadowMap::~ShadowMap() {
+		release();
+	}
+
+	void ShadowMap::release() {
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteTextures(1, &texture);
+		framebuffer = texture = 0;
+	}
+
+	void ShadowMap::allocate() {
+		release();
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount, 0,
+		             GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+		// Hardware comparison, filtered over 2x2 texels
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		invalidate();
+	}
+
+	void ShadowMap::configure(int newCascadeCount, int newResolution) {
+		newCascadeCount = std::clamp(newCascadeCount, 1, MAX_CASCADES);
+		newResolution = std::max(newResolution, 1);
+		if (newCascadeCount == cascadeCount && newResolution == resolution)
+			return;
+		cascadeCount = newCascadeCount;
+		resolution = newResolution;
+		allocate();
+	}
+
+	void ShadowMap::invalidate() {
+		for (Cascade& cascade : cascades)
+			cascade.rendered = false;
+	}
+
+	size_t ShadowMap::getMemorySize() const {
+		return (size_t)resolution * resolution * cascadeCount * 4;
+	}
+
+	void ShadowMap::fitSingle(const glm::vec3& lightPos, const AABB& sceneBounds) {
+		glm::vec3 center = sceneBounds.getCenter();
+		float radius = std::max(glm::length(sceneBounds.getExtent()), 1e-3f);
+		float distance = glm::length(center - lightPos);
+		glm::vec3 direction = distance > 1e-4f ? (center - lightPos) / distance : glm::vec3(0.0f, -1.0f, 0.0f);
+
+		// The cone around the bounding sphere, or a wide view from inside it
+		float halfAngle, nearDistance;
+		if (distance > radius * 1.01f) {
+			halfAngle = std::asin(radius / distance);
+			nearDistance = std::max(distance - radius, distance * 0.01f);
+		}
+		else {
+			halfAngle = glm::radians(75.0f);
+			nearDistance = radius * 0.01f;
+		}
+		glm::mat4 view = glm::lookAt(lightPos, lightPos + direction, upVector(direction));
+		glm::mat4 projection = glm::perspective(2.0f * halfAngle, 1.0f, nearDistance, distance + radius);
+
+		Cascade& cascade = cascades[0];
+		cascade.viewProjection = projection * view;
+		cascade.splitDepth = 1e30f;
+		cascade.texelSize = 2.0f * std::max(distance, radius) * std::tan(halfAngle) / resolution;
+	}
+
+	void ShadowMap::fitCascades(const glm::vec3& lightPos, const AABB& sceneBounds, const glm::mat4& cameraView,
+	                            float fovY, float aspect, float nearPlane, float farPlane) {
+		glm::vec3 center = sceneBounds.getCenter();
+		glm::vec3 direction = center - lightPos;
+		direction = glm::length(direction) > 1e-4f ? glm::normalize(direction) : glm::vec3(0.0f, -1.0f, 0.0f);
+		// A rotation only, the same whatever the camera does
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, upVector(direction));
+
+		// Depth range of the casters along the light, and the farthest scene point seen by the camera
+		glm::vec3 corners[8];
+		boxCorners(sceneBounds, corners);
+		float minZ = INFINITY, maxZ = -INFINITY, sceneDepth = nearPlane;
+		for (const glm::vec3& corner : corners) {
+			float z = (lightView * glm::vec4(corner, 1.0f)).z;
+			minZ = std::min(minZ, z);
+			maxZ = std::max(maxZ, z);
+			sceneDepth = std::max(sceneDepth, -(cameraView * glm::vec4(corner, 1.0f)).z);
+		}
+		float margin = 0.01f * (maxZ - minZ) + 1e-3f;
+		float farthest = std::clamp(sceneDepth, nearPlane * 2.0f, farPlane);
+
+		glm::mat4 cameraToWorld = glm::inverse(cameraView);
+		float tanHalfY = std::tan(fovY * 0.5f), tanHalfX = tanHalfY * aspect;
+		float splitStart = nearPlane;
+		for (int i = 0; i < cascadeCount; i++) {
+			float t = (float)(i + 1) / cascadeCount;
+			float splitEnd = SPLIT_LAMBDA * nearPlane * std::pow(farthest / nearPlane, t)
+			               + (1.0f - SPLIT_LAMBDA) * (nearPlane + (farthest - nearPlane) * t);
+			if (i == cascadeCount - 1)
+				splitEnd = farPlane;
+
+			// Bounding sphere of the slice of the camera frustum: its radius does not change when the
+			// camera turns, so only the snapped center can move the cascade
+			glm::vec3 sliceCorners[8];
+			glm::vec3 sliceCenter(0.0f);
+			for (int c = 0; c < 8; c++) {
+				float depth = c & 4 ? std::min(splitEnd, farthest) : splitStart;
+				glm::vec4 cameraCorner((c & 1 ? 1.0f : -1.0f) * tanHalfX * depth, (c & 2 ? 1.0f : -1.0f) * tanHalfY * depth, -depth, 1.0f);
+				sliceCorners[c] = glm::vec3(cameraToWorld * cameraCorner);
+				sliceCenter += sliceCorners[c] / 8.0f;
+			}
+			float radius = 0.0f;
+			for (const glm::vec3& corner : sliceCorners)
+				radius = std::max(radius, glm::length(corner - sliceCenter));
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			float texelSize = 2.0f * radius / resolution;
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(sliceCenter, 1.0f));
+			lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+			lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+			glm::mat4 projection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius, lightCenter.y - radius, lightCenter.y + radius,
+			                                  -maxZ - margin, -minZ + margin);
+
+			Cascade& cascade = cascades[i];
+			cascade.viewProjection = projection * lightView;
+			cascade.splitDepth = splitEnd;
+			cascade.texelSize = texelSize;
+			splitStart = splitEnd;
+		}
+	}
+
+	unsigned int ShadowMap::prepare(const glm::vec3& lightPos, const AABB& sceneBounds, uint64_t version,
+	                                const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float farPlane) {
+		if (cascadeCount == 1)
+			fitSingle(lightPos, sceneBounds);
+		else
+			fitCascades(lightPos, sceneBounds, cameraView, fovY, aspect, nearPlane, farPlane);
+		sceneVersion = version;
+
+		unsigned int mask = 0;
+		for (int i = 0; i < cascadeCount; i++) {
+			const Cascade& cascade = cascades[i];
+			if (!cascade.rendered || cascade.renderedVersion != sceneVersion || cascade.renderedViewProjection != cascade.viewProjection)
+				mask |= 1u << i;
+		}
+		return mask;
+	}
+
+	void ShadowMap::beginCascade(int index) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, index);
+		glViewport(0, 0, resolution, resolution);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		Cascade& cascade = cascades[index];
+		cascade.renderedViewProjection = cascade.viewProjection;
+		cascade.renderedVersion = sceneVersion;
+		cascade.rendered = true;
+		renderCount++;
+	}
+
+	void ShadowMap::bind(GLuint program, int unit, bool enabled) const {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glActiveTexture(GL_TEXTURE0);
+		glUniform1i(glGetUniformLocation(program, "shadowMap"), unit);
+		glUniform1i(glGetUniformLocation(program, "shadowCascadeCount"), enabled ? cascadeCount : 0);
+		if (!enabled)
+			return;
+
+		glm::mat4 matrices[MAX_CASCADES];
+		glm::vec4 splits(1e30f), texelSizes(0.0f);
+		for (int i = 0; i < cascadeCount; i++) {
+			matrices[i] = cascades[i].viewProjection;
+			splits[i] = cascades[i].splitDepth;
+			texelSizes[i] = cascades[i].texelSize;
+		}
+		glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrices"), cascadeCount, GL_FALSE, glm::value_ptr(matrices[0]));
+		glUniform4fv(glGetUniformLocation(program, "shadowSplits"), 1, glm::value_ptr(splits));
+		glUniform4fv(glGetUniformLocation(program, "shadowTexelSizes"), 1, glm::value_ptr(texelSizes));
+	}
+}
@@ -0,0 +1,602 @@
+#include <glengine/textureCompression.hpp>
+#include <glengine/glext.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace GLEngine {
+	namespace {
+		// Texels of a block, one array per channel, from 0 to 255
+		struct Block {
+			alignas(16) float channels[4][16];
+		};
+
+		// Gray images are spread over RGB for the color formats, the scalar formats read the channels as they are
+		void readBlock(const uint8_t* pixels, int width, int height, int channels, int blockX, int blockY, bool expandGray,
+		               Block& block) {
+			for (int y = 0; y < 4; y++) {
+				int pixelY = std::min(blockY * 4 + y, height - 1);
+				for (int x = 0; x < 4; x++) {
+					int pixelX = std::min(blockX * 4 + x, width - 1);
+					const uint8_t* texel = pixels + ((size_t)pixelY * width + pixelX) * channels;
+					for (int c = 0; c < 4; c++) {
+						int source = expandGray && channels <= 2 ? (c < 3 ? 0 : 1) : c;
+						block.channels[c][y * 4 + x] = source < channels ? texel[source] : c == 3 ? 255.0f : texel[channels - 1];
+					}
+				}
+			}
+		}
+
+		// Nearest palette entry of every texel over channelCount channels, returns the squared error
+		float nearestIndices(const float* const* channels, int channelCount, const float (*palette)[4], int paletteSize,
+		                     uint8_t indices[16]) {
+			float error = 0.0f;
+#if defined(__SSE2__)
+			for (int group = 0; group < 16; group += 4) {
+				__m128 best = _mm_set1_ps(FLT_MAX);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (int p = 0; p < paletteSize; p++) {
+					__m128 distance = _mm_setzero_ps();
+					for (int c = 0; c < channelCount; c++) {
+						__m128 d = _mm_sub_ps(_mm_load_ps(channels[c] + group), _mm_set1_ps(palette[p][c]));
+						distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+					}
+					__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+					best = _mm_min_ps(distance, best);
+					bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+				}
+				alignas(16) float bestErrors[4];
+				alignas(16) int32_t bestIndices[4];
+				_mm_store_ps(bestErrors, best);
+				_mm_store_si128((__m128i*)bestIndices, bestIndex);
+				for (int i = 0; i < 4; i++) {
+					indices[group + i] = (uint8_t)bestIndices[i];
+					error += bestErrors[i];
+				}
+			}
+#else
+			for (int i = 0; i < 16; i++) {
+				float best = FLT_MAX;
+				for (int p = 0; p < paletteSize; p++) {
+					float distance = 0.0f;
+					for (int c = 0; c < channelCount; c++) {
+						float d = channels[c][i] - palette[p][c];
+						distance += d * d;
+					}
+					if (distance < best) {
+						best = distance;
+						indices[i] = (uint8_t)p;
+					}
+				}
+				error += best;
+			}
+#endif
+			return error;
+		}
+
+		// Extremes of the texels along their principal axis (power iteration on the covariance)
+		void principalEndpoints(const float* const* channels, int channelCount, float e0[4], float e1[4]) {
+			float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int c = 0; c < channelCount; c++) {
+				for (int i = 0; i < 16; i++)
+					mean[c] += channels[c][i];
+				mean[c] /= 16.0f;
+			}
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++)
+				for (int a = 0; a < channelCount; a++)
+					for (int b = 0; b < channelCount; b++)
+						covariance[a][b] += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+
+			float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			int widest = 0;
+			for (int c = 1; c < channelCount; c++)
+				if (covariance[c][c] > covariance[widest][widest])
+					widest = c;
+			axis[widest] = 1.0f;
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				float largest = 0.0f;
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++)
+						next[a] += covariance[a][b] * axis[b];
+					largest = std::max(largest, std::abs(next[a]));
+				}
+				if (largest < 1e-6f)
+					break;
+				for (int c = 0; c < channelCount; c++)
+					axis[c] = next[c] / largest;
+			}
+			float length = 0.0f;
+			for (int c = 0; c < channelCount; c++)
+				length += axis[c] * axis[c];
+			length = std::sqrt(length);
+			for (int c = 0; c < channelCount; c++)
+				axis[c] /= length;
+
+			float minT = FLT_MAX, maxT = -FLT_MAX;
+			for (int i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (int c = 0; c < channelCount; c++)
+					t += (channels[c][i] - mean[c]) * axis[c];
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+			for (int c = 0; c < channelCount; c++) {
+				e0[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+				e1[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+			}
+		}
+
+		// Endpoints minimizing the error of the texels for their weights (0 at e0, 1 at e1)
+		bool refitEndpoints(const float* const* channels, int channelCount, const float weights[16], float e0[4], float e1[4]) {
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < 16; i++) {
+				float a = 1.0f - weights[i], b = weights[i];
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (int c = 0; c < channelCount; c++) {
+					ax[c] += a * channels[c][i];
+					bx[c] += b * channels[c][i];
+				}
+			}
+			float determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f)
+				return false;
+			for (int c = 0; c < channelCount; c++) {
+				e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+				e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		uint16_t packRgb565(const float color[4]) {
+			int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+			int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+			int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+			return (uint16_t)(r << 11 | g << 5 | b);
+		}
+
+		void unpackRgb565(uint16_t packed, float color[4]) {
+			int r = packed >> 11, g = packed >> 5 & 63, b = packed & 31;
+			color[0] = (float)(r << 3 | r >> 2);
+			color[1] = (float)(g << 2 | g >> 4);
+			color[2] = (float)(b << 3 | b >> 2);
+			color[3] = 255.0f;
+		}
+
+		// Palette of a BC1 block, 4 colors when c0 > c1, else 3 and black
+		int bc1Palette(uint16_t c0, uint16_t c1, float palette[4][4]) {
+			unpackRgb565(c0, palette[0]);
+			unpackRgb565(c1, palette[1]);
+			for (int c = 0; c < 4; c++) {
+				if (c0 > c1) {
+					palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+					palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+				}
+				else {
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+					palette[3][c] = c == 3 ? 255.0f : 0.0f;
+				}
+			}
+			return c0 > c1 ? 4 : 3;
+		}
+
+		// Opaque BC1 block, always in 4 color mode (also the color half of BC3)
+		void encodeColorBlock(const Block& block, uint8_t* out) {
+			const float* channels[3] = { block.channels[0], block.channels[1], block.channels[2] };
+			float e0[4], e1[4];
+			principalEndpoints(channels, 3, e0, e1);
+
+			float bestError = FLT_MAX;
+			uint16_t bestC0 = 0, bestC1 = 0;
+			uint8_t bestIndices[16] = {};
+			for (int pass = 0; pass < 2; pass++) {
+				uint16_t c0 = packRgb565(e1), c1 = packRgb565(e0);
+				if (c0 < c1)
+					std::swap(c0, c1);
+				float palette[4][4];
+				bc1Palette(c0, c1, palette);
+				// Equal endpoints would select the 3 color mode: only the first entry is used
+				uint8_t indices[16];
+				float error = nearestIndices(channels, 3, palette, c0 > c1 ? 4 : 1, indices);
+				if (error < bestError) {
+					bestError = error;
+					bestC0 = c0;
+					bestC1 = c1;
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+				const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+					weights[i] = indexWeights[indices[i]];
+				if (c0 == c1 || !refitEndpoints(channels, 3, weights, e1, e0))
+					break;
+			}
+
+			out[0] = (uint8_t)bestC0;
+			out[1] = (uint8_t)(bestC0 >> 8);
+			out[2] = (uint8_t)bestC1;
+			out[3] = (uint8_t)(bestC1 >> 8);
+			uint32_t bits = 0;
+			for (int i = 0; i < 16; i++)
+				bits |= (uint32_t)bestIndices[i] << (2 * i);
+			std::memcpy(out + 4, &bits, 4);
+		}
+
+		// Palette of a BC4 block, 8 values when a0 > a1, else 6 values, 0 and 255
+		void bc4Palette(int a0, int a1, float palette[8][4]) {
+			palette[0][0] = (float)a0;
+			palette[1][0] = (float)a1;
+			if (a0 > a1)
+				for (int i = 2; i < 8; i++)
+					palette[i][0] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+			else {
+				for (int i = 2; i < 6; i++)
+					palette[i][0] = ((6 - i) * a0 + (i - 1) * a1) / 5.0f;
+				palette[6][0] = 0.0f;
+				palette[7][0] = 255.0f;
+			}
+		}
+
+		// One channel in 8 bytes: BC4, the alpha of BC3 and each half of BC5
+		void encodeScalarBlock(const Block& block, int channel, uint8_t* out) {
+			const float* channels[1] = { block.channels[channel] };
+			float low = 255.0f, high = 0.0f;
+			for (int i = 0; i < 16; i++) {
+				low = std::min(low, channels[0][i]);
+				high = std::max(high, channels[0][i]);
+			}
+
+			float bestError = FLT_MAX;
+			int bestA0 = 0, bestA1 = 0;
+			uint8_t bestIndices[16] = {};
+			for (int pass = 0; pass < 2; pass++) {
+				int a0 = (int)std::lround(high), a1 = (int)std::lround(low);
+				if (a0 < a1)
+					std::swap(a0, a1);
+				float palette[8][4];
+				bc4Palette(a0, a1, palette);
+				uint8_t indices[16];
+				float error = nearestIndices(channels, 1, palette, a0 > a1 ? 8 : 1, indices);
+				if (error < bestError) {
+					bestError = error;
+					bestA0 = a0;
+					bestA1 = a1;
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+					weights[i] = indices[i] == 0 ? 0.0f : indices[i] == 1 ? 1.0f : (indices[i] - 1) / 7.0f;
+				float e0[4] = { high }, e1[4] = { low };
+				if (a0 == a1 || !refitEndpoints(channels, 1, weights, e0, e1))
+					break;
+				high = e0[0];
+				low = e1[0];
+			}
+
+			out[0] = (uint8_t)bestA0;
+			out[1] = (uint8_t)bestA1;
+			uint64_t bits = 0;
+			for (int i = 0; i < 16; i++)
+				bits |= (uint64_t)bestIndices[i] << (3 * i);
+			for (int i = 0; i < 6; i++)
+				out[2 + i] = (uint8_t)(bits >> (8 * i));
+		}
+
+		const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct BitWriter {
+			uint8_t* out;
+			int position = 0;
+			void write(uint32_t value, int bits) {
+				for (int i = 0; i < bits; i++, position++)
+					if (value >> i & 1)
+						out[position >> 3] |= (uint8_t)(1 << (position & 7));
+			}
+		};
+
+		struct BitReader {
+			const uint8_t* in;
+			int position = 0;
+			uint32_t read(int bits) {
+				uint32_t value = 0;
+				for (int i = 0; i < bits; i++, position++)
+					value |= (uint32_t)(in[position >> 3] >> (position & 7) & 1) << i;
+				return value;
+			}
+		};
+
+		// Endpoint of BC7 mode 6: 7 bits per channel and a shared low bit, chosen for the lower error
+		void quantizeBc7Endpoint(const float endpoint[4], int quantized[4], int& pBit) {
+			float bestError = FLT_MAX;
+			for (int p = 0; p < 2; p++) {
+				float error = 0.0f;
+				int candidate[4];
+				for (int c = 0; c < 4; c++) {
+					candidate[c] = std::clamp((int)std::lround((endpoint[c] - p) / 2.0f), 0, 127);
+					float d = (float)(candidate[c] << 1 | p) - endpoint[c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					pBit = p;
+					std::memcpy(quantized, candidate, sizeof(candidate));
+				}
+			}
+		}
+
+		void bc7Palette(const int q0[4], int p0, const int q1[4], int p1, float palette[16][4]) {
+			for (int c = 0; c < 4; c++) {
+				int e0 = q0[c] << 1 | p0, e1 = q1[c] << 1 | p1;
+				for (int i = 0; i < 16; i++)
+					palette[i][c] = (float)(((64 - bc7Weights[i]) * e0 + bc7Weights[i] * e1 + 32) >> 6);
+			}
+		}
+
+		// BC7 mode 6: one RGBA line with 16 steps, the whole block in a single subset
+		void encodeBc7Block(const Block& block, uint8_t* out) {
+			const float* channels[4] = { block.channels[0], block.channels[1], block.channels[2], block.channels[3] };
+			float e0[4], e1[4];
+			principalEndpoints(channels, 4, e0, e1);
+
+			float bestError = FLT_MAX;
+			int bestQ0[4] = {}, bestQ1[4] = {}, bestP0 = 0, bestP1 = 0;
+			uint8_t bestIndices[16] = {};
+			for (int pass = 0; pass < 2; pass++) {
+				int q0[4], q1[4], p0, p1;
+				quantizeBc7Endpoint(e0, q0, p0);
+				quantizeBc7Endpoint(e1, q1, p1);
+				float palette[16][4];
+				bc7Palette(q0, p0, q1, p1, palette);
+				uint8_t indices[16];
+				float error = nearestIndices(channels, 4, palette, 16, indices);
+				if (error < bestError) {
+					bestError = error;
+					std::memcpy(bestQ0, q0, sizeof(q0));
+					std::memcpy(bestQ1, q1, sizeof(q1));
+					bestP0 = p0;
+					bestP1 = p1;
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+				float weights[16];
+				for (int i = 0; i < 16; i++)
+					weights[i] = bc7Weights[indices[i]] / 64.0f;
+				if (!refitEndpoints(channels, 4, weights, e0, e1))
+					break;
+			}
+
+			// The high bit of the first index is implicit (0): the endpoints are swapped otherwise
+			if (bestIndices[0] >= 8) {
+				std::swap(bestQ0, bestQ1);
+				std::swap(bestP0, bestP1);
+				for (uint8_t& index : bestIndices)
+					index = (uint8_t)(15 - index);
+			}
+			std::memset(out, 0, 16);
+			BitWriter writer{ out };
+			writer.write(1 << 6, 7);
+			for (int c = 0; c < 4; c++) {
+				writer.write(bestQ0[c], 7);
+				writer.write(bestQ1[c], 7);
+			}
+			writer.write(bestP0, 1);
+			writer.write(bestP1, 1);
+			for (int i = 0; i < 16; i++)
+				writer.write(bestIndices[i], i == 0 ? 3 : 4);
+		}
+
+		void decodeColorBlock(const uint8_t* in, uint8_t texels[16][4]) {
+			uint16_t c0 = (uint16_t)(in[0] | in[1] << 8), c1 = (uint16_t)(in[2] | in[3] << 8);
+			float palette[4][4];
+			bc1Palette(c0, c1, palette);
+			uint32_t bits;
+			std::memcpy(&bits, in + 4, 4);
+			for (int i = 0; i < 16; i++)
+				for (int c = 0; c < 3; c++)
+					texels[i][c] = (uint8_t)std::lround(palette[bits >> (2 * i) & 3][c]);
+		}
+
+		void decodeScalarBlock(const uint8_t* in, uint8_t texels[16][4], int channel) {
+			float palette[8][4];
+			bc4Palette(in[0], in[1], palette);
+			uint64_t bits = 0;
+			for (int i = 0; i < 6; i++)
+				bits |= (uint64_t)in[2 + i] << (8 * i);
+			for (int i = 0; i < 16; i++)
+				texels[i][channel] = (uint8_t)std::lround(palette[bits >> (3 * i) & 7][0]);
+		}
+
+		void decodeBc7Block(const uint8_t* in, uint8_t texels[16][4]) {
+			BitReader reader{ in };
+			if (reader.read(7) != 1 << 6) {
+				std::memset(texels, 0, 16 * 4);
+				return;
+			}
+			int q0[4], q1[4];
+			for (int c = 0; c < 4; c++) {
+				q0[c] = (int)reader.read(7);
+				q1[c] = (int)reader.read(7);
+			}
+			int p0 = (int)reader.read(1), p1 = (int)reader.read(1);
+			float palette[16][4];
+			bc7Palette(q0, p0, q1, p1, palette);
+			for (int i = 0; i < 16; i++) {
+				uint32_t index = reader.read(i == 0 ? 3 : 4);
+				for (int c = 0; c < 4; c++)
+					texels[i][c] = (uint8_t)palette[index][c];
+			}
+		}
+	}
+
+	const char* blockFormatName(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return "BC1";
+		case BlockFormat::BC3: return "BC3";
+		case BlockFormat::BC4: return "BC4";
+		case BlockFormat::BC5: return "BC5";
+		case BlockFormat::BC7: return "BC7";
+		default: return "uncompressed";
+		}
+	}
+
+	int blockBytes(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1:
+		case BlockFormat::BC4:
+			return 8;
+		case BlockFormat::NONE:
+			return 0;
+		default:
+			return 16;
+		}
+	}
+
+	size_t compressedSize(BlockFormat format, int width, int height) {
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+	}
+
+	int blockFormatChannels(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return 3;
+		case BlockFormat::BC4: return 1;
+		case BlockFormat::BC5: return 2;
+		default: return 4;
+		}
+	}
+
+	BlockFormat defaultBlockFormat(int channels, bool bc7) {
+		if (channels == 1)
+			return BlockFormat::BC4;
+		if (channels == 2)
+			return BlockFormat::BC5;
+		if (bc7)
+			return BlockFormat::BC7;
+		return channels == 3 ? BlockFormat::BC1 : BlockFormat::BC3;
+	}
+
+	std::vector<uint8_t> compressImage(const uint8_t* pixels, int width, int height, int channels, BlockFormat format,
+	                                   ThreadPool* pool) {
+		int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		int bytes = blockBytes(format);
+		std::vector<uint8_t> blocks(compressedSize(format, width, height));
+		auto encodeRow = [&](size_t blockY) {
+			Block block;
+			for (int blockX = 0; blockX < blocksX; blockX++) {
+				readBlock(pixels, width, height, channels, blockX, (int)blockY, format != BlockFormat::BC4 && format != BlockFormat::BC5, block);
+				uint8_t* out = &blocks[(blockY * blocksX + blockX) * bytes];
+				switch (format) {
+				case BlockFormat::BC1:
+					encodeColorBlock(block, out);
+					break;
+				case BlockFormat::BC3:
+					encodeScalarBlock(block, 3, out);
+					encodeColorBlock(block, out + 8);
+					break;
+				case BlockFormat::BC4:
+					encodeScalarBlock(block, 0, out);
+					break;
+				case BlockFormat::BC5:
+					encodeScalarBlock(block, 0, out);
+					encodeScalarBlock(block, 1, out + 8);
+					break;
+				case BlockFormat::BC7:
+					encodeBc7Block(block, out);
+					break;
+				default:
+					break;
+				}
+			}
+		};
+		if (pool)
+			pool->parallelFor(blocksY, encodeRow);
+		else
+			for (int blockY = 0; blockY < blocksY; blockY++)
+				encodeRow(blockY);
+		return blocks;
+	}
+
+	std::vector<uint8_t> decompressImage(const uint8_t* blocks, int width, int height, BlockFormat format) {
+		int channels = blockFormatChannels(format);
+		int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		int bytes = blockBytes(format);
+		std::vector<uint8_t> pixels((size_t)width * height * channels);
+		for (int blockY = 0; blockY < blocksY; blockY++) {
+			for (int blockX = 0; blockX < blocksX; blockX++) {
+				const uint8_t* in = blocks + ((size_t)blockY * blocksX + blockX) * bytes;
+				uint8_t texels[16][4] = {};
+				switch (format) {
+				case BlockFormat::BC1:
+					decodeColorBlock(in, texels);
+					break;
+				case BlockFormat::BC3:
+					decodeScalarBlock(in, texels, 3);
+					decodeColorBlock(in + 8, texels);
+					break;
+				case BlockFormat::BC4:
+					decodeScalarBlock(in, texels, 0);
+					break;
+				case BlockFormat::BC5:
+					decodeScalarBlock(in, texels, 0);
+					decodeScalarBlock(in + 8, texels, 1);
+					break;
+				case BlockFormat::BC7:
+					decodeBc7Block(in, texels);
+					break;
+				default:
+					break;
+				}
+				for (int y = 0; y < 4 && blockY * 4 + y < height; y++)
+					for (int x = 0; x < 4 && blockX * 4 + x < width; x++)
+						std::memcpy(&pixels[((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * channels], texels[y * 4 + x], channels);
+			}
+		}
+		return pixels;
+	}
+
+	double computePsnr(const uint8_t* reference, int referenceChannels, const uint8_t* image, int imageChannels,
+	                   size_t pixelCount) {
+		int channels = std::min(referenceChannels, imageChannels);
+		double squared = 0.0;
+		for (size_t i = 0; i < pixelCount; i++) {
+			for (int c = 0; c < channels; c++) {
+				double d = (double)reference[i * referenceChannels + c] - image[i * imageChannels + c];
+				squared += d * d;
+			}
+		}
+		if (squared == 0.0)
+			return INFINITY;
+		double mse = squared / ((double)pixelCount * channels);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	GLenum compressedInternalFormat(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default: return 0;
+		}
+	}
+
+	bool isBlockFormatSupported(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1:
+		case BlockFormat::BC3:
+			return ext::hasTextureCompressionS3tc();
+		case BlockFormat::BC7:
+			return ext::hasTextureCompressionBptc();
+		default:
+			return true;
+		}
+	}
+}
@@ -0,0 +1,268 @@
+#include <glengine/textureStreamer.hpp>
+#include <glengine/mipmapGenerator.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace GLEngine {
+	namespace {
+		size_t mipChainBytes(const DecodedImage& image) {
+			size_t bytes = 0;
+			for (int level = 0; level < mipLevelCount(image.width, image.height); level++)
+				bytes += (size_t)std::max(image.width >> level, 1) * std::max(image.height >> level, 1) * image.channels;
+			return bytes;
+		}
+
+		int levelWidth(const DecodedImage& image, int level) {
+			return std::max(image.width >> level, 1);
+		}
+
+		int levelHeight(const DecodedImage& image, int level) {
+			return std::max(image.height >> level, 1);
+		}
+
+		const unsigned char* levelPixels(const DecodedImage& image, int level) {
+			return level == 0 ? image.pixels.data() : image.mipLevels[level - 1].data();
+		}
+	}
+
+	GLint textureInternalFormat(int channels) {
+		const GLint formats[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+		return formats[std::clamp(channels, 1, 4) - 1];
+	}
+
+	GLenum textureFormat(int channels) {
+		const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		return formats[std::clamp(channels, 1, 4) - 1];
+	}
+
+	void setTextureSwizzle(GLenum target, int channels) {
+		const GLint gray[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		const GLint grayAlpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+		const GLint identity[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, channels == 1 ? gray : channels == 2 ? grayAlpha : identity);
+	}
+
+	TextureStreamer::TextureStreamer(ThreadPool& pool, Decoder decoder, size_t slotBytes, int slotCount)
+	: pool(pool), decoder(std::move(decoder)), slotBytes(std::max(slotBytes, (size_t)4096)) {
+		slots.resize(std::max(slotCount, 1));
+		for (Slot& slot : slots) {
+			glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, this->slotBytes, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	TextureStreamer::~TextureStreamer() {
+		release();
+	}
+
+	void TextureStreamer::release() {
+		for (Slot& slot : slots) {
+			if (slot.fence)
+				glDeleteSync(slot.fence);
+			glDeleteBuffers(1, &slot.buffer);
+		}
+		slots.clear();
+	}
+
+	GLuint TextureStreamer::request(const std::string& path) {
+		// Placeholder: one gray texel until the image is there
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		const unsigned char gray[4] = { 128, 128, 128, 255 };
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		Job job;
+		job.texture = texture;
+		Decoder decode = decoder;
+		job.decoding = pool.submit([decode, path]() {
+			std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+			if (!decode(path, *image) || image->width <= 0 || image->height <= 0 || image->channels < 1 || image->channels > 4)
+				return std::shared_ptr<DecodedImage>();
+			return image;
+		});
+		decoding.push_back(std::move(job));
+		pending.insert(texture);
+		stats.requested++;
+		return texture;
+	}
+
+	std::vector<TextureStreamer::Completed> TextureStreamer::takeCompleted() {
+		std::vector<TextureStreamer::Completed> done;
+		done.swap(completed);
+		return done;
+	}
+
+	bool TextureStreamer::isFree(Slot& slot) {
+		if (!slot.fence)
+			return true;
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			return false;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		return true;
+	}
+
+	void TextureStreamer::fillSlot(Slot& slot) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		// The fence guarantees the GPU is done with the previous content
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotBytes,
+		                                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!mapped)
+			return;
+
+		// As many rows as fit, possibly from several levels and images
+		std::vector<Band> bands;
+		size_t used = 0;
+		for (Job& job : uploading) {
+			const DecodedImage& image = *job.image;
+			while (job.level >= 0) {
+				int width = levelWidth(image, job.level), height = levelHeight(image, job.level);
+				size_t rowBytes = (size_t)width * image.channels;
+				int rows = std::min(height - job.nextRow, (int)((slotBytes - used) / rowBytes));
+				if (rows <= 0)
+					break;
+				std::memcpy(mapped + used, levelPixels(image, job.level) + (size_t)job.nextRow * rowBytes, rows * rowBytes);
+				bands.push_back({ &job, job.level, job.nextRow, rows, used });
+				job.nextRow += rows;
+				used += rows * rowBytes;
+				if (job.nextRow < height)
+					break;
+				job.level--;
+				job.nextRow = 0;
+			}
+			if (job.level >= 0)
+				break;
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		for (const Band& band : bands) {
+			const DecodedImage& image = *band.job->image;
+			int width = levelWidth(image, band.level);
+			glBindTexture(GL_TEXTURE_2D, band.job->texture);
+			glTexSubImage2D(GL_TEXTURE_2D, band.level, 0, band.firstRow, width, band.rowCount, textureFormat(image.channels),
+			                GL_UNSIGNED_BYTE, (const void*)band.offset);
+			// A complete level is shown at once, the larger ones follow
+			if (!image.mipLevels.empty() && band.firstRow + band.rowCount == levelHeight(image, band.level))
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, band.level);
+		}
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		stats.uploadedBytes += used;
+
+		while (!uploading.empty() && uploading.front().level < 0) {
+			finish(uploading.front());
+			uploading.pop_front();
+		}
+	}
+
+	void TextureStreamer::finish(const Job& job) {
+		Completed done = { job.texture, mipChainBytes(*job.image), false };
+		if (job.image->mipLevels.empty()) {
+			mipQueue.push_back(done);
+			return;
+		}
+		pending.erase(job.texture);
+		completed.push_back(done);
+		stats.completed++;
+	}
+
+	void TextureStreamer::update() {
+		auto start = std::chrono::steady_clock::now();
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		// Uploaded during the previous frame: mipmaps, then the image replaces the placeholder
+		for (const Completed& done : mipQueue) {
+			glBindTexture(GL_TEXTURE_2D, done.texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			pending.erase(done.texture);
+			completed.push_back(done);
+			stats.completed++;
+		}
+		mipQueue.clear();
+
+		// Decoded images get their storage. Until they are complete, only their last mip level
+		// (1x1, the placeholder color) is shown.
+		for (auto it = decoding.begin(); it != decoding.end();) {
+			if (it->decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+			Job job = std::move(*it);
+			it = decoding.erase(it);
+			job.image = job.decoding.get();
+			if (!job.image) {
+				pending.erase(job.texture);
+				completed.push_back({ job.texture, 4, true });
+				stats.failed++;
+				continue;
+			}
+
+			const DecodedImage& image = *job.image;
+			int levels = mipLevelCount(image.width, image.height);
+			bool hasMipLevels = levels > 1 && (int)image.mipLevels.size() == levels - 1;
+			if (!hasMipLevels)
+				job.image->mipLevels.clear();
+			GLint internalFormat = textureInternalFormat(image.channels);
+			GLenum format = textureFormat(image.channels);
+			glBindTexture(GL_TEXTURE_2D, job.texture);
+			for (int level = 0; level < levels; level++)
+				glTexImage2D(GL_TEXTURE_2D, level, internalFormat, std::max(image.width >> level, 1), std::max(image.height >> level, 1), 0,
+				             format, GL_UNSIGNED_BYTE, nullptr);
+			const unsigned char gray[4] = { 128, 128, 128, 255 };
+			glTexSubImage2D(GL_TEXTURE_2D, levels - 1, 0, 0, 1, 1, format, GL_UNSIGNED_BYTE, gray);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			setTextureSwizzle(GL_TEXTURE_2D, image.channels);
+			if (hasMipLevels)
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			// Levels are sent from the smallest, the real 1x1 one replacing the placeholder
+			job.level = hasMipLevels ? levels - 1 : 0;
+
+			// A row larger than a ring slot can't be streamed, it is sent directly
+			if ((size_t)image.width * image.channels > slotBytes) {
+				for (; job.level >= 0; job.level--)
+					glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, 0, levelWidth(image, job.level), levelHeight(image, job.level), format,
+					                GL_UNSIGNED_BYTE, levelPixels(image, job.level));
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+				finish(job);
+				continue;
+			}
+			uploading.push_back(std::move(job));
+		}
+
+		// Every free slot of the ring takes the next rows
+		for (Slot& slot : slots) {
+			if (uploading.empty())
+				break;
+			if (isFree(slot))
+				fillSlot(slot);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		stats.lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.maxUpdateMs = std::max(stats.maxUpdateMs, stats.lastUpdateMs);
+	}
+
+	MemoryUsage TextureStreamer::getMemoryUsage() const {
+		MemoryUsage usage;
+		usage.gpu = slots.size() * slotBytes;
+		usage.host = heapBytes(slots) + heapBytes(mipQueue) + heapBytes(completed);
+		for (const Job& job : uploading)
+			if (job.image)
+				usage.host += heapBytes(job.image->pixels) + heapBytes(job.image->mipLevels);
+		return usage;
+	}
+}
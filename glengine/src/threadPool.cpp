@@ -0,0 +1,90 @@
+#include <glengine/threadPool.hpp>
+#include <algorithm>
+#include <atomic>
+
+namespace GLEngine {
+	ThreadPool::ThreadPool(unsigned int workerCount)
+	: stopping(false) {
+		if (workerCount == 0) {
+			unsigned int hardware = std::thread::hardware_concurrency();
+			workerCount = hardware > 1 ? hardware - 1 : 1;
+		}
+		for (unsigned int i = 0; i < workerCount; i++)
+			workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	unsigned int ThreadPool::getConcurrency() const {
+		return (unsigned int)workers.size() + 1;
+	}
+
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+		if (count == 0)
+			return;
+		if (count == 1) {
+			task(0);
+			return;
+		}
+
+		// Shared with the helpers, which may only start once the loop is over
+		struct LoopState {
+			std::atomic<size_t> next{0};
+			std::atomic<size_t> done{0};
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		auto state = std::make_shared<LoopState>();
+		const std::function<void(size_t)>* body = &task;
+
+		auto run = [state, body, count]() {
+			size_t i;
+			while ((i = state->next.fetch_add(1)) < count) {
+				(*body)(i);
+				if (state->done.fetch_add(1) + 1 == count) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min(count - 1, workers.size());
+		for (size_t h = 0; h < helpers; h++)
+			enqueue(run);
+		run();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&]() { return state->done.load() == count; });
+	}
+
+	void ThreadPool::enqueue(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+}
@@ -0,0 +1,215 @@
+#include <glengine/tonalArtMap.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace GLEngine {
+	namespace {
+		// Changes whenever the strokes generated for the same settings change
+		const uint32_t GENERATOR_VERSION = 1;
+
+		struct Stroke {
+			float x, y;          // Center, in texture coordinates
+			float dx, dy;        // Direction
+			float halfLength;    // In texture coordinates
+			float intensity;
+		};
+
+		uint64_t splitMix(uint64_t value) {
+			value += 0x9e3779b97f4a7c15ULL;
+			value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+			return value ^ (value >> 31);
+		}
+
+		// Stroke 'index' of the tone: computed from its indices only, so every level and thread
+		// sees the same sequence
+		Stroke makeStroke(const TonalArtMapSettings& settings, int tone, int index) {
+			uint64_t state = splitMix(((uint64_t)settings.seed << 40) ^ ((uint64_t)tone << 32) ^ (uint64_t)index);
+			auto unit = [&state]() {
+				state = splitMix(state);
+				return (float)(state >> 40) / (float)(1 << 24);
+			};
+
+			// Lighter tones are hatched horizontally, darker ones add vertical then diagonal strokes
+			const float directions[3] = { 0.0f, 1.5707963f, 0.7853982f };
+			float angle = directions[std::min(tone * 3 / settings.toneCount, 2)] + (unit() - 0.5f) * 0.16f;
+
+			Stroke stroke;
+			stroke.x = unit();
+			stroke.y = unit();
+			stroke.dx = std::cos(angle);
+			stroke.dy = std::sin(angle);
+			stroke.halfLength = settings.strokeLength * (0.75f + 0.5f * unit()) * 0.5f;
+			stroke.intensity = 0.7f + 0.3f * unit();
+			return stroke;
+		}
+
+		// Ink coverage of one tone image, wrapping around its borders
+		class Canvas {
+		public:
+			explicit Canvas(int size) : size(size), ink(size * size, 0.0f), inkSum(0.0) {}
+
+			void draw(const Stroke& stroke, float width) {
+				float cx = stroke.x * size, cy = stroke.y * size;
+				float half = stroke.halfLength * size;
+				float ax = cx - stroke.dx * half, ay = cy - stroke.dy * half;
+				float bx = cx + stroke.dx * half, by = cy + stroke.dy * half;
+				// Antialiased over one pixel past the width
+				float radius = width * 0.5f + 0.5f;
+				int minX = (int)std::floor(std::min(ax, bx) - radius), maxX = (int)std::ceil(std::max(ax, bx) + radius);
+				int minY = (int)std::floor(std::min(ay, by) - radius), maxY = (int)std::ceil(std::max(ay, by) + radius);
+				float length = 2.0f * half;
+
+				auto shade = [&](int x, int y) {
+					// Distance from the pixel center to the segment
+					float px = x + 0.5f - ax, py = y + 0.5f - ay;
+					float t = std::clamp(px * stroke.dx + py * stroke.dy, 0.0f, length);
+					float ex = px - stroke.dx * t, ey = py - stroke.dy * t;
+					float coverage = radius - std::sqrt(ex * ex + ey * ey);
+					if (coverage <= 0.0f)
+						return;
+					coverage = std::min(coverage, 1.0f) * stroke.intensity;
+
+					float& texel = ink[wrap(y) * size + wrap(x)];
+					float previous = texel;
+					texel = 1.0f - (1.0f - texel) * (1.0f - coverage);
+					inkSum += texel - previous;
+				};
+
+				// Only the pixels near the line along its major axis, not the whole bounding box
+				// (most of it for diagonal strokes)
+				if (std::abs(stroke.dx) >= std::abs(stroke.dy)) {
+					float slope = stroke.dy / stroke.dx, span = radius / std::abs(stroke.dx);
+					for (int x = minX; x <= maxX; x++) {
+						float y = ay + (x + 0.5f - ax) * slope;
+						int first = std::max(minY, (int)std::floor(y - span)), last = std::min(maxY, (int)std::ceil(y + span));
+						for (int yi = first; yi <= last; yi++)
+							shade(x, yi);
+					}
+				}
+				else {
+					float slope = stroke.dx / stroke.dy, span = radius / std::abs(stroke.dy);
+					for (int y = minY; y <= maxY; y++) {
+						float x = ax + (y + 0.5f - ay) * slope;
+						int first = std::max(minX, (int)std::floor(x - span)), last = std::min(maxX, (int)std::ceil(x + span));
+						for (int xi = first; xi <= last; xi++)
+							shade(xi, y);
+					}
+				}
+			}
+
+			double getCoverage() const { return inkSum / ink.size(); }
+
+			void store(uint8_t* pixels) const {
+				for (size_t i = 0; i < ink.size(); i++)
+					pixels[i] = (uint8_t)std::lround(255.0f * (1.0f - ink[i]));
+			}
+
+		private:
+			int wrap(int value) const { return ((value % size) + size) % size; }
+
+			int size;
+			std::vector<float> ink;
+			double inkSum;
+		};
+
+		void runLevels(ThreadPool* pool, size_t count, const std::function<void(size_t)>& task) {
+			if (pool)
+				pool->parallelFor(count, task);
+			else
+				for (size_t i = 0; i < count; i++)
+					task(i);
+		}
+	}
+
+	std::string TonalArtMapSettings::getKey() const {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		auto add = [&hash](const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 0x100000001b3ULL;
+			}
+		};
+		add(&GENERATOR_VERSION, sizeof(GENERATOR_VERSION));
+		add(&toneCount, sizeof(toneCount));
+		add(&levelCount, sizeof(levelCount));
+		add(&size, sizeof(size));
+		add(&strokeWidth, sizeof(strokeWidth));
+		add(&strokeLength, sizeof(strokeLength));
+		add(&lightestInk, sizeof(lightestInk));
+		add(&darkestInk, sizeof(darkestInk));
+		add(&seed, sizeof(seed));
+
+		char key[17];
+		std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+		return key;
+	}
+
+	TonalArtMap generateTonalArtMap(const TonalArtMapSettings& settings, ThreadPool* pool) {
+		auto start = std::chrono::steady_clock::now();
+
+		TonalArtMap map;
+		map.toneCount = std::max(settings.toneCount, 1);
+		for (int size = std::max(settings.size, 1); size >= 1 && (int)map.sizes.size() < settings.levelCount; size /= 2)
+			map.sizes.push_back(size);
+		map.levelCount = (int)map.sizes.size();
+
+		auto targetInk = [&](int tone) {
+			if (map.toneCount == 1)
+				return settings.darkestInk;
+			return settings.lightestInk + (settings.darkestInk - settings.lightestInk) * tone / (map.toneCount - 1);
+		};
+
+		// Strokes of each tone needed by each level on its own, the tones are stored as they are reached
+		std::vector<std::vector<int>> counts(map.levelCount, std::vector<int>(map.toneCount, 0));
+		map.levels.resize(map.levelCount);
+		runLevels(pool, map.levelCount, [&](size_t level) {
+			int size = map.sizes[level];
+			int maxStrokes = 4 * size * size + 16;
+			std::vector<uint8_t>& pixels = map.levels[level];
+			pixels.resize((size_t)size * size * map.toneCount);
+			Canvas canvas(size);
+			for (int tone = 0; tone < map.toneCount; tone++) {
+				int& count = counts[level][tone];
+				while (canvas.getCoverage() < targetInk(tone) && count < maxStrokes)
+					canvas.draw(makeStroke(settings, tone, count++), settings.strokeWidth);
+				canvas.store(&pixels[(size_t)tone * size * size]);
+			}
+		});
+
+		// A finer level keeps every stroke of the coarser ones, the levels missing some are drawn again
+		std::vector<size_t> redrawn;
+		for (int level = map.levelCount - 2; level >= 0; level--) {
+			bool raised = false;
+			for (int tone = 0; tone < map.toneCount; tone++) {
+				if (counts[level + 1][tone] > counts[level][tone]) {
+					counts[level][tone] = counts[level + 1][tone];
+					raised = true;
+				}
+			}
+			if (raised)
+				redrawn.push_back(level);
+		}
+		runLevels(pool, redrawn.size(), [&](size_t i) {
+			int size = map.sizes[redrawn[i]];
+			std::vector<uint8_t>& pixels = map.levels[redrawn[i]];
+			Canvas canvas(size);
+			for (int tone = 0; tone < map.toneCount; tone++) {
+				for (int index = 0; index < counts[redrawn[i]][tone]; index++)
+					canvas.draw(makeStroke(settings, tone, index), settings.strokeWidth);
+				canvas.store(&pixels[(size_t)tone * size * size]);
+			}
+		});
+
+		map.strokeCounts.resize(map.levelCount);
+		for (int level = 0; level < map.levelCount; level++)
+			for (int tone = 0; tone < map.toneCount; tone++)
+				map.strokeCounts[level] += counts[level][tone];
+
+		map.generationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return map;
+	}
+}
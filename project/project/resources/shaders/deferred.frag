@@ -0,0 +1,137 @@
+#version 330 core
+layout(location = 0) out vec4 FragColor;
+
+//Éclairage du rendu différé: mêmes effets que lighting.frag (mêmes variantes NPR_*),
+//calculés une seule fois par pixel à partir du G-buffer, plus le contour des objets
+#include "npr.glsl"
+#include "gbuffer.glsl"
+#include "lights.glsl"
+#include "shadows.glsl"
+
+uniform sampler2D normals;
+uniform usampler2D objects;
+uniform sampler2D depths;
+//Contenu de instanceVBO
+uniform samplerBuffer instances;
+
+uniform mat4 inverseViewProjection;
+//projection[1][1] * hauteur / 2: taille en pixels d'un objet de taille 1 à une distance de 1
+uniform float pixelsPerUnit;
+uniform float nearPlane;
+uniform float farPlane;
+//Distance maximale (en pixels) à laquelle un contour est cherché
+uniform int outlineRadius;
+uniform vec3 backgroundColor;
+
+uniform vec3 lightPos; 
+uniform vec3 lightColor;
+uniform vec3 viewPos;
+uniform vec3 ditheringColor;
+uniform vec3 edgeColor;
+
+uniform int nbColors;
+uniform float edgeThreshold;
+uniform int dithering;
+
+#ifdef NPR_HATCHING
+uniform sampler2DArray hatching;
+uniform float hatchingScale;
+#endif
+
+float viewDepth(float depth)
+{
+    float ndc = depth * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+}
+
+//Contour autour des objets, dessiné sur le fond comme la passe de contour du rendu forward:
+//l'objet voisin le plus proche dont l'épaisseur (projetée en pixels) atteint ce pixel
+vec4 findOutline(ivec2 pixel, ivec2 size)
+{
+    vec4 outline = vec4(0.0);
+    float nearest = 1.0;
+    for (int y = -outlineRadius; y <= outlineRadius; y++) {
+        for (int x = -outlineRadius; x <= outlineRadius; x++) {
+            float distance = length(vec2(x, y));
+            if (distance > float(outlineRadius))
+                continue;
+            ivec2 neighbor = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            uint object = texelFetch(objects, neighbor, 0).r;
+            if (object == 0u)
+                continue;
+            float depth = texelFetch(depths, neighbor, 0).r;
+            int base = instanceBase(object);
+            float thickness = texelFetch(instances, base + INSTANCE_OUTLINE_THICKNESS).r * pixelsPerUnit / viewDepth(depth);
+            if (distance <= thickness && depth < nearest) {
+                nearest = depth;
+                outline = vec4(fetchVec3(instances, base + INSTANCE_OUTLINE_COLOR), 1.0);
+            }
+        }
+    }
+    return outline;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(objects, 0);
+    uint object = texelFetch(objects, pixel, 0).r;
+
+    //Pixel sans objet: le fond, ou le contour d'un objet voisin
+    if (object == 0u) {
+        vec4 outline = findOutline(pixel, size);
+        FragColor = vec4(mix(backgroundColor, outline.rgb, outline.a), 1.0);
+        return;
+    }
+
+    float depth = texelFetch(depths, pixel, 0).r;
+    vec4 position = inverseViewProjection * vec4(gl_FragCoord.xy / vec2(size) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec3 FragPos = position.xyz / position.w;
+    vec3 norm = decodeNormal(texelFetch(normals, pixel, 0).rg);
+    vec3 dragonColor = fetchVec3(instances, instanceBase(object) + INSTANCE_COLOR);
+
+    // ambient
+    float ambientStrength = 0.1;
+    vec3 ambient = ambientStrength * lightColor;
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    LightSum light = noLight();
+    float fragmentDepth = viewDepth(depth);
+    addLight(light, norm, viewDir, normalize(lightPos - FragPos), lightColor, shadowFactor(FragPos, norm, fragmentDepth));
+    addStageLights(light, FragPos, norm, viewDir, gl_FragCoord.xy, fragmentDepth);
+
+    //Luminance seuillée
+    float diff;
+    vec3 result = ambient + toonLight(light, nbColors, diff);
+
+#ifdef NPR_SPECULAR
+    float specularStrength = 0.8;
+    result += specularStrength * light.specular;
+#endif
+
+    vec4 resultColor = vec4(result * dragonColor, 1.0);
+
+#ifdef NPR_HATCHING
+    //Hachures dans le repère de l'objet, retrouvé avec sa matrice
+    mat4 model = fetchModel(instances, object);
+    vec3 objectPos = vec3(inverse(model) * vec4(FragPos, 1.0));
+    vec3 objectNormal = transpose(mat3(model)) * norm;
+    float luminance = min(light.intensity, 1.0);
+    resultColor.rgb *= hatchingShade(hatching, objectPos * hatchingScale, normalize(objectNormal), luminance);
+#endif
+
+#ifdef NPR_EDGES
+    //Différences avec les pixels voisins du même objet (comme dFdx/dFdy)
+    ivec2 right = min(pixel + ivec2(1, 0), size - 1), up = min(pixel + ivec2(0, 1), size - 1);
+    vec3 normalRight = texelFetch(objects, right, 0).r == object ? decodeNormal(texelFetch(normals, right, 0).rg) : norm;
+    vec3 normalUp = texelFetch(objects, up, 0).r == object ? decodeNormal(texelFetch(normals, up, 0).rg) : norm;
+    resultColor = mix(resultColor, vec4(edgeColor, 1.0), edgeFactor(normalRight - norm, normalUp - norm, edgeThreshold));
+#endif
+
+#ifdef NPR_DITHERING
+    if (diff < 0.7 && isDitheringDot(gl_FragCoord.xy, dithering))
+        resultColor = vec4(ditheringColor, 1.0);
+#endif
+
+    FragColor = resultColor;
+}
@@ -0,0 +1,14 @@
+#version 330 core
+layout(location = 0) out vec2 packedNormal;
+layout(location = 1) out uint objectId;
+
+#include "gbuffer.glsl"
+
+in vec3 Normal;
+flat in uint object;
+
+void main()
+{
+    packedNormal = encodeNormal(normalize(Normal));
+    objectId = object;
+}
@@ -0,0 +1,46 @@
+//G-buffer du rendu différé: normale compressée (encodage octaédrique sur deux canaux 16 bits)
+//et identifiant d'objet, qui donne accès aux données de l'instance dans instanceVBO
+
+//Normale unitaire -> [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 encoded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return encoded * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+//Disposition de InstanceData (scene.hpp) lue en flottants: 25 par instance
+const int INSTANCE_STRIDE = 25;
+const int INSTANCE_COLOR = 16;
+const int INSTANCE_OUTLINE_THICKNESS = 19;
+const int INSTANCE_OUTLINE_COLOR = 20;
+
+//L'identifiant d'objet vaut la position de l'instance + 1 (0 pour le fond)
+int instanceBase(uint object)
+{
+    return (int(object) - 1) * INSTANCE_STRIDE;
+}
+
+vec3 fetchVec3(samplerBuffer instances, int index)
+{
+    return vec3(texelFetch(instances, index).r, texelFetch(instances, index + 1).r, texelFetch(instances, index + 2).r);
+}
+
+mat4 fetchModel(samplerBuffer instances, uint object)
+{
+    int base = instanceBase(object);
+    mat4 model;
+    for (int column = 0; column < 4; column++)
+        model[column] = vec4(fetchVec3(instances, base + column * 4), texelFetch(instances, base + column * 4 + 3).r);
+    return model;
+}
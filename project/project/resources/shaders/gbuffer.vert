@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+//Attributs par instance
+layout (location = 2) in mat4 iModel;
+layout (location = 9) in uint iObject;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 Normal;
+flat out uint object;
+
+void main()
+{
+    //Même transformation que lighting.vert, seules la normale et l'objet sont écrits dans le G-buffer
+    Normal = mat3(iModel) * aNormal;
+    object = iObject;
+    gl_Position = projection * view * iModel * vec4(aPos, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+layout(location = 0) out float farthestDepth;
+
+//Niveau précédent de la pyramide (ou la copie du depth buffer)
+uniform sampler2D source;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(source, 0);
+    ivec2 size = max(sourceSize / 2, ivec2(1));
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 first = texel * 2;
+    //Le dernier texel d'une ligne ou colonne impaire récupère aussi le texel restant
+    ivec2 last = min(first + 1, sourceSize - 1);
+    if (texel.x == size.x - 1)
+        last.x = sourceSize.x - 1;
+    if (texel.y == size.y - 1)
+        last.y = sourceSize.y - 1;
+
+    //Profondeur maximale (la plus lointaine) du bloc
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(source, ivec2(x, y), 0).r);
+    farthestDepth = depth;
+}
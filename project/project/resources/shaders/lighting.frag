@@ -1,13 +1,22 @@
 #version 330 core
 layout(location = 0) out vec4 FragColor;
 
+//Les effets (NPR_SPECULAR, NPR_DITHERING, NPR_EDGES, NPR_HATCHING) sont définis par le programme selon la variante
+#include "npr.glsl"
+#include "lights.glsl"
+#include "shadows.glsl"
+
 in vec3 Normal;
 in vec3 FragPos;
+flat in vec3 dragonColor;
+in vec3 ObjectPos;
+in vec3 ObjectNormal;
 
 uniform vec3 lightPos; 
 uniform vec3 lightColor;
-uniform vec3 dragonColor;
 uniform vec3 viewPos;
+//Profondeur du fragment pour les clusters de lumières
+uniform mat4 view;
 uniform vec3 ditheringColor;
 uniform vec3 edgeColor;
 
@@ -15,56 +24,60 @@ uniform int nbColors;
 uniform float edgeThreshold;
 uniform int dithering;
 
+#ifdef NPR_HATCHING
+uniform sampler2DArray hatching;
+//Répétitions de la carte par unité du repère de l'objet
+uniform float hatchingScale;
+#endif
+
 void main()
 {
     // ambient
     float ambientStrength = 0.1;
     vec3 ambient = ambientStrength * lightColor;
 
-    float specularStrength = 0.8;
-    
     vec3 norm = normalize(Normal);
     
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 viewDir = normalize(viewPos - FragPos);
 
-    //Luminance
-    float diff = max(dot(norm, lightDir), 0.0);
-    //Seuillage de l'intensité lumineuse (un nombre de couleurs sur l'objet égal à nbColors)
-    diff = round(diff * nbColors)/nbColors;
-    vec3 diffuse = diff * lightColor;
+    //Lumière principale et lumières de scène du cluster, sommées avant le seuillage
+    LightSum light = noLight();
+    //Les ombres portées retirent la lumière principale avant le seuillage: elles forment une bande de ton
+    float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+    addLight(light, norm, viewDir, normalize(lightPos - FragPos), lightColor, shadowFactor(FragPos, norm, viewDepth));
+    addStageLights(light, FragPos, norm, viewDir, gl_FragCoord.xy, viewDepth);
 
-    //Calcul des reflets de la lumière par rapport au point de vue de la caméra
-    vec3 viewDir = normalize(viewPos - FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    //Luminance seuillée
+    float diff;
+    vec3 diffuse = toonLight(light, nbColors, diff);
+    vec3 result = ambient + diffuse;
 
-    vec3 specular = specularStrength * spec * lightColor;  
-    vec3 result = (ambient + diffuse + specular) * dragonColor;
+#ifdef NPR_SPECULAR
+    float specularStrength = 0.8;
+    result += specularStrength * light.specular;
+#endif
 
-    //Calcul du tramage: on vérifie tous les y pixels (ici 'dithering') que 
-    //la coordonnée x (puis y) du pixel courant est multiple de 'dithering'.
-    //tramage contient donc une valeur entre 0 et dithering - 1 (entre 0 et y avec y le modulo)
-    int tramage = int(mod(floor(gl_FragCoord.x), float(dithering))) + int(mod(floor(gl_FragCoord.y), float(dithering)));
+    vec4 resultColor = vec4(result * dragonColor, 1.0);
 
-    //Dérivées des normales
-    vec3 dNdx = dFdx(norm);
-    vec3 dNdy = dFdy(norm);
+#ifdef NPR_HATCHING
+    //Hachures selon la luminance non seuillée
+    float luminance = min(light.intensity, 1.0);
+    resultColor.rgb *= hatchingShade(hatching, ObjectPos * hatchingScale, normalize(ObjectNormal), luminance);
+#endif
 
-    float edgeStrength = length(dNdx) + length(dNdy);
-    
-    //Déterminer la discontinuité des normales à chaque pixel (effet de crayon)
-    float discontinuity = smoothstep(edgeThreshold, edgeThreshold + 0.2, edgeStrength);
+#ifdef NPR_EDGES
+    //Couleur de la discontinuité des normales
+    //(calculée hors de tout branchement, les dérivées l'exigent)
+    resultColor = mix(resultColor, vec4(edgeColor, 1.0), edgeFactor(dFdx(norm), dFdy(norm), edgeThreshold));
+#endif
 
+#ifdef NPR_DITHERING
     //Si la luminance du fragment est inférieure à un seuil 
     //et que le fragment est un multiple de 'dithering' sur les x et y, 
     //on le met de la couleur ditheringColor (points de couleur)
-    if(diff < 0.7 && tramage == 0.0)
-        FragColor = vec4(ditheringColor, 1.0);
-    else
-    {
-        vec4 resultColor = vec4(result, 1.0);
-        //Couleur de la discontinuité des normales
-        vec4 borderColor = vec4(edgeColor, 1.0);
-        FragColor = mix(resultColor, borderColor, discontinuity);
-    }
-}
\ No newline at end of file
+    if (diff < 0.7 && isDitheringDot(gl_FragCoord.xy, dithering))
+        resultColor = vec4(ditheringColor, 1.0);
+#endif
+
+    FragColor = resultColor;
+}
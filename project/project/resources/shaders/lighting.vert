@@ -1,17 +1,28 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+//Attributs par instance
+layout (location = 2) in mat4 iModel;
+layout (location = 6) in vec3 iColor;
 
 uniform mat4 view;
-uniform mat4 model;
 uniform mat4 projection;
 
 out vec3 FragPos;
 out vec3 Normal;
+flat out vec3 dragonColor;
+//Repère de l'objet, pour que les hachures suivent le modèle
+out vec3 ObjectPos;
+out vec3 ObjectNormal;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    FragPos = vec3(iModel * vec4(aPos, 1.0));
+    //Les instances n'ont que des rotations, translations et mises à l'échelle uniformes:
+    //la matrice du modèle suffit pour les normales (normalisées dans le fragment shader)
+    Normal = mat3(iModel) * aNormal;
+    dragonColor = iColor;
+    ObjectPos = aPos;
+    ObjectNormal = aNormal;
     gl_Position = projection * view * vec4(FragPos, 1.0); 
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+//Éclairage par plusieurs sources: la lumière principale et les lumières de scène (ponctuelles),
+//triées par cluster sur le CPU (GLEngine::LightClusters). À inclure après npr.glsl.
+
+//Deux texels par lumière: position et rayon, couleur et intensité
+uniform samplerBuffer stageLights;
+//Par cluster: début et nombre de ses lumières dans lightIndices
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform int stageLightCount;
+//Tuiles en x et en y, tranches en profondeur
+uniform ivec3 clusterCounts;
+//Tuiles par pixel
+uniform vec2 clusterTileScale;
+//Tranche = log(profondeur) * x + y (tranches exponentielles)
+uniform vec2 clusterDepthParams;
+
+//Lumière reçue de toutes les sources, avant le seuillage
+struct LightSum
+{
+    float intensity;
+    //Couleurs pondérées par l'intensité reçue de chaque source
+    vec3 color;
+    vec3 specular;
+};
+
+LightSum noLight()
+{
+    return LightSum(0.0, vec3(0.0), vec3(0.0));
+}
+
+void addLight(inout LightSum sum, vec3 norm, vec3 viewDir, vec3 lightDir, vec3 color, float attenuation)
+{
+    float amount = max(dot(norm, lightDir), 0.0) * attenuation;
+    sum.intensity += amount;
+    sum.color += amount * color;
+#ifdef NPR_SPECULAR
+    sum.specular += specularTerm(norm, lightDir, viewDir) * attenuation * color;
+#endif
+}
+
+//Seules les lumières du cluster du fragment sont parcourues
+void addStageLights(inout LightSum sum, vec3 position, vec3 norm, vec3 viewDir, vec2 fragCoord, float viewDepth)
+{
+    if (stageLightCount == 0)
+        return;
+    ivec2 tile = min(ivec2(fragCoord * clusterTileScale), clusterCounts.xy - 1);
+    int slice = clamp(int(log(viewDepth) * clusterDepthParams.x + clusterDepthParams.y), 0, clusterCounts.z - 1);
+    int cluster = (slice * clusterCounts.y + tile.y) * clusterCounts.x + tile.x;
+    uvec2 range = texelFetch(lightClusters, cluster).rg;
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 sphere = texelFetch(stageLights, 2 * light);
+        vec4 color = texelFetch(stageLights, 2 * light + 1);
+        vec3 toLight = sphere.xyz - position;
+        float distance2 = dot(toLight, toLight);
+        //Atténuation nulle au rayon de la lumière
+        float falloff = clamp(1.0 - distance2 / (sphere.w * sphere.w), 0.0, 1.0);
+        addLight(sum, norm, viewDir, toLight * inversesqrt(max(distance2, 1e-8)), color.rgb, falloff * falloff * color.a);
+    }
+}
+
+//Diffus seuillé (toon): l'intensité totale est seuillée, la couleur est la moyenne de celles des sources
+vec3 toonLight(LightSum sum, int nbColors, out float diff)
+{
+    diff = toonDiffuse(sum.intensity, nbColors);
+    return diff * sum.color / max(sum.intensity, 1e-4);
+}
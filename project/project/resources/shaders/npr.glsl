@@ -0,0 +1,66 @@
+//Fonctions du rendu non photoréaliste, incluses par lighting.frag.
+//Chaque effet n'existe que si sa variante est compilée (NPR_SPECULAR, NPR_DITHERING, NPR_EDGES, NPR_HATCHING),
+//un effet désactivé ne coûte donc aucune instruction.
+
+//Seuillage de l'intensité lumineuse (un nombre de couleurs sur l'objet égal à nbColors)
+float toonDiffuse(float intensity, int nbColors)
+{
+    return round(intensity * nbColors) / nbColors;
+}
+
+#ifdef NPR_SPECULAR
+//Reflets de la lumière par rapport au point de vue de la caméra
+float specularTerm(vec3 norm, vec3 lightDir, vec3 viewDir)
+{
+    vec3 reflectDir = reflect(-lightDir, norm);
+    return pow(max(dot(viewDir, reflectDir), 0.0), 32);
+}
+#endif
+
+#ifdef NPR_DITHERING
+//Tramage: vrai tous les 'dithering' pixels, quand les coordonnées x et y du pixel
+//sont toutes les deux multiples de 'dithering'
+bool isDitheringDot(vec2 fragCoord, int dithering)
+{
+    ivec2 tramage = ivec2(mod(floor(fragCoord), float(dithering)));
+    return tramage.x + tramage.y == 0;
+}
+#endif
+
+#ifdef NPR_EDGES
+//Discontinuité des normales à chaque pixel (effet de crayon), à partir de leurs variations
+//d'un pixel à l'autre en x et en y (dFdx/dFdy en forward, pixels voisins du G-buffer en deferred)
+float edgeFactor(vec3 normalDx, vec3 normalDy, float edgeThreshold)
+{
+    float edgeStrength = length(normalDx) + length(normalDy);
+    return smoothstep(edgeThreshold, edgeThreshold + 0.2, edgeStrength);
+}
+#endif
+
+#ifdef NPR_HATCHING
+//Projection de la carte sur les trois plans de l'objet (selon la normale)
+float sampleTriplanar(sampler2DArray tam, vec3 position, vec3 weights, float layer)
+{
+    return texture(tam, vec3(position.yz, layer)).r * weights.x
+         + texture(tam, vec3(position.xz, layer)).r * weights.y
+         + texture(tam, vec3(position.xy, layer)).r * weights.z;
+}
+
+//Hachures (tonal art map): la luminance choisit deux tons voisins de la carte, mélangés.
+//Le ton 0 est le papier blanc, les couches de la carte vont du plus clair au plus foncé.
+float hatchingShade(sampler2DArray tam, vec3 position, vec3 normal, float luminance)
+{
+    int toneCount = textureSize(tam, 0).z;
+    vec3 weights = pow(abs(normal), vec3(4.0));
+    weights /= weights.x + weights.y + weights.z;
+
+    float tone = clamp(1.0 - luminance, 0.0, 1.0) * float(toneCount);
+    float lower = min(floor(tone), float(toneCount - 1));
+    //Les deux tons sont toujours échantillonnés (dérivées de texture() hors branchement)
+    float light = sampleTriplanar(tam, position, weights, max(lower - 1.0, 0.0));
+    float dark = sampleTriplanar(tam, position, weights, lower);
+    if (lower == 0.0)
+        light = 1.0;
+    return mix(light, dark, tone - lower);
+}
+#endif
@@ -1,23 +1,26 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+//Attributs par instance
+layout (location = 2) in mat4 iModel;
+layout (location = 7) in float iOutlineThickness;
+layout (location = 8) in vec3 iOutlineColor;
 
 uniform mat4 view;
-uniform mat4 model;
 uniform mat4 projection;
 
-uniform float outlineThickness;
-
 out vec3 FragPos;
 out vec3 Normal;
+flat out vec3 outlineColor;
 
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal * 0.01;
+    FragPos = vec3(iModel * vec4(aPos, 1.0));
+    Normal = mat3(iModel) * aNormal * 0.01;
+    outlineColor = iOutlineColor;
     
-    vec3 offset = normalize(Normal) * outlineThickness;
+    vec3 offset = normalize(Normal) * iOutlineThickness;
     gl_Position = projection * view * vec4(FragPos + offset, 1.0); 
 
 }
\ No newline at end of file
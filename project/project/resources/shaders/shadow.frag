@@ -0,0 +1,6 @@
+#version 330 core
+
+//Carte d'ombres: seule la profondeur est écrite
+void main()
+{
+}
@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+//Attributs par instance
+layout (location = 2) in mat4 iModel;
+
+//Vue et projection de la cascade rendue
+uniform mat4 lightViewProjection;
+
+void main()
+{
+    gl_Position = lightViewProjection * iModel * vec4(aPos, 1.0);
+}
@@ -0,0 +1,29 @@
+//Ombres portées de la lumière principale (GLEngine::ShadowMap): une carte en perspective depuis la lumière,
+//ou plusieurs cascades orthographiques selon la profondeur pour les grandes scènes
+
+uniform sampler2DArrayShadow shadowMap;
+//0: pas d'ombres
+uniform int shadowCascadeCount;
+uniform mat4 shadowMatrices[4];
+//Profondeur (vue de la caméra) où finit chaque cascade
+uniform vec4 shadowSplits;
+//Taille d'un texel de chaque cascade dans la scène
+uniform vec4 shadowTexelSizes;
+
+//1 pour un point éclairé, 0 dans l'ombre (filtré sur 2x2 texels par la comparaison matérielle)
+float shadowFactor(vec3 position, vec3 norm, float viewDepth)
+{
+    if (shadowCascadeCount == 0)
+        return 1.0;
+    int cascade = 0;
+    for (int i = 0; i < shadowCascadeCount - 1; i++)
+        if (viewDepth > shadowSplits[i])
+            cascade = i + 1;
+
+    //Décalage le long de la normale contre l'acné des surfaces face à la lumière
+    vec4 shadowPos = shadowMatrices[cascade] * vec4(position + norm * 1.5 * shadowTexelSizes[cascade], 1.0);
+    vec3 coords = shadowPos.xyz / shadowPos.w * 0.5 + 0.5;
+    if (any(lessThan(coords, vec3(0.0))) || any(greaterThan(coords, vec3(1.0))))
+        return 1.0;
+    return texture(shadowMap, vec4(coords.xy, float(cascade), coords.z));
+}
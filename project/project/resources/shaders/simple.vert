@@ -1,10 +1,10 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 iModel;
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
 
 void main(){
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * iModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -5,6 +5,40 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include <glm/gtc/type_ptr.hpp>
 #include <glengine/orbitalCamera.hpp>
+#include <glengine/gpuTimer.hpp>
+#include <glengine/framePacer.hpp>
+#include "usageMeter.hpp"
+#include "options.hpp"
+#include "scene.hpp"
+#include <glengine/culling.hpp>
+#include <glengine/threadPool.hpp>
+#include <glengine/hiZCuller.hpp>
+#include <glengine/glext.hpp>
+#include <glengine/geometryBuffer.hpp>
+#include <glengine/drawCommandBuffer.hpp>
+#include <glengine/shaderReloader.hpp>
+#include <glengine/gBuffer.hpp>
+#include <glengine/lightClusters.hpp>
+#include <glengine/shadowMap.hpp>
+#include <glengine/textureStreamer.hpp>
+#include <glengine/resourceManager.hpp>
+#include <glengine/textureCompression.hpp>
+#include <glengine/ktx2.hpp>
+#include <glengine/clusterFile.hpp>
+#include <glengine/clusterStreamer.hpp>
+#include <glengine/objClusterBuilder.hpp>
+#include <glengine/meshlets.hpp>
+#include <glengine/arena.hpp>
+#include <glengine/allocationCounter.hpp>
+#include <glengine/modelLibrary.hpp>
+#include "stbimage/stb_image_write.h"
+#include <memory>
+#include <functional>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <algorithm>
+#include <cctype>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
@@ -14,6 +48,24 @@ void processInput(GLFWwindow *window);
 void onMouseMove(GLFWwindow* window, double xpos, double ypos);
 void onMouseButton(GLFWwindow* window, int button, int action, int mods);
 void onMouseScroll(GLFWwindow* window, double xoffset, double yoffset);
+void onKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+void onChar(GLFWwindow* window, unsigned int c);
+void onWindowFocus(GLFWwindow* window, int focused);
+void onWindowRefresh(GLFWwindow* window);
+void requestRedraw();
+VSyncMode applySwapInterval(VSyncMode mode);
+string shaderPath(const string& file);
+void benchmarkShaderCache(const string& cacheDirectory);
+void benchmarkTextureLoading(GLEngine::ThreadPool& threadPool, int count, GLEngine::MipFilter filter);
+bool compressTextures(GLEngine::ThreadPool& threadPool, const string& directory, const string& format, GLEngine::MipFilter filter);
+bool buildClusters(GLEngine::ThreadPool& threadPool, const string& objFile, int memoryMB);
+void benchmarkMeshlets(GLEngine::ThreadPool& threadPool, const vector<string>& objFiles);
+bool compressMeshFile(GLEngine::ThreadPool& threadPool, const string& objFile);
+bool decompressMeshFile(GLEngine::ThreadPool& threadPool, const string& file);
+void benchmarkMeshFormats(GLEngine::ThreadPool& threadPool, const vector<string>& objFiles);
+void benchmarkLibrary(GLEngine::ThreadPool& threadPool, const string& directory, const string& indexFile);
+vector<string> nprDefines(int features);
+vector<string> programDefines(int program);
 
 //VARIABLES USED IN THE PROGRAM
 
@@ -43,6 +95,22 @@ float lightPosArray[3] = { lightPos.x, lightPos.y, lightPos.z };
 glm::vec3 lightColor(0.8f, 0.8f, 0.8f);
 float lightColorArray[3] = { lightColor.r, lightColor.g, lightColor.b };
 
+//Stage lights added to the main one, binned into the clusters of the view every frame
+const int maxStageLights = 256;
+int stageLightCount = 0;
+float stageLightRadius = 0.2f;      // Fraction of the scene size
+float stageLightIntensity = 0.5f;
+bool stageLightsDirty = true;
+vector<GLEngine::PointLight> stageLights;
+GLEngine::AABB sceneBounds;         // Union of the instance bounds, where the stage lights are placed
+
+//Cast shadows of the main light: the map is only rendered again when the light or a model moved
+bool castShadows = false;
+int shadowCascades = 1;             // 1: one map from the light, 2 to 4: cascades following the camera
+int shadowResolution = 2048;
+uint64_t sceneVersion = 0;          // Changes whenever the instances are rebuilt
+int shadowCascadesRendered = 0;     // In the last frame, 0 when the stored maps were reused
+
 // Color of the dragon, stored in an array for ImGui
 glm::vec3 dragonColor(1.0f, 1.0f, 1.0f);
 float dragonColorArray[3] = { dragonColor.r, dragonColor.g, dragonColor.b };
@@ -70,7 +138,22 @@ int colorThreshold = 5;
 bool imgui_window = true;
 
 string currentObjFile;
-vector<string> availableObjFiles;
+vector<string> availableObjFiles;           // Paths of the models of the library
+vector<GLEngine::ModelInfo> availableModels;    // Their metadata, from the library index
+
+//The OBJ files of the library are loaded in the shared geometry buffer when a scene first uses
+//them, the ones out of the scene may be evicted by the resource manager and read again from the
+//mesh cache
+struct LoadedMesh {
+    uint32_t id;                 // Mesh in the geometry buffer, while resident
+    uint32_t resource;           // In the resource manager
+    GLEngine::AABB bounds;       // From the library index until it is loaded
+    size_t triangles;
+    vector<GLEngine::Meshlet> meshlets;      // Ranges of its indices
+    GLEngine::MeshletBounds meshletBounds;
+};
+vector<LoadedMesh> meshes;      // Same order as availableObjFiles
+int currentMesh = 0;
 
 float modelRotationX = 0.0f;     // Initial X rotation 
 float modelRotationY = -120.0f;  // Initial Y rotation 
@@ -79,60 +162,187 @@ float modelRotationZ = 0.0f;     // Initial Z rotation
 // Rendering style (with the mesh or not)
 bool showMesh = false;
 
-int main() {
-
-    //Base shaders
-    string vertexShaderSource = string(_resources_directory).append("shaders/simple.vert");
-    string fragmentShaderSource = string(_resources_directory).append("shaders/simple.frag");
-
-    //Normales
-    string vertexNormalShaderSource = string(_resources_directory).append("shaders/lighting.vert");
-    string fragmentNormalShaderSource = string(_resources_directory).append("shaders/lighting.frag");
-
-    //Outlines
-    string vertexOutlineShaderSource = string(_resources_directory).append("shaders/outline.vert");
-    string fragmentOutlineShaderSource = string(_resources_directory).append("shaders/outline.frag");
-    
-    //Reading shaders
-    //Vertex Shader
-    string vertexShaderCode = readVertexShader(vertexShaderSource);
-    //Fragment Shader
-    string fragmentShaderCode = readFragmentShader(fragmentShaderSource);
-
-    //Vertex Shader of the normals
-    string vertexNormalShaderCode = readVertexShader(vertexNormalShaderSource);
-    //Fragment Shader of the normals
-    string fragmentNormalShaderCode = readFragmentShader(fragmentNormalShaderSource); 
-
-    //Outline Vertex Shader
-    string vertexOutlineShaderCode = readVertexShader(vertexOutlineShaderSource);
-    //Outline fragment Shader
-    string fragmentOutlineShaderCode = readFragmentShader(fragmentOutlineShaderSource);
-
-    //Converting all results to const char *
-    const char * vertexShaderCodeCStr = vertexShaderCode.c_str();
-    const char * vertexNormalShaderCodeCStr = vertexNormalShaderCode.c_str();
-    const char * vertexOutlineShaderCodeCStr = vertexOutlineShaderCode.c_str();
-
-    const char * fragmentShaderCodeCStr = fragmentShaderCode.c_str();
-    const char * fragmentNormalShaderCodeCStr = fragmentNormalShaderCode.c_str();
-    const char * fragmentOutlineShaderCodeCStr = fragmentOutlineShaderCode.c_str();
-
-
-    vector<float> vertices;
-    vector<unsigned int> faces;
-    vector<float> texCoords;
-    vector<float> normals;
-
-    unsigned int VAO, VBO, EBO;
+// Scene: a single model or many copies of it, all drawn with instancing
+SceneType sceneType = SceneType::SINGLE;
+int stressInstanceCount = 1000;
+vector<InstanceData> instances;
+// The instance buffer has to be rebuilt (transform, color or outline changed)
+bool instancesDirty = true;
+// Instance of the streamed scan, after the mesh instances in instanceVBO, and its world bounds
+InstanceData streamedInstance;
+uint32_t streamedInstanceIndex = 0;
+GLEngine::AABB streamedBounds;
+
+// Frustum culling of the instances against the camera
+bool frustumCulling = true;
+vector<GLEngine::AABB> instanceBounds;      // World bounds of every instance (outline included)
+GLEngine::Bvh instanceBvh;
+vector<uint32_t> visibleInstances;
+vector<InstanceData> drawnInstances;        // Content of instanceVBO, grouped by mesh
+GLEngine::CullingStats cullingStats;
+float cullingMs = 0.0f;
+
+// Occlusion culling of the frustum visible instances against the depth of the previous frames
+bool occlusionCulling = true;
+size_t occludedInstances = 0;
+float occlusionMs = 0.0f;
+
+// Triangles of all the instances, of the frustum visible ones and of the drawn ones
+size_t sceneTriangles = 0;
+size_t visibleTriangles = 0;
+size_t drawnTriangles = 0;
+size_t streamedTriangles = 0;     // Of the clusters of the streamed scan
+
+// Meshlet culling of the instances large on screen: the lighting and G-buffer passes skip their
+// off-screen and back-facing meshlets, the outline pass their off-screen and front-facing ones
+bool meshletCulling = true;
+const float meshletCullingPixels = 64.0f;    // Projected radius from which an instance is culled by meshlet
+size_t meshletInstances = 0;
+size_t meshletsTested = 0, meshletsOutside = 0, meshletsBackFacing = 0, meshletsFrontFacing = 0;
+size_t outlineTriangles = 0;                 // Drawn by the outline pass, drawnTriangles by the others
+float meshletMs = 0.0f;
+
+//Meshlets [first, first + count) of an instance, culled by a task into visibility
+struct MeshletCullJob {
+    const GLEngine::MeshletBounds* bounds;
+    glm::mat4 model;
+    float margin;                // Outline thickness, the outline pass extrudes the meshlets
+    size_t first, count;
+    uint8_t* visibility;
+    size_t outside;
+};
+//Jobs of every meshlet of an instance, visibility having one byte per meshlet
+void addMeshletCullJobs(vector<MeshletCullJob>& jobs, const GLEngine::MeshletBounds& bounds, const glm::mat4& model,
+                        float margin, uint8_t* visibility);
+//Runs the jobs over the pool (on the calling thread without one), returns the meshlets outside the frustum
+size_t cullMeshlets(vector<MeshletCullJob>& jobs, const GLEngine::Frustum& frustum, const glm::vec3& cameraPosition,
+                    bool coneCulling, GLEngine::ThreadPool* pool);
+
+// Draw commands of the frame: one per mesh of the drawn instances, then the light marker.
+// The instances culled by meshlet have their visible meshlet ranges in their own buffers.
+size_t meshCommandCount = 0;
+int drawCalls = 0;
+
+// Passes timed separately on the GPU, reported in the statistics overlay
+enum RenderPass { SHADOW_PASS, LIGHTING_PASS, OUTLINE_PASS, GBUFFER_PASS, SHADING_PASS, LIGHT_MARKER_PASS, HIZ_PASS, PASS_COUNT };
+const char* renderPassNames[PASS_COUNT] = { "Shadow map", "Lighting", "Outline", "G-buffer", "Deferred shading", "Light marker",
+                                            "Hi-Z build" };
+
+// Forward: lighting then outline pass over the geometry. Deferred: the geometry is drawn once into
+// a G-buffer, the NPR effects and the outlines are computed in a full screen pass
+enum class RenderPath { FORWARD, DEFERRED };
+RenderPath renderPath = RenderPath::FORWARD;
+// Nearest drawn instance, bounds the outline search of the deferred shading
+float nearestDrawnDistance = nearPlane;
+
+// Animation of the model around the Y axis
+bool autoRotate = false;
+float autoRotateSpeed = 30.0f;   // Degrees per second
+
+// Render on demand: the loop sleeps in glfwWaitEventsTimeout until something changes
+bool renderOnDemand = false;
+// Frames still to draw before going idle (ImGui needs a few frames to settle after an input)
+int framesToRedraw = 1;
+const int redrawFrameCount = 3;
+// Longest sleep when idle, so the statistics overlay still refreshes
+const double idleWaitTimeout = 1.0;
+
+// Showing the statistics overlay
+bool showStats = true;
+
+// Shader programs: vertex and fragment shader files in resources/shaders
+const int PROGRAM_COUNT = 6;
+const char* programFiles[PROGRAM_COUNT][2] = {
+    { "simple.vert", "simple.frag" },
+    { "lighting.vert", "lighting.frag" },
+    { "outline.vert", "outline.frag" },
+    { "fullscreen.vert", "hiz.frag" },
+    { "gbuffer.vert", "gbuffer.frag" },
+    { "shadow.vert", "shadow.frag" }
+};
+const int LIGHTING_PROGRAM = 1;
+// Time spent creating them at startup
+float programStartupMs = 0.0f;
+// Rebuilding the programs when a file of resources/shaders is saved
+bool hotReload = true;
+
+// NPR effects compiled into the lighting program (#ifdef in lighting.frag), one variant per combination
+enum NprFeature { NPR_SPECULAR = 1, NPR_DITHERING = 2, NPR_EDGES = 4, NPR_HATCHING = 8, NPR_ALL = 15 };
+const int NPR_VARIANT_COUNT = 16;
+const int NPR_DEFAULT = NPR_SPECULAR | NPR_DITHERING | NPR_EDGES;
+int nprFeatures = NPR_DEFAULT;
+// Lighting program of the deferred path, with the same variants
+const char* deferredShadingFiles[2] = { "fullscreen.vert", "deferred.frag" };
+// Variants of each path are built the first time they are used (the default forward one at startup)
+GLuint lightingVariants[2][NPR_VARIANT_COUNT] = {};
+bool lightingVariantBuilt[2][NPR_VARIANT_COUNT] = {};
+
+// Pencil hatching: tonal art map repeated this many times across the model
+float hatchingDensity = 6.0f;
+GLuint createHatchingTexture(GLEngine::ThreadPool& threadPool, const string& cacheDirectory);
+
+// GPU time averaged over a fixed number of frames for each configuration of a benchmark:
+// every NPR variant (--bench-variants), or both paths at two resolutions (--bench-deferred)
+struct FrameBenchmark {
+    bool running = false;
+    int configuration = 0;
+    int frame = 0;
+    vector<double> totalMs;
+    vector<int> samples;
+    vector<double> cpuTotalMs;    // CPU work measured alongside, over every measured frame
+};
+// Warm-up frames let the timer queries of the previous configuration drain
+const int benchWarmupFrames = 30;
+const int benchMeasuredFrames = 300;
+void startBenchmark(FrameBenchmark& bench, int configurationCount);
+bool advanceBenchmark(FrameBenchmark& bench, bool timed, float ms, double cpuMs = 0.0);
+double benchmarkAverageMs(const FrameBenchmark& bench, int configuration);
+void printVariantBenchmark(const FrameBenchmark& bench, RenderPath path, int width, int height);
+// Path benchmark: forward and deferred at 1080p, then at 4K, offscreen
+const int benchResolutions[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+RenderPath benchmarkPath(int configuration);
+void printPathBenchmark(const FrameBenchmark& bench, const string& meshName);
+// Light benchmark: lighting pass and CPU binning with more and more stage lights
+const int benchLightCounts[4] = { 1, 16, 64, 256 };
+void printLightBenchmark(const FrameBenchmark& bench, RenderPath path, int width, int height);
+
+// Frame pacing
+VSyncMode vsyncMode = VSyncMode::ON;
+float frameCap = 0.0f;
+int maxFramesInFlight = 2;
+
+int main(int argc, char** argv) {
+
+    AppOptions options;
+    ParseResult parsed = parseOptions(argc, argv, options);
+    if (parsed != ParseResult::RUN)
+        return parsed == ParseResult::HELP ? 0 : 1;
+    renderOnDemand = options.renderOnDemand;
+    frameCap = options.frameCap;
+    maxFramesInFlight = options.maxFramesInFlight;
+    if (options.stressInstances > 0) {
+        sceneType = SceneType::STRESS;
+        stressInstanceCount = glm::min(options.stressInstances, maxStressInstances);
+    }
+    meshletCulling = options.meshletCulling;
 
-    unsigned int lightingVAO, normalVBO;
+    //Worker threads (mesh cache decoding, culling, texture generation and decoding)
+    GLEngine::ThreadPool threadPool;
 
-    unsigned int vertexShader, vertexNormalShader, vertexOutlineShader;
+    //Offline tools, run before the window is created since they need no GL context
+    if (!options.compressTexturesDirectory.empty())
+        return compressTextures(threadPool, options.compressTexturesDirectory, options.compressFormat, options.mipFilter) ? 0 : -1;
+    if (!options.buildClustersFile.empty())
+        return buildClusters(threadPool, options.buildClustersFile, options.clusterMemoryMB) ? 0 : -1;
+    if (!options.compressMeshFile.empty())
+        return compressMeshFile(threadPool, options.compressMeshFile) ? 0 : -1;
+    if (!options.decompressMeshFile.empty())
+        return decompressMeshFile(threadPool, options.decompressMeshFile) ? 0 : -1;
 
-    unsigned int fragmentShader, fragmentNormalShader, fragmentOutlineShader;
+    //Per-instance data of the models, followed by the light source
+    unsigned int instanceVBO;
 
-    unsigned int shaderProgram, lightingProgram, outlineProgram;
+    unsigned int shaderProgram, outlineProgram, hiZProgram, gBufferProgram, shadowProgram;
 
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -155,7 +365,30 @@ int main() {
         cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }  
+    //Functions newer than OpenGL 3.3 (multi-draw indirect)
+    GLEngine::ext::load((GLADloadproc)glfwGetProcAddress);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);  
+    vsyncMode = applySwapInterval(options.vsync);
+    if (options.deferred)
+        renderPath = RenderPath::DEFERRED;
+    if (options.shadowCascades > 0) {
+        castShadows = true;
+        shadowCascades = glm::min(options.shadowCascades, GLEngine::ShadowMap::MAX_CASCADES);
+    }
+    //The benchmarks render continuously, as fast as possible
+    FrameBenchmark variantBench, pathBench, lightBench;
+    if (options.benchDeferred)
+        startBenchmark(pathBench, 4);
+    else if (options.benchVariants)
+        startBenchmark(variantBench, NPR_VARIANT_COUNT);
+    else if (options.benchLights)
+        startBenchmark(lightBench, 4);
+    if (pathBench.running || variantBench.running || lightBench.running) {
+        renderOnDemand = false;
+        frameCap = 0.0f;
+        vsyncMode = applySwapInterval(VSyncMode::OFF);
+    }
+    glfwSetWindowRefreshCallback(window, onWindowRefresh);
 
     //Setting up ImGui
     IMGUI_CHECKVERSION();
@@ -176,138 +409,376 @@ int main() {
     //To see the mesh
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &normalVBO);
-    glGenBuffers(1, &EBO);
-
-    //Main VAO
-    glBindVertexArray(VAO);
-
-    //VBO with vertices data
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    //EBO with faces data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(unsigned int), faces.data(), GL_STATIC_DRAW);
-
-    //Give the vertices to the vertex shader
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    //Give the normalVBO the normals data
-    glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
+    //Positions, normals and indices of every mesh, behind a single VAO
+    unique_ptr<GLEngine::GeometryBuffer> geometry = make_unique<GLEngine::GeometryBuffer>(1 << 18, 1 << 20, options.mappedGeometry);
+    unique_ptr<GLEngine::DrawCommandBuffer> drawCommands = make_unique<GLEngine::DrawCommandBuffer>();
+    unique_ptr<GLEngine::DrawCommandBuffer> lightingMeshletCommands = make_unique<GLEngine::DrawCommandBuffer>();
+    unique_ptr<GLEngine::DrawCommandBuffer> outlineMeshletCommands = make_unique<GLEngine::DrawCommandBuffer>();
 
-    //Give the attributes to the shader
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
+    //Per-instance model matrix, color and outline
+    glBindVertexArray(geometry->getVertexArray());
+    glGenBuffers(1, &instanceVBO);
+    setupInstanceAttributes(instanceVBO);
 
     //Deactivate the VAO
     glBindVertexArray(0);
 
-    //VAO for the lighting
-    glGenVertexArrays(1, &lightingVAO);
-    glBindVertexArray(lightingVAO);
-
-    //VBO data for the lighting this time
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    //Bind the EBO to that VAO too
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-
-    //Deactivate the current VAO
-    glBindVertexArray(0);
-
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderCodeCStr, NULL);
-    glCompileShader(vertexShader);
-
-    vertexNormalShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexNormalShader, 1, &vertexNormalShaderCodeCStr, NULL);
-    glCompileShader(vertexNormalShader);
-
-    vertexOutlineShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexOutlineShader, 1, &vertexOutlineShaderCodeCStr, NULL);
-    glCompileShader(vertexOutlineShader);
-
-    int  success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if(!success){
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << endl;
-    }
-
-    glGetShaderiv(vertexNormalShader, GL_COMPILE_STATUS, &success);
-    if(!success){
-        glGetShaderInfoLog(vertexNormalShader, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::NORMAL::VERTEX::COMPILATION_FAILED\n" << infoLog << endl;
+    //The deferred shading reads the instances (colors, outlines, matrices) through a texture buffer
+    GLuint instanceTexture;
+    glGenTextures(1, &instanceTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, instanceVBO);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    //Every instance, culled or not, casts shadows: the shadow pass reads them from their own buffer
+    GLuint shadowCasterVBO;
+    glGenBuffers(1, &shadowCasterVBO);
+    size_t instanceBufferBytes = 0, shadowCasterBytes = 0;
+    unique_ptr<GLEngine::DrawCommandBuffer> shadowCommands = make_unique<GLEngine::DrawCommandBuffer>();
+
+    //Without a base instance, the instanced attributes are moved to the first instance of every draw
+    auto setBaseInstance = [&](uint32_t firstInstance) { setupInstanceAttributes(instanceVBO, firstInstance); };
+    auto setShadowBaseInstance = [&](uint32_t firstInstance) { setupInstanceAttributes(shadowCasterVBO, firstInstance); };
+
+    //Shader programs, loaded from their cached binaries when neither the sources nor the driver changed
+    string cacheDirectory = options.shaderCache ? options.shaderCacheDirectory : "";
+    if (options.benchShaderCache) {
+        benchmarkShaderCache(options.shaderCacheDirectory);
+        glfwTerminate();
+        return 0;
     }
-
-    glGetShaderiv(vertexOutlineShader, GL_COMPILE_STATUS, &success);
-    if(!success){
-        glGetShaderInfoLog(vertexOutlineShader, 512, NULL, infoLog);
-        cout << "ERROR::SHADER::OUTLINE::VERTEX::COMPILATION_FAILED\n" << infoLog << endl;
-    }
-
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderCodeCStr, NULL);
-    glCompileShader(fragmentShader);
-
-    fragmentNormalShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentNormalShader, 1, &fragmentNormalShaderCodeCStr, NULL);
-    glCompileShader(fragmentNormalShader);
-
-    fragmentOutlineShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentOutlineShader, 1, &fragmentOutlineShaderCodeCStr, NULL);
-    glCompileShader(fragmentOutlineShader);
-
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    lightingProgram = glCreateProgram();
-    glAttachShader(lightingProgram, vertexNormalShader);
-    glAttachShader(lightingProgram, fragmentNormalShader);
-    glLinkProgram(lightingProgram);
-
-    outlineProgram = glCreateProgram();
-    glAttachShader(outlineProgram, vertexOutlineShader);
-    glAttachShader(outlineProgram, fragmentOutlineShader);
-    glLinkProgram(outlineProgram);
-
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if(!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        cout << "Error linking the shaders:\n" << infoLog <<  endl;
+    GLEngine::ProgramCache programCache(cacheDirectory);
+    if (options.clearShaderCache)
+        programCache.clear();
+    double programStart = glfwGetTime();
+    GLuint* programs[] = { &shaderProgram, &lightingVariants[(int)RenderPath::FORWARD][NPR_DEFAULT], &outlineProgram, &hiZProgram,
+                           &gBufferProgram, &shadowProgram };
+    for (int i = 0; i < PROGRAM_COUNT; i++)
+        *programs[i] = createProgram(programCache, shaderPath(programFiles[i][0]), shaderPath(programFiles[i][1]),
+                                     programDefines(i));
+    lightingVariantBuilt[(int)RenderPath::FORWARD][NPR_DEFAULT] = true;
+    programStartupMs = (float)((glfwGetTime() - programStart) * 1000.0);
+    const GLEngine::ProgramCacheStats& cacheStats = programCache.getStats();
+    cout << "Shader programs ready in " << programStartupMs << " ms (" << cacheStats.loaded << " from the cache, "
+         << cacheStats.compiled << " compiled)" << endl;
+
+    //Hot reload: without parallel compilation in the driver, a hidden window shares its objects
+    //with the main one so a thread can compile in its context
+    GLFWwindow* shaderWorkerWindow = NULL;
+    if (!GLEngine::ext::hasParallelShaderCompile()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        shaderWorkerWindow = glfwCreateWindow(1, 1, "Shader compilation", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
     }
+    function<void()> makeWorkerContextCurrent;
+    if (shaderWorkerWindow)
+        makeWorkerContextCurrent = [shaderWorkerWindow]() { glfwMakeContextCurrent(shaderWorkerWindow); };
+    unique_ptr<GLEngine::ShaderReloader> shaderReloader =
+        make_unique<GLEngine::ShaderReloader>(shaderPath(""), makeWorkerContextCurrent);
+    for (int i = 0; i < PROGRAM_COUNT; i++)
+        shaderReloader->watch(programs[i], { { GL_VERTEX_SHADER, programFiles[i][0] }, { GL_FRAGMENT_SHADER, programFiles[i][1] } },
+                              programDefines(i));
+    int shaderReloadCount = 0;
+
+    //Other lighting variants, from the cache when it has them
+    auto getLightingVariant = [&](RenderPath path, int features) {
+        GLuint& program = lightingVariants[(int)path][features];
+        if (!lightingVariantBuilt[(int)path][features]) {
+            lightingVariantBuilt[(int)path][features] = true;
+            const char* const* files = path == RenderPath::FORWARD ? programFiles[LIGHTING_PROGRAM] : deferredShadingFiles;
+            program = createProgram(programCache, shaderPath(files[0]), shaderPath(files[1]), nprDefines(features));
+            shaderReloader->watch(&program, { { GL_VERTEX_SHADER, files[0] }, { GL_FRAGMENT_SHADER, files[1] } }, nprDefines(features));
+        }
+        return program;
+    };
 
     glfwSetMouseButtonCallback(window, onMouseButton);
     glfwSetCursorPosCallback(window, onMouseMove);
     glfwSetScrollCallback(window, onMouseScroll);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetCharCallback(window, onChar);
+    glfwSetWindowFocusCallback(window, onWindowFocus);
+
+    //GPU memory of the meshes and the loaded textures, the least recently used ones are evicted
+    //beyond the budget
+    GLEngine::ResourceManager resources((size_t)options.gpuBudgetMB << 20);
+    int gpuBudgetMB = options.gpuBudgetMB;
+
+    //A mesh from the mesh cache, decoded straight into the geometry buffer, or parsed from its OBJ
+    //file then stored in the cache. Returns its size in the geometry buffer.
+    string meshCacheDirectory = options.meshCache ? options.meshCacheDirectory : "";
+    int meshesLoaded = 0, meshesFromCache = 0;
+    double slowestMeshMs = 0.0;
+    //Temporaries of the mesh processing, reset after every mesh: it keeps the storage of the largest one
+    GLEngine::Arena loadArena(1 << 20);
+    auto loadMesh = [&](size_t index, bool fromSource) {
+        double start = glfwGetTime();
+        LoadedMesh& mesh = meshes[index];
+        string objFile = availableObjFiles[index];
+        string cacheFile = meshCacheDirectory.empty() ? "" : meshCacheFile(meshCacheDirectory, objFile);
+        size_t vertexCount, indexCount;
+        if (!fromSource && !cacheFile.empty() && loadMeshCache(cacheFile, *geometry, mesh.id, vertexCount, indexCount, mesh.bounds,
+                                                                 mesh.meshlets, &threadPool))
+            meshesFromCache++;
+        else {
+            //Parsed arrays, freed once the mesh is in the geometry buffer and the cache
+            vector<float> vertices, normals;
+            vector<unsigned int> faces;
+            mesh.id = loadModel(objFile, vertices, faces, normals, *geometry, mesh.bounds, &mesh.meshlets, &loadArena);
+            loadArena.reset();
+            if (!cacheFile.empty())
+                saveMeshCache(cacheFile, vertices, normals, faces, mesh.bounds, mesh.meshlets, &threadPool);
+            vertexCount = vertices.size() / 3;
+            indexCount = faces.size();
+        }
+        mesh.meshletBounds.build(mesh.meshlets);
+        mesh.triangles = indexCount / 3;
+        meshesLoaded++;
+        slowestMeshMs = glm::max(slowestMeshMs, (glfwGetTime() - start) * 1000.0);
+        return vertexCount * 6 * sizeof(float) + indexCount * sizeof(unsigned int);
+    };
+
+    //Models of the library, their metadata from its index while their file is unchanged. Files
+    //that can't be read or have no triangle are left out.
+    string objDir = options.libraryDirectory.empty() ? string(_resources_directory) + "../objects" : options.libraryDirectory;
+    GLEngine::ModelLibrary library;
+    if (!library.scan(objDir, options.libraryIndexFile, &threadPool))
+        cerr << "Couldn't read the model library " << objDir << endl;
+    for (const GLEngine::ModelInfo& model : library.getModels()) {
+        if (!model.readable || model.triangleCount == 0)
+            continue;
+        availableModels.push_back(model);
+        availableObjFiles.push_back(objDir + "/" + model.path);
+    }
+    const GLEngine::ModelLibrary::Stats& libraryStats = library.getStats();
+    double megabyte = 1024.0 * 1024.0;
+    cout << "Library of " << availableModels.size() << " models in " << libraryStats.directories << " directories indexed in "
+         << fixed << setprecision(1) << libraryStats.totalMs << " ms (" << libraryStats.scanned << " files scanned, "
+         << libraryStats.scannedBytes / megabyte << " MB, " << libraryStats.files - libraryStats.scanned << " from the index)" << endl;
 
-    string objDir = string(_resources_directory) + "../objects/";
-    availableObjFiles = listObjFiles(objDir);
+    //Only the first model is loaded now, the others when a scene first uses them
     if (!availableObjFiles.empty()) {
         currentObjFile = availableObjFiles[0];
-        string fullPath = string(_resources_directory) + currentObjFile;
-        loadModel(fullPath, vertices, faces, texCoords, normals, VBO, EBO, normalVBO);
+        meshes.resize(availableObjFiles.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const GLEngine::ModelInfo& model = availableModels[i];
+            meshes[i].bounds = model.bounds;
+            meshes[i].triangles = model.triangleCount;
+            size_t bytes = model.vertexCount * 6 * sizeof(float) + model.triangleCount * 3 * sizeof(unsigned int);
+            GLEngine::ResourceManager::Callbacks callbacks;
+            callbacks.load = [&loadMesh, i]() { return loadMesh(i, false); };
+            callbacks.unload = [&geometry, i]() { geometry->removeMesh(meshes[i].id); };
+            meshes[i].resource = resources.add(GLEngine::ResourceManager::Kind::BUFFER, bytes, callbacks, false);
+        }
+        double meshStart = glfwGetTime();
+        size_t memoryBefore = processPeakMemory();
+        GLEngine::AllocationCount allocationsBefore = GLEngine::getAllocationCount();
+        resources.use(meshes[currentMesh].resource);
+        GLEngine::AllocationCount loadAllocations = GLEngine::getAllocationCount() - allocationsBefore;
+        //Load report: the peak memory is the process' one, it only grows with the meshes when they
+        //need more than the startup did so far
+        cout << "Meshes ready in " << (glfwGetTime() - meshStart) * 1000.0 << " ms ("
+             << meshesFromCache << " from the cache, " << meshesLoaded - meshesFromCache << " parsed, slowest "
+             << slowestMeshMs << " ms, " << meshes.size() - meshesLoaded << " loaded on first use), "
+             << (geometry->isPersistentlyMapped() ? "written into mapped buffers" : "uploaded with glBufferSubData")
+             << ", peak memory " << memoryBefore / megabyte << " -> " << processPeakMemory() / megabyte << " MB, "
+             << loadAllocations.count << " allocations (" << loadAllocations.bytes / megabyte << " MB)" << endl;
     } 
     else {
         cerr << "No .obj files found in " << objDir << endl;
         return -1;
     }
 
+    if (options.benchTextures > 0) {
+        benchmarkTextureLoading(threadPool, options.benchTextures, options.mipFilter);
+        glfwTerminate();
+        return 0;
+    }
+    if (options.benchMeshlets) {
+        benchmarkMeshlets(threadPool, availableObjFiles);
+        glfwTerminate();
+        return 0;
+    }
+    if (options.benchMeshFormats) {
+        benchmarkMeshFormats(threadPool, availableObjFiles);
+        glfwTerminate();
+        return 0;
+    }
+    if (options.benchLibrary) {
+        benchmarkLibrary(threadPool, objDir, options.libraryIndexFile);
+        glfwTerminate();
+        return 0;
+    }
+    GLuint hatchingTexture = createHatchingTexture(threadPool, options.textureCacheDirectory);
+    size_t hatchingBytes = getTextureMemorySize(hatchingTexture, GL_TEXTURE_2D_ARRAY);
+
+    //GPU time of each frame and idle CPU/GPU usage
+    //(released before the context is destroyed)
+    unique_ptr<GLEngine::GpuTimer> frameTimer = make_unique<GLEngine::GpuTimer>();
+    UsageMeter usageMeter;
+    double lastFrameTime = glfwGetTime();
+
+    //Hierarchical depth of the last frames for the occlusion culling, and the GPU time of each pass
+    unique_ptr<GLEngine::HiZCuller> hiZCuller = make_unique<GLEngine::HiZCuller>(hiZProgram);
+    unique_ptr<GLEngine::GpuTimer[]> passTimers = make_unique<GLEngine::GpuTimer[]>(PASS_COUNT);
+    //Everything but the light marker and the Hi-Z build, compared by the path benchmark
+    unique_ptr<GLEngine::GpuTimer> sceneTimer = make_unique<GLEngine::GpuTimer>();
+
+    //Images of a directory, decoded with their mip levels by the workers and uploaded a few rows at a time
+    //Once evicted, a texture is requested again when its thumbnail is shown
+    GLEngine::MipFilter mipFilter = options.mipFilter;
+    string mipmapCacheDirectory = options.textureCacheDirectory;
+    unique_ptr<GLEngine::TextureStreamer> textureStreamer = make_unique<GLEngine::TextureStreamer>(threadPool,
+        [mipFilter, mipmapCacheDirectory](const string& path, GLEngine::DecodedImage& image) {
+            return decodeTexture(path, image, mipFilter, mipmapCacheDirectory);
+        });
+    struct StreamedTexture {
+        string path;
+        GLuint texture;
+        uint32_t resource;
+    };
+    vector<StreamedTexture> streamedTextures;
+    char textureDirectory[512] = "";
+    auto requestTexture = [&](const string& file) {
+        size_t index = streamedTextures.size();
+        streamedTextures.push_back({ file, textureStreamer->request(file), 0 });
+        //Only the 1x1 placeholder until the streamer is done
+        GLEngine::ResourceManager::Callbacks callbacks;
+        callbacks.load = [&, index]() {
+            streamedTextures[index].texture = textureStreamer->request(streamedTextures[index].path);
+            return (size_t)4;
+        };
+        callbacks.unload = [&, index]() { glDeleteTextures(1, &streamedTextures[index].texture); };
+        callbacks.busy = [&, index]() { return !textureStreamer->isReady(streamedTextures[index].texture); };
+        streamedTextures[index].resource = resources.add(GLEngine::ResourceManager::Kind::TEXTURE, 4, callbacks);
+    };
+
+    //Scan of the streamed scene, its clusters read by the workers and paged in a GPU pool of fixed size
+    GLEngine::ClusterStreamer::Settings clusterSettings;
+    clusterSettings.poolBytes = (size_t)options.clusterBudgetMB << 20;
+    unique_ptr<GLEngine::ClusterStreamer> clusterStreamer = make_unique<GLEngine::ClusterStreamer>(threadPool, clusterSettings);
+    char clusterFilePath[512] = "";
+    if (!options.clusterFile.empty()) {
+        snprintf(clusterFilePath, sizeof(clusterFilePath), "%s", options.clusterFile.c_str());
+        if (clusterStreamer->open(options.clusterFile))
+            sceneType = SceneType::STREAMED;
+        else
+            cerr << "Couldn't open the cluster file " << options.clusterFile << endl;
+    }
+    uint64_t clusterUploadedBytes = 0;
+
+    //Meshes drawn by the scene (and the light marker), used every frame so they stay resident
+    vector<uint32_t> sceneMeshes;
+    auto useSceneMeshes = [&]() {
+        for (uint32_t mesh : sceneMeshes)
+            resources.use(meshes[mesh].resource);
+    };
+
+    //Lists of the stage lights of each cluster
+    unique_ptr<GLEngine::LightClusters> lightClusters = make_unique<GLEngine::LightClusters>();
+    unique_ptr<GLEngine::ShadowMap> shadowMap = make_unique<GLEngine::ShadowMap>(shadowCascades, shadowResolution);
+
+    //Deferred path
+    unique_ptr<GLEngine::GBuffer> gBuffer = make_unique<GLEngine::GBuffer>();
+    GLuint fullscreenVao;
+    glGenVertexArrays(1, &fullscreenVao);
+
+    //The path benchmark renders the bunny offscreen at fixed resolutions, without occlusion culling
+    //(its depth capture reads the window)
+    OffscreenTarget benchTarget;
+    string benchMeshName = currentObjFile;
+    if (pathBench.running) {
+        for (size_t i = 0; i < availableObjFiles.size(); i++) {
+            if (availableObjFiles[i].find("bunny") != string::npos) {
+                currentMesh = (int)i;
+                currentObjFile = benchMeshName = availableObjFiles[i];
+            }
+        }
+        sceneType = SceneType::SINGLE;
+        occlusionCulling = false;
+    }
+
+    //Frame rate cap and frames in flight
+    unique_ptr<GLEngine::FramePacer> framePacer = make_unique<GLEngine::FramePacer>(frameCap, maxFramesInFlight);
+    double lastFrameStatsPrint = glfwGetTime();
+
+    //View projection of the last culling
+    glm::mat4 lastViewProjection(0.0f);
+    //Meshlet culling tasks, kept between frames for their capacity
+    vector<MeshletCullJob> meshletJobs;
+
+    //Scratch data of a frame, reset when the next one begins. Once it has seen the largest frame it
+    //stops calling the heap.
+    GLEngine::Arena frameArena;
+    GLEngine::AllocationCount frameAllocations, frameAllocationStart = GLEngine::getAllocationCount();
+
     while(!glfwWindowShouldClose(window)){
 
+        //Nothing changed since the last frame: wait for an event instead of redrawing
+        if (renderOnDemand && framesToRedraw == 0 && !autoRotate) {
+            glfwWaitEventsTimeout(idleWaitTimeout);
+            framePacer->markIdle();
+            //A shader file saved meanwhile
+            if (hotReload) {
+                shaderReloader->update();
+                if (shaderReloader->getPendingCount() > 0 || shaderReloader->getReloadCount() != shaderReloadCount)
+                    requestRedraw();
+            }
+            //Still nothing: only wake up to refresh the statistics
+            if (framesToRedraw == 0 && !(showStats && usageMeter.refreshDue()))
+                continue;
+        }
+
+        framePacer->beginFrame();
+        frameArena.reset();
+        //Heap allocations of the previous frame (operator new only, ImGui and the driver call malloc)
+        GLEngine::AllocationCount allocationCount = GLEngine::getAllocationCount();
+        frameAllocations = allocationCount - frameAllocationStart;
+        frameAllocationStart = allocationCount;
+
+        //Programs rebuilt in the background are swapped in here, between two frames
+        if (hotReload) {
+            shaderReloader->update();
+            if (shaderReloader->getPendingCount() > 0 || shaderReloader->getReloadCount() != shaderReloadCount)
+                requestRedraw();
+            shaderReloadCount = shaderReloader->getReloadCount();
+            hiZCuller->setProgram(hiZProgram);
+        }
+
+        //Next rows of the textures being loaded
+        if (textureStreamer->getPendingCount() > 0) {
+            textureStreamer->update();
+            requestRedraw();
+        }
+        for (const GLEngine::TextureStreamer::Completed& done : textureStreamer->takeCompleted())
+            for (const StreamedTexture& streamed : streamedTextures)
+                if (streamed.texture == done.texture && resources.isResident(streamed.resource))
+                    resources.resize(streamed.resource, done.bytes);
+
+        double currentTime = glfwGetTime();
+        //Clamped so an animation doesn't jump after a long idle period
+        float deltaTime = glm::min((float)(currentTime - lastFrameTime), 0.1f);
+        lastFrameTime = currentTime;
+
         processInput(window);
 
+        if (autoRotate) {
+            modelRotationY += autoRotateSpeed * deltaTime;
+            if (modelRotationY > 360.0f)
+                modelRotationY -= 720.0f;
+            else if (modelRotationY < -360.0f)
+                modelRotationY += 720.0f;
+            instancesDirty = true;
+        }
+
+        usageMeter.update();
+
+        if (options.printFrameStats && currentTime - lastFrameStatsPrint >= 1.0) {
+            cout << "Frame time " << framePacer->getAverageMs() << " ms, jitter " << framePacer->getJitterMs()
+                 << " ms, max " << framePacer->getMaxMs() << " ms" << endl;
+            lastFrameStatsPrint = currentTime;
+        }
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -315,85 +786,492 @@ int main() {
         if(imgui_window){
             ImGui::Begin("OpenGL Project", &imgui_window);
 
+            if (ImGui::CollapsingHeader("Rendering")) {
+                if (ImGui::Checkbox("Render on demand", &renderOnDemand))
+                    requestRedraw();
+                ImGui::Checkbox("Show statistics", &showStats);
+                int path = (int)renderPath;
+                if (ImGui::Combo("Path", &path, "Forward\0Deferred\0")) {
+                    renderPath = (RenderPath)path;
+                    requestRedraw();
+                }
+
+                //Frame pacing
+                int vsync = (int)vsyncMode;
+                if (ImGui::Combo("VSync", &vsync, "Off\0On\0Adaptive\0"))
+                    vsyncMode = applySwapInterval((VSyncMode)vsync);
+                if (ImGui::SliderFloat("Frame cap", &frameCap, 0.0f, 240.0f, frameCap > 0.0f ? "%.0f fps" : "none"))
+                    framePacer->setFrameCap(frameCap);
+                if (ImGui::SliderInt("Frames in flight", &maxFramesInFlight, 1, GLEngine::FramePacer::MAX_FRAMES_IN_FLIGHT))
+                    framePacer->setMaxFramesInFlight(maxFramesInFlight);
+            }
+
+            if (ImGui::CollapsingHeader("Shaders")) {
+                ImGui::Checkbox("Reload when saved", &hotReload);
+                ImGui::Text("Compilation: %s, %s", GLEngine::ShaderReloader::getModeName(shaderReloader->getMode()),
+                            shaderReloader->isWatchingNatively() ? "inotify" : "polling");
+                ImGui::Text("Reloads: %d, compiling: %d", shaderReloader->getReloadCount(), shaderReloader->getPendingCount());
+                if (ImGui::Button("Reload all")) {
+                    shaderReloader->reloadAll();
+                    requestRedraw();
+                }
+            }
+
             if (ImGui::CollapsingHeader("Background")){
-                ImGui::ColorEdit3("Background color", backgroundColorArray);
+                if (ImGui::ColorEdit3("Background color", backgroundColorArray))
+                    requestRedraw();
                 backgroundColor = glm::vec3(backgroundColorArray[0], backgroundColorArray[1], backgroundColorArray[2]);
             }
 
             // Dragon
             if (ImGui::CollapsingHeader("Model")) {
                 //Showing the mesh or not
-                ImGui::Checkbox("Show mesh", &showMesh);
-                //Gets the name of the file by removing all the path before
-                if (ImGui::BeginCombo("Object file", currentObjFile.substr(currentObjFile.find_last_of("/") + 1).c_str())) {
-                    for (const string& file : availableObjFiles) {
-                        string filename = file.substr(file.find_last_of("/") + 1);
+                //In wireframe the meshlets facing away are seen too: the culling is redone without their cones
+                if (ImGui::Checkbox("Show mesh", &showMesh)) {
+                    instancesDirty = true;
+                    requestRedraw();
+                }
+                //The models by their path in the library, with the size and triangles the index knows, so
+                //a large one isn't loaded by mistake
+                if (ImGui::BeginCombo("Object file", availableModels[currentMesh].path.c_str())) {
+                    for (size_t i = 0; i < availableObjFiles.size(); i++) {
+                        const string& file = availableObjFiles[i];
+                        const GLEngine::ModelInfo& model = availableModels[i];
                         bool isSelected = currentObjFile == file;
-                        if (ImGui::Selectable(filename.c_str(), isSelected)) 
+                        if (ImGui::Selectable(model.path.c_str(), isSelected)) 
                             if (currentObjFile != file) {
+                                //Loaded by the new scene when it isn't in the geometry buffer
                                 currentObjFile = file;
-                                string fullPath = string(_resources_directory) + currentObjFile;
-                                loadModel(fullPath, vertices, faces, texCoords, normals, VBO, EBO, normalVBO);
+                                currentMesh = (int)i;
+                                instancesDirty = true;
+                                requestRedraw();
                             }
                         if (isSelected) 
                             ImGui::SetItemDefaultFocus();
+                        ImGui::SameLine();
+                        ImGui::TextDisabled("%.1f MB, %llu triangles%s", model.fileSize / megabyte,
+                                            (unsigned long long)model.triangleCount,
+                                            resources.isResident(meshes[i].resource) ? ", loaded" : "");
                     }
                     ImGui::EndCombo();
                 }
-                ImGui::ColorEdit3("Model color", dragonColorArray);
+                const GLEngine::ModelInfo& currentModel = availableModels[currentMesh];
+                glm::vec3 modelSize = currentModel.bounds.max - currentModel.bounds.min;
+                ImGui::Text("%llu vertices, %llu triangles, %.1f MB, size %.2f x %.2f x %.2f",
+                            (unsigned long long)currentModel.vertexCount, (unsigned long long)currentModel.triangleCount,
+                            currentModel.fileSize / megabyte, modelSize.x, modelSize.y, modelSize.z);
+                ImGui::Text("Normals: %s, texture coordinates: %s", currentModel.hasNormals() ? "yes" : "no",
+                            currentModel.hasTexCoords() ? "yes" : "no");
+                //Reading the file again, the mesh gets a new place in the geometry buffer
+                if (ImGui::Button("Reload model")) {
+                    geometry->removeMesh(meshes[currentMesh].id);
+                    resources.resize(meshes[currentMesh].resource, loadMesh(currentMesh, true));
+                    instancesDirty = true;
+                    requestRedraw();
+                }
+                bool changed = ImGui::ColorEdit3("Model color", dragonColorArray);
                 dragonColor = glm::vec3(dragonColorArray[0], dragonColorArray[1], dragonColorArray[2]);
-                ImGui::ColorEdit3("Outline color", outlineColorArray);
+                changed |= ImGui::ColorEdit3("Outline color", outlineColorArray);
                 outlineColor = glm::vec3(outlineColorArray[0], outlineColorArray[1], outlineColorArray[2]);
-                ImGui::SliderFloat("Outline Thickness", &outlineThickness, 0.0f, 0.1f);   
+                changed |= ImGui::SliderFloat("Outline Thickness", &outlineThickness, 0.0f, 0.1f);   
                 
-                ImGui::SliderFloat("Rotation X", &modelRotationX, -360.0f, 360.0f);
-                ImGui::SliderFloat("Rotation Y", &modelRotationY, -360.0f, 360.0f);
-                ImGui::SliderFloat("Rotation Z", &modelRotationZ, -360.0f, 360.0f);
+                changed |= ImGui::SliderFloat("Rotation X", &modelRotationX, -360.0f, 360.0f);
+                changed |= ImGui::SliderFloat("Rotation Y", &modelRotationY, -360.0f, 360.0f);
+                changed |= ImGui::SliderFloat("Rotation Z", &modelRotationZ, -360.0f, 360.0f);
+                ImGui::Checkbox("Auto-rotate", &autoRotate);
+                changed |= ImGui::SliderFloat("Rotation speed", &autoRotateSpeed, -180.0f, 180.0f);
+                if (changed) {
+                    instancesDirty = true;
+                    requestRedraw();
+                }
+            }
+
+            // Scene
+            if (ImGui::CollapsingHeader("Scene")) {
+                int type = (int)sceneType;
+                bool changed = ImGui::Combo("Scene type", &type, clusterStreamer->isOpen()
+                                            ? "Single model\0Stress test (shelves)\0Streamed scan\0"
+                                            : "Single model\0Stress test (shelves)\0");
+                sceneType = (SceneType)type;
+                if (sceneType == SceneType::STRESS)
+                    changed |= ImGui::SliderInt("Instances", &stressInstanceCount, 1, maxStressInstances, "%d",
+                                                ImGuiSliderFlags_Logarithmic);
+                ImGui::InputText("Cluster file", clusterFilePath, sizeof(clusterFilePath));
+                ImGui::SameLine();
+                if (ImGui::Button("Open")) {
+                    if (clusterStreamer->open(clusterFilePath))
+                        sceneType = SceneType::STREAMED;
+                    else {
+                        cerr << "Couldn't open the cluster file " << clusterFilePath << endl;
+                        if (sceneType == SceneType::STREAMED)
+                            sceneType = SceneType::SINGLE;
+                    }
+                    changed = true;
+                }
+                if (sceneType == SceneType::STREAMED) {
+                    //Pool usage, what is drawn at each level and what it waits for
+                    GLEngine::ClusterStreamer::Settings& streaming = clusterStreamer->getSettings();
+                    changed |= ImGui::SliderFloat("Error threshold (px)", &streaming.errorThreshold, 0.25f, 16.0f, "%.2f",
+                                                  ImGuiSliderFlags_Logarithmic);
+                    const GLEngine::ClusterStreamer::Stats& clusterStats = clusterStreamer->getStats();
+                    const GLEngine::ClusterFile& file = clusterStreamer->getFile();
+                    ImGui::Text("Scan: %zu triangles, %zu clusters, %u levels", file.getLeafTriangles(), clusterStats.clusters,
+                                file.getLevelCount());
+                    ImGui::Text("Pool: %.1f / %.1f MB, %zu clusters resident", clusterStats.poolUsed / (1024.0 * 1024.0),
+                                clusterStats.poolBytes / (1024.0 * 1024.0), clusterStats.resident);
+                    ImGui::Text("Drawn: %zu clusters, %zu triangles, %zu waiting for their children", clusterStats.drawnClusters,
+                                clusterStats.drawnTriangles, clusterStats.waiting);
+                    //Written in the frame arena, 21 characters per count at most
+                    size_t levelsSize = clusterStats.drawnPerLevel.size() * 21 + 1, written = 0;
+                    char* levels = frameArena.allocateArray<char>(levelsSize);
+                    levels[0] = '\0';
+                    for (size_t count : clusterStats.drawnPerLevel)
+                        written += snprintf(levels + written, levelsSize - written, written ? " %zu" : "%zu", count);
+                    ImGui::Text("  per level (leaves first): %s", levels);
+                    ImGui::Text("Reads: %zu in flight, %llu done (%.1f MB), %llu failed, %llu evictions", clusterStats.reading,
+                                (unsigned long long)clusterStats.reads, clusterStats.readBytes / (1024.0 * 1024.0),
+                                (unsigned long long)clusterStats.readFailures, (unsigned long long)clusterStats.evictions);
+                    ImGui::Text("Selection: %.3f ms", clusterStats.updateMs);
+                }
+                changed |= ImGui::Checkbox("Frustum culling", &frustumCulling);
+                changed |= ImGui::Checkbox("Occlusion culling (Hi-Z)", &occlusionCulling);
+                changed |= ImGui::Checkbox("Meshlet culling", &meshletCulling);
+                if (changed) {
+                    instancesDirty = true;
+                    requestRedraw();
+                }
             }
             
             // Light
             if (ImGui::CollapsingHeader("Light")) {
-                ImGui::SliderFloat3("Light position", lightPosArray, -100, 100);
+                bool changed = ImGui::SliderFloat3("Light position", lightPosArray, -100, 100);
                 lightPos = glm::vec3(lightPosArray[0], lightPosArray[1], lightPosArray[2]);
-                ImGui::ColorEdit3("Light Color", lightColorArray);
+                changed |= ImGui::ColorEdit3("Light Color", lightColorArray);
                 lightColor = glm::vec3(lightColorArray[0], lightColorArray[1], lightColorArray[2]);
+                if (ImGui::SliderInt("Stage lights", &stageLightCount, 0, maxStageLights)
+                    | ImGui::SliderFloat("Stage light radius", &stageLightRadius, 0.02f, 1.0f)
+                    | ImGui::SliderFloat("Stage light intensity", &stageLightIntensity, 0.0f, 2.0f)) {
+                    stageLightsDirty = true;
+                    changed = true;
+                }
+                changed |= ImGui::Checkbox("Cast shadows", &castShadows);
+                if (castShadows) {
+                    changed |= ImGui::SliderInt("Shadow cascades", &shadowCascades, 1, GLEngine::ShadowMap::MAX_CASCADES);
+                    int resolutionIndex = shadowResolution >= 4096 ? 2 : shadowResolution >= 2048 ? 1 : 0;
+                    if (ImGui::Combo("Shadow resolution", &resolutionIndex, "1024\0" "2048\0" "4096\0")) {
+                        shadowResolution = 1024 << resolutionIndex;
+                        changed = true;
+                    }
+                    ImGui::Text("Shadow map renders: %llu", (unsigned long long)shadowMap->getRenderCount());
+                }
+                if (changed)
+                    requestRedraw();
             }
 
             // NPR
             if (ImGui::CollapsingHeader("NPR settings")) {
-                ImGui::SliderInt("Color threshold", &colorThreshold, 1, 50);
-                ImGui::SliderFloat("Edge threshold", &edgeThreshold, 0.0f, 1.0f);
-                ImGui::ColorEdit3("Edges color", edgeColorArray);
+                bool changed = ImGui::SliderInt("Color threshold", &colorThreshold, 1, 50);
+                changed |= ImGui::SliderFloat("Edge threshold", &edgeThreshold, 0.0f, 1.0f);
+                changed |= ImGui::ColorEdit3("Edges color", edgeColorArray);
                 edgeColor = glm::vec3(edgeColorArray[0], edgeColorArray[1], edgeColorArray[2]);
-                ImGui::SliderInt("Dithering", &dithering, 1, 20);
-                ImGui::ColorEdit3("Dithering Color", ditheringColorArray);
+                changed |= ImGui::SliderInt("Dithering", &dithering, 1, 20);
+                changed |= ImGui::ColorEdit3("Dithering Color", ditheringColorArray);
                 ditheringColor = glm::vec3(ditheringColorArray[0], ditheringColorArray[1], ditheringColorArray[2]);
+                //Switching to another variant of the lighting program
+                ImGui::TextUnformatted("Effects:");
+                changed |= ImGui::CheckboxFlags("Specular", &nprFeatures, NPR_SPECULAR);
+                ImGui::SameLine();
+                changed |= ImGui::CheckboxFlags("Dithering##effect", &nprFeatures, NPR_DITHERING);
+                ImGui::SameLine();
+                changed |= ImGui::CheckboxFlags("Edges", &nprFeatures, NPR_EDGES);
+                ImGui::SameLine();
+                changed |= ImGui::CheckboxFlags("Hatching", &nprFeatures, NPR_HATCHING);
+                if (nprFeatures & NPR_HATCHING)
+                    changed |= ImGui::SliderFloat("Hatching density", &hatchingDensity, 1.0f, 20.0f);
+                if (changed)
+                    requestRedraw();
+            }
+
+            // Textures
+            if (ImGui::CollapsingHeader("Textures")) {
+                ImGui::InputTextWithHint("Directory", "Images to load (png, jpg, bmp, tga)", textureDirectory, sizeof(textureDirectory));
+                if (ImGui::Button("Load")) {
+                    vector<string> files = listImageFiles(textureDirectory);
+                    if (files.empty())
+                        cerr << "No images found in " << textureDirectory << endl;
+                    for (const string& file : files)
+                        requestTexture(file);
+                    requestRedraw();
+                }
+                //Textures still loading can't be deleted
+                ImGui::SameLine();
+                if (ImGui::Button("Clear") && textureStreamer->getPendingCount() == 0) {
+                    for (const StreamedTexture& streamed : streamedTextures) {
+                        if (resources.isResident(streamed.resource))
+                            glDeleteTextures(1, &streamed.texture);
+                        resources.remove(streamed.resource);
+                    }
+                    streamedTextures.clear();
+                }
+                const GLEngine::TextureStreamer::Stats& streamStats = textureStreamer->getStats();
+                ImGui::Text("%zu loaded, %zu loading, %zu failed, %.1f MB uploaded", streamStats.completed,
+                            textureStreamer->getPendingCount(), streamStats.failed, streamStats.uploadedBytes / (1024.0 * 1024.0));
+                ImGui::Text("Render thread: %.2f ms last frame, %.2f ms max", streamStats.lastUpdateMs, streamStats.maxUpdateMs);
+                //Only the visible thumbnails are used, the others may be evicted
+                ImGui::BeginChild("Thumbnails", ImVec2(0.0f, 220.0f));
+                ImVec2 thumbnailSize(48.0f, 48.0f);
+                for (size_t i = 0; i < streamedTextures.size(); i++) {
+                    if (i % 6 != 0)
+                        ImGui::SameLine();
+                    if (ImGui::IsRectVisible(thumbnailSize)) {
+                        resources.use(streamedTextures[i].resource);
+                        ImGui::Image((ImTextureID)(intptr_t)streamedTextures[i].texture, thumbnailSize);
+                    }
+                    else
+                        ImGui::Dummy(thumbnailSize);
+                }
+                ImGui::EndChild();
+            }
+
+            // GPU memory, then the host and GPU memory of every subsystem and asset
+            if (ImGui::CollapsingHeader("Memory")) {
+                if (ImGui::SliderInt("Budget (MB)", &gpuBudgetMB, 1, 4096, "%d", ImGuiSliderFlags_Logarithmic))
+                    resources.setBudget((size_t)gpuBudgetMB << 20);
+                const GLEngine::ResourceManager::Stats& memory = resources.getStats();
+                const double megabyte = 1024.0 * 1024.0;
+                char usage[64];
+                snprintf(usage, sizeof(usage), "%.1f / %.1f MB", memory.used / megabyte, memory.budget / megabyte);
+                ImGui::ProgressBar(memory.budget ? (float)memory.used / memory.budget : 1.0f, ImVec2(-1.0f, 0.0f), usage);
+                ImGui::Text("Meshes %.1f MB, textures %.1f MB, peak %.1f MB", memory.bufferBytes / megabyte,
+                            memory.textureBytes / megabyte, memory.peak / megabyte);
+                ImGui::Text("%zu of %zu resources resident", memory.resident, memory.count);
+                ImGui::Text("%llu evictions, %llu reloads", (unsigned long long)memory.evictions, (unsigned long long)memory.reloads);
+
+                //Heap (vector capacities) and GPU storage; a mesh's GPU bytes are part of the geometry buffer.
+                //The rows point to names kept elsewhere and live in the frame arena, so the panel doesn't
+                //allocate a string per model every frame.
+                struct MemoryRow {
+                    const char* name;
+                    GLEngine::MemoryUsage usage;
+                };
+                GLEngine::ArenaVector<MemoryRow> assets(frameArena);
+                assets.reserve(meshes.size() + streamedTextures.size());
+                GLEngine::MemoryUsage meshletUsage;
+                for (size_t i = 0; i < meshes.size(); i++) {
+                    GLEngine::MemoryUsage usage = meshes[i].meshletBounds.getMemoryUsage();
+                    usage.host += GLEngine::heapBytes(meshes[i].meshlets);
+                    meshletUsage += usage;
+                    if (resources.isResident(meshes[i].resource))
+                        usage.gpu = resources.getBytes(meshes[i].resource);
+                    assets.push_back({ availableModels[i].path.c_str(), usage });
+                }
+                for (const StreamedTexture& streamed : streamedTextures) {
+                    GLEngine::MemoryUsage usage;
+                    if (resources.isResident(streamed.resource))
+                        usage.gpu = resources.getBytes(streamed.resource);
+                    size_t slash = streamed.path.find_last_of("/\\");
+                    assets.push_back({ streamed.path.c_str() + (slash == string::npos ? 0 : slash + 1), usage });
+                }
+                GLEngine::MemoryUsage instanceUsage = instanceBvh.getMemoryUsage();
+                instanceUsage.host += GLEngine::heapBytes(instances) + GLEngine::heapBytes(instanceBounds)
+                                    + GLEngine::heapBytes(visibleInstances) + GLEngine::heapBytes(drawnInstances);
+                instanceUsage.gpu += instanceBufferBytes + shadowCasterBytes;
+                GLEngine::MemoryUsage commandUsage = drawCommands->getMemoryUsage();
+                commandUsage += lightingMeshletCommands->getMemoryUsage();
+                commandUsage += outlineMeshletCommands->getMemoryUsage();
+                commandUsage += shadowCommands->getMemoryUsage();
+                GLEngine::MemoryUsage shadowUsage, gBufferUsage;
+                shadowUsage.gpu = shadowMap->getMemorySize();
+                gBufferUsage.gpu = gBuffer->getMemorySize();
+                GLEngine::MemoryUsage textureUsage = textureStreamer->getMemoryUsage();
+                textureUsage.gpu += memory.textureBytes + hatchingBytes;
+                GLEngine::MemoryUsage arenaUsage;
+                arenaUsage.host = frameArena.getCapacity() + loadArena.getCapacity();
+                const MemoryRow subsystems[] = {
+                    { "Geometry buffer", geometry->getMemoryUsage() },
+                    { "Meshlets", meshletUsage },
+                    { "Instances", instanceUsage },
+                    { "Draw commands", commandUsage },
+                    { "Hi-Z culling", hiZCuller->getMemoryUsage() },
+                    { "Light clusters", lightClusters->getMemoryUsage() },
+                    { "Shadow maps", shadowUsage },
+                    { "G-buffer", gBufferUsage },
+                    { "Textures", textureUsage },
+                    { "Streamed scan", clusterStreamer->getMemoryUsage() },
+                    { "Frame and load arenas", arenaUsage }
+                };
+                GLEngine::MemoryUsage total;
+                for (const MemoryRow& row : subsystems)
+                    total += row.usage;
+                size_t resident = processResidentMemory();
+
+                auto memoryTable = [&](const char* id, const MemoryRow* rows, size_t count) {
+                    if (!ImGui::BeginTable(id, 3, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+                        return;
+                    ImGui::TableSetupColumn(id);
+                    ImGui::TableSetupColumn("Host (MB)");
+                    ImGui::TableSetupColumn("GPU (MB)");
+                    ImGui::TableHeadersRow();
+                    for (const MemoryRow* row = rows; row < rows + count; row++) {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(row->name);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.2f", row->usage.host / megabyte);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.2f", row->usage.gpu / megabyte);
+                    }
+                    ImGui::EndTable();
+                };
+                memoryTable("Subsystem", subsystems, size(subsystems));
+                ImGui::Text("Accounted: %.1f MB host, %.1f MB GPU", total.host / megabyte, total.gpu / megabyte);
+                ImGui::Text("Process: %.1f MB resident, peak %.1f MB", resident / megabyte, processPeakMemory() / megabyte);
+                if (ImGui::TreeNode("Assets")) {
+                    memoryTable("Asset", assets.data(), assets.size());
+                    ImGui::TreePop();
+                }
+                if (ImGui::Button("Print to the console")) {
+                    cout << fixed << setprecision(2) << left;
+                    auto printRows = [&](const MemoryRow* rows, size_t count) {
+                        for (const MemoryRow* row = rows; row < rows + count; row++)
+                            cout << setw(32) << row->name << right << setw(10) << row->usage.host / megabyte << " MB host"
+                                 << setw(10) << row->usage.gpu / megabyte << " MB GPU" << left << "\n";
+                    };
+                    printRows(subsystems, size(subsystems));
+                    printRows(assets.data(), assets.size());
+                    cout << right << "Accounted " << total.host / megabyte << " MB host, " << total.gpu / megabyte << " MB GPU; process "
+                         << resident / megabyte << " MB resident, peak " << processPeakMemory() / megabyte << " MB" << endl;
+                }
             }
 
             ImGui::End();
         }
-        
-        glStencilFunc(GL_ALWAYS, 1, 0xFF); 
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); 
-        glStencilMask(0xFF);
-        glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-        if(showMesh)
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        else
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        //Drawing the large dragon with the lighting effect
-        glUseProgram(lightingProgram);
+        //Errors of the last shader builds, the previous programs are still used meanwhile
+        if (hotReload && !shaderReloader->getErrors().empty()) {
+            ImGui::SetNextWindowSize(ImVec2(600.0f, 250.0f), ImGuiCond_FirstUseEver);
+            ImGui::Begin("Shader errors");
+            ImGui::TextUnformatted("The previous version of these programs is kept until they build:");
+            for (const GLEngine::ShaderReloader::Error& error : shaderReloader->getErrors()) {
+                ImGui::Separator();
+                ImGui::TextUnformatted(error.program.c_str());
+                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+                ImGui::TextWrapped("%s", error.log.c_str());
+                ImGui::PopStyleColor();
+            }
+            ImGui::End();
+        }
 
-        //Matrix transformations for the dragon
-        //Model matrix
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, glm::radians(modelRotationX), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(modelRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(modelRotationZ), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::translate(model, glm::vec3(0.0f, -0.3f, 0.0f));
+        if (showStats) {
+            //Overlay in the top right corner
+            ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 10.0f, 10.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+            ImGui::Begin("Statistics", &showStats, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings
+                                                   | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
+            ImGui::Text("Mode: %s", renderOnDemand ? (framesToRedraw > 0 || autoRotate ? "on demand (active)" : "on demand (idle)")
+                                                   : "continuous");
+            ImGui::Text("Rendered frames/s: %.1f", usageMeter.getRenderedFps());
+            ImGui::Text("Frame time: %.2f ms (max %.2f ms)", framePacer->getAverageMs(), framePacer->getMaxMs());
+            ImGui::Text("Frame time jitter: %.2f ms", framePacer->getJitterMs());
+            ImGui::Text("GPU frame time: %.2f ms", frameTimer->getLastMs());
+            ImGui::Text("CPU usage: %.1f %%", usageMeter.getCpuPercent());
+            ImGui::Text("GPU usage: %.1f %%", usageMeter.getGpuPercent());
+            ImGui::Text("Shader programs at startup: %.1f ms (%d cached, %d compiled)", programStartupMs,
+                        programCache.getStats().loaded, programCache.getStats().compiled);
+            ImGui::Text("Heap allocations last frame: %llu (%.1f KB), frame arena %.1f / %.1f KB",
+                        (unsigned long long)frameAllocations.count, frameAllocations.bytes / 1024.0, frameArena.getPeak() / 1024.0,
+                        frameArena.getCapacity() / 1024.0);
+            ImGui::Separator();
+            ImGui::Text("Instances: %zu (drawn %zu)", instances.size(), drawnInstances.size());
+            ImGui::Text("Triangles per pass: %zu", drawnTriangles + streamedTriangles);
+            ImGui::Text("Draw calls: %d (%s)", drawCalls, drawCommands->usesMultiDraw() ? "multi-draw indirect" : "one per mesh");
+            if (renderPath == RenderPath::DEFERRED)
+                ImGui::Text("G-buffer: %dx%d, %.1f MB", gBuffer->getWidth(), gBuffer->getHeight(),
+                            gBuffer->getMemorySize() / (1024.0 * 1024.0));
+            GLEngine::GeometryStats geometryStats = geometry->getStats();
+            ImGui::Text("Geometry: %zu meshes, %.1f MB, %s", geometryStats.meshCount, geometryStats.bytes / (1024.0 * 1024.0),
+                        geometryStats.persistentlyMapped ? "persistently mapped" : "glBufferSubData");
+            if (geometryStats.pendingFrees > 0)
+                ImGui::Text("  %zu removed meshes waiting for the GPU", geometryStats.pendingFrees);
+            ImGui::Text("  vertices %zu / %zu, %zu free blocks, fragmentation %.0f %%", geometryStats.vertexUsed,
+                        geometryStats.vertexCapacity, geometryStats.vertexFreeBlocks, geometryStats.vertexFragmentation * 100.0f);
+            ImGui::Text("  indices %zu / %zu, %zu free blocks, fragmentation %.0f %%", geometryStats.indexUsed,
+                        geometryStats.indexCapacity, geometryStats.indexFreeBlocks, geometryStats.indexFragmentation * 100.0f);
+            const GLEngine::ResourceManager::Stats& memory = resources.getStats();
+            ImGui::Text("GPU resources: %.1f / %.1f MB, %zu of %zu resident, %llu evictions", memory.used / (1024.0 * 1024.0),
+                        memory.budget / (1024.0 * 1024.0), memory.resident, memory.count, (unsigned long long)memory.evictions);
+            if (frustumCulling)
+                ImGui::Text("Frustum culling: %zu visible, %zu culled, %zu tested (%.2f ms)",
+                            cullingStats.visible, cullingStats.culled, cullingStats.tested, cullingMs);
+            if (occlusionCulling)
+                ImGui::Text("Occlusion culling: %zu occluded (%.2f ms, depth %dx%d%s)", occludedInstances, occlusionMs,
+                            hiZCuller->getWidth(), hiZCuller->getHeight(), hiZCuller->isReady() ? "" : ", waiting");
+            if (meshletCulling)
+                ImGui::Text("Meshlet culling: %zu instances, %zu meshlets, %zu outside, %zu back-facing, %zu front-facing (%.2f ms)",
+                            meshletInstances, meshletsTested, meshletsOutside, meshletsBackFacing, meshletsFrontFacing, meshletMs);
+
+            if (lightClusters->getLightCount() > 0)
+                ImGui::Text("Stage lights: %d, %zu in %d clusters (max %d), binning %.2f ms", lightClusters->getLightCount(),
+                            lightClusters->getReferenceCount(), lightClusters->getClusterCount(),
+                            lightClusters->getMaxClusterLights(), lightClusters->getBinningMs());
+
+            //Per pass: what was drawn, what the culling removed and the GPU time
+            size_t frustumCulled = frustumCulling ? cullingStats.culled : 0;
+            if (ImGui::BeginTable("Passes", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("Pass");
+                ImGui::TableSetupColumn("Drawn");
+                ImGui::TableSetupColumn("Frustum");
+                ImGui::TableSetupColumn("Occluded");
+                ImGui::TableSetupColumn("Triangles saved");
+                ImGui::TableSetupColumn("GPU ms");
+                ImGui::TableHeadersRow();
+                bool deferred = renderPath == RenderPath::DEFERRED;
+                for (int pass = 0; pass < PASS_COUNT; pass++) {
+                    //Only the passes of the current path
+                    bool forwardPass = pass == LIGHTING_PASS || pass == OUTLINE_PASS;
+                    bool deferredPass = pass == GBUFFER_PASS || pass == SHADING_PASS;
+                    if ((forwardPass && deferred) || (deferredPass && !deferred))
+                        continue;
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(renderPassNames[pass]);
+                    ImGui::TableNextColumn();
+                    if (pass == SHADOW_PASS) {
+                        //Casters drawn this frame, none while the stored maps are reused
+                        if (castShadows && shadowCascadesRendered == 0)
+                            ImGui::TextUnformatted("cached");
+                        else
+                            ImGui::Text("%zu", castShadows ? instances.size() * shadowCascadesRendered : 0);
+                        for (int column = 0; column < 3; column++) {
+                            ImGui::TableNextColumn();
+                            ImGui::TextUnformatted("-");
+                        }
+                    }
+                    else if (forwardPass || pass == GBUFFER_PASS) {
+                        ImGui::Text("%zu", drawnInstances.size());
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%zu", frustumCulled);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%zu", occludedInstances);
+                        ImGui::TableNextColumn();
+                        size_t passTriangles = (pass == OUTLINE_PASS ? outlineTriangles : drawnTriangles) + streamedTriangles;
+                        ImGui::Text("%zu", sceneTriangles - min(sceneTriangles, passTriangles));
+                    }
+                    else {
+                        ImGui::TextUnformatted(pass == LIGHT_MARKER_PASS || pass == SHADING_PASS ? "1" : "-");
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted("-");
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted("-");
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted("-");
+                    }
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", passTimers[pass].getLastMs());
+                }
+                ImGui::EndTable();
+            }
+            ImGui::End();
+        }
 
         //View matrix
         glm::mat4 view = glm::mat4(1.0f);
@@ -401,97 +1279,609 @@ int main() {
         view = orbitalCamera.getViewMatrix();
         
         //Projection matrix
+        //The scene is drawn in the window, or offscreen at the resolution of the path benchmark
+        GLuint sceneFramebuffer = 0;
+        int sceneWidth, sceneHeight;
+        glfwGetFramebufferSize(window, &sceneWidth, &sceneHeight);
+        if (pathBench.running) {
+            const int* resolution = benchResolutions[pathBench.configuration / 2];
+            if (benchTarget.width != resolution[0] || benchTarget.height != resolution[1]) {
+                deleteOffscreenTarget(benchTarget);
+                benchTarget = createOffscreenTarget(resolution[0], resolution[1]);
+            }
+            sceneFramebuffer = benchTarget.framebuffer;
+            sceneWidth = benchTarget.width;
+            sceneHeight = benchTarget.height;
+        }
+        sceneWidth = glm::max(sceneWidth, 1);
+        sceneHeight = glm::max(sceneHeight, 1);
+
         glm::mat4 projection = glm::mat4(1.0f);
         projection = glm::perspective(glm::radians(-45.0f), (float)width/(float)height, 0.1f, 100.0f);
-        projection = glm::perspective(orbitalCamera.getFov(), (float)width / (float)height, nearPlane, farPlane);
+        projection = glm::perspective(orbitalCamera.getFov(), (float)sceneWidth / (float)sceneHeight, nearPlane, farPlane);
+
+        //Depth of an earlier frame arrived from the GPU
+        bool newDepth = occlusionCulling && hiZCuller->pollReadback();
+
+        //Rebuilding the instances when a transform, a color or the scene changed
+        bool instancesChanged = instancesDirty;
+        bool streamedScene = sceneType == SceneType::STREAMED && clusterStreamer->isOpen();
+        if (instancesDirty) {
+            SceneParameters sceneParams;
+            sceneParams.type = sceneType;
+            sceneParams.instanceCount = stressInstanceCount;
+            sceneParams.rotation = glm::vec3(modelRotationX, modelRotationY, modelRotationZ);
+            sceneParams.color = dragonColor;
+            sceneParams.outlineColor = outlineColor;
+            sceneParams.outlineThickness = outlineThickness;
+            sceneParams.mesh = currentMesh;
+            buildInstances(sceneParams, instances);
+            if (streamedScene) {
+                streamedInstance = buildStreamedInstance(sceneParams, clusterStreamer->getFile().getBounds());
+                streamedBounds = clusterStreamer->getFile().getBounds().transformed(streamedInstance.model)
+                                                                       .expanded(streamedInstance.outlineThickness);
+            }
 
-        //Passing as uniforms
-        //Light position passed as uniform
-        int lightPosLoc = glGetUniformLocation(lightingProgram, "lightPos");
-        glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z);
+            //Meshes of the new scene, read again if they were evicted
+            vector<bool> inScene(meshes.size(), false);
+            inScene[currentMesh] = true;
+            for (const InstanceData& instance : instances)
+                inScene[instance.mesh] = true;
+            sceneMeshes.clear();
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+                if (inScene[mesh])
+                    sceneMeshes.push_back((uint32_t)mesh);
+            useSceneMeshes();
+
+            //World bounds, grown by the outline which is extruded in world space
+            instanceBounds.resize(instances.size());
+            sceneTriangles = 0;
+            for (size_t i = 0; i < instances.size(); i++) {
+                const LoadedMesh& mesh = meshes[instances[i].mesh];
+                instanceBounds[i] = mesh.bounds.transformed(instances[i].model).expanded(instances[i].outlineThickness);
+                sceneTriangles += mesh.triangles;
+            }
+            instanceBvh.build(instanceBounds);
+            sceneBounds = instanceBounds.empty() ? GLEngine::AABB() : instanceBounds[0];
+            for (const GLEngine::AABB& box : instanceBounds)
+                sceneBounds.merge(box);
+            if (streamedScene) {
+                sceneBounds = streamedBounds;
+                sceneTriangles = clusterStreamer->getFile().getLeafTriangles();
+            }
+            stageLightsDirty = true;
+
+            //Shadow casters grouped by mesh in one pass over the instances (counted, then placed in the
+            //scene order), drawn without culling
+            GLEngine::ArenaVector<uint32_t> casterFirst(meshes.size() + 1, 0, frameArena);
+            for (const InstanceData& instance : instances)
+                casterFirst[instance.mesh + 1]++;
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+                casterFirst[mesh + 1] += casterFirst[mesh];
+            GLEngine::ArenaVector<InstanceData> casters(instances.size(), frameArena);
+            GLEngine::ArenaVector<uint32_t> casterNext(casterFirst.begin(), casterFirst.end() - 1, frameArena);
+            for (const InstanceData& instance : instances)
+                casters[casterNext[instance.mesh]++] = instance;
+            shadowCommands->clear();
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+                if (casterFirst[mesh + 1] > casterFirst[mesh])
+                    shadowCommands->add(geometry->getMesh(meshes[mesh].id), casterFirst[mesh + 1] - casterFirst[mesh], casterFirst[mesh]);
+            shadowCommands->upload();
+            glBindBuffer(GL_ARRAY_BUFFER, shadowCasterVBO);
+            glBufferData(GL_ARRAY_BUFFER, casters.size() * sizeof(InstanceData), casters.data(), GL_STATIC_DRAW);
+            shadowCasterBytes = casters.size() * sizeof(InstanceData);
+            sceneVersion++;
+            instancesDirty = false;
+            //The depth captured so far shows the old instances
+            hiZCuller->invalidate();
+        }
+        useSceneMeshes();
+
+        //Culling, only redone when the camera, the instances or the occlusion depth changed
+        glm::mat4 viewProjection = projection * view;
+        if (instancesChanged || newDepth || viewProjection != lastViewProjection) {
+            drawnInstances.clear();
+            if (frustumCulling) {
+                double cullingStart = glfwGetTime();
+                instanceBvh.cull(GLEngine::Frustum::fromMatrix(viewProjection), visibleInstances, cullingStats, &threadPool);
+                //Keeping the scene order so the drawing order doesn't depend on the threads
+                sort(visibleInstances.begin(), visibleInstances.end());
+                cullingMs = (float)((glfwGetTime() - cullingStart) * 1000.0);
+            }
+            else {
+                visibleInstances.resize(instances.size());
+                for (size_t i = 0; i < instances.size(); i++)
+                    visibleInstances[i] = (uint32_t)i;
+            }
 
-        //Light color passed as uniform
-        int lightColorLoc = glGetUniformLocation(lightingProgram, "lightColor");
-        glUniform3f(lightColorLoc, lightColor.r, lightColor.g, lightColor.b);
+            visibleTriangles = 0;
+            for (uint32_t index : visibleInstances)
+                visibleTriangles += meshes[instances[index].mesh].triangles;
+
+            //Occlusion culling of what is left, against the previous depth reprojected in the current view
+            GLEngine::ArenaVector<uint32_t> keptInstances(frameArena);
+            keptInstances.reserve(visibleInstances.size());
+            occludedInstances = 0;
+            if (occlusionCulling) {
+                double occlusionStart = glfwGetTime();
+                hiZCuller->prepare(viewProjection);
+                for (uint32_t index : visibleInstances) {
+                    if (hiZCuller->isOccluded(instanceBounds[index]))
+                        occludedInstances++;
+                    else
+                        keptInstances.push_back(index);
+                }
+                occlusionMs = (float)((glfwGetTime() - occlusionStart) * 1000.0);
+            }
+            else
+                keptInstances.assign(visibleInstances.begin(), visibleInstances.end());
+
+            //Instances large enough on screen are culled by meshlet
+            glm::vec3 cameraPosition = orbitalCamera.getPosition();
+            float pixelsPerUnit = projection[1][1] * sceneHeight * 0.5f;
+            GLEngine::ArenaVector<uint8_t> byMeshlet(keptInstances.size(), 0, frameArena);
+            for (size_t k = 0; meshletCulling && k < keptInstances.size(); k++) {
+                if (meshes[instances[keptInstances[k]].mesh].meshlets.empty())
+                    continue;
+                const GLEngine::AABB& box = instanceBounds[keptInstances[k]];
+                float radius = glm::length(box.getExtent());
+                float distance = glm::max(glm::distance(cameraPosition, box.getCenter()) - radius, nearPlane);
+                byMeshlet[k] = radius * pixelsPerUnit / distance >= meshletCullingPixels;
+            }
 
-        //Current position of the camera
-        glm::vec3 viewPos = orbitalCamera.getPosition();
-        glUniform3f(glGetUniformLocation(lightingProgram, "viewPos"), viewPos.x, viewPos.y, viewPos.z);
+            //Instances grouped by mesh (keeping the scene order inside a group), one draw command per mesh
+            //for the whole ones, those culled by meshlet at the end of their group
+            GLEngine::ArenaVector<uint32_t> meshFirst(meshes.size() + 1, 0, frameArena), meshWhole(meshes.size(), 0, frameArena);
+            for (size_t k = 0; k < keptInstances.size(); k++) {
+                meshFirst[instances[keptInstances[k]].mesh + 1]++;
+                meshWhole[instances[keptInstances[k]].mesh] += !byMeshlet[k];
+            }
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+                meshFirst[mesh + 1] += meshFirst[mesh];
+            drawnInstances.resize(keptInstances.size());
+            GLEngine::ArenaVector<uint32_t> meshNext(meshFirst.begin(), meshFirst.end() - 1, frameArena);
+            GLEngine::ArenaVector<uint32_t> meshletNext(meshes.size(), frameArena);
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+                meshletNext[mesh] = meshFirst[mesh] + meshWhole[mesh];
+            for (size_t k = 0; k < keptInstances.size(); k++) {
+                uint32_t index = keptInstances[k];
+                uint32_t position = byMeshlet[k] ? meshletNext[instances[index].mesh]++ : meshNext[instances[index].mesh]++;
+                drawnInstances[position] = instances[index];
+                drawnInstances[position].object = position + 1;
+            }
+            //The streamed scan after them, its clusters are culled by the streamer
+            if (streamedScene) {
+                streamedInstanceIndex = (uint32_t)drawnInstances.size();
+                drawnInstances.push_back(streamedInstance);
+                drawnInstances.back().object = streamedInstanceIndex + 1;
+            }
 
-        //Color of the object (dragon)
-        glUniform3f(glGetUniformLocation(lightingProgram, "dragonColor"), dragonColor.r, dragonColor.g, dragonColor.b);
+            nearestDrawnDistance = farPlane;
+            for (uint32_t index : keptInstances) {
+                const GLEngine::AABB& box = instanceBounds[index];
+                float distance = glm::distance(cameraPosition, glm::clamp(cameraPosition, box.min, box.max));
+                nearestDrawnDistance = glm::min(nearestDrawnDistance, distance);
+            }
+            if (streamedScene)
+                nearestDrawnDistance = glm::min(nearestDrawnDistance, glm::distance(cameraPosition,
+                                                glm::clamp(cameraPosition, streamedBounds.min, streamedBounds.max)));
+            nearestDrawnDistance = glm::max(nearestDrawnDistance, nearPlane);
+
+            drawCommands->clear();
+            drawnTriangles = 0;
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+                uint32_t count = meshWhole[mesh];
+                if (count == 0)
+                    continue;
+                drawCommands->add(geometry->getMesh(meshes[mesh].id), count, meshFirst[mesh]);
+                drawnTriangles += count * meshes[mesh].triangles;
+            }
+            outlineTriangles = drawnTriangles;
+            meshCommandCount = drawCommands->size();
+
+            //Meshlets of the large instances, in parallel, then one command per run of consecutive visible
+            //meshlets. In wireframe every facing is seen.
+            double meshletStart = glfwGetTime();
+            meshletJobs.clear();
+            meshletInstances = 0;
+            meshletsTested = 0;
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+                meshletInstances += meshFirst[mesh + 1] - meshFirst[mesh] - meshWhole[mesh];
+                meshletsTested += (meshFirst[mesh + 1] - meshFirst[mesh] - meshWhole[mesh]) * meshes[mesh].meshlets.size();
+            }
+            GLEngine::ArenaVector<uint8_t> meshletVisibility(meshletsTested, frameArena);
+            size_t visibilityOffset = 0;
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+                for (uint32_t position = meshFirst[mesh] + meshWhole[mesh]; position < meshFirst[mesh + 1]; position++) {
+                    addMeshletCullJobs(meshletJobs, meshes[mesh].meshletBounds, drawnInstances[position].model,
+                                       drawnInstances[position].outlineThickness, meshletVisibility.data() + visibilityOffset);
+                    visibilityOffset += meshes[mesh].meshlets.size();
+                }
+            }
+            meshletsOutside = cullMeshlets(meshletJobs, GLEngine::Frustum::fromMatrix(viewProjection), cameraPosition,
+                                           !showMesh, &threadPool);
+
+            lightingMeshletCommands->clear();
+            outlineMeshletCommands->clear();
+            meshletsBackFacing = 0;
+            meshletsFrontFacing = 0;
+            visibilityOffset = 0;
+            for (size_t mesh = 0; mesh < meshes.size(); mesh++) {
+                if (meshFirst[mesh] + meshWhole[mesh] == meshFirst[mesh + 1])
+                    continue;
+                const vector<GLEngine::Meshlet>& meshlets = meshes[mesh].meshlets;
+                GLEngine::MeshRange range = geometry->getMesh(meshes[mesh].id);
+                for (uint32_t position = meshFirst[mesh] + meshWhole[mesh]; position < meshFirst[mesh + 1]; position++) {
+                    const uint8_t* visibility = meshletVisibility.data() + visibilityOffset;
+                    visibilityOffset += meshlets.size();
+                    for (uint8_t pass : { GLEngine::MeshletBounds::FRONT, GLEngine::MeshletBounds::BACK }) {
+                        bool lighting = pass == GLEngine::MeshletBounds::FRONT;
+                        for (size_t i = 0; i < meshlets.size();) {
+                            if (!(visibility[i] & pass)) {
+                                i++;
+                                continue;
+                            }
+                            size_t end = i + 1;
+                            while (end < meshlets.size() && (visibility[end] & pass))
+                                end++;
+                            GLEngine::MeshRange run = range;
+                            run.firstIndex += meshlets[i].firstIndex;
+                            run.indexCount = meshlets[end - 1].firstIndex + 3 * meshlets[end - 1].triangleCount - meshlets[i].firstIndex;
+                            (lighting ? lightingMeshletCommands : outlineMeshletCommands)->add(run, 1, position);
+                            (lighting ? drawnTriangles : outlineTriangles) += run.indexCount / 3;
+                            i = end;
+                        }
+                    }
+                    for (size_t i = 0; i < meshlets.size(); i++) {
+                        meshletsBackFacing += visibility[i] == GLEngine::MeshletBounds::BACK;
+                        meshletsFrontFacing += visibility[i] == GLEngine::MeshletBounds::FRONT;
+                    }
+                }
+            }
+            lightingMeshletCommands->upload();
+            outlineMeshletCommands->upload();
+            meshletMs = (float)((glfwGetTime() - meshletStart) * 1000.0);
+            //The light marker comes right after the models
+            drawCommands->add(geometry->getMesh(meshes[currentMesh].id), 1, (uint32_t)drawnInstances.size());
+            drawCommands->upload();
+
+            //One more instance for the light marker, written every frame
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, (drawnInstances.size() + 1) * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+            instanceBufferBytes = (drawnInstances.size() + 1) * sizeof(InstanceData);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, drawnInstances.size() * sizeof(InstanceData), drawnInstances.data());
+            lastViewProjection = viewProjection;
+        }
 
-        //Dithering (and dithering color) of the dragon
-        glUniform1iv(glGetUniformLocation(lightingProgram, "dithering"), 1, &dithering);
-        glUniform3f(glGetUniformLocation(lightingProgram, "ditheringColor"), ditheringColor.r, ditheringColor.g, ditheringColor.b);
+        //Clusters of the scan for this view, the arrived ones uploaded: redrawn until nothing is on its way
+        streamedTriangles = 0;
+        if (streamedScene) {
+            clusterStreamer->update(streamedInstance.model, viewProjection, orbitalCamera.getPosition(),
+                                    projection[1][1] * sceneHeight * 0.5f);
+            const GLEngine::ClusterStreamer::Stats& clusterStats = clusterStreamer->getStats();
+            if (clusterStats.reading > 0 || clusterStats.uploadedBytes != clusterUploadedBytes)
+                requestRedraw();
+            clusterUploadedBytes = clusterStats.uploadedBytes;
+            streamedTriangles = clusterStats.drawnTriangles;
+        }
 
-        glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniform1iv(glGetUniformLocation(lightingProgram, "nbColors"), 1, &colorThreshold);
-        glUniform1fv(glGetUniformLocation(lightingProgram, "edgeThreshold"), 1, &edgeThreshold);
-        glUniform3f(glGetUniformLocation(lightingProgram, "edgeColor"), edgeColor.r, edgeColor.g, edgeColor.b);
+        //Stage lights, placed again when the scene or their settings changed, binned for this view
+        if (lightBench.running && stageLightCount != benchLightCounts[lightBench.configuration]) {
+            stageLightCount = benchLightCounts[lightBench.configuration];
+            stageLightsDirty = true;
+        }
+        if (stageLightsDirty) {
+            buildStageLights(stageLightCount, sceneBounds, stageLightRadius, stageLightIntensity, stageLights);
+            stageLightsDirty = false;
+        }
+        lightClusters->update(stageLights, view, orbitalCamera.getFov(), sceneWidth, sceneHeight, nearPlane, farPlane, &threadPool);
+
+        frameTimer->begin();
+
+        //Shadow map: only the cascades whose view or casters changed, nothing in a static frame
+        drawCalls = 0;
+        shadowCascadesRendered = 0;
+        passTimers[SHADOW_PASS].begin();
+        if (castShadows) {
+            shadowMap->configure(shadowCascades, shadowResolution);
+            unsigned int cascadesToRender = shadowMap->prepare(lightPos, sceneBounds, sceneVersion, view, orbitalCamera.getFov(),
+                                                               (float)sceneWidth / (float)sceneHeight, nearPlane, farPlane);
+            if (cascadesToRender) {
+                glBindVertexArray(geometry->getVertexArray());
+                setupInstanceAttributes(shadowCasterVBO);
+                glUseProgram(shadowProgram);
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                //Depth bias growing with the slope, against shadow acne
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(2.0f, 4.0f);
+                for (int cascade = 0; cascade < shadowMap->getCascadeCount(); cascade++) {
+                    if (!(cascadesToRender & (1u << cascade)))
+                        continue;
+                    shadowMap->beginCascade(cascade);
+                    glUniformMatrix4fv(glGetUniformLocation(shadowProgram, "lightViewProjection"), 1, GL_FALSE,
+                                       glm::value_ptr(shadowMap->getViewProjection(cascade)));
+                    drawCalls += shadowCommands->draw(setShadowBaseInstance);
+                    shadowCascadesRendered++;
+                }
+                glDisable(GL_POLYGON_OFFSET_FILL);
+                setupInstanceAttributes(instanceVBO);
+                glBindVertexArray(0);
+            }
+        }
+        passTimers[SHADOW_PASS].end();
 
-        //Bind the dragon's VAO and draw it
+        sceneTimer->begin();
         
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, faces.size(), GL_UNSIGNED_INT, 0);
-
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF); 
-        glStencilMask(0x00); 
-        glDisable(GL_DEPTH_TEST);
-        glUseProgram(outlineProgram);
-
-        //Passing as uniforms
-        glUniformMatrix4fv(glGetUniformLocation(outlineProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(outlineProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(outlineProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniform3f(glGetUniformLocation(outlineProgram, "outlineColor"), outlineColor.r, outlineColor.g, outlineColor.b);
-        glUniform1f(glGetUniformLocation(outlineProgram, "outlineThickness"), outlineThickness);
-        glDrawElements(GL_TRIANGLES, faces.size(), GL_UNSIGNED_INT, 0);
-        glEnable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        glViewport(0, 0, sceneWidth, sceneHeight);
+        glStencilFunc(GL_ALWAYS, 1, 0xFF); 
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); 
+        glStencilMask(0xFF);
+
+        if(showMesh)
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        else
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+        //Lighting program of the current path, in the variant of the enabled NPR effects
+        RenderPath activePath = pathBench.running ? benchmarkPath(pathBench.configuration) : renderPath;
+        int activeFeatures = variantBench.running ? variantBench.configuration : nprFeatures;
+        GLuint lightingProgram = getLightingVariant(activePath, activeFeatures);
+        glm::vec3 viewPos = orbitalCamera.getPosition();
+
+        //Uniforms of the NPR effects, the same in both paths
+        auto setLightingUniforms = [&]() {
+            //Light position and color passed as uniform
+            glUniform3f(glGetUniformLocation(lightingProgram, "lightPos"), lightPos.x, lightPos.y, lightPos.z);
+            glUniform3f(glGetUniformLocation(lightingProgram, "lightColor"), lightColor.r, lightColor.g, lightColor.b);
+
+            //Current position of the camera
+            glUniform3f(glGetUniformLocation(lightingProgram, "viewPos"), viewPos.x, viewPos.y, viewPos.z);
+
+            //Dithering (and dithering color) of the dragon
+            glUniform1iv(glGetUniformLocation(lightingProgram, "dithering"), 1, &dithering);
+            glUniform3f(glGetUniformLocation(lightingProgram, "ditheringColor"), ditheringColor.r, ditheringColor.g, ditheringColor.b);
+
+            glUniform1iv(glGetUniformLocation(lightingProgram, "nbColors"), 1, &colorThreshold);
+            glUniform1fv(glGetUniformLocation(lightingProgram, "edgeThreshold"), 1, &edgeThreshold);
+            glUniform3f(glGetUniformLocation(lightingProgram, "edgeColor"), edgeColor.r, edgeColor.g, edgeColor.b);
+
+            //Hatching tones, the density is relative to the size of the current model
+            if (activeFeatures & NPR_HATCHING) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, hatchingTexture);
+                glUniform1i(glGetUniformLocation(lightingProgram, "hatching"), 0);
+                const GLEngine::AABB& modelBounds = streamedScene ? clusterStreamer->getFile().getBounds() : meshes[currentMesh].bounds;
+                glm::vec3 modelSize = modelBounds.max - modelBounds.min;
+                float modelExtent = glm::max(modelSize.x, glm::max(modelSize.y, modelSize.z));
+                glUniform1f(glGetUniformLocation(lightingProgram, "hatchingScale"), hatchingDensity / glm::max(modelExtent, 1e-6f));
+            }
+
+            //Stage lights on the units 5 to 7, after the G-buffer ones, then the shadow map
+            lightClusters->bind(lightingProgram, 5);
+            shadowMap->bind(lightingProgram, 8, castShadows);
+        };
+
+        //The streamed scan has its own buffers, and its instance declared for them
+        auto drawStreamedScan = [&]() {
+            if (!streamedScene)
+                return;
+            glBindVertexArray(clusterStreamer->getVertexArray());
+            setupInstanceAttributes(instanceVBO, streamedInstanceIndex);
+            drawCalls += clusterStreamer->draw();
+            glBindVertexArray(geometry->getVertexArray());
+        };
+
+        glBindVertexArray(geometry->getVertexArray());
+        if (activePath == RenderPath::FORWARD) {
+            glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+            //Drawing the large dragon with the lighting effect
+            glUseProgram(lightingProgram);
+
+            //Matrix transformations for the dragon
+            //The model matrices are per instance (instanceVBO), view and projection are computed above
+            glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            setLightingUniforms();
+
+            //Draw every instance of every mesh
+            passTimers[LIGHTING_PASS].begin();
+            drawCalls += drawCommands->draw(0, meshCommandCount, setBaseInstance);
+            drawCalls += lightingMeshletCommands->draw(setBaseInstance);
+            drawStreamedScan();
+            passTimers[LIGHTING_PASS].end();
+
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF); 
+            glStencilMask(0x00); 
+            glDisable(GL_DEPTH_TEST);
+            glUseProgram(outlineProgram);
+
+            //Passing as uniforms (outline color and thickness are per instance)
+            glUniformMatrix4fv(glGetUniformLocation(outlineProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(outlineProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            passTimers[OUTLINE_PASS].begin();
+            drawCalls += drawCommands->draw(0, meshCommandCount, setBaseInstance);
+            drawCalls += outlineMeshletCommands->draw(setBaseInstance);
+            drawStreamedScan();
+            passTimers[OUTLINE_PASS].end();
+            glEnable(GL_DEPTH_TEST);
+        }
+        else {
+            //Geometry pass: normals and object ids only, the models mark the stencil as in forward
+            gBuffer->resize(sceneWidth, sceneHeight);
+            gBuffer->bindForGeometry();
+            glUseProgram(gBufferProgram);
+            glUniformMatrix4fv(glGetUniformLocation(gBufferProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(gBufferProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            passTimers[GBUFFER_PASS].begin();
+            drawCalls += drawCommands->draw(0, meshCommandCount, setBaseInstance);
+            drawCalls += lightingMeshletCommands->draw(setBaseInstance);
+            drawStreamedScan();
+            passTimers[GBUFFER_PASS].end();
+
+            //Shading pass: every pixel once, outlines included
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_STENCIL_TEST);
+            glUseProgram(lightingProgram);
+            setLightingUniforms();
+            const GLuint gBufferTextures[3] = { gBuffer->getNormalTexture(), gBuffer->getObjectTexture(), gBuffer->getDepthTexture() };
+            const char* gBufferSamplers[3] = { "normals", "objects", "depths" };
+            for (int i = 0; i < 3; i++) {
+                glActiveTexture(GL_TEXTURE1 + i);
+                glBindTexture(GL_TEXTURE_2D, gBufferTextures[i]);
+                glUniform1i(glGetUniformLocation(lightingProgram, gBufferSamplers[i]), 1 + i);
+            }
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+            glUniform1i(glGetUniformLocation(lightingProgram, "instances"), 4);
+            glActiveTexture(GL_TEXTURE0);
+
+            float pixelsPerUnit = projection[1][1] * sceneHeight * 0.5f;
+            //Search radius of the outlines: their thickness seen from the nearest drawn instance
+            int outlineRadius = (int)glm::clamp(glm::ceil(outlineThickness * pixelsPerUnit / nearestDrawnDistance), 0.0f, 16.0f);
+            glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+            glUniformMatrix4fv(glGetUniformLocation(lightingProgram, "inverseViewProjection"), 1, GL_FALSE, glm::value_ptr(inverseViewProjection));
+            glUniform1f(glGetUniformLocation(lightingProgram, "pixelsPerUnit"), pixelsPerUnit);
+            glUniform1f(glGetUniformLocation(lightingProgram, "nearPlane"), nearPlane);
+            glUniform1f(glGetUniformLocation(lightingProgram, "farPlane"), farPlane);
+            glUniform1i(glGetUniformLocation(lightingProgram, "outlineRadius"), outlineRadius);
+            glUniform3f(glGetUniformLocation(lightingProgram, "backgroundColor"), backgroundColor.r, backgroundColor.g, backgroundColor.b);
+
+            passTimers[SHADING_PASS].begin();
+            glBindVertexArray(fullscreenVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(geometry->getVertexArray());
+            passTimers[SHADING_PASS].end();
+            drawCalls++;
+
+            //Depth and stencil for the light marker and the Hi-Z capture, then the same state as after the outline pass
+            gBuffer->blitDepth(sceneFramebuffer);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF); 
+            glStencilMask(0x00); 
+            glEnable(GL_DEPTH_TEST);
+            if (showMesh)
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        }
+        sceneTimer->end();
 
         //Base shader for the light source (little dragon)
         glUseProgram(shaderProgram);
 
-        //Matrix transformations for the little dragon
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, lightPos);
-        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.2f));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+        //Matrix transformations for the little dragon, its only instance
+        InstanceData lightInstance = {};
+        lightInstance.model = glm::translate(glm::mat4(1.0f), lightPos);
+        lightInstance.model = glm::rotate(lightInstance.model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        lightInstance.model = glm::scale(lightInstance.model, glm::vec3(0.2f));
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, drawnInstances.size() * sizeof(InstanceData), sizeof(InstanceData), &lightInstance);
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-        //Normal VAO
-        glBindVertexArray(lightingVAO);
-        glDrawElements(GL_TRIANGLES, faces.size(), GL_UNSIGNED_INT, 0);
+        //Same VAO, last draw command
+        passTimers[LIGHT_MARKER_PASS].begin();
+        drawCalls += drawCommands->draw(meshCommandCount, 1, setBaseInstance);
+        passTimers[LIGHT_MARKER_PASS].end();
+        glBindVertexArray(0);
+
+        //Depth pyramid of this frame for the occlusion culling of the next ones
+        if (occlusionCulling) {
+            passTimers[HIZ_PASS].begin();
+            hiZCuller->captureDepth(sceneWidth, sceneHeight, viewProjection);
+            passTimers[HIZ_PASS].end();
+        }
+
+        //The benchmark renders offscreen, its picture is scaled down in the window
+        if (sceneFramebuffer) {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, framebufferWidth, framebufferHeight);
+        }
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        frameTimer->end();
 
         glfwSwapBuffers(window);
+        framePacer->endFrame();
+        resources.endFrame();
+        if (framesToRedraw > 0)
+            framesToRedraw--;
         glfwPollEvents();
+
+        frameTimer->poll();
+        //The lighting of the variants is the shading pass in deferred
+        int shadingPass = renderPath == RenderPath::DEFERRED ? SHADING_PASS : LIGHTING_PASS;
+        bool shadingTimed = false;
+        for (int pass = 0; pass < PASS_COUNT; pass++)
+            if (passTimers[pass].poll() && pass == shadingPass)
+                shadingTimed = true;
+        bool sceneTimed = sceneTimer->poll();
+        usageMeter.frameRendered(frameTimer->takeCompletedMs());
+
+        if (variantBench.running && !advanceBenchmark(variantBench, shadingTimed, passTimers[shadingPass].getLastMs())) {
+            printVariantBenchmark(variantBench, renderPath, sceneWidth, sceneHeight);
+            glfwSetWindowShouldClose(window, true);
+        }
+        if (pathBench.running && !advanceBenchmark(pathBench, sceneTimed, sceneTimer->getLastMs())) {
+            printPathBenchmark(pathBench, benchMeshName);
+            glfwSetWindowShouldClose(window, true);
+        }
+        if (lightBench.running && !advanceBenchmark(lightBench, shadingTimed, passTimers[shadingPass].getLastMs(),
+                                                    lightClusters->getBinningMs())) {
+            printLightBenchmark(lightBench, renderPath, sceneWidth, sceneHeight);
+            glfwSetWindowShouldClose(window, true);
+        }
     }
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteVertexArrays(1, &lightingVAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &normalVBO);
-    glDeleteBuffers(1, &EBO);
+    //Joins the compilation thread before its context is destroyed
+    shaderReloader.reset();
+    if (shaderWorkerWindow)
+        glfwDestroyWindow(shaderWorkerWindow);
+    frameTimer.reset();
+    framePacer.reset();
+    passTimers.reset();
+    sceneTimer.reset();
+    lightClusters.reset();
+    textureStreamer.reset();
+    clusterStreamer.reset();
+    for (const StreamedTexture& streamed : streamedTextures)
+        if (resources.isResident(streamed.resource))
+            glDeleteTextures(1, &streamed.texture);
+    shadowMap.reset();
+    shadowCommands.reset();
+    glDeleteBuffers(1, &shadowCasterVBO);
+    gBuffer.reset();
+    deleteOffscreenTarget(benchTarget);
+    glDeleteVertexArrays(1, &fullscreenVao);
+    glDeleteTextures(1, &instanceTexture);
+    hiZCuller.reset();
+    geometry.reset();
+    drawCommands.reset();
+    lightingMeshletCommands.reset();
+    outlineMeshletCommands.reset();
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteTextures(1, &hatchingTexture);
     glDeleteProgram(shaderProgram);
-    glDeleteProgram(lightingProgram);
+    for (int path = 0; path < 2; path++)
+        for (int i = 0; i < NPR_VARIANT_COUNT; i++)
+            glDeleteProgram(lightingVariants[path][i]);
+    glDeleteProgram(gBufferProgram);
     glDeleteProgram(outlineProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    glDeleteShader(vertexNormalShader);
-    glDeleteShader(fragmentNormalShader);
-    glDeleteShader(vertexOutlineShader);
-    glDeleteShader(fragmentOutlineShader);
+    glDeleteProgram(hiZProgram);
+    glDeleteProgram(shadowProgram);
     glfwTerminate();
 
 #ifdef __APPLE__
@@ -504,6 +1894,799 @@ int main() {
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    requestRedraw();
+}
+
+//Setting the swap interval, adaptive vsync falls back to vsync on when not supported
+VSyncMode applySwapInterval(VSyncMode mode) {
+    if (mode == VSyncMode::ADAPTIVE) {
+        if (glfwExtensionSupported("GLX_EXT_swap_control_tear") || glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+            glfwSwapInterval(-1);
+            return mode;
+        }
+        cerr << "Adaptive vsync is not supported, using vsync on" << endl;
+        mode = VSyncMode::ON;
+    }
+    glfwSwapInterval(mode == VSyncMode::ON ? 1 : 0);
+    return mode;
+}
+
+string shaderPath(const string& file) {
+    return string(_resources_directory) + "shaders/" + file;
+}
+
+//Startup time of the programs without cache, with an empty cache (compiling and storing) and with a filled one
+void benchmarkShaderCache(const string& cacheDirectory) {
+    const int warmRuns = 5;
+    auto createAll = [](GLEngine::ProgramCache& cache) {
+        double start = glfwGetTime();
+        GLuint programs[PROGRAM_COUNT];
+        for (int i = 0; i < PROGRAM_COUNT; i++)
+            programs[i] = createProgram(cache, shaderPath(programFiles[i][0]), shaderPath(programFiles[i][1]), programDefines(i));
+        double elapsed = (glfwGetTime() - start) * 1000.0;
+        for (int i = 0; i < PROGRAM_COUNT; i++)
+            glDeleteProgram(programs[i]);
+        return elapsed;
+    };
+
+    GLEngine::ProgramCache uncached("");
+    double sourceMs = createAll(uncached);
+
+    GLEngine::ProgramCache cold(cacheDirectory);
+    if (!cold.isEnabled()) {
+        cerr << "The shader cache is unavailable (no program binary format, or " << cacheDirectory << " can't be created)" << endl;
+        return;
+    }
+    cold.clear();
+    double coldMs = createAll(cold);
+
+    double warmMs = 1e9;
+    int loaded = 0;
+    for (int run = 0; run < warmRuns; run++) {
+        GLEngine::ProgramCache warm(cacheDirectory);
+        warmMs = glm::min(warmMs, createAll(warm));
+        loaded = warm.getStats().loaded;
+    }
+
+    cout << "Shader programs (" << PROGRAM_COUNT << "), cache in " << cacheDirectory << "\n"
+         << "  from source:  " << sourceMs << " ms\n"
+         << "  cold cache:   " << coldMs << " ms (" << cold.getStats().stored << " binaries stored)\n"
+         << "  warm cache:   " << warmMs << " ms (" << loaded << " binaries loaded, best of " << warmRuns << ")\n"
+         << "The driver may have its own shader cache (Mesa: MESA_SHADER_CACHE_DISABLE=true to measure without it)" << endl;
+}
+
+//Loading time of images decoded and uploaded on the render thread (loadTexture), then streamed
+//(decoded by the workers, uploaded through the pixel buffer ring of the streamer), then the time of
+//their mip levels: glGenerateMipmap against every CPU filter on one thread and on the workers
+void benchmarkTextureLoading(GLEngine::ThreadPool& threadPool, int count, GLEngine::MipFilter filter) {
+    const int size = 512;
+    filesystem::path directory = filesystem::temp_directory_path() / "opengl-project-texture-bench";
+    std::error_code error;
+    filesystem::create_directories(directory, error);
+    vector<string> files;
+    vector<unsigned char> pixels(size * size * 3);
+    for (int i = 0; i < count; i++) {
+        string file = (directory / ("texture" + to_string(i) + ".png")).string();
+        files.push_back(file);
+        if (filesystem::exists(file))
+            continue;
+        //Noise over a gradient, so the files don't compress to nothing
+        uint32_t state = 2654435761u * (i + 1);
+        for (int p = 0; p < size * size; p++) {
+            state = state * 1664525u + 1013904223u;
+            for (int c = 0; c < 3; c++)
+                pixels[p * 3 + c] = (unsigned char)(((p % size) * (c + 1) + i * 37 + (state >> (8 * c + 8) & 31)) & 255);
+        }
+        if (!stbi_write_png(file.c_str(), size, size, 3, pixels.data(), size * 3)) {
+            cerr << "Can't write the benchmark textures in " << directory << endl;
+            return;
+        }
+    }
+
+    double start = glfwGetTime();
+    vector<GLuint> textures;
+    for (const string& file : files)
+        textures.push_back(loadTexture(file.c_str(), filter));
+    glFinish();
+    double syncMs = (glfwGetTime() - start) * 1000.0;
+    glDeleteTextures((GLsizei)textures.size(), textures.data());
+    textures.clear();
+
+    //The render thread only spends the update() calls, the rest of the time it could draw frames
+    GLEngine::TextureStreamer streamer(threadPool, [filter](const string& path, GLEngine::DecodedImage& image) {
+        return decodeTexture(path, image, filter, "");
+    });
+    start = glfwGetTime();
+    for (const string& file : files)
+        textures.push_back(streamer.request(file));
+    int updates = 0;
+    double updateMs = 0.0;
+    while (streamer.getPendingCount() > 0) {
+        streamer.update();
+        glFlush();
+        updateMs += streamer.getStats().lastUpdateMs;
+        updates++;
+    }
+    glFinish();
+    double streamMs = (glfwGetTime() - start) * 1000.0;
+    glDeleteTextures((GLsizei)textures.size(), textures.data());
+
+    cout << count << " textures of " << size << "x" << size << " (RGB PNG) in " << directory.string() << ", "
+         << threadPool.getConcurrency() << " worker threads\n"
+         << "  render thread: " << syncMs << " ms, all of it blocking\n"
+         << "  streamed:      " << streamMs << " ms, " << updateMs << " ms on the render thread over " << updates
+         << " updates (max " << streamer.getStats().maxUpdateMs << " ms)" << endl;
+    if (streamer.getStats().failed > 0)
+        cerr << streamer.getStats().failed << " textures could not be decoded" << endl;
+
+    vector<GLEngine::DecodedImage> images(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+        decodeImage(files[i], images[i]);
+    textures.assign(files.size(), 0);
+    glGenTextures((GLsizei)textures.size(), textures.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < images.size(); i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, images[i].width, images[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, images[i].pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glFinish();
+    start = glfwGetTime();
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glFinish();
+    double driverMs = (glfwGetTime() - start) * 1000.0;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures((GLsizei)textures.size(), textures.data());
+
+    cout << "  mipmaps:       glGenerateMipmap " << driverMs << " ms on the render thread\n";
+    for (GLEngine::MipFilter mipFilter : {GLEngine::MipFilter::BOX, GLEngine::MipFilter::KAISER, GLEngine::MipFilter::LANCZOS,
+                                          GLEngine::MipFilter::DARKEST}) {
+        start = glfwGetTime();
+        for (const GLEngine::DecodedImage& image : images)
+            GLEngine::generateMipmaps(image.pixels.data(), image.width, image.height, image.channels, mipFilter);
+        double singleMs = (glfwGetTime() - start) * 1000.0;
+        //One image per worker, as the streamer does
+        start = glfwGetTime();
+        threadPool.parallelFor(images.size(), [&](size_t i) {
+            GLEngine::generateMipmaps(images[i].pixels.data(), images[i].width, images[i].height, images[i].channels, mipFilter);
+        });
+        double poolMs = (glfwGetTime() - start) * 1000.0;
+        cout << "                 " << left << setw(8) << GLEngine::mipFilterName(mipFilter) << right << singleMs << " ms on one thread, "
+             << poolMs << " ms on the workers\n";
+    }
+    cout << flush;
+}
+
+//Compresses the images of a directory into DIRECTORY/ktx2 with their mip chains (format "auto" picks BC4, BC5,
+//BC1 or BC3 from the channels), after measuring every block format fitting each image: encoding throughput on
+//one thread and on the pool, quality (PSNR) and size
+bool compressTextures(GLEngine::ThreadPool& threadPool, const string& directory, const string& format, GLEngine::MipFilter filter) {
+    const GLEngine::BlockFormat formats[] = {GLEngine::BlockFormat::NONE, GLEngine::BlockFormat::BC1, GLEngine::BlockFormat::BC3,
+                                             GLEngine::BlockFormat::BC4, GLEngine::BlockFormat::BC5, GLEngine::BlockFormat::BC7};
+    bool automatic = format == "auto";
+    GLEngine::BlockFormat chosen = GLEngine::BlockFormat::NONE;
+    if (!automatic) {
+        bool known = format == "none";
+        for (GLEngine::BlockFormat candidate : formats) {
+            string name = GLEngine::blockFormatName(candidate);
+            transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+            if (candidate != GLEngine::BlockFormat::NONE && name == format) {
+                chosen = candidate;
+                known = true;
+            }
+        }
+        if (!known) {
+            cerr << "Unknown compression format " << format << " (auto, none, bc1, bc3, bc4, bc5 or bc7)" << endl;
+            return false;
+        }
+    }
+    vector<string> files = listImageFiles(directory);
+    if (files.empty()) {
+        cerr << "No images found in " << directory << endl;
+        return false;
+    }
+    filesystem::path outputDirectory = filesystem::path(directory) / "ktx2";
+    error_code error;
+    filesystem::create_directories(outputDirectory, error);
+
+    struct Measure {
+        int images = 0;
+        double texels = 0.0, singleMs = 0.0, poolMs = 0.0, psnr = 0.0;
+        size_t rawBytes = 0, compressedBytes = 0;
+    };
+    map<GLEngine::BlockFormat, Measure> measures;
+    int written = 0;
+    for (const string& file : files) {
+        GLEngine::DecodedImage image;
+        if (!decodeImage(file, image)) {
+            cerr << "Can't decode " << file << endl;
+            continue;
+        }
+        vector<GLEngine::BlockFormat> candidates;
+        if (image.channels == 1)
+            candidates = {GLEngine::BlockFormat::BC4};
+        else if (image.channels == 2)
+            candidates = {GLEngine::BlockFormat::BC5};
+        else
+            candidates = {GLEngine::defaultBlockFormat(image.channels), GLEngine::BlockFormat::BC7};
+        size_t pixelCount = (size_t)image.width * image.height;
+        for (GLEngine::BlockFormat candidate : candidates) {
+            double start = glfwGetTime();
+            vector<uint8_t> blocks = GLEngine::compressImage(image.pixels.data(), image.width, image.height, image.channels, candidate);
+            double singleMs = (glfwGetTime() - start) * 1000.0;
+            start = glfwGetTime();
+            GLEngine::compressImage(image.pixels.data(), image.width, image.height, image.channels, candidate, &threadPool);
+            double poolMs = (glfwGetTime() - start) * 1000.0;
+            vector<uint8_t> decoded = GLEngine::decompressImage(blocks.data(), image.width, image.height, candidate);
+            Measure& measure = measures[candidate];
+            measure.images++;
+            measure.texels += (double)pixelCount;
+            measure.singleMs += singleMs;
+            measure.poolMs += poolMs;
+            measure.psnr += glm::min(GLEngine::computePsnr(image.pixels.data(), image.channels, decoded.data(),
+                                                           GLEngine::blockFormatChannels(candidate), pixelCount), 99.0);
+            measure.rawBytes += image.pixels.size();
+            measure.compressedBytes += blocks.size();
+        }
+
+        GLEngine::Ktx2Texture texture;
+        texture.format = automatic ? GLEngine::defaultBlockFormat(image.channels) : chosen;
+        texture.channels = image.channels;
+        texture.width = image.width;
+        texture.height = image.height;
+        vector<vector<unsigned char>> levels = GLEngine::generateMipmaps(image.pixels.data(), image.width, image.height,
+                                                                        image.channels, filter, &threadPool);
+        levels.insert(levels.begin(), move(image.pixels));
+        int levelWidth = image.width, levelHeight = image.height;
+        for (vector<unsigned char>& level : levels) {
+            if (texture.format == GLEngine::BlockFormat::NONE)
+                texture.levels.push_back(move(level));
+            else
+                texture.levels.push_back(GLEngine::compressImage(level.data(), levelWidth, levelHeight, image.channels,
+                                                                 texture.format, &threadPool));
+            levelWidth = glm::max(levelWidth / 2, 1);
+            levelHeight = glm::max(levelHeight / 2, 1);
+        }
+        string output = (outputDirectory / (filesystem::path(file).stem().string() + ".ktx2")).string();
+        if (GLEngine::writeKtx2(output, texture))
+            written++;
+        else
+            cerr << "Couldn't write " << output << endl;
+    }
+
+    cout << written << " of " << files.size() << " images written to " << outputDirectory.string() << " ("
+         << threadPool.getConcurrency() << " worker threads)\n"
+         << "  format  images  1 thread MP/s  pool MP/s  PSNR dB  bits/texel (uncompressed)" << endl;
+    for (const auto& [blockFormat, measure] : measures) {
+        char line[160];
+        snprintf(line, sizeof(line), "  %-6s  %6d  %13.1f  %9.1f  %7.2f  %4.1f (%.1f)", GLEngine::blockFormatName(blockFormat),
+                 measure.images, measure.texels / 1000.0 / measure.singleMs, measure.texels / 1000.0 / measure.poolMs,
+                 measure.psnr / measure.images, measure.compressedBytes * 8.0 / measure.texels, measure.rawBytes * 8.0 / measure.texels);
+        cout << line << endl;
+    }
+    return written > 0;
+}
+
+//Cluster file of an OBJ model, next to it: the OBJ file is streamed and sorted through temporary files
+bool buildClusters(GLEngine::ThreadPool& threadPool, const string& objFile, int memoryMB) {
+    GLEngine::ObjClusterSettings settings;
+    settings.memoryBytes = (size_t)memoryMB << 20;
+    GLEngine::ObjClusterStats stats;
+    string output = filesystem::path(objFile).replace_extension(".clusters").string();
+    string error;
+    if (!GLEngine::buildClusterFileFromObj(objFile, output, threadPool, settings, &stats, error)) {
+        cerr << error << endl;
+        return false;
+    }
+    const GLEngine::ClusterBuildStats& clusters = stats.clusters;
+    cout << output << ": " << clusters.leafTriangles << " triangles in " << clusters.leaves << " leaves, " << clusters.clusters
+         << " clusters over " << clusters.levels << " levels (" << clusters.triangles << " triangles in all), "
+         << fixed << setprecision(1) << clusters.bytes / (1024.0 * 1024.0) << " MB\n"
+         << "  " << stats.vertices << " vertices, " << stats.triangles << " triangles read (" << stats.droppedTriangles
+         << " dropped), " << stats.objBytes / (1024.0 * 1024.0) << " MB of OBJ\n"
+         << "  " << memoryMB << " MB of memory, " << threadPool.getConcurrency() << " threads: " << stats.vertexChunks
+         << " vertex chunks, " << stats.sortRuns << " sorted runs, " << stats.mergePasses << " extra merge passes, "
+         << stats.tempBytes / (1024.0 * 1024.0) << " MB of temporary files\n"
+         << "  parse " << stats.parseMs << " ms, positions and normals " << stats.joinMs << " ms, sort " << stats.sortMs
+         << " ms, clusters " << stats.buildMs << " ms\n"
+         << "  total " << stats.totalMs << " ms, " << stats.getTrianglesPerSecond() / 1e6 << " million triangles/s" << endl;
+    return true;
+}
+
+void addMeshletCullJobs(vector<MeshletCullJob>& jobs, const GLEngine::MeshletBounds& bounds, const glm::mat4& model,
+                        float margin, uint8_t* visibility) {
+    //Enough meshlets per task to cover the cost of the task, a large instance is still spread over the pool
+    const size_t meshletsPerJob = 256;
+    for (size_t first = 0; first < bounds.size(); first += meshletsPerJob) {
+        size_t count = min(meshletsPerJob, bounds.size() - first);
+        jobs.push_back({ &bounds, model, margin, first, count, visibility + first, 0 });
+    }
+}
+
+size_t cullMeshlets(vector<MeshletCullJob>& jobs, const GLEngine::Frustum& frustum, const glm::vec3& cameraPosition,
+                    bool coneCulling, GLEngine::ThreadPool* pool) {
+    auto cull = [&](size_t i) {
+        MeshletCullJob& job = jobs[i];
+        job.outside = job.bounds->cull(job.model, frustum, cameraPosition, job.margin, coneCulling, job.first, job.count,
+                                       job.visibility);
+    };
+    if (pool && jobs.size() > 1)
+        pool->parallelFor(jobs.size(), cull);
+    else
+        for (size_t i = 0; i < jobs.size(); i++)
+            cull(i);
+    size_t outside = 0;
+    for (const MeshletCullJob& job : jobs)
+        outside += job.outside;
+    return outside;
+}
+
+//Meshlets of every model, and what their culling leaves to the lighting and outline passes seen from
+//cameras around the model at several distances
+void benchmarkMeshlets(GLEngine::ThreadPool& threadPool, const vector<string>& objFiles) {
+    const float distances[3] = { 0.6f, 1.5f, 4.0f };
+    const int views = 16;
+    const float outlineThickness = 0.01f;
+    cout << fixed << setprecision(1);
+    for (const string& objFile : objFiles) {
+        vector<float> vertices = fetchAllVertices(objFile);
+        vector<unsigned int> faces = fetchAllFaces(objFile);
+        if (faces.empty())
+            continue;
+        double start = glfwGetTime();
+        vector<GLEngine::Meshlet> meshlets = GLEngine::buildMeshlets(vertices.data(), vertices.size() / 3, faces.data(), faces.size());
+        double buildMs = (glfwGetTime() - start) * 1000.0;
+        GLEngine::MeshletBounds bounds;
+        bounds.build(meshlets);
+        size_t meshletVertices = 0, cones = 0;
+        for (const GLEngine::Meshlet& meshlet : meshlets) {
+            meshletVertices += meshlet.vertexCount;
+            cones += meshlet.coneCutoff < 1.0f;
+        }
+        size_t triangles = faces.size() / 3;
+        cout << filesystem::path(objFile).filename().string() << ": " << triangles << " triangles in " << meshlets.size()
+             << " meshlets (" << (double)triangles / meshlets.size() << " triangles, " << (double)meshletVertices / meshlets.size()
+             << " vertices on average), " << cones * 100.0 / meshlets.size() << " % with a normal cone, built in "
+             << buildMs << " ms\n";
+
+        //Model centered and scaled to a unit size, seen by a 45 degrees camera looking at its center
+        GLEngine::AABB box = GLEngine::AABB::fromPositions(vertices.data(), vertices.size() / 3);
+        glm::vec3 size = box.max - box.min;
+        glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / glm::max(size.x, glm::max(size.y, size.z))));
+        model = glm::translate(model, -box.getCenter());
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        auto cameraAt = [&](float distance, int view) {
+            float angle = view * 2.0f * glm::pi<float>() / views;
+            return glm::vec3(cos(angle), 0.4f, sin(angle)) * distance;
+        };
+
+        vector<uint8_t> visibility(meshlets.size());
+        vector<MeshletCullJob> jobs;
+        for (float distance : distances) {
+            size_t outside = 0, backFacing = 0, frontFacing = 0, lightingTriangles = 0, outlineTriangles = 0;
+            for (int view = 0; view < views; view++) {
+                glm::vec3 camera = cameraAt(distance, view);
+                GLEngine::Frustum frustum = GLEngine::Frustum::fromMatrix(projection * glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+                jobs.clear();
+                addMeshletCullJobs(jobs, bounds, model, outlineThickness, visibility.data());
+                outside += cullMeshlets(jobs, frustum, camera, true, nullptr);
+                for (size_t i = 0; i < meshlets.size(); i++) {
+                    backFacing += visibility[i] == GLEngine::MeshletBounds::BACK;
+                    frontFacing += visibility[i] == GLEngine::MeshletBounds::FRONT;
+                    if (visibility[i] & GLEngine::MeshletBounds::FRONT)
+                        lightingTriangles += meshlets[i].triangleCount;
+                    if (visibility[i] & GLEngine::MeshletBounds::BACK)
+                        outlineTriangles += meshlets[i].triangleCount;
+                }
+            }
+            double tested = (double)views * meshlets.size() / 100.0, drawn = (double)views * triangles / 100.0;
+            cout << "  distance " << distance << ": " << outside / tested << " % of the meshlets outside the frustum; lighting "
+                 << backFacing / tested << " % back-facing, " << lightingTriangles / drawn << " % of the triangles drawn; outline "
+                 << frontFacing / tested << " % front-facing, " << outlineTriangles / drawn << " % of the triangles drawn\n";
+        }
+
+        //Culling time of a view, on the calling thread then over the pool
+        const int repeats = 100;
+        double ms[2];
+        for (int pooled = 0; pooled < 2; pooled++) {
+            start = glfwGetTime();
+            for (int repeat = 0; repeat < repeats; repeat++) {
+                for (int view = 0; view < views; view++) {
+                    glm::vec3 camera = cameraAt(distances[1], view);
+                    GLEngine::Frustum frustum = GLEngine::Frustum::fromMatrix(projection * glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+                    jobs.clear();
+                    addMeshletCullJobs(jobs, bounds, model, outlineThickness, visibility.data());
+                    cullMeshlets(jobs, frustum, camera, true, pooled ? &threadPool : nullptr);
+                }
+            }
+            ms[pooled] = (glfwGetTime() - start) * 1000.0 / (repeats * views);
+        }
+        cout << setprecision(4) << "  culling: " << ms[0] << " ms per view on one thread, " << ms[1] << " ms over "
+             << threadPool.getConcurrency() << " threads (" << jobs.size() << " tasks)\n" << setprecision(1);
+    }
+    cout << flush;
+}
+
+//OBJ model compressed next to it, its triangles first ordered by meshlet (closer indices, smaller deltas)
+bool compressMeshFile(GLEngine::ThreadPool& threadPool, const string& objFile) {
+    double start = glfwGetTime();
+    vector<float> vertices = fetchAllVertices(objFile);
+    vector<unsigned int> faces = fetchAllFaces(objFile);
+    if (vertices.empty() || faces.empty()) {
+        cerr << "No triangles in " << objFile << endl;
+        return false;
+    }
+    vector<float> normals = computeNormal(vertices, faces);
+    GLEngine::buildMeshlets(vertices.data(), vertices.size() / 3, faces.data(), faces.size());
+    double parseMs = (glfwGetTime() - start) * 1000.0;
+    start = glfwGetTime();
+    vector<uint8_t> compressed = GLEngine::compressMesh(vertices.data(), normals.data(), vertices.size() / 3, faces.data(),
+                                                        faces.size(), GLEngine::MeshCompressionSettings(), &threadPool);
+    double encodeMs = (glfwGetTime() - start) * 1000.0;
+
+    string output = filesystem::path(objFile).replace_extension(".glmz").string();
+    ofstream out(output, ios::binary);
+    out.write((const char*)compressed.data(), compressed.size());
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write " << output << endl;
+        return false;
+    }
+    error_code error;
+    uintmax_t objBytes = filesystem::file_size(objFile, error);
+    size_t rawBytes = vertices.size() * 2 * sizeof(float) + faces.size() * sizeof(unsigned int);
+    cout << output << ": " << vertices.size() / 3 << " vertices, " << faces.size() / 3 << " triangles, " << compressed.size()
+         << " bytes, " << fixed << setprecision(2) << (double)objBytes / compressed.size() << "x smaller than the OBJ file, "
+         << (double)rawBytes / compressed.size() << "x than the raw mesh\n" << setprecision(1)
+         << "  parsed in " << parseMs << " ms, compressed in " << encodeMs << " ms on " << threadPool.getConcurrency()
+         << " threads" << endl;
+    return true;
+}
+
+//Compressed model written back as an OBJ file (positions and faces, the loader computes the normals)
+bool decompressMeshFile(GLEngine::ThreadPool& threadPool, const string& file) {
+    vector<uint8_t> data;
+    if (!readBinaryFile(file, data)) {
+        cerr << "Couldn't read " << file << endl;
+        return false;
+    }
+    vector<float> vertices, normals;
+    vector<unsigned int> faces;
+    double start = glfwGetTime();
+    if (!GLEngine::decompressMesh(data.data(), data.size(), vertices, normals, faces, &threadPool)) {
+        cerr << file << " is not a compressed mesh or is damaged" << endl;
+        return false;
+    }
+    double decodeMs = (glfwGetTime() - start) * 1000.0;
+
+    filesystem::path path(file);
+    string output = (path.parent_path() / (path.stem().string() + "-decoded.obj")).string();
+    ofstream out(output);
+    out << setprecision(9);
+    for (size_t v = 0; v < vertices.size(); v += 3)
+        out << "v " << vertices[v] << " " << vertices[v + 1] << " " << vertices[v + 2] << "\n";
+    for (size_t i = 0; i < faces.size(); i += 3)
+        out << "f " << faces[i] + 1 << " " << faces[i + 1] + 1 << " " << faces[i + 2] + 1 << "\n";
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write " << output << endl;
+        return false;
+    }
+    cout << output << ": " << vertices.size() / 3 << " vertices, " << faces.size() / 3 << " triangles, decoded in "
+         << fixed << setprecision(1) << decodeMs << " ms on " << threadPool.getConcurrency() << " threads" << endl;
+    return true;
+}
+
+//Every model read as OBJ, as a raw binary copy of its arrays and compressed: sizes, times and the
+//error of the compressed one. The files are read back from the page cache, so the decoding speed is
+//the one a storage has to beat.
+void benchmarkMeshFormats(GLEngine::ThreadPool& threadPool, const vector<string>& objFiles) {
+    filesystem::path directory = filesystem::temp_directory_path() / "opengl-project-mesh-bench";
+    error_code error;
+    filesystem::create_directories(directory, error);
+    const int repeats = 10;
+    auto writeFile = [](const filesystem::path& path, const vector<pair<const void*, size_t>>& parts) {
+        ofstream out(path, ios::binary);
+        for (const pair<const void*, size_t>& part : parts)
+            out.write((const char*)part.first, part.second);
+        return (bool)out;
+    };
+    cout << fixed << setprecision(1);
+    for (const string& objFile : objFiles) {
+        string name = filesystem::path(objFile).stem().string();
+        double start = glfwGetTime();
+        vector<float> vertices = fetchAllVertices(objFile);
+        vector<unsigned int> faces = fetchAllFaces(objFile);
+        vector<float> normals = computeNormal(vertices, faces);
+        double parseMs = (glfwGetTime() - start) * 1000.0;
+        if (faces.empty())
+            continue;
+        GLEngine::buildMeshlets(vertices.data(), vertices.size() / 3, faces.data(), faces.size());
+        uintmax_t objBytes = filesystem::file_size(objFile, error);
+
+        //Raw: the arrays as they are in memory
+        filesystem::path rawFile = directory / (name + ".raw");
+        size_t rawBytes = vertices.size() * 2 * sizeof(float) + faces.size() * sizeof(unsigned int);
+        if (!writeFile(rawFile, { { vertices.data(), vertices.size() * sizeof(float) }, { normals.data(), normals.size() * sizeof(float) },
+                                  { faces.data(), faces.size() * sizeof(unsigned int) } })) {
+            cerr << "Couldn't write " << rawFile.string() << endl;
+            continue;
+        }
+        vector<uint8_t> data;
+        start = glfwGetTime();
+        for (int repeat = 0; repeat < repeats; repeat++)
+            readBinaryFile(rawFile.string(), data);
+        double rawReadMs = (glfwGetTime() - start) * 1000.0 / repeats;
+
+        //Compressed, on the calling thread then over the pool
+        double encodeMs[2], decodeMs[2];
+        vector<uint8_t> compressed;
+        for (int pooled = 0; pooled < 2; pooled++) {
+            start = glfwGetTime();
+            compressed = GLEngine::compressMesh(vertices.data(), normals.data(), vertices.size() / 3, faces.data(), faces.size(),
+                                                GLEngine::MeshCompressionSettings(), pooled ? &threadPool : nullptr);
+            encodeMs[pooled] = (glfwGetTime() - start) * 1000.0;
+        }
+        filesystem::path compressedFile = directory / (name + ".glmz");
+        if (!writeFile(compressedFile, { { compressed.data(), compressed.size() } })) {
+            cerr << "Couldn't write " << compressedFile.string() << endl;
+            continue;
+        }
+        start = glfwGetTime();
+        for (int repeat = 0; repeat < repeats; repeat++)
+            readBinaryFile(compressedFile.string(), data);
+        double compressedReadMs = (glfwGetTime() - start) * 1000.0 / repeats;
+        vector<float> decodedVertices, decodedNormals;
+        vector<unsigned int> decodedFaces;
+        for (int pooled = 0; pooled < 2; pooled++) {
+            start = glfwGetTime();
+            for (int repeat = 0; repeat < repeats; repeat++)
+                GLEngine::decompressMesh(data.data(), data.size(), decodedVertices, decodedNormals, decodedFaces,
+                                         pooled ? &threadPool : nullptr);
+            decodeMs[pooled] = (glfwGetTime() - start) * 1000.0 / repeats;
+        }
+
+        //Error through the triangles, the vertices being renumbered
+        GLEngine::AABB bounds = GLEngine::AABB::fromPositions(vertices.data(), vertices.size() / 3);
+        glm::vec3 size = bounds.max - bounds.min;
+        float positionError = 0.0f, normalError = 0.0f;
+        for (size_t i = 0; i < faces.size() && decodedFaces.size() == faces.size(); i++) {
+            glm::vec3 position = glm::make_vec3(&vertices[3 * faces[i]]), normal = glm::make_vec3(&normals[3 * faces[i]]);
+            glm::vec3 decodedPosition = glm::make_vec3(&decodedVertices[3 * decodedFaces[i]]);
+            glm::vec3 decodedNormal = glm::make_vec3(&decodedNormals[3 * decodedFaces[i]]);
+            positionError = glm::max(positionError, glm::distance(position, decodedPosition));
+            if (glm::length(normal) > 0.5f)
+                normalError = glm::max(normalError, glm::degrees(glm::acos(glm::clamp(glm::dot(normal, decodedNormal), -1.0f, 1.0f))));
+        }
+
+        double megabyte = 1024.0 * 1024.0;
+        double decodeSpeed = compressed.size() / megabyte / (decodeMs[1] / 1000.0);
+        cout << name << ": " << vertices.size() / 3 << " vertices, " << faces.size() / 3 << " triangles\n"
+             << "  OBJ:        " << setprecision(2) << objBytes / megabyte << " MB, parsed in " << setprecision(1) << parseMs << " ms\n"
+             << "  raw:        " << setprecision(2) << rawBytes / megabyte << " MB (" << (double)objBytes / rawBytes
+             << "x smaller than OBJ), read in " << rawReadMs << " ms\n"
+             << "  compressed: " << compressed.size() / megabyte << " MB (" << (double)objBytes / compressed.size()
+             << "x smaller than OBJ, " << (double)rawBytes / compressed.size() << "x than raw), read in " << compressedReadMs
+             << " ms\n" << setprecision(1)
+             << "    encoded in " << encodeMs[0] << " ms on one thread, " << encodeMs[1] << " ms on " << threadPool.getConcurrency()
+             << "; decoded in " << setprecision(2) << decodeMs[0] << " ms on one thread, " << decodeMs[1] << " ms on "
+             << threadPool.getConcurrency() << setprecision(0) << "\n"
+             << "    decoding takes " << decodeSpeed << " MB/s of compressed data: a storage reading the raw mesh at "
+             << decodeSpeed * rawBytes / compressed.size() << " MB/s would be as fast\n" << setprecision(1)
+             << "    error: positions " << setprecision(6) << positionError / glm::max(size.x, glm::max(size.y, size.z))
+             << " of the model size, normals " << setprecision(3) << normalError << " degrees\n" << setprecision(1);
+        filesystem::remove(rawFile, error);
+        filesystem::remove(compressedFile, error);
+    }
+    filesystem::remove(directory, error);
+    cout << flush;
+}
+
+//Indexing the library with every file scanned, then with the index (written by the first pass when
+//there is one), then the models found
+void benchmarkLibrary(GLEngine::ThreadPool& threadPool, const string& directory, const string& indexFile) {
+    GLEngine::ModelLibrary library;
+    double megabyte = 1024.0 * 1024.0;
+    cout << fixed << setprecision(1);
+    const char* passes[2] = { "Scanning every file", "With the index" };
+    for (int pass = 0; pass < 2; pass++) {
+        //The first pass replaces the index, the second one reads it
+        if (pass == 0 && !indexFile.empty()) {
+            error_code error;
+            filesystem::remove(indexFile, error);
+        }
+        if (!library.scan(directory, indexFile, &threadPool)) {
+            cerr << "Couldn't read the model library " << directory << endl;
+            return;
+        }
+        const GLEngine::ModelLibrary::Stats& stats = library.getStats();
+        cout << passes[pass] << ": " << stats.files << " files in " << stats.directories << " directories, "
+             << stats.totalMs << " ms (listing " << stats.listMs << " ms, scanning " << stats.scanned << " files of "
+             << stats.scannedBytes / megabyte << " MB in " << stats.scanMs << " ms";
+        if (stats.scanMs > 0.0)
+            cout << ", " << stats.scannedBytes / megabyte / (stats.scanMs / 1000.0) << " MB/s";
+        cout << ")" << (stats.indexWritten ? ", index written" : "") << endl;
+        if (indexFile.empty())
+            break;
+    }
+
+    //The largest first, a long library is cut
+    vector<GLEngine::ModelInfo> models = library.getModels();
+    sort(models.begin(), models.end(), [](const GLEngine::ModelInfo& a, const GLEngine::ModelInfo& b) {
+        return a.fileSize > b.fileSize;
+    });
+    const size_t listed = 50;
+    for (size_t i = 0; i < models.size() && i < listed; i++) {
+        const GLEngine::ModelInfo& model = models[i];
+        glm::vec3 size = model.bounds.max - model.bounds.min;
+        cout << "  " << model.path << ": " << model.fileSize / megabyte << " MB, " << model.vertexCount << " vertices, "
+             << model.triangleCount << " triangles" << (model.hasNormals() ? ", normals" : "")
+             << (model.hasTexCoords() ? ", texture coordinates" : "") << ", size " << setprecision(2) << size.x << " x "
+             << size.y << " x " << size.z << setprecision(1) << (model.readable ? "" : " (unreadable)") << endl;
+    }
+    if (models.size() > listed)
+        cout << "  ... " << models.size() - listed << " more" << endl;
+}
+
+//Tonal art map from the cache, or generated, compressed to BC4 then stored in the cache
+GLuint createHatchingTexture(GLEngine::ThreadPool& threadPool, const string& cacheDirectory) {
+    GLEngine::TonalArtMapSettings settings;
+    string file = cacheDirectory + "/tam-" + settings.getKey() + ".ktx2";
+    GLEngine::Ktx2Texture texture;
+    if (!cacheDirectory.empty() && GLEngine::readKtx2(file, texture))
+        return GLEngine::createKtx2Texture(texture);
+
+    GLEngine::TonalArtMap map = GLEngine::generateTonalArtMap(settings, &threadPool);
+    cout << "Tonal art map generated in " << map.generationMs << " ms (" << map.toneCount << " tones, "
+         << map.levelCount << " levels, " << threadPool.getConcurrency() << " threads)" << endl;
+    double start = glfwGetTime();
+    texture = compressTonalArtMap(map, &threadPool);
+    size_t rawBytes = 0, compressedBytes = 0;
+    for (int level = 0; level < map.levelCount; level++) {
+        rawBytes += map.levels[level].size();
+        compressedBytes += texture.levels[level].size();
+    }
+    cout << "Tonal art map compressed to BC4 in " << (glfwGetTime() - start) * 1000.0 << " ms (" << compressedBytes / 1024
+         << " KB instead of " << rawBytes / 1024 << " KB)" << endl;
+    if (!cacheDirectory.empty()) {
+        error_code error;
+        filesystem::create_directories(cacheDirectory, error);
+        if (!GLEngine::writeKtx2(file, texture))
+            cerr << "Couldn't write " << file << endl;
+    }
+    return GLEngine::createKtx2Texture(texture);
+}
+
+//Preprocessor symbols enabling the NPR effects in lighting.frag
+vector<string> nprDefines(int features) {
+    vector<string> defines;
+    if (features & NPR_SPECULAR)
+        defines.push_back("NPR_SPECULAR");
+    if (features & NPR_DITHERING)
+        defines.push_back("NPR_DITHERING");
+    if (features & NPR_EDGES)
+        defines.push_back("NPR_EDGES");
+    if (features & NPR_HATCHING)
+        defines.push_back("NPR_HATCHING");
+    return defines;
+}
+
+//The lighting program of programFiles is the default variant
+vector<string> programDefines(int program) {
+    return program == LIGHTING_PROGRAM ? nprDefines(NPR_DEFAULT) : vector<string>();
+}
+
+void startBenchmark(FrameBenchmark& bench, int configurationCount) {
+    bench.running = true;
+    bench.configuration = 0;
+    bench.frame = 0;
+    bench.totalMs.assign(configurationCount, 0.0);
+    bench.samples.assign(configurationCount, 0);
+    bench.cpuTotalMs.assign(configurationCount, 0.0);
+}
+
+//Called after each frame, returns false once every configuration was measured
+bool advanceBenchmark(FrameBenchmark& bench, bool timed, float ms, double cpuMs) {
+    if (bench.frame >= benchWarmupFrames && timed) {
+        bench.totalMs[bench.configuration] += ms;
+        bench.samples[bench.configuration]++;
+    }
+    if (bench.frame >= benchWarmupFrames)
+        bench.cpuTotalMs[bench.configuration] += cpuMs;
+    if (++bench.frame < benchWarmupFrames + benchMeasuredFrames)
+        return true;
+    bench.frame = 0;
+    bench.running = ++bench.configuration < (int)bench.totalMs.size();
+    return bench.running;
+}
+
+double benchmarkAverageMs(const FrameBenchmark& bench, int configuration) {
+    return bench.samples[configuration] > 0 ? bench.totalMs[configuration] / bench.samples[configuration] : 0.0;
+}
+
+void printVariantBenchmark(const FrameBenchmark& bench, RenderPath path, int width, int height) {
+    auto averageMs = [&](int variant) { return benchmarkAverageMs(bench, variant); };
+    double allMs = averageMs(NPR_ALL);
+    cout << (path == RenderPath::DEFERRED ? "Deferred shading pass" : "Lighting pass") << " per NPR variant, "
+         << width << "x" << height << ", " << drawnInstances.size()
+         << " instances (average of " << benchMeasuredFrames << " frames)\n";
+    for (int variant = NPR_VARIANT_COUNT - 1; variant >= 0; variant--) {
+        string name;
+        if (variant & NPR_SPECULAR)
+            name += "specular ";
+        if (variant & NPR_DITHERING)
+            name += "dithering ";
+        if (variant & NPR_EDGES)
+            name += "edges ";
+        if (variant & NPR_HATCHING)
+            name += "hatching ";
+        if (name.empty())
+            name = "toon shading only ";
+        double ms = averageMs(variant);
+        cout << "  " << left << setw(36) << name << right << fixed << setprecision(3) << ms << " ms";
+        if (allMs > 0.0)
+            cout << "  (" << setprecision(0) << 100.0 * ms / allMs << "% of every effect)";
+        cout << "\n";
+    }
+    cout << defaultfloat << flush;
+}
+
+//Configurations alternate forward and deferred, resolution by resolution
+RenderPath benchmarkPath(int configuration) {
+    return configuration % 2 == 0 ? RenderPath::FORWARD : RenderPath::DEFERRED;
+}
+
+void printPathBenchmark(const FrameBenchmark& bench, const string& meshName) {
+    cout << "Scene GPU time per path, " << meshName << " (average of " << benchMeasuredFrames << " frames)\n"
+         << "  resolution    forward     deferred\n";
+    for (int resolution = 0; resolution < 2; resolution++) {
+        double forwardMs = benchmarkAverageMs(bench, 2 * resolution);
+        double deferredMs = benchmarkAverageMs(bench, 2 * resolution + 1);
+        cout << "  " << setw(4) << benchResolutions[resolution][0] << "x" << left << setw(4) << benchResolutions[resolution][1] << right
+             << fixed << setprecision(3) << setw(10) << forwardMs << " ms" << setw(10) << deferredMs << " ms";
+        if (forwardMs > 0.0)
+            cout << "  (deferred " << setprecision(2) << deferredMs / forwardMs << "x forward)";
+        cout << "\n";
+    }
+    cout << defaultfloat << flush;
+}
+
+void printLightBenchmark(const FrameBenchmark& bench, RenderPath path, int width, int height) {
+    cout << "Stage lights, " << (path == RenderPath::DEFERRED ? "deferred shading pass" : "lighting pass") << ", "
+         << width << "x" << height << ", " << drawnInstances.size() << " instances (average of " << benchMeasuredFrames << " frames)\n"
+         << "  lights   binning (CPU)   GPU\n";
+    for (int configuration = 0; configuration < (int)bench.totalMs.size(); configuration++) {
+        cout << "  " << setw(6) << benchLightCounts[configuration] << fixed << setprecision(3)
+             << setw(12) << bench.cpuTotalMs[configuration] / benchMeasuredFrames << " ms"
+             << setw(10) << benchmarkAverageMs(bench, configuration) << " ms\n";
+    }
+    cout << defaultfloat << flush;
+}
+
+void requestRedraw() {
+    framesToRedraw = redrawFrameCount;
+}
+
+void onWindowRefresh(GLFWwindow* window) {
+    requestRedraw();
+}
+
+void onWindowFocus(GLFWwindow* window, int focused) {
+    requestRedraw();
+    ImGui_ImplGlfw_WindowFocusCallback(window, focused);
+}
+
+void onKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    requestRedraw();
+    ImGui_ImplGlfw_KeyCallback(window, key, scancode, action, mods);
+}
+
+void onChar(GLFWwindow* window, unsigned int c) {
+    requestRedraw();
+    ImGui_ImplGlfw_CharCallback(window, c);
 }
 
 void processInput(GLFWwindow *window)
@@ -513,6 +2696,7 @@ void processInput(GLFWwindow *window)
 }
 
 void onMouseButton(GLFWwindow* window, int button, int action, int mods) {
+    requestRedraw();
     if (!ImGui::GetIO().WantCaptureMouse) {
         if (action == GLFW_RELEASE) {
             mouseButtonState = MousePressedButton::NONE;
@@ -532,6 +2716,7 @@ void onMouseButton(GLFWwindow* window, int button, int action, int mods) {
 }
 
 void onMouseMove(GLFWwindow* window, double xpos, double ypos) {
+    requestRedraw();
     if (!ImGui::GetIO().WantCaptureMouse) {
         if (mouseButtonState == MousePressedButton::NONE) {
             lastX = (float)xpos;
@@ -567,6 +2752,7 @@ void onMouseMove(GLFWwindow* window, double xpos, double ypos) {
 }
 
 void onMouseScroll(GLFWwindow* window, double xoffset, double yoffset) {
+    requestRedraw();
     if (!ImGui::GetIO().WantCaptureMouse) {
         orbitalCamera.zoom((float)yoffset);
     }
@@ -0,0 +1,219 @@
+#include "options.hpp"
+#include <glengine/framePacer.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+         << "  --on-demand               Only redraw when something changes\n"
+         << "  --vsync off|on|adaptive   Swap interval (default: on)\n"
+         << "  --fps-cap N               Frame rate cap, 0 for none (default: 0)\n"
+         << "  --frames-in-flight N      Frames the CPU may queue ahead of the GPU, 1 to " << GLEngine::FramePacer::MAX_FRAMES_IN_FLIGHT << " (default: 2)\n"
+         << "  --frame-stats             Print frame time and jitter every second\n"
+         << "  --deferred                Start with the deferred rendering path\n"
+         << "  --shadows N               Cast shadows of the light: 1 for a single map, 2 to 4 for cascades\n"
+         << "  --stress N                Start with the stress scene showing N copies of the model (up to 10000)\n"
+         << "  --no-meshlet-culling      Draw every meshlet of the large instances, only the instances are culled\n"
+         << "  --shader-cache DIR        Directory of the shader binary cache (default: " << defaultShaderCacheDirectory() << ")\n"
+         << "  --no-shader-cache         Always compile the shaders from source\n"
+         << "  --clear-shader-cache      Empty the shader binary cache before starting\n"
+         << "  --bench-shader-cache      Compare the shader startup time with a cold and a warm cache, then exit\n"
+         << "  --bench-variants          Time the lighting pass of every NPR shader variant, then exit\n"
+         << "  --bench-deferred          Compare the GPU time of the forward and deferred paths at 1080p and 4K, then exit\n"
+         << "  --bench-lights            Time the lighting and the light binning with 1, 16, 64 and 256 stage lights, then exit\n"
+         << "  --bench-meshlets          Report the meshlets of every model and how many the culling rejects around it, then exit\n"
+         << "  --bench-textures [N]      Compare loading N textures (default: 100) on the render thread and streamed, then exit\n"
+         << "  --compress-textures DIR   Compress the images of DIR to DIR/ktx2 and compare the block formats, then exit\n"
+         << "  --compress-format F       auto, none, bc1, bc3, bc4, bc5 or bc7 (default: auto)\n"
+         << "  --mip-filter F            Mip levels of the loaded textures: box, kaiser, lanczos or darkest (default: kaiser)\n"
+         << "  --texture-cache DIR       Directory of the generated textures (default: " << defaultTextureCacheDirectory() << ")\n"
+         << "  --no-texture-cache        Always generate the textures\n"
+         << "  --mesh-cache DIR          Directory of the parsed models (default: " << defaultMeshCacheDirectory() << ")\n"
+         << "  --no-mesh-cache           Always parse the OBJ files\n"
+         << "  --compress-mesh OBJ       Compress an OBJ model (OBJ with a .glmz extension), then exit\n"
+         << "  --decompress-mesh GLMZ    Write a compressed model back as OBJ (name-decoded.obj), then exit\n"
+         << "  --bench-mesh-formats      Compare reading the models as OBJ, raw binary and compressed, then exit\n"
+         << "  --no-mapped-geometry      Upload the meshes with glBufferSubData instead of persistently mapped buffers\n"
+         << "  --library DIR             Directory of the models, searched recursively (default: the objects directory)\n"
+         << "  --library-index FILE      Metadata of the models kept between runs (default: " << defaultLibraryIndexFile() << ")\n"
+         << "  --no-library-index        Scan every model file at startup\n"
+         << "  --bench-library           Time indexing the library without then with its index, list the models, then exit\n"
+         << "  --gpu-budget MB           GPU memory of the meshes and textures before evicting the least recently used (default: 256)\n"
+         << "  --clusters FILE           Start with the streamed scene showing a cluster file\n"
+         << "  --build-clusters OBJ      Build the cluster file of an OBJ model (OBJ with a .clusters extension), then exit\n"
+         << "  --cluster-memory MB       Working memory of --build-clusters, the rest goes to temporary files (default: 512)\n"
+         << "  --cluster-budget MB       GPU memory of the resident clusters of the streamed scene (default: 64)\n"
+         << "  --help                    Show this message" << endl;
+}
+
+//Subdirectory of the user cache, or a directory of the working one without a home
+static string defaultCacheDirectory(const string& name, const string& fallback) {
+    const char* cacheHome = getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome)
+        return string(cacheHome) + "/opengl-project/" + name;
+    const char* home = getenv("HOME");
+    if (home && *home)
+        return string(home) + "/.cache/opengl-project/" + name;
+    return fallback;
+}
+
+string defaultShaderCacheDirectory() {
+    return defaultCacheDirectory("shaders", "shader_cache");
+}
+
+string defaultTextureCacheDirectory() {
+    return defaultCacheDirectory("textures", "texture_cache");
+}
+
+string defaultMeshCacheDirectory() {
+    return defaultCacheDirectory("meshes", "mesh_cache");
+}
+
+string defaultLibraryIndexFile() {
+    return defaultCacheDirectory("library.index", "library.index");
+}
+
+const char* vsyncModeName(VSyncMode mode) {
+    switch (mode) {
+        case VSyncMode::OFF: return "off";
+        case VSyncMode::ON: return "on";
+        case VSyncMode::ADAPTIVE: return "adaptive";
+    }
+    return "";
+}
+
+ParseResult parseOptions(int argc, char** argv, AppOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        //Options expecting a value
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return ParseResult::HELP;
+        }
+        else if (arg == "--on-demand")
+            options.renderOnDemand = true;
+        else if (arg == "--frame-stats")
+            options.printFrameStats = true;
+        else if (arg == "--vsync" && hasValue) {
+            string mode = argv[++i];
+            if (mode == "off")
+                options.vsync = VSyncMode::OFF;
+            else if (mode == "on")
+                options.vsync = VSyncMode::ON;
+            else if (mode == "adaptive")
+                options.vsync = VSyncMode::ADAPTIVE;
+            else {
+                cerr << "Unknown vsync mode: " << mode << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else if (arg == "--fps-cap" && hasValue)
+            options.frameCap = (float)atof(argv[++i]);
+        else if (arg == "--frames-in-flight" && hasValue) {
+            options.maxFramesInFlight = atoi(argv[++i]);
+            if (options.maxFramesInFlight < 1 || options.maxFramesInFlight > GLEngine::FramePacer::MAX_FRAMES_IN_FLIGHT) {
+                cerr << "--frames-in-flight must be between 1 and " << GLEngine::FramePacer::MAX_FRAMES_IN_FLIGHT << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else if (arg == "--deferred")
+            options.deferred = true;
+        else if (arg == "--shadows" && hasValue)
+            options.shadowCascades = atoi(argv[++i]);
+        else if (arg == "--stress" && hasValue)
+            options.stressInstances = atoi(argv[++i]);
+        else if (arg == "--no-meshlet-culling")
+            options.meshletCulling = false;
+        else if (arg == "--shader-cache" && hasValue)
+            options.shaderCacheDirectory = argv[++i];
+        else if (arg == "--no-shader-cache")
+            options.shaderCache = false;
+        else if (arg == "--clear-shader-cache")
+            options.clearShaderCache = true;
+        else if (arg == "--bench-shader-cache")
+            options.benchShaderCache = true;
+        else if (arg == "--bench-variants")
+            options.benchVariants = true;
+        else if (arg == "--bench-deferred")
+            options.benchDeferred = true;
+        else if (arg == "--bench-lights")
+            options.benchLights = true;
+        else if (arg == "--bench-meshlets")
+            options.benchMeshlets = true;
+        else if (arg == "--bench-textures") {
+            options.benchTextures = 100;
+            if (hasValue && isdigit((unsigned char)argv[i + 1][0]))
+                options.benchTextures = max(atoi(argv[++i]), 1);
+        }
+        else if (arg == "--compress-textures" && hasValue)
+            options.compressTexturesDirectory = argv[++i];
+        else if (arg == "--compress-format" && hasValue)
+            options.compressFormat = argv[++i];
+        else if (arg == "--mip-filter" && hasValue) {
+            string filter = argv[++i];
+            if (!GLEngine::parseMipFilter(filter, options.mipFilter)) {
+                cerr << "Unknown mip filter: " << filter << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else if (arg == "--texture-cache" && hasValue)
+            options.textureCacheDirectory = argv[++i];
+        else if (arg == "--no-texture-cache")
+            options.textureCacheDirectory.clear();
+        else if (arg == "--mesh-cache" && hasValue)
+            options.meshCacheDirectory = argv[++i];
+        else if (arg == "--no-mesh-cache")
+            options.meshCache = false;
+        else if (arg == "--no-mapped-geometry")
+            options.mappedGeometry = false;
+        else if (arg == "--compress-mesh" && hasValue)
+            options.compressMeshFile = argv[++i];
+        else if (arg == "--decompress-mesh" && hasValue)
+            options.decompressMeshFile = argv[++i];
+        else if (arg == "--bench-mesh-formats")
+            options.benchMeshFormats = true;
+        else if (arg == "--library" && hasValue)
+            options.libraryDirectory = argv[++i];
+        else if (arg == "--library-index" && hasValue)
+            options.libraryIndexFile = argv[++i];
+        else if (arg == "--no-library-index")
+            options.libraryIndexFile.clear();
+        else if (arg == "--bench-library")
+            options.benchLibrary = true;
+        else if (arg == "--gpu-budget" && hasValue) {
+            options.gpuBudgetMB = atoi(argv[++i]);
+            if (options.gpuBudgetMB < 1) {
+                cerr << "--gpu-budget must be at least 1 MB" << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else if (arg == "--clusters" && hasValue)
+            options.clusterFile = argv[++i];
+        else if (arg == "--build-clusters" && hasValue)
+            options.buildClustersFile = argv[++i];
+        else if (arg == "--cluster-memory" && hasValue) {
+            options.clusterMemoryMB = atoi(argv[++i]);
+            if (options.clusterMemoryMB < 16) {
+                cerr << "--cluster-memory must be at least 16 MB" << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else if (arg == "--cluster-budget" && hasValue) {
+            options.clusterBudgetMB = atoi(argv[++i]);
+            if (options.clusterBudgetMB < 1) {
+                cerr << "--cluster-budget must be at least 1 MB" << endl;
+                return ParseResult::INVALID;
+            }
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+            printUsage(argv[0]);
+            return ParseResult::INVALID;
+        }
+    }
+    return ParseResult::RUN;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <glengine/mipmapGenerator.hpp>
+
+using namespace std;
+
+enum class VSyncMode { OFF, ON, ADAPTIVE };
+
+//$XDG_CACHE_HOME (or ~/.cache) /opengl-project/shaders, shader_cache in the working directory without a home
+string defaultShaderCacheDirectory();
+//Same with textures / texture_cache
+string defaultTextureCacheDirectory();
+//Same with meshes / mesh_cache
+string defaultMeshCacheDirectory();
+//Same with the file library.index
+string defaultLibraryIndexFile();
+
+//Options given on the command line
+struct AppOptions {
+    //Render loop
+    bool renderOnDemand = false;
+    VSyncMode vsync = VSyncMode::ON;
+    float frameCap = 0.0f;              // 0 for no cap
+    int maxFramesInFlight = 2;
+    bool printFrameStats = false;       // Frame time and jitter printed every second
+
+    //Scene
+    bool deferred = false;              // Deferred NPR path instead of the forward one
+    int shadowCascades = 0;             // Cast shadows: 0 for none, 1 for a single map, up to 4 cascades
+    int stressInstances = 0;            // Copies of the model in the stress scene, 0 for a single model
+    bool meshletCulling = true;         // Back-facing and off-screen meshlets of the large instances skipped
+
+    //Shader program binaries kept between launches
+    bool shaderCache = true;
+    string shaderCacheDirectory = defaultShaderCacheDirectory();
+    bool clearShaderCache = false;
+    bool benchShaderCache = false;      // Compares the startup with a cold and a warm cache, then exits
+    bool benchVariants = false;         // Times the lighting pass of every NPR variant, then exits
+    bool benchDeferred = false;         // Compares the forward and deferred paths at 1080p and 4K, then exits
+    bool benchLights = false;           // Times the lighting with 1, 16, 64 and 256 stage lights, then exits
+    bool benchMeshlets = false;         // Reports the meshlets and their culling around every model, then exits
+    int benchTextures = 0;              // Loads N textures with and without the streamer, then exits
+    string compressTexturesDirectory;   // Compresses its images to KTX2 and reports the encoders, then exits
+    string compressFormat = "auto";     // auto, none, bc1, bc3, bc4, bc5 or bc7
+
+    //Generated textures (hatching tonal art map, mip levels), empty to always generate them
+    string textureCacheDirectory = defaultTextureCacheDirectory();
+    //Downsampling of the mip levels of the loaded textures
+    GLEngine::MipFilter mipFilter = GLEngine::MipFilter::KAISER;
+
+    //Parsed models, read back without parsing the OBJ files
+    bool meshCache = true;
+    string meshCacheDirectory = defaultMeshCacheDirectory();
+    string compressMeshFile;            // OBJ file compressed next to it (.glmz), then exits
+    string decompressMeshFile;          // Compressed mesh written back as an OBJ file, then exits
+    bool benchMeshFormats = false;      // Compares reading the models as OBJ, raw and compressed, then exits
+    bool mappedGeometry = true;         // Meshes written into persistently mapped buffers, when the driver has them
+    //Models offered in the interface, searched recursively, their metadata kept in the index file
+    //(empty to scan every file at startup)
+    string libraryDirectory;            // The objects directory of the project when empty
+    string libraryIndexFile = defaultLibraryIndexFile();
+    bool benchLibrary = false;          // Times indexing the library without and with its index, then exits
+    //GPU memory of the meshes and loaded textures, the least recently used are evicted beyond it
+    int gpuBudgetMB = 256;
+
+    //Scan larger than the GPU memory, drawn from a cluster file
+    string clusterFile;                 // Opened at startup, in the streamed scene
+    string buildClustersFile;           // OBJ file turned into a cluster file next to it, then exits
+    int clusterMemoryMB = 512;          // Working memory of that conversion, beyond it temporary files are used
+    int clusterBudgetMB = 64;           // GPU pool of the resident clusters
+};
+
+//Outcome of the command line: run, exit after the usage (--help) or exit with an error
+enum class ParseResult { RUN, HELP, INVALID };
+
+ParseResult parseOptions(int argc, char** argv, AppOptions& options);
+void printUsage(const char* program);
+
+const char* vsyncModeName(VSyncMode mode);
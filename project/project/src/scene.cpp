@@ -0,0 +1,141 @@
+#include "scene.hpp"
+#include <cmath>
+#include <cstddef>
+#include "glm/gtc/matrix_transform.hpp"
+
+//Model matrix of the single model, as it has always been placed in front of the camera
+static glm::mat4 modelMatrix(const glm::vec3& rotation) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    model = glm::translate(model, glm::vec3(0.0f, -0.3f, 0.0f));
+    return model;
+}
+
+//Deterministic pseudo-random value in [0, 1] so the stress scene is the same every frame
+static float hashToUnit(unsigned int x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return (x & 0xFFFFFF) / float(0xFFFFFF);
+}
+
+void buildInstances(const SceneParameters& params, vector<InstanceData>& instances) {
+    instances.clear();
+
+    InstanceData instance;
+    instance.color = params.color;
+    instance.outlineThickness = params.outlineThickness;
+    instance.outlineColor = params.outlineColor;
+    instance.mesh = (uint32_t)params.mesh;
+    instance.object = 0;
+
+    if (params.type == SceneType::SINGLE) {
+        instance.model = modelMatrix(params.rotation);
+        instances.push_back(instance);
+        return;
+    }
+    if (params.type == SceneType::STREAMED)
+        return;
+
+    //Stress scene: copies on shelves (columns x levels), with rows of shelves going away from the camera
+    int count = params.instanceCount;
+    int side = (int)ceil(cbrt((double)count));
+    int rows = (count + side * side - 1) / (side * side);
+    float spacing = 2.4f / side;
+    float scale = spacing * 0.45f;
+    instances.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        int column = i % side;
+        int level = (i / side) % side;
+        int row = i / (side * side);
+
+        glm::vec3 position((column - (side - 1) * 0.5f) * spacing,
+                           (level - (side - 1) * 0.5f) * spacing,
+                           ((rows - 1) * 0.5f - row) * spacing * 1.5f);
+
+        //Each copy gets its own orientation and a slightly different shade
+        glm::vec3 rotation = params.rotation + glm::vec3(0.0f, 360.0f * hashToUnit(2 * i), 0.0f);
+        float shade = 0.6f + 0.4f * hashToUnit(2 * i + 1);
+
+        instance.model = glm::translate(glm::mat4(1.0f), position)
+                       * glm::scale(glm::mat4(1.0f), glm::vec3(scale))
+                       * modelMatrix(rotation);
+        instance.color = params.color * shade;
+        instances.push_back(instance);
+    }
+}
+
+InstanceData buildStreamedInstance(const SceneParameters& params, const GLEngine::AABB& bounds) {
+    InstanceData instance;
+    instance.color = params.color;
+    instance.outlineThickness = params.outlineThickness;
+    instance.outlineColor = params.outlineColor;
+    instance.mesh = 0;
+    instance.object = 0;
+    glm::vec3 size = bounds.max - bounds.min;
+    float extent = glm::max(size.x, glm::max(size.y, size.z));
+    instance.model = modelMatrix(params.rotation)
+                   * glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / glm::max(extent, 1e-6f)))
+                   * glm::translate(glm::mat4(1.0f), -(bounds.min + bounds.max) * 0.5f);
+    return instance;
+}
+
+//Fully saturated color of a hue in [0, 1]
+static glm::vec3 hueColor(float hue) {
+    glm::vec3 color = glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(1.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f;
+    return glm::clamp(color, 0.0f, 1.0f);
+}
+
+void buildStageLights(int count, const GLEngine::AABB& sceneBounds, float radius, float intensity,
+                      vector<GLEngine::PointLight>& lights) {
+    lights.clear();
+    glm::vec3 center = sceneBounds.getCenter();
+    //Around the models, a little past their bounds
+    glm::vec3 extent = sceneBounds.getExtent() * 1.2f + glm::vec3(0.05f);
+    float size = 2.0f * glm::max(extent.x, glm::max(extent.y, extent.z));
+
+    GLEngine::PointLight light;
+    light.radius = radius * size;
+    light.intensity = intensity;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 random(hashToUnit(3 * i + 1000), hashToUnit(3 * i + 1001), hashToUnit(3 * i + 1002));
+        light.position = center + (random * 2.0f - 1.0f) * extent;
+        //Golden ratio steps: consecutive lights get distant hues
+        light.color = hueColor(glm::fract(i * 0.618034f));
+        lights.push_back(light);
+    }
+}
+
+void setupInstanceAttributes(GLuint instanceVBO, uint32_t firstInstance) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    size_t base = firstInstance * sizeof(InstanceData);
+
+    //A mat4 takes 4 consecutive locations, one per column
+    for (int column = 0; column < 4; column++) {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(base + offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribDivisor(2 + column, 1);
+    }
+
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, color)));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, outlineThickness)));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+
+    glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, outlineColor)));
+    glEnableVertexAttribArray(8);
+    glVertexAttribDivisor(8, 1);
+
+    glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)(base + offsetof(InstanceData, object)));
+    glEnableVertexAttribArray(9);
+    glVertexAttribDivisor(9, 1);
+}
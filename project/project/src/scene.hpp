@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+#include <glengine/culling.hpp>
+#include <glengine/lightClusters.hpp>
+
+using namespace std;
+
+//Per-instance data, read by the shaders as instanced vertex attributes
+struct InstanceData {
+    glm::mat4 model;          // Locations 2 to 5
+    glm::vec3 color;          // Location 6 (the model color)
+    float outlineThickness;   // Location 7
+    glm::vec3 outlineColor;   // Location 8
+    uint32_t mesh;            // Index of the mesh drawn, not read by the shaders
+    uint32_t object;          // Location 9: position in instanceVBO + 1, the object id of the G-buffer
+};
+//The deferred shading reads the instances from instanceVBO as floats (gbuffer.glsl)
+static_assert(sizeof(InstanceData) == 25 * sizeof(float), "InstanceData layout is mirrored in gbuffer.glsl");
+
+//The streamed scene is a scan drawn from a cluster file (GLEngine::ClusterStreamer), it has no mesh instances
+enum class SceneType { SINGLE, STRESS, STREAMED };
+
+//Largest number of copies in the stress scene
+const int maxStressInstances = 10000;
+
+//Values of the ImGui window used to build the instances
+struct SceneParameters {
+    SceneType type = SceneType::SINGLE;
+    int instanceCount = 1000;
+    glm::vec3 rotation = glm::vec3(0.0f);   // Degrees around X, Y and Z
+    glm::vec3 color = glm::vec3(1.0f);
+    glm::vec3 outlineColor = glm::vec3(0.0f);
+    float outlineThickness = 0.01f;
+    int mesh = 0;         // Mesh of the model, and of all its copies in the stress scene
+};
+
+//Filling the instances of the scene: one model, or copies of it lined up on shelves
+void buildInstances(const SceneParameters& params, vector<InstanceData>& instances);
+
+//Instance of the streamed scan: centered, its largest side scaled to the size of the models, then
+//placed like the single model
+InstanceData buildStreamedInstance(const SceneParameters& params, const GLEngine::AABB& bounds);
+
+//Stage lights scattered around the scene bounds, hues spread over the color wheel.
+//The radius is a fraction of the largest side of the bounds.
+void buildStageLights(int count, const GLEngine::AABB& sceneBounds, float radius, float intensity,
+                      vector<GLEngine::PointLight>& lights);
+
+//Declaring the instanced attributes (locations 2 to 9) of the bound VAO, read from instanceVBO
+//starting at firstInstance (OpenGL 3.3 has no base instance for the draws)
+void setupInstanceAttributes(GLuint instanceVBO, uint32_t firstInstance = 0);
@@ -1,9 +1,67 @@
 #include "tools.hpp"
+#include "stbimage/stb_image_write.h"
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+//Lines of a file starting with the two characters of prefix, counted on raw blocks so the
+//arrays can be reserved to their exact size before parsing
+static size_t countLines(const string& filename, const char prefix[2]) {
+    ifstream in(filename, ios::binary);
+    vector<char> block(1 << 20);
+    size_t count = 0;
+    //A line start split between two blocks is carried over
+    int carried = 0;
+    bool lineStart = true;
+    while (in) {
+        in.read(block.data(), block.size());
+        size_t size = (size_t)in.gcount();
+        for (size_t i = 0; i < size; i++) {
+            if (carried == 1) {
+                count += block[i] == prefix[1];
+                carried = 0;
+            }
+            if (lineStart && block[i] == prefix[0]) {
+                if (i + 1 < size)
+                    count += block[i + 1] == prefix[1];
+                else
+                    carried = 1;
+            }
+            lineStart = block[i] == '\n';
+        }
+    }
+    return count;
+}
+
+//The 3 numbers at the start of text, separated by spaces
+static bool parseNumbers(const char* text, float numbers[3]) {
+    for (int i = 0; i < 3; i++) {
+        char* end;
+        numbers[i] = strtof(text, &end);
+        if (end == text)
+            return false;
+        text = end;
+    }
+    return true;
+}
+
+static bool parseNumbers(const char* text, unsigned int numbers[3]) {
+    for (int i = 0; i < 3; i++) {
+        char* end;
+        numbers[i] = (unsigned int)strtoul(text, &end, 10);
+        if (end == text)
+            return false;
+        text = end;
+    }
+    return true;
+}
 
 vector<float> fetchAllVertices(const string& filename){
     ifstream verticesStream;
     string vertice;
     vector<float> vertices;
+    vertices.reserve(countLines(filename, "v ") * 3);
 
     verticesStream.open(filename);
     
@@ -12,15 +70,10 @@ vector<float> fetchAllVertices(const string& filename){
             getline(verticesStream, vertice);
             // If the line starts with 'v' 
             if (!vertice.empty() && vertice[0] == 'v' && vertice[1] == ' ') {
-                // Only get what's after the v
-                istringstream iss(vertice.substr(2));
-                float point1, point2, point3;
-                // Get the 3 points
-                if(iss >> point1 >> point2 >> point3){
-                    vertices.push_back(point1);
-                    vertices.push_back(point2);
-                    vertices.push_back(point3);
-                }
+                // Get the 3 points after the v, straight from the line (no copy nor stream to allocate)
+                float points[3];
+                if(parseNumbers(vertice.c_str() + 2, points))
+                    vertices.insert(vertices.end(), points, points + 3);
                 else
                     cerr << "Couldn't read the line for the vertices" << endl;
             }
@@ -38,6 +91,7 @@ vector<unsigned int> fetchAllFaces(const string& filename){
     ifstream facesStream;
     string face;
     vector<unsigned int> faces;
+    faces.reserve(countLines(filename, "f ") * 3);
 
     facesStream.open(filename);
     
@@ -46,18 +100,12 @@ vector<unsigned int> fetchAllFaces(const string& filename){
             getline(facesStream, face);
             // If it starts with 'f' 
             if (!face.empty() && face[0] == 'f' && face[1] == ' ') {
-                // Only get what's after the f
-                istringstream iss(face.substr(2));
-                unsigned int face1, face2, face3;
-                // Get the 3 faces
-                if(iss >> face1 >> face2 >> face3){
+                // Get the 3 faces after the f
+                unsigned int indices[3];
+                if(parseNumbers(face.c_str() + 2, indices)){
                     // Offset the index by 1
-                    face1--;
-                    face2--;
-                    face3--;
-                    faces.push_back(face1);
-                    faces.push_back(face2);
-                    faces.push_back(face3);
+                    for (unsigned int index : indices)
+                        faces.push_back(index - 1);
                 }
                 else
                     cerr << "Couldn't read the line for the faces" << endl;
@@ -71,46 +119,10 @@ vector<unsigned int> fetchAllFaces(const string& filename){
     return faces;
 }
 
-vector<float> fetchAllTexCoords(const string& filename){
-    ifstream texturesStream;
-    string texCoord;
-    vector<float> textures;
-
-    texturesStream.open(filename);
-    
-    if(texturesStream.is_open()){
-        do{
-            getline(texturesStream, texCoord);
-            // If the line starts with 'v' 
-            if (!texCoord.empty() && texCoord[0] == 'v' && texCoord[1] == 't') {
-                // Only get what's after the v
-                istringstream iss(texCoord.substr(3));
-                float point1, point2, point3;
-                // Get the 3 points of the texture coordinates
-                if(iss >> point1 >> point2 >> point3){
-                    textures.push_back(point1);
-                    textures.push_back(point2);
-                    textures.push_back(point3);
-                }
-                else
-                    cerr << "Couldn't read the line for the texture coordinates" << endl;
-            }
-        } while(!texturesStream.eof());
-        texturesStream.close();
-    }
-    else
-        std::cerr << "Couldn't open file " << filename << " to read the textures." << std::endl;
-
-    return textures;
-}
-
-
 vector<float> computeNormal(const vector<float>& vertices,
                             const vector<unsigned int>& faces){
-    vector<float> normals;
-    //Initialize the normals vector
-    for (size_t i = 0; i < vertices.size(); i++)
-        normals.push_back(0);
+    //One normal per vertex, starting from zero
+    vector<float> normals(vertices.size(), 0.0f);
 
     //Compute the normals
     for (unsigned int i = 0; i < faces.size() - 3; i+=3){
@@ -145,15 +157,14 @@ vector<float> computeNormal(const vector<float>& vertices,
 }
 
 
+//The #include directives are expanded
 string readVertexShader(const string& filename) {
     ifstream vertexShaderFile(filename);
     if (!vertexShaderFile.is_open()) {
         std::cerr << "Couldn't open the vertex shader file" << std::endl;
         return "";
     }
-    stringstream iss;
-    iss << vertexShaderFile.rdbuf();
-    return iss.str();
+    return GLEngine::loadShaderSource(filename);
 }
 
 string readFragmentShader(const string& filename) {
@@ -162,57 +173,177 @@ string readFragmentShader(const string& filename) {
         std::cerr << "Couldn't open the fragment shader file" << std::endl;
         return "";
     }
-    stringstream iss;
-    iss << fragmentShaderFile.rdbuf();
-    return iss.str();
+    return GLEngine::loadShaderSource(filename);
 }
 
+GLuint createProgram(GLEngine::ProgramCache& cache, const string& vertexPath, const string& fragmentPath,
+                     const vector<string>& defines) {
+    vector<GLEngine::ShaderStage> stages = {
+        { GL_VERTEX_SHADER, readVertexShader(vertexPath), vertexPath },
+        { GL_FRAGMENT_SHADER, readFragmentShader(fragmentPath), fragmentPath }
+    };
+    GLuint program = cache.getProgram(stages, defines);
+    if (!program)
+        cerr << cache.getLastError();
+    return program;
+}
 
-//Reloading the 3D model
-void loadModel(const string& filename, 
+//Loading a 3D model into the geometry buffer
+uint32_t loadModel(const string& filename, 
                 vector<float>& vertices,
                 vector<unsigned int>& faces, 
-                vector<float>& texCoords,
                 vector<float>& normals,
-                int VBO, 
-                int EBO, 
-                int normalVBO) {
+                GLEngine::GeometryBuffer& geometry,
+                GLEngine::AABB& bounds,
+                vector<GLEngine::Meshlet>* meshlets,
+                GLEngine::Arena* scratch) {
     vertices = fetchAllVertices(filename);
     faces = fetchAllFaces(filename);
-    texCoords = fetchAllTexCoords(filename);
     normals = computeNormal(vertices, faces);
+    //Bounding box used for the culling
+    bounds = GLEngine::AABB::fromPositions(vertices.data(), vertices.size() / 3);
+    if (meshlets)
+        *meshlets = GLEngine::buildMeshlets(vertices.data(), vertices.size() / 3, faces.data(), faces.size(),
+                                            GLEngine::MeshletSettings(), scratch);
 
-    // We update the buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    //Suballocated in the shared buffers
+    return geometry.addMesh(vertices.data(), normals.data(), vertices.size() / 3, faces.data(), faces.size());
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(unsigned int), faces.data(), GL_STATIC_DRAW);
+//Header of the mesh cache files, followed by the meshlets then the compressed mesh
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t meshletCount;
+    uint64_t compressedBytes;
+};
+static const char meshCacheMagic[8] = { 'G', 'L', 'M', 'E', 'S', 'H', '3', '\0' };
 
-    glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
+string meshCacheFile(const string& directory, const string& objFile) {
+    error_code error;
+    uintmax_t size = filesystem::file_size(objFile, error);
+    auto date = filesystem::last_write_time(objFile, error).time_since_epoch().count();
+    stringstream name;
+    name << filesystem::path(objFile).stem().string() << "-" << hex << size << "-" << (uint64_t)date << ".mesh";
+    return directory + "/" + name.str();
 }
 
-vector<string> listObjFiles(const string& directory) {
-    vector<string> objFiles;
-    DIR *dir;
-    struct dirent *ent;
-    
-    if ((dir = opendir(directory.c_str())) != NULL) {
-        while ((ent = readdir(dir)) != NULL) {
-            string filename = ent->d_name;
-            // We only read .obj files
-            if (filename.length() > 4 && 
-                filename.substr(filename.length() - 4) == ".obj") 
-                objFiles.push_back("../objects/" + filename);
+bool saveMeshCache(const string& file, const vector<float>& vertices, const vector<float>& normals,
+                   const vector<unsigned int>& faces, const GLEngine::AABB& bounds,
+                   const vector<GLEngine::Meshlet>& meshlets, GLEngine::ThreadPool* pool) {
+    vector<uint8_t> compressed = GLEngine::compressMesh(vertices.data(), normals.data(), vertices.size() / 3, faces.data(),
+                                                        faces.size(), GLEngine::MeshCompressionSettings(), pool);
+    error_code error;
+    filesystem::create_directories(filesystem::path(file).parent_path(), error);
+    //Written aside then renamed, so a reader never sees half a file
+    string temporary = file + ".tmp";
+    ofstream out(temporary, ios::binary);
+    MeshCacheHeader header = {};
+    memcpy(header.magic, meshCacheMagic, sizeof(header.magic));
+    header.vertexCount = (uint32_t)(vertices.size() / 3);
+    header.indexCount = (uint32_t)faces.size();
+    header.meshletCount = (uint32_t)meshlets.size();
+    header.compressedBytes = compressed.size();
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)meshlets.data(), meshlets.size() * sizeof(GLEngine::Meshlet));
+    out.write((const char*)compressed.data(), compressed.size());
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write " << file << endl;
+        filesystem::remove(temporary, error);
+        return false;
+    }
+    filesystem::rename(temporary, file, error);
+    return !error;
+}
+
+bool loadMeshCache(const string& file, GLEngine::GeometryBuffer& geometry, uint32_t& id, size_t& vertexCount,
+                   size_t& indexCount, GLEngine::AABB& bounds, vector<GLEngine::Meshlet>& meshlets,
+                   GLEngine::ThreadPool* pool) {
+    vector<uint8_t> data;
+    MeshCacheHeader header;
+    if (!readBinaryFile(file, data) || data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    size_t meshletBytes = (size_t)header.meshletCount * sizeof(GLEngine::Meshlet);
+    if (memcmp(header.magic, meshCacheMagic, sizeof(header.magic)) != 0
+        || data.size() != sizeof(header) + meshletBytes + header.compressedBytes)
+        return false;
+    const uint8_t* compressed = data.data() + sizeof(header) + meshletBytes;
+    if (!GLEngine::getCompressedMeshSize(compressed, header.compressedBytes, vertexCount, indexCount)
+        || vertexCount != header.vertexCount || indexCount != header.indexCount)
+        return false;
+    GLEngine::MeshWriter writer = geometry.beginMesh(vertexCount, indexCount);
+    bool decoded = GLEngine::decompressMesh(compressed, header.compressedBytes, writer.positions, writer.normals,
+                                            writer.indices, pool);
+    geometry.commitMesh(writer);
+    if (!decoded) {
+        geometry.removeMesh(writer.id);
+        return false;
+    }
+    id = writer.id;
+    meshlets.resize(header.meshletCount);
+    memcpy(meshlets.data(), data.data() + sizeof(header), meshletBytes);
+    bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+bool readBinaryFile(const string& file, vector<uint8_t>& data) {
+    ifstream in(file, ios::binary | ios::ate);
+    if (!in)
+        return false;
+    data.resize((size_t)in.tellg());
+    in.seekg(0);
+    return (bool)in.read((char*)data.data(), data.size());
+}
+
+size_t getTextureMemorySize(GLuint texture, GLenum target) {
+    glBindTexture(target, texture);
+    size_t bytes = 0;
+    for (GLint level = 0; level < 32; level++) {
+        GLint width = 0, height = 0, depth = 0, compressed = 0;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+        if (width == 0)
+            break;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            bytes += size;
+            continue;
+        }
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+        GLint bits = 0;
+        for (GLenum channel : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE }) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, channel, &size);
+            bits += size;
         }
-        closedir(dir);
+        bytes += (size_t)width * height * depth * bits / 8;
     }
-    return objFiles;
+    glBindTexture(target, 0);
+    return bytes;
 }
 
-GLuint loadTexture(const char* path) {
-    
+GLuint loadTexture(const char* path, GLEngine::MipFilter filter, GLEngine::ThreadPool* pool) {
+    if (filesystem::path(path).extension() == ".ktx2") {
+        GLEngine::Ktx2Texture texture;
+        if (GLEngine::readKtx2(path, texture))
+            return GLEngine::createKtx2Texture(texture);
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        return 0;
+    }
+
     GLuint textureID;
     glGenTextures(1, &textureID);
     
@@ -220,8 +351,17 @@ GLuint loadTexture(const char* path) {
     unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
     if (data) {
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        //The format follows the channels of the file (RGB rows are not 4-byte aligned)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GLEngine::textureInternalFormat(nrChannels), width, height, 0,
+                     GLEngine::textureFormat(nrChannels), GL_UNSIGNED_BYTE, data);
+        //Mip levels filtered on the CPU rather than by glGenerateMipmap (a box filter in most drivers)
+        vector<vector<uint8_t>> levels = GLEngine::generateMipmaps(data, width, height, nrChannels, filter, pool);
+        for (size_t level = 0; level < levels.size(); level++)
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level + 1, GLEngine::textureInternalFormat(nrChannels), glm::max(width >> (level + 1), 1),
+                         glm::max(height >> (level + 1), 1), 0, GLEngine::textureFormat(nrChannels), GL_UNSIGNED_BYTE, levels[level].data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        GLEngine::setTextureSwizzle(GL_TEXTURE_2D, nrChannels);
         
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -233,4 +373,157 @@ GLuint loadTexture(const char* path) {
     stbi_image_free(data);
     
     return textureID;
-}
\ No newline at end of file
+}
+
+GLEngine::Ktx2Texture compressTonalArtMap(const GLEngine::TonalArtMap& map, GLEngine::ThreadPool* pool) {
+    GLEngine::Ktx2Texture texture;
+    texture.format = GLEngine::BlockFormat::BC4;
+    texture.width = texture.height = map.sizes[0];
+    texture.layerCount = map.toneCount;
+    //The tones are stacked vertically in each level, every one is a layer
+    for (int level = 0; level < map.levelCount; level++) {
+        int size = map.sizes[level];
+        vector<uint8_t> blocks;
+        for (int tone = 0; tone < map.toneCount; tone++) {
+            vector<uint8_t> layer = GLEngine::compressImage(map.levels[level].data() + (size_t)tone * size * size, size, size, 1,
+                                                            GLEngine::BlockFormat::BC4, pool);
+            blocks.insert(blocks.end(), layer.begin(), layer.end());
+        }
+        texture.levels.push_back(move(blocks));
+    }
+    return texture;
+}
+
+bool decodeImage(const string& path, GLEngine::DecodedImage& image) {
+    unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!data) {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        return false;
+    }
+    image.pixels.assign(data, data + (size_t)image.width * image.height * image.channels);
+    stbi_image_free(data);
+    return true;
+}
+
+bool decodeTexture(const string& path, GLEngine::DecodedImage& image, GLEngine::MipFilter filter, const string& cacheDirectory) {
+    if (!decodeImage(path, image))
+        return false;
+    string file = cacheDirectory.empty() ? string() : mipmapCacheFile(cacheDirectory, path, filter);
+    if (!file.empty() && loadMipmapCache(file, image))
+        return true;
+    image.mipLevels = GLEngine::generateMipmaps(image.pixels.data(), image.width, image.height, image.channels, filter);
+    if (!file.empty())
+        saveMipmapCache(file, image);
+    return true;
+}
+
+//Header of the mipmap cache files
+struct MipmapCacheHeader {
+    char magic[8];
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    int32_t levelCount;
+};
+static const char mipmapCacheMagic[8] = { 'G', 'L', 'M', 'I', 'P', 'S', '1', '\0' };
+
+string mipmapCacheFile(const string& directory, const string& imageFile, GLEngine::MipFilter filter) {
+    error_code error;
+    uintmax_t size = filesystem::file_size(imageFile, error);
+    auto date = filesystem::last_write_time(imageFile, error).time_since_epoch().count();
+    string filterName = GLEngine::mipFilterName(filter);
+    for (char& c : filterName)
+        c = (char)tolower((unsigned char)c);
+    stringstream name;
+    name << filesystem::path(imageFile).stem().string() << "-" << hex << size << "-" << (uint64_t)date << "-" << filterName << ".mips";
+    return directory + "/mipmaps/" + name.str();
+}
+
+bool saveMipmapCache(const string& file, const GLEngine::DecodedImage& image) {
+    error_code error;
+    filesystem::create_directories(filesystem::path(file).parent_path(), error);
+    //Written aside then renamed, several workers may store the same image
+    string temporary = file + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+    ofstream out(temporary, ios::binary);
+    MipmapCacheHeader header;
+    memcpy(header.magic, mipmapCacheMagic, sizeof(header.magic));
+    header.width = image.width;
+    header.height = image.height;
+    header.channels = image.channels;
+    header.levelCount = (int32_t)image.mipLevels.size();
+    out.write((const char*)&header, sizeof(header));
+    for (const vector<unsigned char>& level : image.mipLevels)
+        out.write((const char*)level.data(), level.size());
+    out.close();
+    if (!out) {
+        cerr << "Couldn't write " << file << endl;
+        filesystem::remove(temporary, error);
+        return false;
+    }
+    filesystem::rename(temporary, file, error);
+    return !error;
+}
+
+bool loadMipmapCache(const string& file, GLEngine::DecodedImage& image) {
+    ifstream in(file, ios::binary);
+    MipmapCacheHeader header;
+    if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, mipmapCacheMagic, sizeof(header.magic)) != 0
+        || header.width != image.width || header.height != image.height || header.channels != image.channels
+        || header.levelCount != GLEngine::mipLevelCount(image.width, image.height) - 1)
+        return false;
+    image.mipLevels.resize(header.levelCount);
+    for (int level = 0; level < header.levelCount; level++) {
+        image.mipLevels[level].resize((size_t)glm::max(image.width >> (level + 1), 1) * glm::max(image.height >> (level + 1), 1) * image.channels);
+        in.read((char*)image.mipLevels[level].data(), image.mipLevels[level].size());
+    }
+    if (!in) {
+        image.mipLevels.clear();
+        return false;
+    }
+    return true;
+}
+
+vector<string> listImageFiles(const string& directory) {
+    vector<string> files;
+    std::error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        string extension = entry.path().extension().string();
+        for (char& c : extension)
+            c = (char)tolower((unsigned char)c);
+        if (entry.is_regular_file(error) && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"
+                                             || extension == ".bmp" || extension == ".tga"))
+            files.push_back(entry.path().string());
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+OffscreenTarget createOffscreenTarget(int width, int height) {
+    OffscreenTarget target;
+    target.width = width;
+    target.height = height;
+    glGenRenderbuffers(1, &target.colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &target.depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depthRenderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Incomplete offscreen framebuffer " << width << "x" << height << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return target;
+}
+
+void deleteOffscreenTarget(OffscreenTarget& target) {
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.colorRenderbuffer);
+    glDeleteRenderbuffers(1, &target.depthRenderbuffer);
+    target = OffscreenTarget();
+}
+
@@ -6,8 +6,17 @@
 #include <format>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
-#include <dirent.h>
 #include "stbimage/stb_image.h"
+#include <glengine/culling.hpp>
+#include <glengine/geometryBuffer.hpp>
+#include <glengine/meshlets.hpp>
+#include <glengine/meshCompression.hpp>
+#include <glengine/programCache.hpp>
+#include <glengine/shaderSource.hpp>
+#include <glengine/tonalArtMap.hpp>
+#include <glengine/textureStreamer.hpp>
+#include <glengine/ktx2.hpp>
+#include <glengine/mipmapGenerator.hpp>
 
 
 using namespace std;
@@ -15,26 +24,75 @@ using namespace std;
 //Reading objects and applying normals
 vector<unsigned int> fetchAllFaces(const string& filename);
 vector<float> fetchAllVertices(const string& filename);
-vector<float> fetchAllTexCoords(const string& filename);
 vector<float> computeNormal(const vector<float>& vertices,
                             const vector<unsigned int>& faces);
 
 
-//Reading shaders
+//Reading shaders, with their #include "file" expanded
 string readVertexShader(const string& filename);
 string readFragmentShader(const string& filename);
+//Vertex/fragment program, from the binary cache or compiled, errors are printed (returns 0 on failure)
+GLuint createProgram(GLEngine::ProgramCache& cache, const string& vertexPath, const string& fragmentPath,
+                     const vector<string>& defines = {});
 
-//Reloading the 3D model chosen
-void loadModel(const string& filename, 
+//Loading a 3D model into the geometry buffer, returns its mesh id.
+//With meshlets, the faces are first reordered into meshlets (see GLEngine::buildMeshlets), its
+//temporaries taken from the scratch arena when there is one.
+uint32_t loadModel(const string& filename, 
                 vector<float>& vertices,
                 vector<unsigned int>& faces, 
-                vector<float>& texCoords,
                 vector<float>& normals,
-                int VBO, 
-                int EBO, 
-                int normalVBO);
-
-//Listing OBJ files
-vector<string> listObjFiles(const string& directory);
-//Loading a texture
-GLuint loadTexture(const char* path);
+                GLEngine::GeometryBuffer& geometry,
+                GLEngine::AABB& bounds,
+                vector<GLEngine::Meshlet>* meshlets = nullptr,
+                GLEngine::Arena* scratch = nullptr);
+
+//Mesh cache: a parsed model (bounds, meshlets, then positions, normals and indices compressed, see
+//GLEngine::compressMesh), read back without parsing the OBJ file. The file name changes with the size
+//and date of the OBJ file. The blocks of the mesh are encoded and decoded over the pool if any.
+string meshCacheFile(const string& directory, const string& objFile);
+bool saveMeshCache(const string& file, const vector<float>& vertices, const vector<float>& normals,
+                   const vector<unsigned int>& faces, const GLEngine::AABB& bounds,
+                   const vector<GLEngine::Meshlet>& meshlets, GLEngine::ThreadPool* pool = nullptr);
+//The mesh is decoded straight into the geometry buffer, in its mapped memory when it is persistently
+//mapped. False, with nothing added, when the file is missing or damaged.
+bool loadMeshCache(const string& file, GLEngine::GeometryBuffer& geometry, uint32_t& id, size_t& vertexCount,
+                   size_t& indexCount, GLEngine::AABB& bounds, vector<GLEngine::Meshlet>& meshlets,
+                   GLEngine::ThreadPool* pool = nullptr);
+//Whole content of a file, false when it can't be read
+bool readBinaryFile(const string& file, vector<uint8_t>& data);
+
+//Loading a texture, decoded and uploaded on the calling thread (see GLEngine::TextureStreamer otherwise),
+//its mip levels computed on the CPU, spread over the pool if any.
+//KTX2 files keep their compressed format and mip levels.
+GLuint loadTexture(const char* path, GLEngine::MipFilter filter = GLEngine::MipFilter::KAISER, GLEngine::ThreadPool* pool = nullptr);
+//GPU memory of a texture and its mip levels, as the driver reports them
+size_t getTextureMemorySize(GLuint texture, GLenum target = GL_TEXTURE_2D);
+//Decoding an image file with its own channel count, for the texture streamer's workers
+bool decodeImage(const string& path, GLEngine::DecodedImage& image);
+//Decoding an image with its mip levels, read from the cache directory or generated then stored there
+//(not cached when the directory is empty)
+bool decodeTexture(const string& path, GLEngine::DecodedImage& image, GLEngine::MipFilter filter, const string& cacheDirectory);
+//Image files (png, jpg, bmp, tga) of a directory, sorted, with their path
+vector<string> listImageFiles(const string& directory);
+
+//Mipmap cache: levels 1 to 1x1 of an image. The file name changes with the size and date of the image
+//and with the filter.
+string mipmapCacheFile(const string& directory, const string& imageFile, GLEngine::MipFilter filter);
+bool saveMipmapCache(const string& file, const GLEngine::DecodedImage& image);
+//The image must be decoded already, the levels have to match its size
+bool loadMipmapCache(const string& file, GLEngine::DecodedImage& image);
+
+//Framebuffer with a color and a depth/stencil renderbuffer, to render at another size than the window
+struct OffscreenTarget {
+    GLuint framebuffer = 0;
+    GLuint colorRenderbuffer = 0;
+    GLuint depthRenderbuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+OffscreenTarget createOffscreenTarget(int width, int height);
+void deleteOffscreenTarget(OffscreenTarget& target);
+
+//Tonal art map as a BC4 (RGTC1) texture array, one layer per tone, to be cached as KTX2
+GLEngine::Ktx2Texture compressTonalArtMap(const GLEngine::TonalArtMap& map, GLEngine::ThreadPool* pool);
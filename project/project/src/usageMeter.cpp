@@ -0,0 +1,71 @@
+#include "usageMeter.hpp"
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+
+double processCpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1.0e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1.0e6;
+}
+
+size_t processPeakMemory() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    //In kilobytes on Linux, in bytes on macOS
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+size_t processResidentMemory() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long pages = 0, resident = 0;
+    if (fscanf(statm, "%lu %lu", &pages, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return (size_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+UsageMeter::UsageMeter(double windowSeconds)
+    : windowSeconds(windowSeconds),
+      windowStart(chrono::steady_clock::now()),
+      cpuTimeStart(processCpuSeconds()),
+      gpuMsAccumulated(0.0),
+      framesRendered(0),
+      cpuPercent(0.0f),
+      gpuPercent(0.0f),
+      renderedFps(0.0f) {}
+
+void UsageMeter::frameRendered(float gpuMs) {
+    gpuMsAccumulated += gpuMs;
+    framesRendered++;
+}
+
+bool UsageMeter::refreshDue() const {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - windowStart;
+    return elapsed.count() >= windowSeconds;
+}
+
+bool UsageMeter::update() {
+    auto now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - windowStart).count();
+    if (elapsed < windowSeconds)
+        return false;
+
+    double cpuTime = processCpuSeconds();
+    cpuPercent = (float)(100.0 * (cpuTime - cpuTimeStart) / elapsed);
+    gpuPercent = (float)(100.0 * (gpuMsAccumulated / 1000.0) / elapsed);
+    renderedFps = (float)(framesRendered / elapsed);
+
+    windowStart = now;
+    cpuTimeStart = cpuTime;
+    gpuMsAccumulated = 0.0;
+    framesRendered = 0;
+    return true;
+}
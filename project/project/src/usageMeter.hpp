@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+using namespace std;
+
+//Measures how much CPU and GPU time the application uses over a sliding window,
+//so the idle cost of the render loop can be shown in the overlay
+class UsageMeter {
+public:
+    UsageMeter(double windowSeconds = 1.0);
+
+    //Called once per rendered frame with the GPU time of that frame
+    void frameRendered(float gpuMs);
+    //Recomputes the averages when the window is over, returns true if they changed
+    bool update();
+    //True when the window is over and the displayed values are stale
+    bool refreshDue() const;
+
+    float getCpuPercent() const { return cpuPercent; }
+    float getGpuPercent() const { return gpuPercent; }
+    float getRenderedFps() const { return renderedFps; }
+
+private:
+    double windowSeconds;
+    chrono::steady_clock::time_point windowStart;
+    double cpuTimeStart;
+    double gpuMsAccumulated;
+    int framesRendered;
+
+    float cpuPercent;
+    float gpuPercent;
+    float renderedFps;
+};
+
+//CPU time (user + system) consumed by the process, in seconds
+double processCpuSeconds();
+//Largest resident memory of the process so far, in bytes
+size_t processPeakMemory();
+//Resident memory of the process now, in bytes (0 where /proc is missing)
+size_t processResidentMemory();